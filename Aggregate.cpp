@@ -0,0 +1,584 @@
+#include "Aggregate.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <functional>
+#include <limits>
+
+static constexpr size_t kNoInput = static_cast<size_t>(-1);
+static constexpr uint64_t kNullKeyBits = 0x6e756c6c6e756c6cULL; // hash input of a NULL key
+
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static bool selected(const Selection& sel, size_t i) {
+    return (sel.words[i >> 6] >> (i & 63)) & 1;
+}
+
+static size_t countSelected(const Selection& sel) {
+    size_t n = 0;
+    for (size_t w = 0; w < kBatchWords; w++) {
+        n += static_cast<size_t>(std::popcount(sel.words[w]));
+    }
+    return n;
+}
+
+// Branch-free kernels over the selected values of one batch. Each handles 64
+// rows per selection word with a fixed trip count, so the compiler can
+// vectorize the inner loop; unselected rows contribute the identity.
+static int64_t sumInts(const int* v, size_t count, const Selection& sel) {
+    int64_t total = 0;
+    for (size_t base = 0; base < count; base += 64) {
+        uint64_t bits = sel.words[base >> 6];
+        size_t n = std::min<size_t>(64, count - base);
+        const int* block = v + base;
+        int64_t sum = 0;
+        if (n == 64) {
+            for (size_t j = 0; j < 64; j++) {
+                sum += int64_t(block[j]) & -int64_t((bits >> j) & 1);
+            }
+        } else {
+            for (size_t j = 0; j < n; j++) {
+                sum += int64_t(block[j]) & -int64_t((bits >> j) & 1);
+            }
+        }
+        total += sum;
+    }
+    return total;
+}
+
+// Float values masked by their selection bit: unselected ones become +0.0
+// (or `fill`) through integer masking, which keeps the loops free of branches
+static float maskFloat(float v, uint64_t bit, float fill) {
+    uint32_t x, f;
+    std::memcpy(&x, &v, 4);
+    std::memcpy(&f, &fill, 4);
+    uint32_t m = -static_cast<uint32_t>(bit);
+    x = (x & m) | (f & ~m);
+    std::memcpy(&v, &x, 4);
+    return v;
+}
+
+// Eight independent accumulators keep the additions in a fixed order per
+// lane, which lets the loop vectorize without reassociating doubles
+static double sumFloats(const float* v, size_t count, const Selection& sel) {
+    double lanes[8] = {};
+    for (size_t base = 0; base < count; base += 64) {
+        uint64_t bits = sel.words[base >> 6];
+        size_t n = std::min<size_t>(64, count - base);
+        const float* block = v + base;
+        if (n == 64) {
+            for (size_t j = 0; j < 64; j += 8) {
+                for (size_t l = 0; l < 8; l++) {
+                    lanes[l] += maskFloat(block[j + l], (bits >> (j + l)) & 1, 0.0f);
+                }
+            }
+        } else {
+            for (size_t j = 0; j < n; j++) {
+                lanes[j & 7] += maskFloat(block[j], (bits >> j) & 1, 0.0f);
+            }
+        }
+    }
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+static void minMaxInts(const int* v, size_t count, const Selection& sel, int& lo, int& hi) {
+    const int top = std::numeric_limits<int>::max();
+    const int bottom = std::numeric_limits<int>::min();
+    lo = top;
+    hi = bottom;
+    for (size_t base = 0; base < count; base += 64) {
+        uint64_t bits = sel.words[base >> 6];
+        size_t n = std::min<size_t>(64, count - base);
+        const int* block = v + base;
+        for (size_t j = 0; j < n; j++) {
+            int m = -static_cast<int>((bits >> j) & 1);
+            lo = std::min(lo, (block[j] & m) | (top & ~m));
+            hi = std::max(hi, (block[j] & m) | (bottom & ~m));
+        }
+    }
+}
+
+static void minMaxFloats(const float* v, size_t count, const Selection& sel, float& lo, float& hi) {
+    const float top = std::numeric_limits<float>::infinity();
+    lo = top;
+    hi = -top;
+    for (size_t base = 0; base < count; base += 64) {
+        uint64_t bits = sel.words[base >> 6];
+        size_t n = std::min<size_t>(64, count - base);
+        const float* block = v + base;
+        for (size_t j = 0; j < n; j++) {
+            uint64_t bit = (bits >> j) & 1;
+            lo = std::min(lo, maskFloat(block[j], bit, top));
+            hi = std::max(hi, maskFloat(block[j], bit, -top));
+        }
+    }
+}
+
+HashAggregator::HashAggregator(const Table& t, const std::vector<int>& groups,
+                               const std::vector<AggregateSpec>& specs)
+    : table(t), groupColumns(groups), aggregates(specs) {
+    auto inputFor = [this](int column) {
+        for (size_t i = 0; i < inputs.size(); i++) {
+            if (inputs[i].column == column) {
+                return i;
+            }
+        }
+        ColumnBatch input;
+        input.column = column;
+        input.type = table.getColumns()[column].getType();
+        inputs.push_back(std::move(input));
+        return inputs.size() - 1;
+    };
+    for (int column : groupColumns) {
+        groupInput.push_back(inputFor(column));
+    }
+    for (const auto& spec : aggregates) {
+        aggregateInput.push_back(spec.column < 0 ? kNoInput : inputFor(spec.column));
+    }
+    probe.resize(groupColumns.size());
+
+    if (groupColumns.empty()) {
+        // A query without GROUP BY has exactly one group, even over no rows
+        groupCount = 1;
+        states.resize(aggregates.size());
+    } else {
+        slots.assign(64, 0);
+    }
+}
+
+size_t HashAggregator::getGroupCount() const {
+    return groupCount;
+}
+
+size_t HashAggregator::getMemoryUsage() const {
+    return slots.capacity() * sizeof(uint32_t) + hashes.capacity() * sizeof(uint64_t) +
+           keys.capacity() * sizeof(KeyPart) + states.capacity() * sizeof(AggregateState);
+}
+
+size_t HashAggregator::findOrInsert(const KeyPart* key, uint64_t hash) {
+    size_t width = groupColumns.size();
+    size_t mask = slots.size() - 1;
+    for (size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+        uint32_t slot = slots[pos];
+        if (slot == 0) {
+            size_t group = groupCount++;
+            slots[pos] = static_cast<uint32_t>(group + 1);
+            hashes.push_back(hash);
+            keys.insert(keys.end(), key, key + width);
+            states.resize(states.size() + aggregates.size());
+            if (groupCount * 2 > slots.size()) {
+                grow();
+            }
+            return group;
+        }
+        size_t group = slot - 1;
+        if (hashes[group] == hash && std::equal(key, key + width, keys.begin() + group * width)) {
+            return group;
+        }
+    }
+}
+
+// Doubles the slot array, keeping the load factor at or below one half
+void HashAggregator::grow() {
+    slots.assign(slots.size() * 2, 0);
+    size_t mask = slots.size() - 1;
+    for (size_t group = 0; group < groupCount; group++) {
+        size_t pos = hashes[group] & mask;
+        while (slots[pos] != 0) {
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = static_cast<uint32_t>(group + 1);
+    }
+}
+
+void HashAggregator::loadBatch(size_t first, size_t count) {
+    const TableStorage& storage = table.getStorage();
+    for (auto& input : inputs) {
+        input.nulls = storage.getNulls(input.column, first, count, input.nullScratch);
+        switch (input.type) {
+            case ColumnType::INT:
+                input.ints = storage.getInts(input.column, first, count, input.intScratch);
+                break;
+            case ColumnType::FLOAT:
+                input.floats = storage.getFloats(input.column, first, count, input.floatScratch);
+                break;
+            case ColumnType::BOOLEAN:
+                storage.getBools(input.column, first, count, input.bools);
+                break;
+            case ColumnType::STRING:
+                input.dictionary = storage.getStringCodes(input.column, first, count, input.codes);
+                if (!input.dictionary) {
+                    storage.getStrings(input.column, first, count, input.strings);
+                } else if (input.cached != input.dictionary) {
+                    input.cached = input.dictionary;
+                    size_t entries = input.dictionary->dictionarySize();
+                    input.codeHashes.resize(entries);
+                    for (size_t code = 0; code < entries; code++) {
+                        input.codeHashes[code] =
+                            std::hash<std::string_view>{}(input.dictionary->dictionaryAt(static_cast<uint16_t>(code)));
+                    }
+                    input.codeGroups.assign(entries, 0);
+                }
+                break;
+        }
+    }
+}
+
+void HashAggregator::update(AggregateState& state, const AggregateSpec& spec, const ColumnBatch& input, size_t i) {
+    if (input.isNull(i)) {
+        return;
+    }
+    bool first = state.count == 0;
+    state.count++;
+    switch (spec.function) {
+        case AggregateFunction::COUNT:
+            break;
+        case AggregateFunction::SUM:
+        case AggregateFunction::AVG:
+            if (spec.type == ColumnType::INT) {
+                state.intValue += input.ints[i];
+            } else {
+                state.floatValue += input.floats[i];
+            }
+            break;
+        case AggregateFunction::MIN:
+        case AggregateFunction::MAX: {
+            bool isMin = spec.function == AggregateFunction::MIN;
+            switch (spec.type) {
+                case ColumnType::INT: {
+                    int64_t v = input.ints[i];
+                    if (first || (isMin ? v < state.intValue : v > state.intValue)) {
+                        state.intValue = v;
+                    }
+                    break;
+                }
+                case ColumnType::FLOAT: {
+                    double v = input.floats[i];
+                    if (first || (isMin ? v < state.floatValue : v > state.floatValue)) {
+                        state.floatValue = v;
+                    }
+                    break;
+                }
+                case ColumnType::BOOLEAN: {
+                    int64_t v = (input.bools[i >> 6] >> (i & 63)) & 1;
+                    if (first || (isMin ? v < state.intValue : v > state.intValue)) {
+                        state.intValue = v;
+                    }
+                    break;
+                }
+                case ColumnType::STRING: {
+                    std::string_view v = input.string(i);
+                    if (first || (isMin ? v < state.stringValue : v > state.stringValue)) {
+                        state.stringValue = v;
+                    }
+                    break;
+                }
+            }
+            break;
+        }
+    }
+}
+
+void HashAggregator::combine(AggregateState& into, const AggregateState& from, const AggregateSpec& spec) {
+    if (from.count == 0) {
+        return;
+    }
+    bool first = into.count == 0;
+    into.count += from.count;
+    switch (spec.function) {
+        case AggregateFunction::COUNT:
+            break;
+        case AggregateFunction::SUM:
+        case AggregateFunction::AVG:
+            into.intValue += from.intValue;
+            into.floatValue += from.floatValue;
+            break;
+        case AggregateFunction::MIN:
+        case AggregateFunction::MAX: {
+            bool isMin = spec.function == AggregateFunction::MIN;
+            if (first) {
+                into.intValue = from.intValue;
+                into.floatValue = from.floatValue;
+                into.stringValue = from.stringValue;
+            } else if (isMin) {
+                into.intValue = std::min(into.intValue, from.intValue);
+                into.floatValue = std::min(into.floatValue, from.floatValue);
+                into.stringValue = std::min(into.stringValue, from.stringValue);
+            } else {
+                into.intValue = std::max(into.intValue, from.intValue);
+                into.floatValue = std::max(into.floatValue, from.floatValue);
+                into.stringValue = std::max(into.stringValue, from.stringValue);
+            }
+            break;
+        }
+    }
+}
+
+void HashAggregator::consume(size_t first, size_t count, const Selection& sel) {
+    bool any = false;
+    for (size_t w = 0; w < kBatchWords; w++) {
+        any |= sel.words[w] != 0;
+    }
+    if (!any) {
+        return;
+    }
+    loadBatch(first, count);
+    if (groupColumns.empty()) {
+        consumeSingle(count, sel);
+    } else {
+        consumeGrouped(first, count, sel);
+    }
+}
+
+// NULL inputs are dropped from the selection up front, so the kernels
+// below never see them
+void HashAggregator::consumeSingle(size_t count, const Selection& sel) {
+    for (size_t a = 0; a < aggregates.size(); a++) {
+        const AggregateSpec& spec = aggregates[a];
+        AggregateState& state = states[a];
+        if (aggregateInput[a] == kNoInput) {
+            state.count += static_cast<int64_t>(countSelected(sel));
+            continue;
+        }
+        const ColumnBatch& input = inputs[aggregateInput[a]];
+        Selection valid = sel;
+        if (input.nulls) {
+            for (size_t w = 0; w * 64 < count; w++) {
+                valid.words[w] &= ~input.nulls[w];
+            }
+        }
+        size_t rows = countSelected(valid);
+        bool numeric = spec.type == ColumnType::INT || spec.type == ColumnType::FLOAT;
+        if (spec.function == AggregateFunction::COUNT) {
+            state.count += static_cast<int64_t>(rows);
+            continue;
+        }
+        if (rows == 0) {
+            continue;
+        }
+        if (!numeric) {
+            for (size_t i = 0; i < count; i++) {
+                if (selected(valid, i)) {
+                    update(state, spec, input, i);
+                }
+            }
+            continue;
+        }
+
+        bool first = state.count == 0;
+        state.count += static_cast<int64_t>(rows);
+        switch (spec.function) {
+            case AggregateFunction::SUM:
+            case AggregateFunction::AVG:
+                if (spec.type == ColumnType::INT) {
+                    state.intValue += sumInts(input.ints, count, valid);
+                } else {
+                    state.floatValue += sumFloats(input.floats, count, valid);
+                }
+                break;
+            case AggregateFunction::MIN:
+            case AggregateFunction::MAX: {
+                bool isMin = spec.function == AggregateFunction::MIN;
+                if (spec.type == ColumnType::INT) {
+                    int lo, hi;
+                    minMaxInts(input.ints, count, valid, lo, hi);
+                    int64_t v = isMin ? lo : hi;
+                    state.intValue = first ? v : (isMin ? std::min(state.intValue, v) : std::max(state.intValue, v));
+                } else {
+                    float lo, hi;
+                    minMaxFloats(input.floats, count, valid, lo, hi);
+                    double v = isMin ? lo : hi;
+                    state.floatValue = first ? v : (isMin ? std::min(state.floatValue, v) : std::max(state.floatValue, v));
+                }
+                break;
+            }
+            case AggregateFunction::COUNT:
+                break;
+        }
+    }
+}
+
+void HashAggregator::updateGroup(size_t group, size_t i) {
+    AggregateState* groupStates = states.data() + group * aggregates.size();
+    for (size_t a = 0; a < aggregates.size(); a++) {
+        if (aggregateInput[a] == kNoInput) {
+            groupStates[a].count++;
+        } else {
+            update(groupStates[a], aggregates[a], inputs[aggregateInput[a]], i);
+        }
+    }
+}
+
+// GROUP BY a single dictionary encoded column: a row's group comes from
+// its code, so each distinct value is hashed and looked up once per chunk
+void HashAggregator::consumeCodes(size_t count, const Selection& sel) {
+    ColumnBatch& input = inputs[groupInput[0]];
+    KeyPart& part = probe[0];
+    for (size_t i = 0; i < count; i++) {
+        if (!selected(sel, i)) {
+            continue;
+        }
+        if (input.isNull(i)) {
+            readKey(part, input, i);
+            updateGroup(findOrInsert(probe.data(), mix(part.bits)), i);
+            continue;
+        }
+        uint16_t code = input.codes[i];
+        if (input.codeGroups[code] == 0) {
+            part.text = input.dictionary->dictionaryAt(code);
+            part.bits = input.codeHashes[code];
+            part.null = false;
+            // The hash consumeGrouped gives a one-column key
+            input.codeGroups[code] = static_cast<uint32_t>(findOrInsert(probe.data(), mix(part.bits)) + 1);
+        }
+        updateGroup(input.codeGroups[code] - 1, i);
+    }
+}
+
+void HashAggregator::readKey(KeyPart& part, const ColumnBatch& input, size_t i) const {
+    part.null = input.isNull(i);
+    part.text = {};
+    if (part.null) {
+        part.bits = kNullKeyBits;
+        return;
+    }
+    switch (input.type) {
+        case ColumnType::INT:
+            part.bits = static_cast<uint32_t>(input.ints[i]);
+            break;
+        case ColumnType::FLOAT: {
+            float f = input.floats[i];
+            if (f == 0.0f) {
+                f = 0.0f; // -0.0 and 0.0 are one group
+            }
+            uint32_t bits;
+            std::memcpy(&bits, &f, 4);
+            part.bits = bits;
+            break;
+        }
+        case ColumnType::BOOLEAN:
+            part.bits = (input.bools[i >> 6] >> (i & 63)) & 1;
+            break;
+        case ColumnType::STRING:
+            if (input.dictionary) {
+                uint16_t code = input.codes[i];
+                part.text = input.dictionary->dictionaryAt(code);
+                part.bits = input.codeHashes[code];
+            } else {
+                part.text = input.strings[i];
+                part.bits = std::hash<std::string_view>{}(part.text);
+            }
+            break;
+    }
+}
+
+void HashAggregator::consumeGrouped(size_t, size_t count, const Selection& sel) {
+    size_t width = groupColumns.size();
+    if (width == 1 && inputs[groupInput[0]].dictionary) {
+        consumeCodes(count, sel);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!selected(sel, i)) {
+            continue;
+        }
+        uint64_t hash = 0;
+        for (size_t k = 0; k < width; k++) {
+            KeyPart& part = probe[k];
+            readKey(part, inputs[groupInput[k]], i);
+            hash = mix(hash ^ part.bits ^ (k * 0x9e3779b97f4a7c15ULL));
+        }
+        updateGroup(findOrInsert(probe.data(), hash), i);
+    }
+}
+
+void HashAggregator::merge(const HashAggregator& other) {
+    size_t width = groupColumns.size();
+    for (size_t g = 0; g < other.groupCount; g++) {
+        size_t group = width == 0 ? 0 : findOrInsert(other.keys.data() + g * width, other.hashes[g]);
+        for (size_t a = 0; a < aggregates.size(); a++) {
+            combine(states[group * aggregates.size() + a], other.states[g * aggregates.size() + a], aggregates[a]);
+        }
+    }
+}
+
+void HashAggregator::writeKey(ResultBuffer& out, size_t group, size_t keyColumn) const {
+    const KeyPart& part = keys[group * groupColumns.size() + keyColumn];
+    if (part.null) {
+        out.null();
+        return;
+    }
+    switch (inputs[groupInput[keyColumn]].type) {
+        case ColumnType::INT:
+            out.value(static_cast<int>(static_cast<uint32_t>(part.bits)));
+            break;
+        case ColumnType::FLOAT: {
+            uint32_t bits = static_cast<uint32_t>(part.bits);
+            float f;
+            std::memcpy(&f, &bits, 4);
+            out.value(f);
+            break;
+        }
+        case ColumnType::BOOLEAN:
+            out.value(part.bits != 0);
+            break;
+        case ColumnType::STRING:
+            out.value(part.text);
+            break;
+    }
+}
+
+void HashAggregator::writeAggregate(ResultBuffer& out, size_t group, size_t aggregate) const {
+    const AggregateSpec& spec = aggregates[aggregate];
+    const AggregateState& state = states[group * aggregates.size() + aggregate];
+    if (spec.function == AggregateFunction::COUNT) {
+        out.value(state.count);
+        return;
+    }
+    if (state.count == 0) {
+        out.null();
+        return;
+    }
+    switch (spec.function) {
+        case AggregateFunction::SUM:
+            if (spec.type == ColumnType::INT) {
+                out.value(state.intValue);
+            } else {
+                out.value(state.floatValue);
+            }
+            break;
+        case AggregateFunction::AVG:
+            if (spec.type == ColumnType::INT) {
+                out.value(static_cast<double>(state.intValue) / static_cast<double>(state.count));
+            } else {
+                out.value(state.floatValue / static_cast<double>(state.count));
+            }
+            break;
+        case AggregateFunction::MIN:
+        case AggregateFunction::MAX:
+            switch (spec.type) {
+                case ColumnType::INT:
+                    out.value(static_cast<int>(state.intValue));
+                    break;
+                case ColumnType::FLOAT:
+                    out.value(static_cast<float>(state.floatValue));
+                    break;
+                case ColumnType::BOOLEAN:
+                    out.value(state.intValue != 0);
+                    break;
+                case ColumnType::STRING:
+                    out.value(state.stringValue);
+                    break;
+            }
+            break;
+        case AggregateFunction::COUNT:
+            break;
+    }
+}
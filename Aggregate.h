@@ -0,0 +1,127 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Filter.h"
+#include "ResultSink.h"
+
+enum class AggregateFunction {
+    COUNT,
+    SUM,
+    AVG,
+    MIN,
+    MAX
+};
+
+struct AggregateSpec {
+    AggregateFunction function;
+    int column = -1;                     // -1: COUNT(*)
+    ColumnType type = ColumnType::INT;   // type of the input column
+};
+
+// Running state of one aggregate in one group. count is the number of input
+// rows; SUM/AVG and MIN/MAX keep INT and BOOLEAN inputs in intValue, FLOAT in
+// floatValue and STRING in stringValue (a view into table storage, valid
+// while the table is unchanged).
+struct AggregateState {
+    int64_t count = 0;
+    int64_t intValue = 0;
+    double floatValue = 0;
+    std::string_view stringValue;
+};
+
+// Hash aggregation over the rows a Filter selects. Aggregates skip NULL
+// inputs, as COUNT(column) does; COUNT(*) counts every row. Groups live in an
+// open-addressing table keyed by the typed GROUP BY values; every worker of
+// a parallel scan fills its own aggregator and the partials are merged at
+// the end. Without GROUP BY there is a single group and INT/FLOAT inputs go
+// through branch-free loops the compiler can vectorize.
+class HashAggregator {
+private:
+    // One GROUP BY value: numbers and booleans as bits, strings as views.
+    // All NULLs of a column form one group.
+    struct KeyPart {
+        uint64_t bits = 0;
+        std::string_view text;
+        bool null = false;
+
+        bool operator==(const KeyPart& other) const {
+            return bits == other.bits && text == other.text && null == other.null;
+        }
+    };
+
+    // A batch of one input column, fetched once per batch
+    struct ColumnBatch {
+        int column;
+        ColumnType type;
+        std::vector<int> intScratch;
+        std::vector<float> floatScratch;
+        const int* ints = nullptr;
+        const float* floats = nullptr;
+        uint64_t bools[kBatchWords] = {};
+        std::vector<std::string_view> strings;
+        std::vector<uint64_t> nullScratch;
+        const uint64_t* nulls = nullptr; // null when the batch has no NULLs
+
+        // STRING batches inside a dictionary chunk come as codes instead.
+        // Entry hashes and, for a lone GROUP BY column, the group of each
+        // code (+1, 0 unknown) are cached until the chunk changes.
+        const uint16_t* codes = nullptr;
+        const ColumnChunk* dictionary = nullptr;
+        const ColumnChunk* cached = nullptr;
+        std::vector<uint64_t> codeHashes;
+        std::vector<uint32_t> codeGroups;
+
+        std::string_view string(size_t i) const {
+            return dictionary ? dictionary->dictionaryAt(codes[i]) : strings[i];
+        }
+
+        bool isNull(size_t i) const {
+            return nulls && ((nulls[i >> 6] >> (i & 63)) & 1);
+        }
+    };
+
+    const Table& table;
+    std::vector<int> groupColumns;
+    std::vector<AggregateSpec> aggregates;
+
+    std::vector<uint32_t> slots;            // group id + 1, 0 is empty; power of two
+    std::vector<uint64_t> hashes;           // per group
+    std::vector<KeyPart> keys;              // groupCount * groupColumns.size()
+    std::vector<AggregateState> states;     // groupCount * aggregates.size()
+    size_t groupCount = 0;
+
+    std::vector<ColumnBatch> inputs;        // distinct columns read per batch
+    std::vector<size_t> groupInput;         // input of each GROUP BY column
+    std::vector<size_t> aggregateInput;     // input of each aggregate, npos for COUNT(*)
+    std::vector<KeyPart> probe;
+
+    size_t findOrInsert(const KeyPart* key, uint64_t hash);
+    void grow();
+    void loadBatch(size_t first, size_t count);
+    void consumeGrouped(size_t first, size_t count, const Selection& sel);
+    void consumeCodes(size_t count, const Selection& sel);
+    void updateGroup(size_t group, size_t i);
+    void consumeSingle(size_t count, const Selection& sel);
+    void readKey(KeyPart& part, const ColumnBatch& input, size_t i) const;
+    static void update(AggregateState& state, const AggregateSpec& spec, const ColumnBatch& input, size_t i);
+    static void combine(AggregateState& into, const AggregateState& from, const AggregateSpec& spec);
+
+public:
+    HashAggregator(const Table& table, const std::vector<int>& groupColumns,
+                   const std::vector<AggregateSpec>& aggregates);
+
+    // Adds the selected rows of the batch [first, first + count)
+    void consume(size_t first, size_t count, const Selection& sel);
+    void merge(const HashAggregator& other);
+
+    size_t getGroupCount() const;
+    size_t getMemoryUsage() const; // bytes held by the groups and their table
+    void writeKey(ResultBuffer& out, size_t group, size_t keyColumn) const;
+    void writeAggregate(ResultBuffer& out, size_t group, size_t aggregate) const; // NULL for no input rows
+};
+
+#endif //AGGREGATE_H
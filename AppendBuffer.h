@@ -0,0 +1,157 @@
+#ifndef APPENDBUFFER_H
+#define APPENDBUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include "CopyOnWrite.h"
+
+// Growable array of trivially copyable items whose copies share memory, so
+// copying one costs a reference count. Items are only ever written through
+// mutableData(), which first gives a copy items of its own if another copy
+// shares them. Appending needs no such copy: the new items go past the end
+// of every copy sharing the memory while there is room, and a copy never
+// reads past its own size(). That lets a table append to the last block it
+// shares with a snapshot without copying the block.
+//
+// Of several copies sharing memory, the one that appended last (or the
+// original) may append in place; the others reallocate on their first append.
+template <typename T>
+class AppendBuffer {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+private:
+    struct Items {
+        std::unique_ptr<T[]> data;
+        size_t capacity = 0;
+        size_t claimed = 0; // items written by some copy; the rest are free
+    };
+
+    std::shared_ptr<Items> items;
+    size_t used = 0;
+
+    void reallocate(size_t capacity) {
+        auto fresh = std::make_shared<Items>();
+        fresh->data = std::make_unique_for_overwrite<T[]>(capacity);
+        fresh->capacity = capacity;
+        fresh->claimed = used;
+        if (used > 0) {
+            std::memcpy(fresh->data.get(), items->data.get(), used * sizeof(T));
+        }
+        items = std::move(fresh);
+    }
+
+public:
+    AppendBuffer() = default;
+    AppendBuffer(const AppendBuffer&) = default;
+    AppendBuffer& operator=(const AppendBuffer&) = default;
+    AppendBuffer(AppendBuffer&& other) noexcept : items(std::move(other.items)), used(other.used) {
+        other.used = 0;
+    }
+    AppendBuffer& operator=(AppendBuffer&& other) noexcept {
+        items = std::move(other.items);
+        used = other.used;
+        other.used = 0;
+        return *this;
+    }
+
+    size_t size() const { return used; }
+    bool empty() const { return used == 0; }
+    size_t capacity() const { return items ? items->capacity : 0; }
+    const T* data() const { return items ? items->data.get() : nullptr; }
+    const T& operator[](size_t i) const { return items->data[i]; }
+    const T& back() const { return items->data[used - 1]; }
+
+    // Copies are made by the table's writer for snapshots (see soleOwner)
+    T* mutableData() {
+        if (!items) {
+            return nullptr;
+        }
+        if (!soleOwner(items)) {
+            reallocate(items->capacity);
+        }
+        return items->data.get();
+    }
+
+    // Appends n items, left uninitialized, and returns them
+    T* grow(size_t n) {
+        if (!items || items->claimed != used || used + n > items->capacity) {
+            reallocate(std::max(used + n, 2 * capacity()));
+        }
+        T* out = items->data.get() + used;
+        used += n;
+        items->claimed = used;
+        return out;
+    }
+    void push_back(const T& value) { *grow(1) = value; }
+    void append(const T* values, size_t n) {
+        if (n > 0) {
+            std::memcpy(grow(n), values, n * sizeof(T));
+        }
+    }
+    void assign(const T* values, size_t n) {
+        clear();
+        append(values, n);
+    }
+    // New items are value-initialized
+    void resize(size_t n) {
+        if (n > used) {
+            std::fill_n(grow(n - used), n - used, T{});
+        } else {
+            truncate(n);
+        }
+    }
+    // Drops the items past n. Other copies may still read them, so unless
+    // none shares the memory they stay claimed and aren't written again.
+    void truncate(size_t n) {
+        if (n >= used) {
+            return;
+        }
+        used = n;
+        if (soleOwner(items)) {
+            items->claimed = n;
+        }
+    }
+    void reserve(size_t n) {
+        if (n > capacity()) {
+            reallocate(n);
+        }
+    }
+    void shrinkToFit() {
+        if (used == 0) {
+            clear();
+        } else if (used < capacity()) {
+            reallocate(used);
+        }
+    }
+    void clear() {
+        items.reset();
+        used = 0;
+    }
+
+    // Removes items [first, first + n), moving the rest down
+    void erase(size_t first, size_t n) {
+        T* out = mutableData();
+        std::memmove(out + first, out + first + n, (used - first - n) * sizeof(T));
+        truncate(used - n);
+    }
+    // Replaces items [first, first + n) with the m items at values
+    void replace(size_t first, size_t n, const T* values, size_t m) {
+        size_t rest = used - first - n;
+        if (m > n) {
+            grow(m - n);
+        }
+        T* out = mutableData();
+        std::memmove(out + first + m, out + first + n, rest * sizeof(T));
+        if (m > 0) {
+            std::memcpy(out + first, values, m * sizeof(T));
+        }
+        if (m < n) {
+            truncate(used - (n - m));
+        }
+    }
+};
+
+#endif //APPENDBUFFER_H
@@ -7,3 +7,24 @@
 
 const std::string& Column::getName() const { return this->name;}
 ColumnType Column::getType() const{ return this->type;}
+bool Column::isNullable() const { return this->nullable; }
+const Value& Column::getDefault() const { return this->defaultValue; }
+bool Column::hasDefault() const { return !isNull(this->defaultValue); }
+
+Value defaultValueFor(ColumnType type) {
+    switch (type) {
+        case ColumnType::INT:
+            return 0;
+        case ColumnType::FLOAT:
+            return 0.0f;
+        case ColumnType::STRING:
+            return std::string("");
+        case ColumnType::BOOLEAN:
+            return false;
+    }
+    return 0;
+}
+
+bool isNull(const Value& value) {
+    return std::holds_alternative<std::monostate>(value);
+}
@@ -15,17 +15,29 @@ enum class ColumnType {
     STRING,
     BOOLEAN
 };
-using Value = std::variant<int, float, std::string, bool>;
+// std::monostate is SQL NULL; it comes last so the other alternatives keep
+// the indices they are serialized with
+using Value = std::variant<int, float, std::string, bool, std::monostate>;
+
+// Value a NOT NULL column falls back to, and what a NULL cell holds in storage
+Value defaultValueFor(ColumnType type);
+bool isNull(const Value& value);
+
 class Column {
     private:
       std::string name;
       ColumnType type;
-      bool isNull;
+      bool nullable;
+      Value defaultValue; // DEFAULT clause, NULL when there is none
     public:
-      Column(const std::string& n, ColumnType t, bool isNull = true) : name(n), type(t), isNull(isNull) {}
+      Column(const std::string& n, ColumnType t, bool nullable = true, Value defaultValue = std::monostate{})
+          : name(n), type(t), nullable(nullable), defaultValue(std::move(defaultValue)) {}
 
       const std::string& getName() const;
       ColumnType getType() const;
+      bool isNullable() const;
+      const Value& getDefault() const;
+      bool hasDefault() const;
 
 
 };
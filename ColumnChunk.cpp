@@ -0,0 +1,454 @@
+#include "ColumnChunk.h"
+#include <stdexcept>
+#include <unordered_map>
+
+ColumnChunk::ColumnChunk(ColumnType t) : type(t) {
+    if (type == ColumnType::STRING) {
+        offsets.push_back(0);
+    }
+}
+
+ColumnChunk::ColumnChunk(ColumnType t, size_t n, std::shared_ptr<const MappedFile> file, const char* payload)
+    : type(t), count(n), mapping(std::move(file)), mapped(payload) {}
+
+ColumnChunk::ColumnChunk(size_t n, uint32_t entries, std::shared_ptr<const MappedFile> file, const char* payload)
+    : type(ColumnType::STRING), count(n), dictionary(true), dictionaryEntries(entries),
+      mapping(std::move(file)), mapped(payload) {}
+
+// Bytes of a dictionary block's codes, padded so the offsets are aligned
+static size_t codeBytes(size_t count) {
+    return (count * sizeof(uint16_t) + 3) & ~size_t(3);
+}
+
+ColumnType ColumnChunk::getType() const { return type; }
+size_t ColumnChunk::size() const { return count; }
+bool ColumnChunk::isMapped() const { return mapped != nullptr; }
+
+bool ColumnChunk::isNull(size_t i) const {
+    if (mapped) {
+        return mappedNulls && ((mappedNulls[i >> 6] >> (i & 63)) & 1);
+    }
+    return nulls.test(i);
+}
+
+size_t ColumnChunk::nullCount() const {
+    return mapped ? mappedNullCount : nulls.count();
+}
+
+const uint64_t* ColumnChunk::nullBits() const {
+    return mapped ? mappedNulls : nulls.data();
+}
+
+void ColumnChunk::setNulls(const uint64_t* bitmap) {
+    detach();
+    nulls.assign(bitmap, count);
+}
+
+void ColumnChunk::mapNulls(const uint64_t* bitmap, size_t nullCount) {
+    mappedNulls = nullCount ? bitmap : nullptr;
+    mappedNullCount = nullCount;
+}
+
+bool ColumnChunk::getBit(size_t i) const {
+    return (boolBits()[i >> 6] >> (i & 63)) & 1;
+}
+
+void ColumnChunk::detach() {
+    if (mapped) {
+        nulls.assign(mappedNulls, count);
+        mappedNulls = nullptr;
+        mappedNullCount = 0;
+    }
+    if (dictionary) {
+        AppendBuffer<uint32_t> plainOffsets;
+        AppendBuffer<char> plainChars;
+        plainOffsets.reserve(count + 1);
+        plainOffsets.push_back(0);
+        for (size_t i = 0; i < count; i++) {
+            std::string_view s = stringAt(i);
+            plainChars.append(s.data(), s.size());
+            plainOffsets.push_back(static_cast<uint32_t>(plainChars.size()));
+        }
+        offsets = std::move(plainOffsets);
+        chars = std::move(plainChars);
+        std::vector<uint16_t>().swap(codes);
+        dictionary = false;
+        dictionaryEntries = 0;
+        mapped = nullptr;
+        mapping.reset();
+        return;
+    }
+    if (!mapped) {
+        return;
+    }
+    switch (type) {
+        case ColumnType::INT:
+            ints.assign(intData(), count);
+            break;
+        case ColumnType::FLOAT:
+            floats.assign(floatData(), count);
+            break;
+        case ColumnType::STRING:
+            offsets.assign(stringOffsets(), count + 1);
+            chars.assign(stringChars(), offsets[count]);
+            break;
+        case ColumnType::BOOLEAN:
+            bits.assign(boolBits(), boolBits() + (count + 63) / 64);
+            break;
+    }
+    mapped = nullptr;
+    mapping.reset();
+}
+
+void ColumnChunk::setBit(size_t i, bool b) {
+    uint64_t mask = uint64_t(1) << (i & 63);
+    if (b) {
+        bits[i >> 6] |= mask;
+    } else {
+        bits[i >> 6] &= ~mask;
+    }
+}
+
+void ColumnChunk::append(const Value& v) {
+    if (::isNull(v)) {
+        append(defaultValueFor(type));
+        nulls.set(count - 1, true);
+        return;
+    }
+    detach();
+    switch (type) {
+        case ColumnType::INT:
+            ints.push_back(std::get<int>(v));
+            break;
+        case ColumnType::FLOAT:
+            floats.push_back(std::get<float>(v));
+            break;
+        case ColumnType::STRING: {
+            const auto& s = std::get<std::string>(v);
+            chars.append(s.data(), s.size());
+            offsets.push_back(static_cast<uint32_t>(chars.size()));
+            break;
+        }
+        case ColumnType::BOOLEAN:
+            if ((count & 63) == 0) {
+                bits.push_back(0);
+            }
+            setBit(count, std::get<bool>(v));
+            break;
+    }
+    count++;
+    nulls.append(false);
+}
+
+void ColumnChunk::set(size_t i, const Value& v) {
+    if (i >= count) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    if (::isNull(v)) {
+        set(i, defaultValueFor(type));
+        nulls.set(i, true);
+        return;
+    }
+    detach();
+    nulls.set(i, false);
+    switch (type) {
+        case ColumnType::INT:
+            ints.mutableData()[i] = std::get<int>(v);
+            break;
+        case ColumnType::FLOAT:
+            floats.mutableData()[i] = std::get<float>(v);
+            break;
+        case ColumnType::STRING: {
+            const auto& s = std::get<std::string>(v);
+            uint32_t oldLen = offsets[i + 1] - offsets[i];
+            chars.replace(offsets[i], oldLen, s.data(), s.size());
+            int64_t delta = static_cast<int64_t>(s.size()) - oldLen;
+            uint32_t* offs = offsets.mutableData();
+            for (size_t j = i + 1; j <= count; j++) {
+                offs[j] = static_cast<uint32_t>(offs[j] + delta);
+            }
+            break;
+        }
+        case ColumnType::BOOLEAN:
+            setBit(i, std::get<bool>(v));
+            break;
+    }
+}
+
+void ColumnChunk::erase(size_t i) {
+    if (i >= count) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    detach();
+    nulls.erase(i);
+    switch (type) {
+        case ColumnType::INT:
+            ints.erase(i, 1);
+            break;
+        case ColumnType::FLOAT:
+            floats.erase(i, 1);
+            break;
+        case ColumnType::STRING: {
+            uint32_t len = offsets[i + 1] - offsets[i];
+            chars.erase(offsets[i], len);
+            offsets.erase(i + 1, 1);
+            uint32_t* offs = offsets.mutableData();
+            for (size_t j = i + 1; j < count; j++) {
+                offs[j] -= len;
+            }
+            break;
+        }
+        case ColumnType::BOOLEAN:
+            for (size_t j = i; j + 1 < count; j++) {
+                setBit(j, getBit(j + 1));
+            }
+            if (((count - 1) & 63) == 0) {
+                bits.pop_back();
+            }
+            break;
+    }
+    count--;
+}
+
+void ColumnChunk::appendInts(const int* values, size_t n) {
+    detach();
+    ints.append(values, n);
+    count += n;
+    nulls.appendValid(n);
+}
+
+void ColumnChunk::appendFloats(const float* values, size_t n) {
+    detach();
+    floats.append(values, n);
+    count += n;
+    nulls.appendValid(n);
+}
+
+void ColumnChunk::appendBools(const uint64_t* words, size_t n) {
+    detach();
+    if ((count & 63) == 0) {
+        // Word aligned: copy whole words and clear the bits past n
+        size_t w = (n + 63) / 64;
+        bits.insert(bits.end(), words, words + w);
+        if (n & 63) {
+            bits.back() &= (uint64_t(1) << (n & 63)) - 1;
+        }
+        count += n;
+        nulls.appendValid(n);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if ((count & 63) == 0) {
+            bits.push_back(0);
+        }
+        setBit(count, (words[i >> 6] >> (i & 63)) & 1);
+        count++;
+    }
+    nulls.appendValid(n);
+}
+
+void ColumnChunk::appendStrings(const uint32_t* stringOffsets, const char* stringChars, size_t n) {
+    detach();
+    uint32_t base = static_cast<uint32_t>(chars.size()) - stringOffsets[0];
+    chars.append(stringChars + stringOffsets[0], stringOffsets[n] - stringOffsets[0]);
+    uint32_t* out = offsets.grow(n);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = stringOffsets[i + 1] + base;
+    }
+    count += n;
+    nulls.appendValid(n);
+}
+
+void ColumnChunk::appendRange(const ColumnChunk& src, size_t first, size_t n) {
+    detach();
+    switch (type) {
+        case ColumnType::INT:
+            appendInts(src.intData() + first, n);
+            break;
+        case ColumnType::FLOAT:
+            appendFloats(src.floatData() + first, n);
+            break;
+        case ColumnType::STRING:
+            if (!src.isDictionary()) {
+                appendStrings(src.stringOffsets() + first, src.stringChars(), n);
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                std::string_view s = src.stringAt(first + i);
+                chars.append(s.data(), s.size());
+                offsets.push_back(static_cast<uint32_t>(chars.size()));
+            }
+            count += n;
+            nulls.appendValid(n);
+            break;
+        case ColumnType::BOOLEAN:
+            for (size_t i = 0; i < n; i++) {
+                if ((count & 63) == 0) {
+                    bits.push_back(0);
+                }
+                setBit(count, src.getBit(first + i));
+                count++;
+            }
+            nulls.appendValid(n);
+            break;
+    }
+    if (src.nullCount() > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (src.isNull(first + i)) {
+                nulls.set(count - n + i, true);
+            }
+        }
+    }
+}
+
+void ColumnChunk::reserve(size_t n) {
+    detach();
+    switch (type) {
+        case ColumnType::INT:
+            ints.reserve(n);
+            break;
+        case ColumnType::FLOAT:
+            floats.reserve(n);
+            break;
+        case ColumnType::STRING:
+            offsets.reserve(n + 1);
+            break;
+        case ColumnType::BOOLEAN:
+            bits.reserve((n + 63) / 64);
+            break;
+    }
+}
+
+ValueRef ColumnChunk::get(size_t i) const {
+    if (isNull(i)) {
+        return std::monostate{};
+    }
+    switch (type) {
+        case ColumnType::INT:
+            return intData()[i];
+        case ColumnType::FLOAT:
+            return floatData()[i];
+        case ColumnType::STRING:
+            return stringAt(i);
+        case ColumnType::BOOLEAN:
+            return getBit(i);
+    }
+    return 0;
+}
+
+// Mapped payloads follow the file block layout, see FileFormat.h
+const int* ColumnChunk::intData() const {
+    return mapped ? reinterpret_cast<const int*>(mapped) : ints.data();
+}
+
+const float* ColumnChunk::floatData() const {
+    return mapped ? reinterpret_cast<const float*>(mapped) : floats.data();
+}
+
+const uint64_t* ColumnChunk::boolBits() const {
+    return mapped ? reinterpret_cast<const uint64_t*>(mapped) : bits.data();
+}
+
+const uint32_t* ColumnChunk::stringOffsets() const {
+    if (!mapped) {
+        return offsets.data();
+    }
+    return reinterpret_cast<const uint32_t*>(dictionary ? mapped + codeBytes(count) : mapped);
+}
+
+const char* ColumnChunk::stringChars() const {
+    if (!mapped) {
+        return chars.data();
+    }
+    size_t entries = dictionary ? dictionaryEntries : count;
+    return reinterpret_cast<const char*>(stringOffsets() + entries + 1);
+}
+
+std::string_view ColumnChunk::stringAt(size_t i) const {
+    if (dictionary) {
+        return dictionaryAt(codeData()[i]);
+    }
+    const uint32_t* offs = stringOffsets();
+    return std::string_view(stringChars() + offs[i], offs[i + 1] - offs[i]);
+}
+
+bool ColumnChunk::encodeDictionary() {
+    if (dictionary || mapped || type != ColumnType::STRING || count == 0) {
+        return dictionary;
+    }
+    std::vector<std::string_view> strings(count);
+    for (size_t i = 0; i < count; i++) {
+        strings[i] = stringAt(i);
+    }
+    // Worth it only if codes plus dictionary take at most half the plain bytes
+    size_t plainBytes = (count + 1) * sizeof(uint32_t) + chars.size();
+    size_t budget = plainBytes / 2;
+    if (budget <= count * sizeof(uint16_t)) {
+        return false;
+    }
+    std::vector<uint16_t> newCodes;
+    std::vector<uint32_t> newOffsets;
+    std::string newChars;
+    if (!buildDictionary(strings.data(), count, budget - count * sizeof(uint16_t), newCodes, newOffsets, newChars)) {
+        return false;
+    }
+    codes = std::move(newCodes);
+    offsets.assign(newOffsets.data(), newOffsets.size());
+    chars.assign(newChars.data(), newChars.size());
+    dictionaryEntries = static_cast<uint32_t>(offsets.size() - 1);
+    dictionary = true;
+    return true;
+}
+
+void ColumnChunk::appendDictionary(const uint16_t* rowCodes, size_t n, const uint32_t* dictOffsets,
+                                   const char* dictChars, uint32_t entries) {
+    if (type != ColumnType::STRING || count != 0 || mapped) {
+        throw std::invalid_argument("Dictionary codes need an empty STRING chunk");
+    }
+    codes.assign(rowCodes, rowCodes + n);
+    offsets.clear();
+    uint32_t* out = offsets.grow(size_t(entries) + 1);
+    for (size_t i = 0; i <= entries; i++) {
+        out[i] = dictOffsets[i] - dictOffsets[0];
+    }
+    chars.assign(dictChars + dictOffsets[0], out[entries]);
+    dictionaryEntries = entries;
+    dictionary = true;
+    count = n;
+    nulls.appendValid(n);
+}
+
+bool ColumnChunk::isDictionary() const { return dictionary; }
+uint32_t ColumnChunk::dictionarySize() const { return dictionaryEntries; }
+
+const uint16_t* ColumnChunk::codeData() const {
+    return mapped ? reinterpret_cast<const uint16_t*>(mapped) : codes.data();
+}
+
+std::string_view ColumnChunk::dictionaryAt(uint16_t code) const {
+    const uint32_t* offs = stringOffsets();
+    return std::string_view(stringChars() + offs[code], offs[code + 1] - offs[code]);
+}
+
+bool ColumnChunk::buildDictionary(const std::string_view* strings, size_t n, size_t maxBytes,
+                                  std::vector<uint16_t>& codes, std::vector<uint32_t>& offsets, std::string& chars) {
+    constexpr size_t kMaxEntries = size_t(UINT16_MAX) + 1;
+    std::unordered_map<std::string_view, uint16_t> seen;
+    codes.resize(n);
+    offsets.assign(1, 0);
+    chars.clear();
+    size_t bytes = sizeof(uint32_t);
+    for (size_t i = 0; i < n; i++) {
+        auto [it, added] = seen.try_emplace(strings[i], static_cast<uint16_t>(seen.size()));
+        if (added) {
+            bytes += sizeof(uint32_t) + strings[i].size();
+            if (seen.size() > kMaxEntries || bytes > maxBytes) {
+                return false;
+            }
+            chars.append(strings[i]);
+            offsets.push_back(static_cast<uint32_t>(chars.size()));
+        }
+        codes[i] = it->second;
+    }
+    return true;
+}
@@ -0,0 +1,118 @@
+#ifndef COLUMNCHUNK_H
+#define COLUMNCHUNK_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "AppendBuffer.h"
+#include "Column.h"
+#include "MappedFile.h"
+#include "NullBitmap.h"
+
+// Non-owning view of a single cell, std::monostate for NULL. Strings point
+// into table storage and stay valid until the table is modified.
+using ValueRef = std::variant<int, float, std::string_view, bool, std::monostate>;
+
+// Rows per chunk. Every chunk except the last one of a column is full, so
+// row i lives in chunk i / kChunkRows at position i % kChunkRows.
+constexpr size_t kChunkRows = 1 << 16;
+
+// The values of one column for up to kChunkRows consecutive rows, kept in a
+// single typed array: INT and FLOAT as plain arrays, BOOLEAN as a bitmap and
+// STRING as an offset table into one character arena.
+//
+// A full STRING chunk with few distinct values is dictionary encoded: each
+// row holds a uint16 code and offsets/chars hold the distinct values once.
+// Codes are local to the chunk, so a chunk (and its file block) stays
+// self-contained. Modifying the chunk decodes it again.
+//
+// NULLs are flagged in a NullBitmap next to the values; a NULL row holds the
+// type's default in the value array, so scans read it like any other.
+//
+// A chunk can also serve its values straight out of a mapped database file
+// (same layout as a file block). It is copied into owned memory the first
+// time it is modified.
+class ColumnChunk {
+private:
+    ColumnType type;
+    size_t count = 0;
+    AppendBuffer<int> ints;
+    AppendBuffer<float> floats;
+    std::vector<uint64_t> bits;
+    AppendBuffer<uint32_t> offsets; // count + 1 entries, offsets[i]..offsets[i+1]
+    AppendBuffer<char> chars;
+    std::vector<uint16_t> codes;   // dictionary chunks: offsets/chars hold the entries
+    bool dictionary = false;
+    uint32_t dictionaryEntries = 0;
+    NullBitmap nulls;
+    std::shared_ptr<const MappedFile> mapping;
+    const char* mapped = nullptr; // block payload inside mapping, if any
+    const uint64_t* mappedNulls = nullptr;
+    size_t mappedNullCount = 0;
+
+    bool getBit(size_t i) const;
+    void setBit(size_t i, bool b);
+    void detach(); // copy mapped data into owned storage and undo dictionary encoding
+
+public:
+    explicit ColumnChunk(ColumnType type);
+    // Chunk of `count` values whose payload lives at `payload` inside `file`
+    ColumnChunk(ColumnType type, size_t count, std::shared_ptr<const MappedFile> file, const char* payload);
+    // Mapped dictionary STRING chunk with `entries` distinct values
+    ColumnChunk(size_t count, uint32_t entries, std::shared_ptr<const MappedFile> file, const char* payload);
+
+    ColumnType getType() const;
+    size_t size() const;
+    bool isMapped() const;
+
+    bool isNull(size_t i) const;
+    size_t nullCount() const;
+    const uint64_t* nullBits() const; // one bit per row, null when no row is NULL
+    // Flags rows as NULL from a bitmap over all size() rows
+    void setNulls(const uint64_t* bitmap);
+    // NULL flags of a mapped chunk, inside the same mapping
+    void mapNulls(const uint64_t* bitmap, size_t nullCount);
+
+    void append(const Value& v); // std::monostate appends a NULL
+    // Bulk appends of n values; strings take n + 1 offsets relative to chars
+    void appendInts(const int* values, size_t n);
+    void appendFloats(const float* values, size_t n);
+    void appendBools(const uint64_t* words, size_t n);
+    void appendStrings(const uint32_t* stringOffsets, const char* stringChars, size_t n);
+    void appendRange(const ColumnChunk& src, size_t first, size_t n);
+    void reserve(size_t n);
+    void set(size_t i, const Value& v);
+    void erase(size_t i);
+    ValueRef get(size_t i) const;
+
+    // Typed access for scans; only the accessor matching getType() is valid.
+    const int* intData() const;
+    const float* floatData() const;
+    const uint64_t* boolBits() const;
+    // Per row for plain chunks, per dictionary entry for dictionary chunks
+    const uint32_t* stringOffsets() const;
+    const char* stringChars() const;
+    std::string_view stringAt(size_t i) const;
+
+    // Encodes an owned STRING chunk if its distinct values take at most half
+    // of the plain bytes; returns whether the chunk is dictionary encoded
+    bool encodeDictionary();
+    // Appends n codes into a dictionary given as entries + 1 offsets into
+    // dictChars; only valid on an empty chunk
+    void appendDictionary(const uint16_t* rowCodes, size_t n, const uint32_t* dictOffsets, const char* dictChars, uint32_t entries);
+    bool isDictionary() const;
+    const uint16_t* codeData() const;
+    uint32_t dictionarySize() const;
+    std::string_view dictionaryAt(uint16_t code) const;
+
+    // Distinct values of strings[0..n) in first-seen order, as codes per
+    // string and entries + 1 offsets into chars. False, leaving the outputs
+    // unspecified, when there are more distinct values than a uint16 holds
+    // or the offsets and chars would take more than maxBytes.
+    static bool buildDictionary(const std::string_view* strings, size_t n, size_t maxBytes, std::vector<uint16_t>& codes,
+                                std::vector<uint32_t>& offsets, std::string& chars);
+};
+
+#endif //COLUMNCHUNK_H
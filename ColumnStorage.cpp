@@ -0,0 +1,412 @@
+#include "ColumnStorage.h"
+#include <algorithm>
+#include <stdexcept>
+#include "CopyOnWrite.h"
+
+// Copies the chunk vectors only; the chunks themselves are shared
+std::unique_ptr<TableStorage> ColumnStorage::clone() const {
+    return std::make_unique<ColumnStorage>(*this);
+}
+
+StorageMode ColumnStorage::getMode() const { return StorageMode::COLUMNAR; }
+size_t ColumnStorage::getRowCount() const { return rowCount; }
+
+void ColumnStorage::checkRow(const Row& row) const {
+    if (row.size() != types.size()) {
+        throw std::invalid_argument("Row doesn't match table schema");
+    }
+    for (size_t c = 0; c < types.size(); c++) {
+        const Value& value = row.getValue(static_cast<int>(c));
+        if (!isNull(value) && value.index() != variantIndexFor(types[c])) {
+            throw std::invalid_argument("Value type doesn't match column type");
+        }
+    }
+}
+
+// Dictionary encodes the full STRING chunks from the one holding firstRow
+// on; the last chunk is left alone until it fills up. Shared chunks are
+// ones a snapshot already holds as they are, and stay so.
+void ColumnStorage::encodeFullChunks(size_t firstRow) {
+    for (size_t c = 0; c < types.size(); c++) {
+        if (types[c] != ColumnType::STRING) {
+            continue;
+        }
+        for (size_t k = firstRow / kChunkRows; k < rowCount / kChunkRows; k++) {
+            if (soleOwner(columns[c][k])) {
+                columns[c][k]->encodeDictionary();
+            }
+        }
+    }
+}
+
+bool ColumnStorage::isLazy(size_t col, size_t chunk) const {
+    return columns[col][chunk]->size() == 0;
+}
+
+// A chunk shared with a snapshot is copied first (see soleOwner)
+ColumnChunk& ColumnStorage::writable(size_t col, size_t chunk) {
+    return unshare(columns[col][chunk]);
+}
+
+void ColumnStorage::materialize(size_t col, size_t chunk) {
+    ColumnChunk& target = writable(col, chunk);
+    Value fill = fills[col].null ? Value(std::monostate{}) : fills[col].value;
+    target.reserve(kChunkRows);
+    for (size_t i = 0; i < kChunkRows; i++) {
+        target.append(fill);
+    }
+    target.encodeDictionary();
+}
+
+ValueRef ColumnStorage::lazyValue(size_t col) const {
+    if (fills[col].null) {
+        return std::monostate{};
+    }
+    return toValueRef(fills[col].value);
+}
+
+void ColumnStorage::addColumn(ColumnType type, const Value& fill) {
+    if (!isNull(fill) && fill.index() != variantIndexFor(type)) {
+        throw std::invalid_argument("Value type doesn't match column type");
+    }
+    std::vector<std::shared_ptr<ColumnChunk>> chunks;
+    chunks.reserve(getChunkCount());
+    for (size_t k = 0; k < rowCount / kChunkRows; k++) {
+        chunks.push_back(std::make_shared<ColumnChunk>(type));
+    }
+    if (rowCount % kChunkRows) {
+        chunks.push_back(std::make_shared<ColumnChunk>(type));
+        for (size_t i = 0; i < rowCount % kChunkRows; i++) {
+            chunks.back()->append(fill);
+        }
+    }
+    types.push_back(type);
+    columns.push_back(std::move(chunks));
+    fills.push_back({isNull(fill) ? defaultValueFor(type) : fill, isNull(fill)});
+}
+
+// Frees the column's chunks; the other columns are only moved
+void ColumnStorage::dropColumn(size_t col) {
+    if (col >= types.size()) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    types.erase(types.begin() + col);
+    columns.erase(columns.begin() + col);
+    fills.erase(fills.begin() + col);
+}
+
+void ColumnStorage::clearColumns() {
+    types.clear();
+    columns.clear();
+    fills.clear();
+    rowCount = 0;
+}
+
+void ColumnStorage::appendRow(const Row& row) {
+    checkRow(row);
+    bool newChunk = rowCount % kChunkRows == 0;
+    for (size_t c = 0; c < types.size(); c++) {
+        if (newChunk) {
+            columns[c].push_back(std::make_shared<ColumnChunk>(types[c]));
+        }
+        writable(c, columns[c].size() - 1).append(row.getValue(static_cast<int>(c)));
+    }
+    rowCount++;
+    if (rowCount % kChunkRows == 0) {
+        encodeFullChunks(rowCount - 1);
+    }
+}
+
+void ColumnStorage::appendChunks(std::vector<ColumnChunk>& chunks) {
+    if (chunks.size() != types.size()) {
+        throw std::invalid_argument("Chunk count doesn't match table schema");
+    }
+    size_t n = chunks.empty() ? 0 : chunks[0].size();
+    for (size_t c = 0; c < types.size(); c++) {
+        if (chunks[c].getType() != types[c] || chunks[c].size() != n) {
+            throw std::invalid_argument("Chunk doesn't match table schema");
+        }
+    }
+    for (size_t c = 0; c < types.size(); c++) {
+        // A chunk starting on a chunk boundary is adopted as is, which also
+        // keeps memory-mapped chunks mapped
+        if (rowCount % kChunkRows == 0 && n <= kChunkRows) {
+            columns[c].push_back(std::make_shared<ColumnChunk>(std::move(chunks[c])));
+            continue;
+        }
+        size_t done = 0;
+        size_t filled = rowCount % kChunkRows;
+        while (done < n) {
+            if (filled == 0) {
+                columns[c].push_back(std::make_shared<ColumnChunk>(types[c]));
+            }
+            size_t take = std::min(n - done, kChunkRows - filled);
+            writable(c, columns[c].size() - 1).appendRange(chunks[c], done, take);
+            done += take;
+            filled = (filled + take) % kChunkRows;
+        }
+    }
+    size_t firstRow = rowCount;
+    rowCount += n;
+    encodeFullChunks(firstRow);
+}
+
+void ColumnStorage::updateRow(size_t idx, const Row& row) {
+    if (idx >= rowCount) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    checkRow(row);
+    for (size_t c = 0; c < types.size(); c++) {
+        if (isLazy(c, idx / kChunkRows)) {
+            materialize(c, idx / kChunkRows);
+        }
+        writable(c, idx / kChunkRows).set(idx % kChunkRows, row.getValue(static_cast<int>(c)));
+    }
+}
+
+// Fixed width values are set in place. Setting a string shifts the rest of
+// its chunk, so a STRING chunk is instead rebuilt once from runs of the
+// old values and the new ones: O(chunk) per chunk touched rather than per
+// row.
+void ColumnStorage::updateRows(const std::vector<size_t>& rows, const std::vector<Row>& updated) {
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (rows[i] >= rowCount) {
+            throw std::out_of_range("Index out of bounds");
+        }
+        checkRow(updated[i]);
+    }
+    for (size_t begin = 0, end; begin < rows.size(); begin = end) {
+        size_t chunk = rows[begin] / kChunkRows;
+        end = begin + 1;
+        while (end < rows.size() && rows[end] / kChunkRows == chunk) {
+            end++;
+        }
+        for (size_t c = 0; c < types.size(); c++) {
+            if (isLazy(c, chunk)) {
+                materialize(c, chunk);
+            }
+            if (types[c] != ColumnType::STRING) {
+                ColumnChunk& target = writable(c, chunk);
+                for (size_t i = begin; i < end; i++) {
+                    target.set(rows[i] % kChunkRows, updated[i].getValue(static_cast<int>(c)));
+                }
+                continue;
+            }
+            const ColumnChunk& source = *columns[c][chunk];
+            auto rebuilt = std::make_shared<ColumnChunk>(ColumnType::STRING);
+            rebuilt->reserve(source.size());
+            size_t next = 0;
+            for (size_t i = begin; i < end; i++) {
+                size_t r = rows[i] % kChunkRows;
+                rebuilt->appendRange(source, next, r - next);
+                rebuilt->append(updated[i].getValue(static_cast<int>(c)));
+                next = r + 1;
+            }
+            rebuilt->appendRange(source, next, source.size() - next);
+            if (rebuilt->size() == kChunkRows) {
+                rebuilt->encodeDictionary();
+            }
+            columns[c][chunk] = std::move(rebuilt);
+        }
+    }
+}
+
+void ColumnStorage::eraseRow(size_t idx) {
+    if (idx >= rowCount) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    // Keep every chunk but the last full by pulling the first value of each
+    // following chunk down into its predecessor.
+    for (size_t col = 0; col < columns.size(); col++) {
+        auto& chunks = columns[col];
+        size_t c = idx / kChunkRows;
+        for (size_t k = c; k < chunks.size(); k++) {
+            if (isLazy(col, k)) {
+                materialize(col, k);
+            }
+            writable(col, k);
+        }
+        chunks[c]->erase(idx % kChunkRows);
+        for (size_t k = c + 1; k < chunks.size(); k++) {
+            chunks[k - 1]->append(toValue(chunks[k]->get(0)));
+            chunks[k]->erase(0);
+        }
+        if (chunks.back()->size() == 0) {
+            chunks.pop_back();
+        }
+    }
+    rowCount--;
+    // Erasing decoded the chunks from idx on
+    encodeFullChunks(idx);
+}
+
+// Rebuilds each column from the runs of kept rows. A chunk kept whole that
+// lands on a chunk boundary is kept as is (mapped, dictionary encoded, a
+// placeholder or shared with a snapshot), so erasing near the end leaves
+// earlier chunks alone.
+void ColumnStorage::eraseRows(const uint64_t* erased) {
+    size_t kept = 0;
+    forEachClearRun(erased, rowCount, [&](size_t, size_t n) { kept += n; });
+    for (size_t col = 0; col < columns.size(); col++) {
+        std::vector<std::shared_ptr<ColumnChunk>> rebuilt;
+        rebuilt.reserve((kept + kChunkRows - 1) / kChunkRows);
+        Value fill = fills[col].null ? Value(std::monostate{}) : fills[col].value;
+        size_t written = 0; // rows in rebuilt, which may end in a placeholder
+        forEachClearRun(erased, rowCount, [&](size_t first, size_t n) {
+            while (n > 0) {
+                bool aligned = written % kChunkRows == 0;
+                if (aligned && first % kChunkRows == 0 && n >= kChunkRows) {
+                    rebuilt.push_back(columns[col][first / kChunkRows]);
+                    first += kChunkRows;
+                    n -= kChunkRows;
+                    written += kChunkRows;
+                    continue;
+                }
+                if (aligned) {
+                    rebuilt.push_back(std::make_shared<ColumnChunk>(types[col]));
+                }
+                const ColumnChunk& source = *columns[col][first / kChunkRows];
+                size_t offset = first % kChunkRows;
+                size_t take = std::min({n, kChunkRows - offset, kChunkRows - rebuilt.back()->size()});
+                if (source.size()) {
+                    rebuilt.back()->appendRange(source, offset, take);
+                } else {
+                    for (size_t i = 0; i < take; i++) {
+                        rebuilt.back()->append(fill);
+                    }
+                }
+                first += take;
+                n -= take;
+                written += take;
+            }
+        });
+        columns[col] = std::move(rebuilt);
+    }
+    rowCount = kept;
+    encodeFullChunks(0);
+}
+
+void ColumnStorage::clear() {
+    for (auto& chunks : columns) {
+        chunks.clear();
+    }
+    rowCount = 0;
+}
+
+ValueRef ColumnStorage::getValue(size_t row, size_t col) const {
+    if (row >= rowCount || col >= columns.size()) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    if (isLazy(col, row / kChunkRows)) {
+        return lazyValue(col);
+    }
+    return columns[col][row / kChunkRows]->get(row % kChunkRows);
+}
+
+Row ColumnStorage::getRow(size_t row) const {
+    if (row >= rowCount) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    Row result;
+    for (size_t col = 0; col < columns.size(); col++) {
+        result.addValue(toValue(getValue(row, col)));
+    }
+    return result;
+}
+
+size_t ColumnStorage::getChunkCount() const {
+    return (rowCount + kChunkRows - 1) / kChunkRows;
+}
+
+const ColumnChunk& ColumnStorage::getChunk(size_t col, size_t chunk) const {
+    return *columns[col][chunk];
+}
+
+// Batches that stay inside one chunk are served straight from the chunk's
+// array (or filled from a placeholder's value); the rest are gathered value
+// by value.
+const int* ColumnStorage::getInts(size_t col, size_t first, size_t count, std::vector<int>& scratch) const {
+    size_t chunk = first / kChunkRows;
+    if (count == 0 || chunk == (first + count - 1) / kChunkRows) {
+        if (isLazy(col, chunk)) {
+            scratch.assign(count, std::get<int>(fills[col].value));
+            return scratch.data();
+        }
+        return columns[col][chunk]->intData() + first % kChunkRows;
+    }
+    scratch.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t r = first + i;
+        const ColumnChunk& source = *columns[col][r / kChunkRows];
+        scratch[i] = source.size() ? source.intData()[r % kChunkRows] : std::get<int>(fills[col].value);
+    }
+    return scratch.data();
+}
+
+const float* ColumnStorage::getFloats(size_t col, size_t first, size_t count, std::vector<float>& scratch) const {
+    size_t chunk = first / kChunkRows;
+    if (count == 0 || chunk == (first + count - 1) / kChunkRows) {
+        if (isLazy(col, chunk)) {
+            scratch.assign(count, std::get<float>(fills[col].value));
+            return scratch.data();
+        }
+        return columns[col][chunk]->floatData() + first % kChunkRows;
+    }
+    scratch.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t r = first + i;
+        const ColumnChunk& source = *columns[col][r / kChunkRows];
+        scratch[i] = source.size() ? source.floatData()[r % kChunkRows] : std::get<float>(fills[col].value);
+    }
+    return scratch.data();
+}
+
+void ColumnStorage::getBools(size_t col, size_t first, size_t count, uint64_t* out) const {
+    size_t words = (count + 63) / 64;
+    uint64_t fill = std::get<bool>(fills[col].value) ? ~uint64_t(0) : 0;
+    for (size_t w = 0; w < words; w++) {
+        size_t r = first + w * 64;
+        const ColumnChunk& source = *columns[col][r / kChunkRows];
+        out[w] = source.size() ? source.boolBits()[(r % kChunkRows) >> 6] : fill;
+    }
+    if (count & 63) {
+        out[words - 1] &= (uint64_t(1) << (count & 63)) - 1;
+    }
+}
+
+void ColumnStorage::getStrings(size_t col, size_t first, size_t count, std::vector<std::string_view>& out) const {
+    out.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t r = first + i;
+        const ColumnChunk& source = *columns[col][r / kChunkRows];
+        out[i] = source.size() ? source.stringAt(r % kChunkRows) : std::get<std::string>(fills[col].value);
+    }
+}
+
+const ColumnChunk* ColumnStorage::getStringCodes(size_t col, size_t first, size_t count, const uint16_t*& codes) const {
+    size_t chunk = first / kChunkRows;
+    if (count == 0 || chunk != (first + count - 1) / kChunkRows || !columns[col][chunk]->isDictionary()) {
+        return nullptr;
+    }
+    codes = columns[col][chunk]->codeData() + first % kChunkRows;
+    return columns[col][chunk].get();
+}
+
+const uint64_t* ColumnStorage::getNulls(size_t col, size_t first, size_t count, std::vector<uint64_t>& scratch) const {
+    size_t chunk = first / kChunkRows;
+    if (count == 0 || (chunk == (first + count - 1) / kChunkRows && !isLazy(col, chunk))) {
+        const uint64_t* bits = columns[col][chunk]->nullBits();
+        return bits ? bits + (first % kChunkRows) / 64 : nullptr;
+    }
+    bool any = false;
+    scratch.assign((count + 63) / 64, 0);
+    for (size_t i = 0; i < count; i++) {
+        size_t r = first + i;
+        const ColumnChunk& source = *columns[col][r / kChunkRows];
+        if (source.size() ? source.isNull(r % kChunkRows) : fills[col].null) {
+            scratch[i >> 6] |= uint64_t(1) << (i & 63);
+            any = true;
+        }
+    }
+    return any ? scratch.data() : nullptr;
+}
@@ -0,0 +1,75 @@
+#ifndef COLUMNSTORAGE_H
+#define COLUMNSTORAGE_H
+
+#include <memory>
+#include <vector>
+#include "TableStorage.h"
+#include "ColumnChunk.h"
+
+// Column-oriented layout: each column is a list of ColumnChunks, so a scan of
+// two columns only touches the memory of those two columns.
+//
+// A column added to a non-empty table gets an empty placeholder chunk for
+// every full chunk of rows, which reads as the column's fill value; only
+// the partly filled last chunk is written. A placeholder turns into a real
+// chunk when one of its rows is written, so adding a column costs at most
+// one chunk of work however long the table is.
+//
+// Chunks are shared between a table and its snapshots (see clone()); a
+// shared chunk is copied before it is written, so a snapshot keeps seeing
+// the values it was taken with. The copy shares the value arrays until
+// existing values change, so appending to a table with a live snapshot
+// copies the last chunk's NULL and BOOLEAN bitmaps but not its values.
+class ColumnStorage : public TableStorage {
+private:
+    struct LazyFill {
+        Value value;       // never NULL, the type's default stands in for it
+        bool null = false;
+    };
+
+    std::vector<ColumnType> types;
+    std::vector<std::vector<std::shared_ptr<ColumnChunk>>> columns; // [column][chunk]
+    std::vector<LazyFill> fills;                   // per column
+    size_t rowCount = 0;
+
+    void checkRow(const Row& row) const;
+    void encodeFullChunks(size_t firstRow);
+    bool isLazy(size_t col, size_t chunk) const;
+    void materialize(size_t col, size_t chunk);
+    ColumnChunk& writable(size_t col, size_t chunk); // unshares the chunk
+    ValueRef lazyValue(size_t col) const;
+
+public:
+    ColumnStorage() = default;
+
+    std::unique_ptr<TableStorage> clone() const override;
+    StorageMode getMode() const override;
+    size_t getRowCount() const override;
+
+    void addColumn(ColumnType type, const Value& fill) override;
+    void dropColumn(size_t col) override;
+    void clearColumns() override;
+
+    void appendRow(const Row& row) override;
+    void appendChunks(std::vector<ColumnChunk>& chunks) override;
+    void updateRow(size_t idx, const Row& row) override;
+    void updateRows(const std::vector<size_t>& rows, const std::vector<Row>& updated) override;
+    void eraseRow(size_t idx) override;
+    void eraseRows(const uint64_t* erased) override;
+    void clear() override;
+
+    ValueRef getValue(size_t row, size_t col) const override;
+    Row getRow(size_t row) const override;
+
+    const int* getInts(size_t col, size_t first, size_t count, std::vector<int>& scratch) const override;
+    const float* getFloats(size_t col, size_t first, size_t count, std::vector<float>& scratch) const override;
+    void getBools(size_t col, size_t first, size_t count, uint64_t* out) const override;
+    void getStrings(size_t col, size_t first, size_t count, std::vector<std::string_view>& out) const override;
+    const uint64_t* getNulls(size_t col, size_t first, size_t count, std::vector<uint64_t>& scratch) const override;
+    const ColumnChunk* getStringCodes(size_t col, size_t first, size_t count, const uint16_t*& codes) const override;
+
+    size_t getChunkCount() const;
+    const ColumnChunk& getChunk(size_t col, size_t chunk) const; // empty for a placeholder
+};
+
+#endif //COLUMNSTORAGE_H
@@ -0,0 +1,31 @@
+#ifndef COPYONWRITE_H
+#define COPYONWRITE_H
+
+#include <atomic>
+#include <memory>
+
+// Copy-on-write ownership rule for the parts of a table shared with its
+// snapshots (storage blocks and chunks, tombstone segments, zones): they are
+// only shared with snapshots, which never write them, and only copied by
+// the table's writer. So a count of one means no reader holds the part any
+// more, and the writer may change it in place. The fence orders the last
+// reader's accesses before the writer's.
+template <typename T>
+bool soleOwner(const std::shared_ptr<T>& shared) {
+    if (shared.use_count() > 1) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+}
+
+// The part, copied first unless the writer is its sole owner
+template <typename T>
+T& unshare(std::shared_ptr<T>& shared) {
+    if (!soleOwner(shared)) {
+        shared = std::make_shared<T>(*shared);
+    }
+    return *shared;
+}
+
+#endif //COPYONWRITE_H
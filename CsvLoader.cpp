@@ -0,0 +1,332 @@
+#include "CsvLoader.h"
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+// Typed values of one column for the batch being parsed
+struct ColumnBuilder {
+    ColumnType type;
+    std::vector<int> ints;
+    std::vector<float> floats;
+    std::vector<uint64_t> bits;
+    std::vector<uint32_t> offsets{0};
+    std::string chars;
+    std::vector<uint64_t> nulls; // empty until the batch's first NULL
+
+    void clear() {
+        ints.clear();
+        floats.clear();
+        bits.clear();
+        offsets.assign(1, 0);
+        chars.clear();
+        nulls.clear();
+    }
+
+    ColumnChunk build(size_t rows) const {
+        ColumnChunk chunk(type);
+        chunk.reserve(rows);
+        switch (type) {
+            case ColumnType::INT:
+                chunk.appendInts(ints.data(), rows);
+                break;
+            case ColumnType::FLOAT:
+                chunk.appendFloats(floats.data(), rows);
+                break;
+            case ColumnType::BOOLEAN:
+                chunk.appendBools(bits.data(), rows);
+                break;
+            case ColumnType::STRING:
+                chunk.appendStrings(offsets.data(), chars.data(), rows);
+                break;
+        }
+        if (!nulls.empty()) {
+            std::vector<uint64_t> flags = nulls;
+            flags.resize((rows + 63) / 64);
+            chunk.setNulls(flags.data());
+        }
+        return chunk;
+    }
+};
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+bool equalsIgnoreCase(std::string_view s, const char* word) {
+    size_t n = std::strlen(word);
+    if (s.size() != n) {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (std::tolower(static_cast<unsigned char>(s[i])) != word[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Splits one record starting at p. Returns the start of the next record, or
+// null when the record runs past `end` and more input is needed. Quoted
+// fields with "" escapes are decoded into `unescaped`; a deque, so growing
+// it leaves views of earlier fields intact. quoted[i] tells whether field i
+// was quoted.
+const char* splitRecord(const char* p, const char* end, bool eof, char delimiter,
+                        std::vector<std::string_view>& fields, std::vector<bool>& quoted,
+                        std::deque<std::string>& unescaped) {
+    fields.clear();
+    quoted.clear();
+    while (true) {
+        if (p < end && *p == '"') {
+            const char* q = p + 1;
+            bool escaped = false;
+            const char* close;
+            while (true) {
+                close = static_cast<const char*>(std::memchr(q, '"', end - q));
+                if (close == nullptr) {
+                    if (eof) {
+                        throw std::runtime_error("unterminated quoted field");
+                    }
+                    return nullptr;
+                }
+                if (close + 1 == end && !eof) {
+                    return nullptr; // can't tell "" from a closing quote yet
+                }
+                if (close + 1 < end && close[1] == '"') {
+                    escaped = true;
+                    q = close + 2;
+                    continue;
+                }
+                break;
+            }
+            std::string_view raw(p + 1, close - p - 1);
+            if (escaped) {
+                if (unescaped.size() <= fields.size()) {
+                    unescaped.resize(fields.size() + 1);
+                }
+                std::string& out = unescaped[fields.size()];
+                out.clear();
+                for (size_t i = 0; i < raw.size(); i++) {
+                    out += raw[i];
+                    if (raw[i] == '"') {
+                        i++;
+                    }
+                }
+                raw = out;
+            }
+            fields.push_back(raw);
+            quoted.push_back(true);
+            p = close + 1;
+        } else {
+            const char* q = p;
+            while (q < end && *q != delimiter && *q != '\n' && *q != '\r') {
+                q++;
+            }
+            if (q == end && !eof) {
+                return nullptr;
+            }
+            fields.emplace_back(p, q - p);
+            quoted.push_back(false);
+            p = q;
+        }
+
+        if (p < end && *p == delimiter) {
+            p++;
+            continue;
+        }
+        if (p < end && *p == '\r') {
+            if (p + 1 == end && !eof) {
+                return nullptr;
+            }
+            p++;
+        }
+        if (p < end && *p == '\n') {
+            return p + 1;
+        }
+        if (p == end) {
+            if (!eof) {
+                return nullptr;
+            }
+            return end;
+        }
+        throw std::runtime_error("unexpected character after quoted field");
+    }
+}
+
+// NULL is an empty INTEGER, FLOAT or BOOLEAN field, or an empty unquoted
+// STRING field; a quoted one ("") is the empty string. That is how
+// ResultSink writes CSV, so its output loads back as the same values.
+void appendField(ColumnBuilder& column, std::string_view field, bool quoted, size_t row, const Column& schema) {
+    bool null = column.type == ColumnType::STRING ? field.empty() && !quoted : trim(field).empty();
+    if (null) {
+        if (!schema.isNullable()) {
+            throw std::runtime_error("column " + schema.getName() + " can't be NULL");
+        }
+        column.nulls.resize(row / 64 + 1);
+        column.nulls[row / 64] |= uint64_t(1) << (row & 63);
+        field = column.type == ColumnType::BOOLEAN ? "false" : column.type == ColumnType::STRING ? "" : "0";
+    }
+    switch (column.type) {
+        case ColumnType::INT: {
+            std::string_view text = trim(field);
+            int v = 0;
+            auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), v);
+            if (ec != std::errc() || ptr != text.data() + text.size() || text.empty()) {
+                throw std::runtime_error("invalid INTEGER '" + std::string(field) + "' for " + schema.getName());
+            }
+            column.ints.push_back(v);
+            break;
+        }
+        case ColumnType::FLOAT: {
+            std::string_view text = trim(field);
+            float v = 0.0f;
+            auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), v);
+            if (ec != std::errc() || ptr != text.data() + text.size() || text.empty()) {
+                throw std::runtime_error("invalid FLOAT '" + std::string(field) + "' for " + schema.getName());
+            }
+            column.floats.push_back(v);
+            break;
+        }
+        case ColumnType::BOOLEAN: {
+            std::string_view text = trim(field);
+            bool v;
+            if (equalsIgnoreCase(text, "true") || text == "1") {
+                v = true;
+            } else if (equalsIgnoreCase(text, "false") || text == "0") {
+                v = false;
+            } else {
+                throw std::runtime_error("invalid BOOLEAN '" + std::string(field) + "' for " + schema.getName());
+            }
+            if ((row & 63) == 0) {
+                column.bits.push_back(0);
+            }
+            column.bits.back() |= uint64_t(v) << (row & 63);
+            break;
+        }
+        case ColumnType::STRING:
+            column.chars.append(field);
+            column.offsets.push_back(static_cast<uint32_t>(column.chars.size()));
+            break;
+    }
+}
+
+}
+
+std::vector<std::vector<ColumnChunk>> readCsv(const std::string& fileName, const std::vector<Column>& columns,
+                                              const CsvOptions& options) {
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open " + fileName);
+    }
+
+    std::vector<ColumnBuilder> builders;
+    builders.reserve(columns.size());
+    for (const auto& col : columns) {
+        ColumnBuilder builder;
+        builder.type = col.getType();
+        switch (builder.type) {
+            case ColumnType::INT:
+                builder.ints.reserve(kChunkRows);
+                break;
+            case ColumnType::FLOAT:
+                builder.floats.reserve(kChunkRows);
+                break;
+            case ColumnType::BOOLEAN:
+                builder.bits.reserve(kChunkRows / 64);
+                break;
+            case ColumnType::STRING:
+                builder.offsets.reserve(kChunkRows + 1);
+                break;
+        }
+        builders.push_back(std::move(builder));
+    }
+
+    std::vector<std::vector<ColumnChunk>> batches;
+    size_t rows = 0; // rows in the current batch
+    auto flush = [&]() {
+        std::vector<ColumnChunk> batch;
+        batch.reserve(builders.size());
+        for (auto& builder : builders) {
+            batch.push_back(builder.build(rows));
+            builder.clear();
+        }
+        batches.push_back(std::move(batch));
+        rows = 0;
+    };
+
+    std::vector<char> buffer(1 << 20);
+    size_t begin = 0, end = 0;
+    bool eof = false;
+    size_t record = 0;
+    std::vector<std::string_view> fields;
+    std::vector<bool> quoted;
+    std::deque<std::string> unescaped;
+
+    while (true) {
+        if (begin == end && eof) {
+            break;
+        }
+        const char* next = nullptr;
+        if (begin < end) {
+            try {
+                next = splitRecord(buffer.data() + begin, buffer.data() + end, eof, options.delimiter, fields, quoted, unescaped);
+            } catch (const std::runtime_error& e) {
+                throw std::runtime_error("Record " + std::to_string(record + 1) + ": " + e.what());
+            }
+        }
+        if (next == nullptr) {
+            // Keep the partial record, grow if it fills the whole buffer
+            std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+            end -= begin;
+            begin = 0;
+            if (end == buffer.size()) {
+                buffer.resize(buffer.size() * 2);
+            }
+            file.read(buffer.data() + end, static_cast<std::streamsize>(buffer.size() - end));
+            end += static_cast<size_t>(file.gcount());
+            if (file.gcount() == 0) {
+                eof = true;
+            }
+            continue;
+        }
+        begin = next - buffer.data();
+        record++;
+
+        // Blank lines carry no row
+        if (fields.size() == 1 && fields[0].empty() && !quoted[0] && columns.size() != 1) {
+            continue;
+        }
+        if (record == 1 && options.header) {
+            continue;
+        }
+        if (fields.size() != columns.size()) {
+            throw std::runtime_error("Record " + std::to_string(record) + ": expected " +
+                                     std::to_string(columns.size()) + " fields, got " + std::to_string(fields.size()));
+        }
+        try {
+            for (size_t c = 0; c < columns.size(); c++) {
+                appendField(builders[c], fields[c], quoted[c], rows, columns[c]);
+            }
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error("Record " + std::to_string(record) + ": " + e.what());
+        }
+        if (++rows == kChunkRows) {
+            flush();
+        }
+    }
+    if (rows > 0) {
+        flush();
+    }
+    return batches;
+}
@@ -0,0 +1,24 @@
+#ifndef CSVLOADER_H
+#define CSVLOADER_H
+
+#include <string>
+#include <vector>
+#include "Column.h"
+#include "ColumnChunk.h"
+
+struct CsvOptions {
+    char delimiter = ',';
+    bool header = false; // skip the first record
+};
+
+// Reads a CSV file (RFC 4180 quoting, LF or CRLF line ends) into batches of
+// up to kChunkRows rows, one ColumnChunk per column in schema order, ready
+// for Table::appendChunks. Fields are converted with std::from_chars straight
+// out of the read buffer. An empty field is NULL, except a quoted one ("")
+// in a STRING column, which is the empty string. Throws std::runtime_error
+// naming the first bad record, a NULL in a NOT NULL column included;
+// nothing is returned in that case.
+std::vector<std::vector<ColumnChunk>> readCsv(const std::string& fileName, const std::vector<Column>& columns,
+                                              const CsvOptions& options = CsvOptions());
+
+#endif //CSVLOADER_H
@@ -0,0 +1,819 @@
+#include "Database.h"
+#include <bit>
+#include <fstream>
+#include <list>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include "FileFormat.h"
+#include "MappedFile.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+void Database::createTable(const std::string& tableName, StorageMode mode) {
+    addTable(std::make_shared<Table>(tableName, mode));
+}
+
+bool Database::addTable(std::shared_ptr<Table> table) {
+    std::unique_lock<std::shared_mutex> lock(tablesLock);
+    std::string name = table->getName();
+    return tables.emplace(name, std::move(table)).second;
+}
+
+void Database::DropTable(const std::string& tableName) {
+    std::unique_lock<std::shared_mutex> lock(tablesLock);
+    tables.erase(tableName);
+}
+
+std::shared_ptr<Table> Database::GetTable(const std::string& tableName) const {
+    std::shared_lock<std::shared_mutex> lock(tablesLock);
+    auto it = tables.find(tableName);
+    if (it == tables.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+std::vector<std::shared_ptr<Table>> Database::getTables() const {
+    std::shared_lock<std::shared_mutex> lock(tablesLock);
+    std::vector<std::shared_ptr<Table>> result;
+    result.reserve(tables.size());
+    for (const auto& [name, table] : tables) {
+        result.push_back(table);
+    }
+    return result;
+}
+
+std::shared_lock<std::shared_mutex> Database::lockCatalog() {
+    return std::shared_lock<std::shared_mutex>(catalogLock);
+}
+
+void Database::attachLog(std::unique_ptr<WriteAheadLog> newLog) {
+    log = std::move(newLog);
+}
+
+std::unique_ptr<WriteAheadLog> Database::detachLog() {
+    return std::move(log);
+}
+
+WriteAheadLog* Database::getLog() {
+    return log.get();
+}
+
+Database::Database() : pool(std::make_unique<ThreadPool>()) {}
+
+Database::~Database() {
+    {
+        std::lock_guard<std::mutex> lock(compactionMutex);
+        compactionStopping = true;
+    }
+    compactionWake.notify_one();
+    if (compactor.joinable()) {
+        compactor.join();
+    }
+}
+
+void Database::scheduleCompaction(const std::shared_ptr<Table>& table) {
+    std::lock_guard<std::mutex> lock(compactionMutex);
+    for (const auto& queued : compactionQueue) {
+        if (queued.lock() == table) {
+            return;
+        }
+    }
+    compactionQueue.push_back(table);
+    if (!compactor.joinable()) {
+        compactor = std::thread(&Database::compactionLoop, this);
+    }
+    compactionWake.notify_one();
+}
+
+// A dropped table is skipped: the queue holds it weakly
+void Database::compactionLoop() {
+    std::unique_lock<std::mutex> lock(compactionMutex);
+    while (true) {
+        compactionWake.wait(lock, [this] { return compactionStopping || !compactionQueue.empty(); });
+        if (compactionStopping) {
+            return;
+        }
+        std::shared_ptr<Table> table = compactionQueue.front().lock();
+        compactionQueue.erase(compactionQueue.begin());
+        lock.unlock();
+        if (table) {
+            Table::WriteLock write = table->lockForWrite();
+            if (table->needsCompaction()) {
+                table->compact();
+            }
+        }
+        lock.lock();
+    }
+}
+
+void Database::setThreadCount(size_t threads) {
+    pool = std::make_unique<ThreadPool>(threads);
+}
+
+ThreadPool& Database::getThreadPool() {
+    return *pool;
+}
+
+uint64_t Database::getCheckpointLsn() const {
+    return checkpointLsn;
+}
+
+void Database::listTables() const {
+    std::vector<std::shared_ptr<Table>> current = getTables();
+    if (current.empty()) {
+        std::cout << "No tables." << std::endl;
+        return;
+    }
+    for (const auto& table : current) {
+        std::shared_ptr<const Table> snapshot = table->readSnapshot();
+        std::cout << snapshot->getName() << " (" << snapshot->getColumnCount() << " columns, "
+                  << snapshot->getLiveRowCount() << " rows)" << std::endl;
+    }
+}
+
+// Stream buffer size used for save and load
+static constexpr size_t kIoBufferSize = 1 << 20;
+
+// Writes a block header and a payload made of `pieces`, without first
+// copying them together
+static void writePieces(BinaryWriter& writer, uint32_t rows, const std::vector<std::string_view>& pieces) {
+    uint32_t crc = 0;
+    uint64_t size = 0;
+    for (const auto& piece : pieces) {
+        crc = crc32(piece.data(), piece.size(), crc);
+        size += piece.size();
+    }
+    writer.writeU32(rows);
+    writer.writeU32(crc);
+    writer.writeU64(size);
+    for (const auto& piece : pieces) {
+        writer.writeBytes(piece.data(), piece.size());
+    }
+}
+
+template <typename T>
+static std::string_view bytesOf(const T* data, size_t n) {
+    return std::string_view(reinterpret_cast<const char*>(data), n * sizeof(T));
+}
+
+// STRING blocks are dictionary encoded when the rows come from a dictionary
+// chunk or when the dictionary takes at most half the plain size
+static void writeStringBlock(BinaryWriter& writer, const TableStorage& storage, size_t col, size_t first, size_t count,
+                             std::vector<std::string_view> pieces) {
+    static const char zeros[4] = {};
+    uint32_t rows = static_cast<uint32_t>(count);
+    size_t codeBytes = count * sizeof(uint16_t);
+    size_t padding = (4 - codeBytes % 4) % 4;
+
+    const uint16_t* chunkCodes;
+    if (const ColumnChunk* chunk = storage.getStringCodes(col, first, count, chunkCodes)) {
+        uint32_t header[2] = {1, chunk->dictionarySize()};
+        const uint32_t* offsets = chunk->stringOffsets();
+        pieces.insert(pieces.end(), {bytesOf(header, 2), bytesOf(chunkCodes, count), std::string_view(zeros, padding),
+                                     bytesOf(offsets, size_t(header[1]) + 1),
+                                     std::string_view(chunk->stringChars() + offsets[0], offsets[header[1]] - offsets[0])});
+        writePieces(writer, rows, pieces);
+        return;
+    }
+
+    std::vector<std::string_view> strings;
+    storage.getStrings(col, first, count, strings);
+    std::vector<uint32_t> offsets(count + 1);
+    offsets[0] = 0;
+    for (size_t i = 0; i < count; i++) {
+        offsets[i + 1] = offsets[i] + static_cast<uint32_t>(strings[i].size());
+    }
+    size_t budget = ((count + 1) * sizeof(uint32_t) + offsets[count]) / 2;
+    std::vector<uint16_t> codes;
+    std::vector<uint32_t> dictOffsets;
+    std::string dictChars;
+    if (budget > codeBytes + padding &&
+        ColumnChunk::buildDictionary(strings.data(), count, budget - codeBytes - padding, codes, dictOffsets, dictChars)) {
+        uint32_t header[2] = {1, static_cast<uint32_t>(dictOffsets.size() - 1)};
+        pieces.insert(pieces.end(), {bytesOf(header, 2), bytesOf(codes.data(), count), std::string_view(zeros, padding),
+                                     bytesOf(dictOffsets.data(), dictOffsets.size()), dictChars});
+        writePieces(writer, rows, pieces);
+        return;
+    }
+
+    uint32_t header[2] = {0, 0};
+    pieces.reserve(pieces.size() + count + 2);
+    pieces.push_back(bytesOf(header, 2));
+    pieces.push_back(bytesOf(offsets.data(), offsets.size()));
+    pieces.insert(pieces.end(), strings.begin(), strings.end());
+    writePieces(writer, rows, pieces);
+}
+
+// Writes rows [first, first + count) of one column as a block: the NULL
+// flags, then the typed values
+static void writeBlock(BinaryWriter& writer, const Table& table, size_t col, size_t first, size_t count) {
+    const TableStorage& storage = table.getStorage();
+    uint32_t rows = static_cast<uint32_t>(count);
+
+    std::vector<uint64_t> nullScratch;
+    std::vector<uint64_t> nullWords;
+    uint32_t nullHeader[2] = {0, 0};
+    if (const uint64_t* bits = storage.getNulls(col, first, count, nullScratch)) {
+        nullWords.assign(bits, bits + (count + 63) / 64);
+        if (count % 64) {
+            nullWords.back() &= (uint64_t(1) << (count % 64)) - 1;
+        }
+        for (uint64_t word : nullWords) {
+            nullHeader[0] += static_cast<uint32_t>(std::popcount(word));
+        }
+    }
+    std::vector<std::string_view> pieces{bytesOf(nullHeader, 2)};
+    if (nullHeader[0] > 0) {
+        pieces.push_back(bytesOf(nullWords.data(), nullWords.size()));
+    }
+
+    switch (table.getColumns()[col].getType()) {
+        case ColumnType::INT: {
+            std::vector<int> scratch;
+            pieces.push_back(bytesOf(storage.getInts(col, first, count, scratch), count));
+            writePieces(writer, rows, pieces);
+            break;
+        }
+        case ColumnType::FLOAT: {
+            std::vector<float> scratch;
+            pieces.push_back(bytesOf(storage.getFloats(col, first, count, scratch), count));
+            writePieces(writer, rows, pieces);
+            break;
+        }
+        case ColumnType::BOOLEAN: {
+            std::vector<uint64_t> words((count + 63) / 64);
+            storage.getBools(col, first, count, words.data());
+            pieces.push_back(bytesOf(words.data(), words.size()));
+            writePieces(writer, rows, pieces);
+            break;
+        }
+        case ColumnType::STRING:
+            writeStringBlock(writer, storage, col, first, count, std::move(pieces));
+            break;
+    }
+    writer.padTo8();
+}
+
+static void writeDefault(BinaryWriter& writer, const Value& value) {
+    std::visit([&](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::string>) {
+            writer.writeString(v);
+        } else if constexpr (std::is_same_v<T, bool>) {
+            writer.writeU8(v);
+        } else if constexpr (!std::is_same_v<T, std::monostate>) {
+            writer.writeBytes(&v, sizeof(v));
+        }
+    }, value);
+}
+
+static Value readDefault(BinaryReader& reader, ColumnType type) {
+    switch (type) {
+        case ColumnType::INT: {
+            int v;
+            reader.readBytes(&v, sizeof(v));
+            return v;
+        }
+        case ColumnType::FLOAT: {
+            float v;
+            reader.readBytes(&v, sizeof(v));
+            return v;
+        }
+        case ColumnType::STRING:
+            return reader.readString();
+        case ColumnType::BOOLEAN:
+            return reader.readU8() != 0;
+    }
+    return std::monostate{};
+}
+
+static void writeTable(BinaryWriter& writer, const Table& table) {
+    std::ostringstream headerStream;
+    BinaryWriter header(headerStream);
+    header.writeString(table.getName());
+    header.writeU8(static_cast<uint8_t>(table.getStorageMode()));
+    header.writeU32(static_cast<uint32_t>(table.getColumnCount()));
+    for (const auto& col : table.getColumns()) {
+        header.writeString(col.getName());
+        header.writeU8(static_cast<uint8_t>(col.getType()) | (col.isNullable() ? 0 : kNotNullFlag) |
+                       (col.hasDefault() ? kDefaultFlag : 0));
+        if (col.hasDefault()) {
+            writeDefault(header, col.getDefault());
+        }
+    }
+    header.writeU64(table.getRowCount());
+    header.writeU32(static_cast<uint32_t>(table.getIndexes().size()));
+    for (const auto& index : table.getIndexes()) {
+        header.writeString(index->getName());
+        header.writeU32(static_cast<uint32_t>(index->getColumn()));
+        header.writeU8(static_cast<uint8_t>(index->getType()));
+    }
+    const ZoneMap& zones = table.getZoneMap();
+    for (size_t z = 0; z * kZoneRows < table.getRowCount(); z++) {
+        for (size_t c = 0; c < table.getColumnCount(); c++) {
+            const Zone& zone = zones.getZone(c, z);
+            header.writeU32(zone.nullCount);
+            if (table.getColumns()[c].getType() != ColumnType::BOOLEAN) {
+                header.writeU8(!isNull(zone.min));
+                if (!isNull(zone.min)) {
+                    writeDefault(header, zone.min);
+                    writeDefault(header, zone.max);
+                }
+            }
+        }
+    }
+
+    std::string bytes = headerStream.str();
+    writer.writeU32(static_cast<uint32_t>(bytes.size()));
+    writer.writeBytes(bytes.data(), bytes.size());
+    writer.writeU32(crc32(bytes.data(), bytes.size()));
+    writer.padTo8();
+
+    size_t rowCount = table.getRowCount();
+    for (size_t first = 0; first < rowCount; first += kChunkRows) {
+        size_t count = std::min(kChunkRows, rowCount - first);
+        for (size_t c = 0; c < table.getColumnCount(); c++) {
+            writeBlock(writer, table, c, first, count);
+        }
+    }
+}
+
+bool Database::saveToFile(const std::string& fileName) {
+    // Write to a temporary file and rename it over the target, so a failed
+    // save never leaves a half-written database behind
+    std::string tmpName = fileName + ".tmp";
+    std::vector<char> buffer(kIoBufferSize);
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.open(tmpName, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Cannot open " << tmpName << " for writing" << std::endl;
+        return false;
+    }
+
+    // Writers are held off while saving, so the file matches the log position
+    std::unique_lock<std::shared_mutex> catalog(catalogLock);
+    std::vector<std::shared_ptr<Table>> saved = getTables();
+    std::list<Table::WriteLock> writeLocks;
+    for (const auto& table : saved) {
+        writeLocks.emplace_back(*table);
+    }
+    uint64_t lsn = log ? log->getLastLsn() : checkpointLsn;
+    BinaryWriter writer(out);
+    writer.writeBytes(kFileMagic, sizeof(kFileMagic));
+    writer.writeU32(kFileVersion);
+    writer.writeU32(static_cast<uint32_t>(saved.size()));
+    writer.writeU32(0);
+    writer.writeU64(lsn);
+    for (const auto& table : saved) {
+        table->compact(); // tombstoned rows are not written
+        writeTable(writer, *table);
+    }
+
+    out.close();
+    if (!out) {
+        std::cerr << "Error writing " << tmpName << std::endl;
+        std::remove(tmpName.c_str());
+        return false;
+    }
+    // The snapshot must be on disk before the log records it replaces go away
+    int fd = ::open(tmpName.c_str(), O_RDONLY);
+    bool synced = fd >= 0 && ::fsync(fd) == 0;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!synced) {
+        std::cerr << "Cannot sync " << tmpName << std::endl;
+        std::remove(tmpName.c_str());
+        return false;
+    }
+    if (std::rename(tmpName.c_str(), fileName.c_str()) != 0) {
+        std::cerr << "Cannot replace " << fileName << std::endl;
+        std::remove(tmpName.c_str());
+        return false;
+    }
+
+    checkpointLsn = lsn;
+    if (log) {
+        try {
+            log->truncate(lsn);
+        } catch (const std::exception& e) {
+            // Harmless: replay skips records the snapshot already covers
+            std::cerr << e.what() << std::endl;
+        }
+    }
+    return true;
+}
+
+// Payload size of a fixed-width block; STRING sizes are checked by
+// parseStringBlock
+static size_t fixedPayloadSize(ColumnType type, size_t rows) {
+    switch (type) {
+        case ColumnType::INT:
+        case ColumnType::FLOAT:
+            return rows * 4;
+        case ColumnType::BOOLEAN:
+            return (rows + 63) / 64 * 8;
+        case ColumnType::STRING:
+            break;
+    }
+    return 0;
+}
+
+static void checkBlockHeader(uint32_t rows, size_t expectedRows) {
+    if (rows != expectedRows) {
+        throw std::runtime_error("Block row count mismatch");
+    }
+}
+
+// NULL flags at the front of a block payload. Moves payload and size past
+// them and returns the bitmap, or null if no row is NULL.
+static const uint64_t* parseNullSection(const char*& payload, uint64_t& size, uint32_t rows, uint32_t& nullCount) {
+    nullCount = 0;
+    if (size < 8) {
+        throw std::runtime_error("Corrupt null flags");
+    }
+    std::memcpy(&nullCount, payload, 4);
+    payload += 8;
+    size -= 8;
+    if (nullCount == 0) {
+        return nullptr;
+    }
+    uint64_t words = (uint64_t(rows) + 63) / 64;
+    if (nullCount > rows || size < words * 8) {
+        throw std::runtime_error("Corrupt null flags");
+    }
+    const uint64_t* bitmap = reinterpret_cast<const uint64_t*>(payload);
+    uint64_t counted = 0;
+    for (uint64_t w = 0; w < words; w++) {
+        counted += static_cast<uint64_t>(std::popcount(bitmap[w]));
+    }
+    if (counted != nullCount || (rows % 64 && (bitmap[words - 1] >> (rows % 64)))) {
+        throw std::runtime_error("Corrupt null flags");
+    }
+    payload += words * 8;
+    size -= words * 8;
+    return bitmap;
+}
+
+static void checkPayloadSize(ColumnType type, uint32_t rows, uint64_t size) {
+    if (type != ColumnType::STRING && size != fixedPayloadSize(type, rows)) {
+        throw std::runtime_error("Block size mismatch");
+    }
+}
+
+// The parts of a STRING block payload, see FileFormat.h
+struct StringBlock {
+    bool dictionary = false;
+    uint32_t entries = 0;            // dictionary size
+    const char* body = nullptr;      // codes or offsets, where a chunk maps from
+    const uint16_t* codes = nullptr;
+    const uint32_t* offsets = nullptr; // entries + 1 or rows + 1 of them
+    const char* chars = nullptr;
+    size_t offsetCount = 0;
+};
+
+// Checks the layout, that the offsets rise from 0 to the end of the
+// characters and that every code names a dictionary entry, so no string
+// read from the block can reach outside it
+static StringBlock parseStringBlock(const char* payload, uint64_t size, uint32_t rows) {
+    StringBlock block;
+    uint32_t encoding;
+    if (size < 8) {
+        throw std::runtime_error("Corrupt string block");
+    }
+    std::memcpy(&encoding, payload, 4);
+    std::memcpy(&block.entries, payload + 4, 4);
+    if (encoding > 1) {
+        throw std::runtime_error("Unknown string encoding");
+    }
+    block.dictionary = encoding == 1;
+    uint64_t pos = 8;
+    block.body = payload + pos;
+    size_t strings = rows;
+    if (block.dictionary) {
+        if (block.entries > size_t(UINT16_MAX) + 1 || (rows > 0 && block.entries == 0)) {
+            throw std::runtime_error("Corrupt string block");
+        }
+        block.codes = reinterpret_cast<const uint16_t*>(payload + pos);
+        pos += (uint64_t(rows) * sizeof(uint16_t) + 3) & ~uint64_t(3);
+        strings = block.entries;
+    }
+    uint64_t offsetBytes = (uint64_t(strings) + 1) * 4;
+    if (size < pos + offsetBytes) {
+        throw std::runtime_error("Block size mismatch");
+    }
+    block.offsets = reinterpret_cast<const uint32_t*>(payload + pos);
+    block.chars = payload + pos + offsetBytes;
+    block.offsetCount = strings + 1;
+    uint32_t firstOffset;
+    uint32_t lastOffset;
+    std::memcpy(&firstOffset, block.offsets, 4);
+    std::memcpy(&lastOffset, block.offsets + strings, 4);
+    if (firstOffset != 0 || lastOffset != size - pos - offsetBytes) {
+        throw std::runtime_error("Corrupt string block");
+    }
+    for (size_t i = 0; i + 1 < block.offsetCount; i++) {
+        if (block.offsets[i] > block.offsets[i + 1]) {
+            throw std::runtime_error("Corrupt string block");
+        }
+    }
+    if (block.dictionary) {
+        for (size_t i = 0; i < rows; i++) {
+            if (block.codes[i] >= block.entries) {
+                throw std::runtime_error("Corrupt string block");
+            }
+        }
+    }
+    return block;
+}
+
+// Reads one block into `chunk`, verifying its row count and checksum
+static void readBlock(BinaryReader& reader, std::vector<char>& payload, size_t expectedRows, ColumnChunk& chunk) {
+    uint32_t rows = reader.readU32();
+    uint32_t crc = reader.readU32();
+    uint64_t size = reader.readU64();
+    checkBlockHeader(rows, expectedRows);
+
+    payload.resize(size);
+    reader.readBytes(payload.data(), size);
+    if (crc32(payload.data(), size) != crc) {
+        throw std::runtime_error("Block checksum mismatch");
+    }
+    reader.skipTo8();
+
+    const char* data = payload.data();
+    uint32_t nullCount;
+    const uint64_t* nulls = parseNullSection(data, size, rows, nullCount);
+    checkPayloadSize(chunk.getType(), rows, size);
+    switch (chunk.getType()) {
+        case ColumnType::INT:
+            chunk.appendInts(reinterpret_cast<const int*>(data), rows);
+            break;
+        case ColumnType::FLOAT:
+            chunk.appendFloats(reinterpret_cast<const float*>(data), rows);
+            break;
+        case ColumnType::BOOLEAN:
+            chunk.appendBools(reinterpret_cast<const uint64_t*>(data), rows);
+            break;
+        case ColumnType::STRING: {
+            StringBlock block = parseStringBlock(data, size, rows);
+            if (!block.dictionary) {
+                chunk.appendStrings(block.offsets, block.chars, rows);
+                break;
+            }
+            chunk.appendDictionary(block.codes, rows, block.offsets, block.chars, block.entries);
+            break;
+        }
+    }
+    if (nulls) {
+        chunk.setNulls(nulls);
+    }
+}
+
+struct IndexDefinition {
+    std::string name;
+    uint32_t column;
+    uint8_t type;
+};
+
+// Builds an empty table from its serialized header. zoneStats gets the
+// statistics of each row group, one per column.
+static Table parseTableHeader(const std::string& bytes, uint64_t& rowCount,
+                              std::vector<IndexDefinition>& indexes, std::vector<std::vector<Zone>>& zoneStats) {
+    std::istringstream headerStream(bytes);
+    BinaryReader header(headerStream);
+    std::string name = header.readString();
+    uint8_t mode = header.readU8();
+    if (mode > static_cast<uint8_t>(StorageMode::COLUMNAR)) {
+        throw std::runtime_error("Unknown storage mode");
+    }
+    Table table(name, static_cast<StorageMode>(mode));
+    uint32_t columnCount = header.readU32();
+    for (uint32_t c = 0; c < columnCount; c++) {
+        std::string colName = header.readString();
+        uint8_t type = header.readU8();
+        bool nullable = !(type & kNotNullFlag);
+        bool hasDefault = type & kDefaultFlag;
+        type &= ~(kNotNullFlag | kDefaultFlag);
+        if (type > static_cast<uint8_t>(ColumnType::BOOLEAN)) {
+            throw std::runtime_error("Unknown column type");
+        }
+        Value defaultValue = std::monostate{};
+        if (hasDefault) {
+            defaultValue = readDefault(header, static_cast<ColumnType>(type));
+        }
+        table.addColumn(Column(colName, static_cast<ColumnType>(type), nullable, defaultValue));
+    }
+    rowCount = header.readU64();
+    uint32_t indexCount = header.readU32();
+    for (uint32_t i = 0; i < indexCount; i++) {
+        IndexDefinition def;
+        def.name = header.readString();
+        def.column = header.readU32();
+        def.type = header.readU8();
+        if (def.column >= columnCount || def.type > static_cast<uint8_t>(IndexType::BTREE)) {
+            throw std::runtime_error("Corrupt index definition");
+        }
+        indexes.push_back(def);
+    }
+    for (uint64_t first = 0; first < rowCount; first += kZoneRows) {
+        size_t rows = static_cast<size_t>(std::min<uint64_t>(kZoneRows, rowCount - first));
+        std::vector<Zone>& group = zoneStats.emplace_back(columnCount);
+        for (uint32_t c = 0; c < columnCount; c++) {
+            Zone& zone = group[c];
+            ColumnType type = table.getColumns()[c].getType();
+            zone.nullCount = header.readU32();
+            if (zone.nullCount > rows) {
+                throw std::runtime_error("Corrupt zone statistics");
+            }
+            if (type != ColumnType::BOOLEAN && header.readU8()) {
+                zone.min = readDefault(header, type);
+                zone.max = readDefault(header, type);
+            }
+        }
+    }
+    return table;
+}
+
+// Indexes are built once the rows are in, in a single pass each
+static void buildIndexes(Table& table, const std::vector<IndexDefinition>& indexes) {
+    for (const auto& def : indexes) {
+        table.createIndex(def.name, table.getColumns()[def.column].getName(), static_cast<IndexType>(def.type));
+    }
+}
+
+static Table readTable(BinaryReader& reader, std::vector<char>& payload) {
+    uint32_t headerSize = reader.readU32();
+    std::string bytes(headerSize, '\0');
+    reader.readBytes(bytes.data(), headerSize);
+    if (crc32(bytes.data(), bytes.size()) != reader.readU32()) {
+        throw std::runtime_error("Table header checksum mismatch");
+    }
+    reader.skipTo8();
+
+    uint64_t rowCount = 0;
+    std::vector<IndexDefinition> indexes;
+    std::vector<std::vector<Zone>> zoneStats;
+    Table table = parseTableHeader(bytes, rowCount, indexes, zoneStats);
+    size_t columnCount = table.getColumnCount();
+
+    for (uint64_t first = 0; first < rowCount; first += kChunkRows) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(kChunkRows, rowCount - first));
+        std::vector<ColumnChunk> chunks;
+        chunks.reserve(columnCount);
+        for (const auto& col : table.getColumns()) {
+            chunks.emplace_back(col.getType());
+            readBlock(reader, payload, count, chunks.back());
+        }
+        table.appendChunks(chunks, zoneStats[first / kChunkRows]);
+    }
+    buildIndexes(table, indexes);
+    return table;
+}
+
+// Maps one table out of the file. COLUMNAR tables point their chunks at the
+// block payloads; payload checksums are skipped since verifying them would
+// fault in the whole file. What a chunk reads through is still checked:
+// the NULL flags, and the offsets and codes of STRING blocks, so a corrupt
+// block fails the load rather than a later read (the characters and the
+// INT, FLOAT and BOOLEAN values can hold any bits). ROW tables need Row
+// objects and are decoded.
+static Table mapTable(MemoryReader& reader, const std::shared_ptr<const MappedFile>& file) {
+    uint32_t headerSize = reader.readU32();
+    std::string bytes(reader.take(headerSize), headerSize);
+    if (crc32(bytes.data(), bytes.size()) != reader.readU32()) {
+        throw std::runtime_error("Table header checksum mismatch");
+    }
+    reader.skipTo8();
+
+    uint64_t rowCount = 0;
+    std::vector<IndexDefinition> indexes;
+    std::vector<std::vector<Zone>> zoneStats;
+    Table table = parseTableHeader(bytes, rowCount, indexes, zoneStats);
+    bool mapped = table.getStorageMode() == StorageMode::COLUMNAR;
+
+    for (uint64_t first = 0; first < rowCount; first += kChunkRows) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(kChunkRows, rowCount - first));
+        std::vector<ColumnChunk> chunks;
+        chunks.reserve(table.getColumnCount());
+        for (const auto& col : table.getColumns()) {
+            ColumnType type = col.getType();
+            uint32_t rows = reader.readU32();
+            uint32_t crc = reader.readU32();
+            uint64_t size = reader.readU64();
+            checkBlockHeader(rows, count);
+            const char* payload = reader.take(size);
+            reader.skipTo8();
+
+            // ROW tables copy the chunk into rows in appendChunks, so those are verified
+            if (!mapped && crc32(payload, size) != crc) {
+                throw std::runtime_error("Block checksum mismatch");
+            }
+            uint32_t nullCount;
+            const uint64_t* nulls = parseNullSection(payload, size, rows, nullCount);
+            checkPayloadSize(type, rows, size);
+            if (type != ColumnType::STRING) {
+                chunks.emplace_back(type, rows, file, payload);
+            } else {
+                StringBlock block = parseStringBlock(payload, size, rows);
+                if (block.dictionary) {
+                    chunks.emplace_back(rows, block.entries, file, block.body);
+                } else {
+                    chunks.emplace_back(type, rows, file, block.body);
+                }
+            }
+            chunks.back().mapNulls(nulls, nullCount);
+        }
+        // Saved statistics spare computing them, which would read every block
+        table.appendChunks(chunks, zoneStats[first / kChunkRows]);
+    }
+    buildIndexes(table, indexes);
+    return table;
+}
+
+bool Database::loadFromFile(const std::string& fileName, bool memoryMapped) {
+    if (memoryMapped) {
+        try {
+            auto file = std::make_shared<const MappedFile>(fileName);
+            MemoryReader reader(file->getData(), file->getSize());
+            if (std::memcmp(reader.take(sizeof(kFileMagic)), kFileMagic, sizeof(kFileMagic)) != 0) {
+                throw std::runtime_error("Not a database file");
+            }
+            uint32_t version = reader.readU32();
+            if (version != kFileVersion) {
+                throw std::runtime_error("Unsupported file version " + std::to_string(version));
+            }
+            uint32_t tableCount = reader.readU32();
+            reader.readU32(); // reserved
+            uint64_t lsn = reader.readU64();
+
+            std::unordered_map<std::string, std::shared_ptr<Table>> loaded;
+            for (uint32_t t = 0; t < tableCount; t++) {
+                auto table = std::make_shared<Table>(mapTable(reader, file));
+                std::string name = table->getName();
+                loaded.emplace(name, std::move(table));
+            }
+            {
+                std::unique_lock<std::shared_mutex> lock(tablesLock);
+                tables = std::move(loaded);
+            }
+            checkpointLsn = lsn;
+            if (log) {
+                log->setLastLsn(lsn);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error mapping " << fileName << ": " << e.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<char> buffer(kIoBufferSize);
+    std::ifstream in;
+    in.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    in.open(fileName, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open " << fileName << std::endl;
+        return false;
+    }
+
+    try {
+        BinaryReader reader(in);
+        char magic[sizeof(kFileMagic)];
+        reader.readBytes(magic, sizeof(magic));
+        if (!std::equal(magic, magic + sizeof(magic), kFileMagic)) {
+            throw std::runtime_error("Not a database file");
+        }
+        uint32_t version = reader.readU32();
+        if (version != kFileVersion) {
+            throw std::runtime_error("Unsupported file version " + std::to_string(version));
+        }
+        uint32_t tableCount = reader.readU32();
+        reader.readU32(); // reserved
+        uint64_t lsn = reader.readU64();
+
+        // Build the new catalog on the side so a bad file leaves the current one intact
+        std::unordered_map<std::string, std::shared_ptr<Table>> loaded;
+        std::vector<char> payload;
+        for (uint32_t t = 0; t < tableCount; t++) {
+            auto table = std::make_shared<Table>(readTable(reader, payload));
+            std::string name = table->getName();
+            loaded.emplace(name, std::move(table));
+        }
+        {
+            std::unique_lock<std::shared_mutex> lock(tablesLock);
+            tables = std::move(loaded);
+        }
+        checkpointLsn = lsn;
+        if (log) {
+            log->setLastLsn(lsn);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading " << fileName << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -6,26 +6,79 @@
 #define DATABASE_H
 #include <iostream>
 #include  <string>
+#include <unordered_map>
+#include <memory>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
 #include "Table.h"
+#include "WriteAheadLog.h"
+#include "ThreadPool.h"
 
+// Safe to share between threads. Tables are handed out as shared pointers,
+// so a table dropped while another thread works on it stays alive until
+// that thread lets go; what a thread may do with a table is up to the
+// table's own locking (see Table). Configuration (attachLog, setThreadCount,
+// loadFromFile) is meant for startup, before other threads use the database.
 class Database {
 private:
-    std::unordered_map<std::string ,Table> tables;
+    std::unordered_map<std::string, std::shared_ptr<Table>> tables;
+    mutable std::shared_mutex tablesLock; // guards the map only, never held while waiting for a table
+    // CREATE and DROP TABLE hold it shared until they are logged; saving holds
+    // it exclusively, so the tables saved are the ones the log position covers
+    std::shared_mutex catalogLock;
+    std::unique_ptr<WriteAheadLog> log;
+    uint64_t checkpointLsn = 0; // last log record covered by the loaded/saved snapshot
+    std::unique_ptr<ThreadPool> pool;
+    // Tables waiting for compaction, and the thread compacting them; started
+    // by the first scheduleCompaction
+    std::mutex compactionMutex;
+    std::condition_variable compactionWake;
+    std::vector<std::weak_ptr<Table>> compactionQueue;
+    bool compactionStopping = false;
+    std::thread compactor;
+
+    void compactionLoop();
 
 public:
-    Database() = default;
+    Database();
+    ~Database(); // tables still queued for compaction are left as they are
 
 
 
-    void createTable(const std::string& tableName);
+    void createTable(const std::string& tableName, StorageMode mode = StorageMode::ROW);
+    // Publishes a table built on the side; false if the name is taken
+    bool addTable(std::shared_ptr<Table> table);
     void DropTable(const std::string& tableName);
-    Table* GetTable(const std::string& tableName);
-    std::unordered_map<std::string,Table> getTables() const;//for alter drop sentence
+    std::shared_ptr<Table> GetTable(const std::string& tableName) const; // null if absent
+    std::vector<std::shared_ptr<Table>> getTables() const;
     void listTables() const;
+    std::shared_lock<std::shared_mutex> lockCatalog();
+
+
+    // Saving is a checkpoint: the log is cut back to records newer than the file
+    bool saveToFile(const std::string& fileName);
+    // memoryMapped: map the file and serve COLUMNAR tables from the mapping
+    // instead of reading it; pages load lazily, writes copy into memory
+    bool loadFromFile(const std::string& fileName, bool memoryMapped = false);
+
+    // Mutations are logged to the attached log, if any; see QueryParser::recoverFromLog
+    void attachLog(std::unique_ptr<WriteAheadLog> newLog);
+    std::unique_ptr<WriteAheadLog> detachLog();
+    WriteAheadLog* getLog();
+    uint64_t getCheckpointLsn() const;
 
+    // Workers for parallel scans; 0 threads means one per hardware core
+    void setThreadCount(size_t threads);
+    ThreadPool& getThreadPool();
 
-    bool saveToFile(const std::string& fileName) const;
-    bool loadFromFile(const std::string& fileName);
+    // Compacts the table on a background thread, under its write lock, if it
+    // still needs it by then. DELETE calls this once its own lock is
+    // released, so no statement waits for a compaction pass; row positions
+    // aren't stable across statements, and the log replays DELETEs by their
+    // WHERE, so compacting later changes nothing a client can see.
+    void scheduleCompaction(const std::shared_ptr<Table>& table);
 
 };
 #endif //DATABASE_H
@@ -0,0 +1,215 @@
+#include "Explain.h"
+#include <cstdio>
+#include <sstream>
+
+uint64_t nanosBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+uint64_t nanosSince(std::chrono::steady_clock::time_point start) {
+    return nanosBetween(start, std::chrono::steady_clock::now());
+}
+
+ScanCounters ScanProfile::total() const {
+    ScanCounters sum;
+    for (const ScanCounters& c : workers) {
+        sum.batches += c.batches;
+        sum.rows += c.rows;
+        sum.selected += c.selected;
+        sum.filterNanos += c.filterNanos;
+        sum.consumerNanos += c.consumerNanos;
+    }
+    return sum;
+}
+
+uint64_t ScanProfile::filterNanos() const {
+    ScanCounters sum = total();
+    uint64_t busy = sum.filterNanos + sum.consumerNanos;
+    if (busy == 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(static_cast<double>(wallNanos) * static_cast<double>(sum.filterNanos) /
+                                 static_cast<double>(busy));
+}
+
+uint64_t ScanProfile::consumerNanos() const {
+    return wallNanos - filterNanos();
+}
+
+static std::string describeValue(const Value& v) {
+    if (const int* i = std::get_if<int>(&v)) {
+        return std::to_string(*i);
+    }
+    if (const float* f = std::get_if<float>(&v)) {
+        std::ostringstream text;
+        text << *f;
+        return text.str();
+    }
+    if (const bool* b = std::get_if<bool>(&v)) {
+        return *b ? "TRUE" : "FALSE";
+    }
+    if (const std::string* s = std::get_if<std::string>(&v)) {
+        std::string quoted = "'";
+        for (char c : *s) {
+            quoted += c;
+            if (c == '\'') {
+                quoted += c;
+            }
+        }
+        return quoted + "'";
+    }
+    return "NULL";
+}
+
+static const char* describeOp(CompareOp op) {
+    switch (op) {
+        case CompareOp::EQ:
+            return " = ";
+        case CompareOp::NE:
+            return " <> ";
+        case CompareOp::LT:
+            return " < ";
+        case CompareOp::LE:
+            return " <= ";
+        case CompareOp::GT:
+            return " > ";
+        case CompareOp::GE:
+            return " >= ";
+    }
+    return " ? ";
+}
+
+static std::string columnName(const Predicate& p, const std::vector<Column>& columns) {
+    return p.column >= 0 && static_cast<size_t>(p.column) < columns.size() ? columns[p.column].getName() : "?";
+}
+
+// Terms of an AND or OR are parenthesized when they are the other one
+std::string describePredicate(const Predicate& p, const std::vector<Column>& columns) {
+    auto term = [&](const Predicate& child) {
+        std::string text = describePredicate(child, columns);
+        bool compound = child.kind == PredicateKind::AND || child.kind == PredicateKind::OR;
+        return compound && child.kind != p.kind ? "(" + text + ")" : text;
+    };
+    std::string column = columnName(p, columns);
+    switch (p.kind) {
+        case PredicateKind::COMPARE:
+            return column + describeOp(p.op) + describeValue(p.literals[0]);
+        case PredicateKind::BETWEEN:
+            return column + " BETWEEN " + describeValue(p.literals[0]) + " AND " + describeValue(p.literals[1]);
+        case PredicateKind::IN: {
+            std::string text = column + " IN (";
+            for (size_t i = 0; i < p.literals.size(); i++) {
+                text += (i ? ", " : "") + describeValue(p.literals[i]);
+            }
+            return text + ")";
+        }
+        case PredicateKind::IS_NULL:
+            return column + " IS NULL";
+        case PredicateKind::AND:
+        case PredicateKind::OR: {
+            std::string text;
+            for (const auto& child : p.children) {
+                if (!text.empty()) {
+                    text += p.kind == PredicateKind::AND ? " AND " : " OR ";
+                }
+                text += term(*child);
+            }
+            return text;
+        }
+        case PredicateKind::NOT: {
+            const Predicate& child = *p.children[0];
+            if (child.kind == PredicateKind::IS_NULL) {
+                return columnName(child, columns) + " IS NOT NULL";
+            }
+            return "NOT (" + describePredicate(child, columns) + ")";
+        }
+    }
+    return "?";
+}
+
+PlanOperator describeScan(const Table& table, const Filter& filter, const ScanProfile* profile) {
+    const std::vector<Column>& columns = table.getColumns();
+    PlanOperator scan;
+    const Predicate* term = filter.getIndexedTerm();
+    if (term) {
+        scan.name = "Index Scan on " + table.getName() + " using " + filter.getIndexName();
+        scan.detail = describePredicate(*term, columns);
+        scan.estimatedRows = static_cast<double>(filter.getCandidateCount());
+    } else {
+        scan.name = "Seq Scan on " + table.getName();
+        scan.estimatedRows = static_cast<double>(table.getLiveRowCount());
+    }
+    size_t zones = (table.getRowCount() + kZoneRows - 1) / kZoneRows;
+    scan.blocks = "zones skipped " + std::to_string(filter.getSkippedZoneCount()) + " of " + std::to_string(zones);
+
+    const Predicate* predicate = filter.getPredicate();
+    bool filtered = predicate && term != predicate;
+    if (profile) {
+        ScanCounters total = profile->total();
+        size_t batches = (table.getRowCount() + kBatchRows - 1) / kBatchRows;
+        scan.blocks += ", batches read " + std::to_string(total.batches) + " of " + std::to_string(batches);
+        scan.nanos = profile->setupNanos + (filtered ? 0 : profile->filterNanos());
+        if (!filtered) {
+            scan.rowsOut = total.selected;
+        } else {
+            scan.rowsOut = term ? filter.getCandidateCount() : total.rows;
+        }
+        scan.bytes = filter.getCandidateCount() * sizeof(size_t);
+    }
+    if (!filtered) {
+        return scan;
+    }
+    PlanOperator op;
+    op.name = "Filter";
+    op.detail = describePredicate(*predicate, columns);
+    op.estimatedRows = filter.estimateRows();
+    if (profile) {
+        op.nanos = profile->filterNanos();
+        op.rowsIn = scan.rowsOut;
+        op.rowsOut = profile->total().selected;
+    }
+    op.children.push_back(std::move(scan));
+    return op;
+}
+
+static void printOperator(std::ostream& out, const PlanOperator& op, bool analyze, size_t depth) {
+    std::string line = depth ? std::string((depth - 1) * 4 + 2, ' ') + "-> " : "";
+    line += op.name;
+    if (!op.detail.empty()) {
+        line += ": " + op.detail;
+    }
+    char text[160];
+    if (op.estimatedRows >= 0) {
+        std::snprintf(text, sizeof(text), "  (est. rows %.0f)", op.estimatedRows);
+        line += text;
+    }
+    if (analyze) {
+        std::snprintf(text, sizeof(text), "  (actual time %.3f ms, rows %llu", static_cast<double>(op.nanos) / 1e6,
+                      static_cast<unsigned long long>(op.rowsOut));
+        line += text;
+        if (!op.children.empty()) {
+            line += ", in " + std::to_string(op.rowsIn);
+        }
+        if (op.bytes) {
+            line += ", bytes " + std::to_string(op.bytes);
+        }
+        line += ")";
+    }
+    if (!op.blocks.empty()) {
+        line += "  [" + op.blocks + "]";
+    }
+    out << line << "\n";
+    for (const PlanOperator& child : op.children) {
+        printOperator(out, child, analyze, depth + 1);
+    }
+}
+
+void printPlan(std::ostream& out, const Explain& explain, uint64_t totalNanos) {
+    printOperator(out, explain.root, explain.analyze, 0);
+    if (explain.analyze) {
+        char text[64];
+        std::snprintf(text, sizeof(text), "Execution time: %.3f ms", static_cast<double>(totalNanos) / 1e6);
+        out << text << "\n";
+    }
+    out.flush();
+}
@@ -0,0 +1,63 @@
+#ifndef EXPLAIN_H
+#define EXPLAIN_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Filter.h"
+
+// One operator of a SELECT plan as EXPLAIN prints it. Operators fused into
+// one parallel scan share its wall time in proportion to the thread time
+// each of them spent, so the times of a plan add up to its run time.
+struct PlanOperator {
+    std::string name;          // "Seq Scan on t", "Filter", "Hash Join", ...
+    std::string detail;        // columns, predicate, keys
+    double estimatedRows = -1; // < 0: no estimate
+    std::string blocks;        // what a scan could skip
+    // EXPLAIN ANALYZE
+    uint64_t nanos = 0;
+    uint64_t rowsIn = 0;
+    uint64_t rowsOut = 0;
+    uint64_t bytes = 0; // memory the operator built up, or result bytes written
+    std::vector<PlanOperator> children;
+};
+
+// What the scan feeding a plan did while profiled: counters per worker,
+// the time spent setting the Filter up (zone pruning, index probe) and the
+// wall time of the parallel scan, which it shares with the operator it feeds
+struct ScanProfile {
+    std::vector<ScanCounters> workers;
+    uint64_t setupNanos = 0;
+    uint64_t wallNanos = 0;
+
+    ScanCounters total() const;
+    uint64_t filterNanos() const;   // the scan's share of wallNanos
+    uint64_t consumerNanos() const; // the rest
+};
+
+// EXPLAIN of one SELECT. The executor that would run the plan describes the
+// operators it set up into root and, unless analyze, returns without running
+// them. Profiled scans count into scan and, for a join's build side, build.
+struct Explain {
+    bool analyze = false;
+    PlanOperator root;
+    ScanProfile scan;
+    ScanProfile build;
+};
+
+// The scan of a table through filter: Seq Scan or Index Scan, under a Filter
+// unless the index answers the whole predicate. With a profile, what they did.
+PlanOperator describeScan(const Table& table, const Filter& filter, const ScanProfile* profile);
+
+// SQL text of a predicate over the given columns
+std::string describePredicate(const Predicate& p, const std::vector<Column>& columns);
+
+// One line per operator, children indented under their parent
+void printPlan(std::ostream& out, const Explain& explain, uint64_t totalNanos);
+
+uint64_t nanosBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+uint64_t nanosSince(std::chrono::steady_clock::time_point start);
+
+#endif //EXPLAIN_H
@@ -0,0 +1,152 @@
+#include "FileFormat.h"
+#include <array>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+static_assert(std::endian::native == std::endian::little, "file format assumes a little-endian host");
+
+// Slicing-by-8 tables for the reflected IEEE polynomial
+static const std::array<std::array<uint32_t, 256>, 8>& crcTables() {
+    static const auto tables = [] {
+        std::array<std::array<uint32_t, 256>, 8> t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (size_t s = 1; s < 8; s++) {
+                t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xFF];
+            }
+        }
+        return t;
+    }();
+    return tables;
+}
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc) {
+    const auto& t = crcTables();
+    const auto* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    while (size >= 8) {
+        uint32_t lo;
+        uint32_t hi;
+        std::memcpy(&lo, p, 4);
+        std::memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p += 8;
+        size -= 8;
+    }
+    while (size--) {
+        crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+BinaryWriter::BinaryWriter(std::ostream& o) : out(o) {}
+
+void BinaryWriter::writeBytes(const void* data, size_t size) {
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    offset += size;
+}
+
+void BinaryWriter::writeU8(uint8_t v) { writeBytes(&v, sizeof(v)); }
+void BinaryWriter::writeU32(uint32_t v) { writeBytes(&v, sizeof(v)); }
+void BinaryWriter::writeU64(uint64_t v) { writeBytes(&v, sizeof(v)); }
+
+void BinaryWriter::writeString(const std::string& s) {
+    writeU32(static_cast<uint32_t>(s.size()));
+    writeBytes(s.data(), s.size());
+}
+
+void BinaryWriter::padTo8() {
+    static const char zeros[8] = {};
+    if (offset % 8) {
+        writeBytes(zeros, 8 - offset % 8);
+    }
+}
+
+uint64_t BinaryWriter::getOffset() const { return offset; }
+
+BinaryReader::BinaryReader(std::istream& i) : in(i) {}
+
+void BinaryReader::readBytes(void* data, size_t size) {
+    if (!in.read(static_cast<char*>(data), static_cast<std::streamsize>(size))) {
+        throw std::runtime_error("Unexpected end of file");
+    }
+    offset += size;
+}
+
+uint8_t BinaryReader::readU8() {
+    uint8_t v;
+    readBytes(&v, sizeof(v));
+    return v;
+}
+
+uint32_t BinaryReader::readU32() {
+    uint32_t v;
+    readBytes(&v, sizeof(v));
+    return v;
+}
+
+uint64_t BinaryReader::readU64() {
+    uint64_t v;
+    readBytes(&v, sizeof(v));
+    return v;
+}
+
+std::string BinaryReader::readString() {
+    uint32_t len = readU32();
+    std::string s(len, '\0');
+    readBytes(s.data(), len);
+    return s;
+}
+
+void BinaryReader::skipTo8() {
+    char pad[8];
+    if (offset % 8) {
+        readBytes(pad, 8 - offset % 8);
+    }
+}
+
+uint64_t BinaryReader::getOffset() const { return offset; }
+
+MemoryReader::MemoryReader(const char* d, size_t s) : data(d), size(s) {}
+
+const char* MemoryReader::take(size_t n) {
+    if (n > size - offset) {
+        throw std::runtime_error("Unexpected end of file");
+    }
+    const char* p = data + offset;
+    offset += n;
+    return p;
+}
+
+uint8_t MemoryReader::readU8() {
+    uint8_t v;
+    std::memcpy(&v, take(sizeof(v)), sizeof(v));
+    return v;
+}
+
+uint32_t MemoryReader::readU32() {
+    uint32_t v;
+    std::memcpy(&v, take(sizeof(v)), sizeof(v));
+    return v;
+}
+
+uint64_t MemoryReader::readU64() {
+    uint64_t v;
+    std::memcpy(&v, take(sizeof(v)), sizeof(v));
+    return v;
+}
+
+void MemoryReader::skipTo8() {
+    if (offset % 8) {
+        take(8 - offset % 8);
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef FILEFORMAT_H
+#define FILEFORMAT_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Binary database file, all integers little-endian:
+//
+//   file header   "SDBF", u32 version, u32 table count, u32 reserved,
+//                 u64 last write-ahead log LSN in the snapshot
+//   per table     u32 header size, header, u32 crc32 of header, padding to 8,
+//                 then ceil(rows / kChunkRows) row groups, each holding one
+//                 block per column in schema order
+//   table header  u32 name length, name, u8 storage mode, u32 column count,
+//                 per column: u32 name length, name, u8 type | kNotNullFlag
+//                 for NOT NULL columns | kDefaultFlag, the DEFAULT value
+//                 following as a 4-byte INT or FLOAT, a u32 length and bytes
+//                 for STRING, or a u8 BOOLEAN; u64 row count;
+//                 u32 index count, per index: u32 name length, name,
+//                 u32 column, u8 index type;
+//                 zone statistics, per row group and column: u32 NULL
+//                 count, then for INT, FLOAT and STRING columns a u8 that is
+//                 1 when the non-NULL minimum and maximum follow, each
+//                 encoded like a DEFAULT value
+//   block         u32 row count, u32 crc32 of payload, u64 payload size,
+//                 payload, zero padding to a multiple of 8 bytes
+//
+// A block payload starts with the NULL flags: u32 NULL count, u32 reserved
+// and, if the count is not zero, (rows + 63) / 64 u64 bitmap words with a
+// bit set per NULL row. The typed array follows, NULL rows holding the
+// type's default: INT and FLOAT as 4-byte values, BOOLEAN as u64 bitmap
+// words, STRING as u32 encoding and u32 dictionary size, then for encoding
+// 0 (rows + 1) u32 offsets followed by the characters, for encoding 1 rows
+// u16 codes, zero padding to 4 bytes, then (dictionary size + 1) u32
+// offsets and the characters of the distinct values. Every block starts
+// 8-byte aligned so its payload can be used in place from a memory mapping.
+constexpr char kFileMagic[4] = {'S', 'D', 'B', 'F'};
+constexpr uint32_t kFileVersion = 1;
+constexpr uint8_t kNotNullFlag = 0x80;
+constexpr uint8_t kDefaultFlag = 0x40;
+constexpr size_t kBlockHeaderSize = 16;
+
+// CRC-32 (IEEE), slicing-by-8; pass the previous result to continue a checksum
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+// Buffered sequential writer that tracks the file offset for alignment
+class BinaryWriter {
+private:
+    std::ostream& out;
+    uint64_t offset = 0;
+
+public:
+    explicit BinaryWriter(std::ostream& out);
+
+    void writeBytes(const void* data, size_t size);
+    void writeU8(uint8_t v);
+    void writeU32(uint32_t v);
+    void writeU64(uint64_t v);
+    void writeString(const std::string& s); // u32 length + bytes
+    void padTo8();
+    uint64_t getOffset() const;
+};
+
+// Sequential reader; throws std::runtime_error on short reads
+class BinaryReader {
+private:
+    std::istream& in;
+    uint64_t offset = 0;
+
+public:
+    explicit BinaryReader(std::istream& in);
+
+    void readBytes(void* data, size_t size);
+    uint8_t readU8();
+    uint32_t readU32();
+    uint64_t readU64();
+    std::string readString();
+    void skipTo8();
+    uint64_t getOffset() const;
+};
+
+// Bounds-checked reader over an in-memory copy or mapping of a file
+class MemoryReader {
+private:
+    const char* data;
+    size_t size;
+    size_t offset = 0;
+
+public:
+    MemoryReader(const char* data, size_t size);
+
+    const char* take(size_t n); // returns a pointer to the next n bytes
+    uint8_t readU8();
+    uint32_t readU32();
+    uint64_t readU64();
+    void skipTo8();
+};
+
+#endif //FILEFORMAT_H
@@ -0,0 +1,722 @@
+#include "Filter.h"
+#include <cmath>
+#include <cstring>
+
+// Mask with the low `count` bits of a batch set
+static void fillAll(size_t count, Selection& out) {
+    for (size_t w = 0; w < kBatchWords; w++) {
+        size_t base = w * 64;
+        if (base + 64 <= count) {
+            out.words[w] = ~uint64_t(0);
+        } else if (base < count) {
+            out.words[w] = (uint64_t(1) << (count - base)) - 1;
+        } else {
+            out.words[w] = 0;
+        }
+    }
+}
+
+// Branch-free comparison kernel: 64 values per output word, the inner loop
+// has a fixed trip count so the compiler can vectorize it.
+template <typename T, typename Pred>
+static void compareKernel(const T* data, size_t count, Selection& out, Pred pred) {
+    size_t fullWords = count / 64;
+    for (size_t w = 0; w < fullWords; w++) {
+        const T* block = data + w * 64;
+        uint64_t bits = 0;
+        for (size_t j = 0; j < 64; j++) {
+            bits |= uint64_t(pred(block[j])) << j;
+        }
+        out.words[w] = bits;
+    }
+    size_t rest = count - fullWords * 64;
+    if (rest) {
+        const T* block = data + fullWords * 64;
+        uint64_t bits = 0;
+        for (size_t j = 0; j < rest; j++) {
+            bits |= uint64_t(pred(block[j])) << j;
+        }
+        out.words[fullWords++] = bits;
+    }
+    for (size_t w = fullWords; w < kBatchWords; w++) {
+        out.words[w] = 0;
+    }
+}
+
+template <typename T>
+static void compareOp(const T* data, size_t count, CompareOp op, T lit, Selection& out) {
+    switch (op) {
+        case CompareOp::EQ:
+            compareKernel(data, count, out, [lit](T v) { return v == lit; });
+            break;
+        case CompareOp::NE:
+            compareKernel(data, count, out, [lit](T v) { return v != lit; });
+            break;
+        case CompareOp::LT:
+            compareKernel(data, count, out, [lit](T v) { return v < lit; });
+            break;
+        case CompareOp::LE:
+            compareKernel(data, count, out, [lit](T v) { return v <= lit; });
+            break;
+        case CompareOp::GT:
+            compareKernel(data, count, out, [lit](T v) { return v > lit; });
+            break;
+        case CompareOp::GE:
+            compareKernel(data, count, out, [lit](T v) { return v >= lit; });
+            break;
+    }
+}
+
+// Evaluates a leaf over typed values, shared by INT, FLOAT and STRING
+template <typename T, typename L>
+static void evaluateTyped(const Predicate& p, const T* data, size_t count, Selection& out, L literal) {
+    switch (p.kind) {
+        case PredicateKind::COMPARE:
+            compareOp<T>(data, count, p.op, literal(p.literals[0]), out);
+            break;
+        case PredicateKind::BETWEEN: {
+            T lo = literal(p.literals[0]);
+            T hi = literal(p.literals[1]);
+            compareKernel(data, count, out, [lo, hi](T v) { return (v >= lo) & (v <= hi); });
+            break;
+        }
+        case PredicateKind::IN: {
+            Selection one;
+            std::memset(out.words, 0, sizeof(out.words));
+            for (const auto& v : p.literals) {
+                compareOp<T>(data, count, CompareOp::EQ, literal(v), one);
+                for (size_t w = 0; w < kBatchWords; w++) {
+                    out.words[w] |= one.words[w];
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static std::string_view stringLiteral(const Value& v) {
+    return std::get<std::string>(v);
+}
+
+// BOOLEAN columns come as a bitmap already, so comparisons are word ops
+static uint64_t compareBoolWord(uint64_t x, CompareOp op, bool lit) {
+    switch (op) {
+        case CompareOp::EQ:
+            return lit ? x : ~x;
+        case CompareOp::NE:
+            return lit ? ~x : x;
+        case CompareOp::LT:
+            return lit ? ~x : 0;
+        case CompareOp::LE:
+            return lit ? ~uint64_t(0) : ~x;
+        case CompareOp::GT:
+            return lit ? 0 : x;
+        case CompareOp::GE:
+            return lit ? x : ~uint64_t(0);
+    }
+    return 0;
+}
+
+Filter::Filter(const Table& t, std::unique_ptr<Predicate> p) : table(t), owned(std::move(p)), predicate(owned.get()) {
+    pruneZones();
+    chooseIndex();
+}
+
+Filter::Filter(const Table& t, const Predicate* p) : table(t), predicate(p) {
+    pruneZones();
+    chooseIndex();
+}
+
+// Selectivity guesses for columns ANALYZE hasn't seen, as in PostgreSQL
+static constexpr double kDefaultEqualSelectivity = 0.005;
+static constexpr double kDefaultRangeSelectivity = 1.0 / 3;
+static constexpr double kDefaultNullSelectivity = 0.005;
+
+// Share of rows where leaf p holds; column is null without statistics
+static double leafSelectivity(const Predicate& p, const ColumnStatistics* column) {
+    const std::vector<Value>& lits = p.literals;
+    if (!column) {
+        switch (p.kind) {
+            case PredicateKind::COMPARE:
+                if (p.op == CompareOp::EQ) {
+                    return kDefaultEqualSelectivity;
+                }
+                return p.op == CompareOp::NE ? 1 - kDefaultEqualSelectivity : kDefaultRangeSelectivity;
+            case PredicateKind::BETWEEN:
+                return kDefaultRangeSelectivity * kDefaultRangeSelectivity;
+            case PredicateKind::IN:
+                return std::min(1.0, kDefaultEqualSelectivity * static_cast<double>(lits.size()));
+            default:
+                return kDefaultNullSelectivity;
+        }
+    }
+    switch (p.kind) {
+        case PredicateKind::COMPARE:
+            switch (p.op) {
+                case CompareOp::EQ:
+                    return column->equalSelectivity(lits[0]);
+                case CompareOp::NE:
+                    return std::max(1 - column->nullFraction - column->equalSelectivity(lits[0]), 0.0);
+                case CompareOp::LT:
+                    return column->rangeSelectivity(nullptr, false, &lits[0], false);
+                case CompareOp::LE:
+                    return column->rangeSelectivity(nullptr, false, &lits[0], true);
+                case CompareOp::GT:
+                    return column->rangeSelectivity(&lits[0], false, nullptr, false);
+                case CompareOp::GE:
+                    return column->rangeSelectivity(&lits[0], true, nullptr, false);
+            }
+            return 1;
+        case PredicateKind::BETWEEN:
+            return column->rangeSelectivity(&lits[0], true, &lits[1], true);
+        case PredicateKind::IN: {
+            double s = 0;
+            for (const Value& v : lits) {
+                s += column->equalSelectivity(v);
+            }
+            return std::min(s, 1 - column->nullFraction);
+        }
+        default:
+            return column->nullFraction;
+    }
+}
+
+// Share of rows where p (or, negated, NOT p) holds, taking terms to be
+// independent. Like evaluate(), NOT of a comparison leaves out the NULLs.
+static double selectivity(const Predicate& p, bool negated, const TableStatistics* stats) {
+    switch (p.kind) {
+        case PredicateKind::AND:
+        case PredicateKind::OR: {
+            bool intersect = (p.kind == PredicateKind::AND) != negated;
+            double s = intersect ? 1 : 0;
+            for (const auto& child : p.children) {
+                double c = selectivity(*child, negated, stats);
+                s = intersect ? s * c : s + c - s * c;
+            }
+            return s;
+        }
+        case PredicateKind::NOT:
+            return selectivity(*p.children[0], !negated, stats);
+        default:
+            break;
+    }
+    const ColumnStatistics* column = nullptr;
+    if (stats && static_cast<size_t>(p.column) < stats->columns.size() && stats->columns[p.column].analyzed) {
+        column = &stats->columns[p.column];
+    }
+    double s = std::clamp(leafSelectivity(p, column), 0.0, 1.0);
+    if (!negated) {
+        return s;
+    }
+    if (p.kind == PredicateKind::IS_NULL) {
+        return 1 - s;
+    }
+    return std::max((column ? 1 - column->nullFraction : 1.0) - s, 0.0);
+}
+
+// Rough cost of a plan in nanoseconds, measured on 2M-row tables: a scan
+// reads each row of the zones it can't skip, an index scan pays for every
+// candidate it fetches (lookup, sort, deduplication, then reading the row
+// out of order, dearer for ROW storage) and, unless the index answers the
+// whole predicate, evaluates each batch holding a candidate. Candidates are
+// taken to be spread out, so k of them touch about
+// batches * (1 - e^(-k / batches)) batches.
+struct CostModel {
+    double scanRow;
+    double indexRow;
+};
+
+static CostModel costModel(StorageMode mode) {
+    return mode == StorageMode::COLUMNAR ? CostModel{1.5, 250} : CostModel{8, 500};
+}
+
+// Looks at the predicate itself or, for an AND, at each of its terms.
+// Equality (=, IN) can use any index, ranges need an ordered one.
+// Without statistics equality wins over ranges, because it is usually far
+// more selective, and an index always beats a scan. After ANALYZE the term
+// expected to select the fewest rows is probed, and only when that is
+// cheaper than scanning: a range covering much of the table is faster to
+// scan than to fetch row by row.
+//
+// The probe happens here, under the index lock, so a writer changing the
+// indexes later doesn't affect the filter. Indexes whose positions no
+// longer match the table's rows (a snapshot from before rows moved) are
+// not used.
+void Filter::chooseIndex() {
+    if (!predicate) {
+        return;
+    }
+    std::shared_lock<std::shared_mutex> lock = table.lockIndexes();
+    if (!table.indexesMatch()) {
+        return;
+    }
+    std::vector<const Predicate*> terms;
+    if (predicate->kind == PredicateKind::AND) {
+        for (const auto& child : predicate->children) {
+            terms.push_back(child.get());
+        }
+    } else {
+        terms.push_back(predicate);
+    }
+
+    const TableStatistics* stats = table.getStatistics();
+    double liveRows = static_cast<double>(table.getLiveRowCount());
+    const Index* best = nullptr;
+    const Predicate* bestTerm = nullptr;
+    double bestRows = 0;
+    for (const Predicate* term : terms) {
+        bool equality = (term->kind == PredicateKind::COMPARE && term->op == CompareOp::EQ) ||
+                        term->kind == PredicateKind::IN;
+        bool range = term->kind == PredicateKind::BETWEEN ||
+                     (term->kind == PredicateKind::COMPARE && term->op != CompareOp::EQ && term->op != CompareOp::NE);
+        if (!equality && !range) {
+            continue;
+        }
+        for (const auto& candidate : table.getIndexes()) {
+            if (candidate->getColumn() != term->column || (range && !candidate->supportsRange())) {
+                continue;
+            }
+            if (!stats && equality) {
+                indexed = term;
+                indexName = candidate->getName();
+                probeIndex(*candidate);
+                return;
+            }
+            double rows = stats ? liveRows * selectivity(*term, false, stats) : 0;
+            if (!best || rows < bestRows) {
+                best = candidate.get();
+                bestTerm = term;
+                bestRows = rows;
+            }
+        }
+    }
+    if (!best) {
+        return;
+    }
+    if (stats) {
+        CostModel cost = costModel(table.getStorageMode());
+        double indexCost = bestRows * cost.indexRow;
+        if (bestTerm != predicate) {
+            double batches = std::ceil(static_cast<double>(table.getRowCount()) / kBatchRows);
+            indexCost += batches * -std::expm1(-bestRows / batches) * kBatchRows * cost.scanRow;
+        }
+        if (indexCost >= static_cast<double>(getScannedRowCount()) * cost.scanRow) {
+            return;
+        }
+    }
+    indexed = bestTerm;
+    indexName = best->getName();
+    probeIndex(*best);
+}
+
+// Read from a snapshot, the indexes also hold rows appended after it was
+// taken; those are dropped along with tombstoned ones
+void Filter::probeIndex(const Index& index) {
+    std::vector<size_t>& rows = candidates;
+    const Predicate& p = *indexed;
+    if (p.kind == PredicateKind::IN) {
+        for (const auto& v : p.literals) {
+            index.lookupEqual(v, rows);
+        }
+    } else if (p.kind == PredicateKind::BETWEEN) {
+        index.lookupRange(&p.literals[0], true, &p.literals[1], true, rows);
+    } else {
+        const Value& v = p.literals[0];
+        switch (p.op) {
+            case CompareOp::EQ:
+                index.lookupEqual(v, rows);
+                break;
+            case CompareOp::LT:
+                index.lookupRange(nullptr, false, &v, false, rows);
+                break;
+            case CompareOp::LE:
+                index.lookupRange(nullptr, false, &v, true, rows);
+                break;
+            case CompareOp::GT:
+                index.lookupRange(&v, false, nullptr, false, rows);
+                break;
+            case CompareOp::GE:
+                index.lookupRange(&v, true, nullptr, false, rows);
+                break;
+            case CompareOp::NE:
+                break;
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    rows.erase(std::lower_bound(rows.begin(), rows.end(), table.getRowCount()), rows.end());
+    if (table.getLiveRowCount() != table.getRowCount()) {
+        std::erase_if(rows, [&](size_t r) { return table.isDeleted(r); });
+    }
+}
+
+// Whether p (or, negated, NOT p) can hold for any row of a zone with the
+// given statistics. Mirrors evaluate(): NULLs never qualify, except for
+// IS NULL, and NOT turns a leaf into its complement over the non-NULL rows.
+static bool zoneMayMatch(const Predicate& p, bool negated, const ZoneMap& zones, size_t zone, size_t rows) {
+    switch (p.kind) {
+        case PredicateKind::AND:
+        case PredicateKind::OR: {
+            bool intersect = (p.kind == PredicateKind::AND) != negated;
+            for (const auto& child : p.children) {
+                if (zoneMayMatch(*child, negated, zones, zone, rows) != intersect) {
+                    return !intersect;
+                }
+            }
+            return intersect;
+        }
+        case PredicateKind::NOT:
+            return zoneMayMatch(*p.children[0], !negated, zones, zone, rows);
+        default:
+            break;
+    }
+
+    const Zone& z = zones.getZone(p.column, zone);
+    if (p.kind == PredicateKind::IS_NULL) {
+        return negated ? z.nullCount < rows : z.nullCount > 0;
+    }
+    if (z.nullCount >= rows) {
+        return false;
+    }
+    if (isNull(z.min)) {
+        return true; // no bounds kept
+    }
+    for (const Value& v : p.literals) {
+        if (std::holds_alternative<float>(v) && std::isnan(std::get<float>(v))) {
+            return true; // NaN breaks the complement rules below
+        }
+    }
+    const Value& lo = z.min;
+    const Value& hi = z.max;
+    switch (p.kind) {
+        case PredicateKind::COMPARE: {
+            const Value& v = p.literals[0];
+            switch (p.op) {
+                case CompareOp::EQ:
+                    return negated ? !(lo == v && hi == v) : lo <= v && v <= hi;
+                case CompareOp::NE:
+                    return negated ? lo <= v && v <= hi : !(lo == v && hi == v);
+                case CompareOp::LT:
+                    return negated ? v <= hi : lo < v;
+                case CompareOp::LE:
+                    return negated ? v < hi : lo <= v;
+                case CompareOp::GT:
+                    return negated ? lo <= v : v < hi;
+                case CompareOp::GE:
+                    return negated ? lo < v : v <= hi;
+            }
+            return true;
+        }
+        case PredicateKind::BETWEEN: {
+            const Value& low = p.literals[0];
+            const Value& high = p.literals[1];
+            return negated ? lo < low || high < hi : low <= hi && lo <= high;
+        }
+        case PredicateKind::IN: {
+            bool inRange = false;
+            bool coversZone = false; // every row holds one of the values
+            for (const Value& v : p.literals) {
+                inRange |= lo <= v && v <= hi;
+                coversZone |= lo == v && hi == v;
+            }
+            return negated ? !coversZone : inRange;
+        }
+        default:
+            return true;
+    }
+}
+
+// Zone statistics rule out whole zones before the scan; an index scan only
+// reads candidate batches anyway, but the planner weighs it against the
+// scan that is left
+void Filter::pruneZones() {
+    if (!predicate) {
+        return;
+    }
+    const ZoneMap& zones = table.getZoneMap();
+    size_t rowCount = table.getRowCount();
+    size_t zoneCount = (rowCount + kZoneRows - 1) / kZoneRows;
+    std::vector<uint8_t> matches(zoneCount);
+    bool skipped = false;
+    for (size_t z = 0; z < zoneCount; z++) {
+        matches[z] = zoneMayMatch(*predicate, false, zones, z, zoneRowCount(z, rowCount));
+        skipped |= !matches[z];
+    }
+    if (skipped) {
+        zoneMatches = std::move(matches);
+    }
+}
+
+bool Filter::skipsZone(size_t zone) const {
+    return !zoneMatches.empty() && !zoneMatches[zone];
+}
+
+size_t Filter::getSkippedZoneCount() const {
+    return static_cast<size_t>(std::count(zoneMatches.begin(), zoneMatches.end(), uint8_t(0)));
+}
+
+size_t Filter::getScannedRowCount() const {
+    size_t rowCount = table.getRowCount();
+    if (zoneMatches.empty()) {
+        return rowCount;
+    }
+    size_t rows = 0;
+    for (size_t z = 0; z < zoneMatches.size(); z++) {
+        rows += zoneMatches[z] ? zoneRowCount(z, rowCount) : 0;
+    }
+    return rows;
+}
+
+double Filter::estimateRows() const {
+    if (indexed && indexed == predicate) {
+        return static_cast<double>(candidates.size());
+    }
+    double rows = static_cast<double>(table.getLiveRowCount());
+    if (predicate) {
+        rows *= selectivity(*predicate, false, table.getStatistics());
+    }
+    if (indexed) {
+        rows = std::min(rows, static_cast<double>(candidates.size()));
+    }
+    return std::min(rows, static_cast<double>(getScannedRowCount()));
+}
+
+size_t Filter::getMorselCount() const {
+    return (table.getRowCount() + kMorselRows - 1) / kMorselRows;
+}
+
+bool Filter::usesIndex() const {
+    return indexed != nullptr;
+}
+
+const std::string& Filter::getIndexName() const {
+    return indexName;
+}
+
+const Predicate* Filter::getIndexedTerm() const {
+    return indexed;
+}
+
+size_t Filter::getCandidateCount() const {
+    return candidates.size();
+}
+
+const Predicate* Filter::getPredicate() const {
+    return predicate;
+}
+
+void Filter::setCounters(std::vector<ScanCounters>* c) {
+    counters = c;
+}
+
+// Tombstoned rows never qualify; a batch of nothing but tombstones is not
+// evaluated
+void Filter::evaluateBatch(size_t first, size_t count, Selection& out, ScanScratch& scratch) const {
+    const uint64_t* deleted = table.getDeletedBits(first);
+    size_t words = (count + 63) / 64;
+    if (deleted) {
+        Selection all;
+        fillAll(count, all);
+        uint64_t live = 0;
+        for (size_t w = 0; w < words; w++) {
+            live |= all.words[w] & ~deleted[w];
+        }
+        if (!live) {
+            std::memset(out.words, 0, sizeof(out.words));
+            return;
+        }
+    }
+    if (!predicate) {
+        fillAll(count, out);
+    } else {
+        evaluate(*predicate, false, first, count, out, scratch);
+    }
+    if (deleted) {
+        for (size_t w = 0; w < words; w++) {
+            out.words[w] &= ~deleted[w];
+        }
+    }
+}
+
+// NOT flips `negated` on the way down; under it AND and OR swap roles
+// (De Morgan), which keeps unknown rows out of both a term and its negation
+void Filter::evaluate(const Predicate& p, bool negated, size_t first, size_t count, Selection& out,
+                      ScanScratch& scratch) const {
+    switch (p.kind) {
+        case PredicateKind::AND:
+        case PredicateKind::OR: {
+            bool intersect = (p.kind == PredicateKind::AND) != negated;
+            evaluate(*p.children[0], negated, first, count, out, scratch);
+            Selection rhs;
+            for (size_t c = 1; c < p.children.size(); c++) {
+                if (intersect) {
+                    uint64_t any = 0;
+                    for (size_t w = 0; w < kBatchWords; w++) {
+                        any |= out.words[w];
+                    }
+                    if (!any) {
+                        return; // nothing left to narrow down
+                    }
+                }
+                evaluate(*p.children[c], negated, first, count, rhs, scratch);
+                for (size_t w = 0; w < kBatchWords; w++) {
+                    out.words[w] = intersect ? out.words[w] & rhs.words[w] : out.words[w] | rhs.words[w];
+                }
+            }
+            return;
+        }
+        case PredicateKind::NOT:
+            evaluate(*p.children[0], !negated, first, count, out, scratch);
+            return;
+        default:
+            evaluateLeaf(p, negated, first, count, out, scratch);
+            return;
+    }
+}
+
+// NULL rows are taken out of the values' result, and an all-NULL batch is
+// not read at all
+void Filter::evaluateLeaf(const Predicate& p, bool negated, size_t first, size_t count, Selection& out,
+                          ScanScratch& scratch) const {
+    Selection all;
+    fillAll(count, all);
+    const uint64_t* nulls = table.getStorage().getNulls(p.column, first, count, scratch.nulls);
+    size_t words = (count + 63) / 64;
+    if (p.kind == PredicateKind::IS_NULL) {
+        for (size_t w = 0; w < kBatchWords; w++) {
+            uint64_t x = nulls && w < words ? nulls[w] : 0;
+            out.words[w] = (negated ? ~x : x) & all.words[w];
+        }
+        return;
+    }
+    Selection valid = all;
+    if (nulls) {
+        uint64_t any = 0;
+        for (size_t w = 0; w < words; w++) {
+            valid.words[w] &= ~nulls[w];
+            any |= valid.words[w];
+        }
+        if (!any) {
+            std::memset(out.words, 0, sizeof(out.words));
+            return;
+        }
+    }
+    evaluateValues(p, first, count, out, scratch);
+    for (size_t w = 0; w < kBatchWords; w++) {
+        uint64_t r = negated ? ~out.words[w] : out.words[w];
+        out.words[w] = r & valid.words[w];
+    }
+}
+
+// Kleene logic with true = 1, unknown = 0, false = -1
+static int truthForNulls(const Predicate& p) {
+    switch (p.kind) {
+        case PredicateKind::IS_NULL:
+            return 1;
+        case PredicateKind::NOT:
+            return -truthForNulls(*p.children[0]);
+        case PredicateKind::AND: {
+            int result = 1;
+            for (const auto& child : p.children) {
+                result = std::min(result, truthForNulls(*child));
+            }
+            return result;
+        }
+        case PredicateKind::OR: {
+            int result = -1;
+            for (const auto& child : p.children) {
+                result = std::max(result, truthForNulls(*child));
+            }
+            return result;
+        }
+        default:
+            return 0;
+    }
+}
+
+bool isTrueForNulls(const Predicate& p) {
+    return truthForNulls(p) == 1;
+}
+
+// Dictionary chunks: the leaf is evaluated once per distinct value, then
+// each row only looks its code up, whatever the operator
+const std::vector<uint8_t>& Filter::matchDictionary(const Predicate& p, const ColumnChunk& chunk,
+                                                    ScanScratch& scratch) const {
+    auto it = std::find_if(scratch.dictionaryMatches.begin(), scratch.dictionaryMatches.end(),
+                           [&p](const auto& m) { return m.leaf == &p; });
+    if (it == scratch.dictionaryMatches.end()) {
+        scratch.dictionaryMatches.push_back({&p, nullptr, {}});
+        it = scratch.dictionaryMatches.end() - 1;
+    }
+    if (it->chunk == &chunk) {
+        return it->matches;
+    }
+    it->chunk = &chunk;
+    size_t entries = chunk.dictionarySize();
+    it->matches.resize(entries);
+    Selection sel;
+    for (size_t first = 0; first < entries; first += kBatchRows) {
+        size_t n = std::min(kBatchRows, entries - first);
+        scratch.strings.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            scratch.strings[i] = chunk.dictionaryAt(static_cast<uint16_t>(first + i));
+        }
+        evaluateTyped<std::string_view>(p, scratch.strings.data(), n, sel, stringLiteral);
+        for (size_t i = 0; i < n; i++) {
+            it->matches[first + i] = (sel.words[i >> 6] >> (i & 63)) & 1;
+        }
+    }
+    return it->matches;
+}
+
+void Filter::evaluateValues(const Predicate& p, size_t first, size_t count, Selection& out, ScanScratch& scratch) const {
+    const TableStorage& storage = table.getStorage();
+    switch (p.type) {
+        case ColumnType::INT: {
+            const int* data = storage.getInts(p.column, first, count, scratch.ints);
+            evaluateTyped<int>(p, data, count, out, [](const Value& v) { return std::get<int>(v); });
+            break;
+        }
+        case ColumnType::FLOAT: {
+            const float* data = storage.getFloats(p.column, first, count, scratch.floats);
+            evaluateTyped<float>(p, data, count, out, [](const Value& v) { return std::get<float>(v); });
+            break;
+        }
+        case ColumnType::STRING: {
+            const uint16_t* codes;
+            if (const ColumnChunk* chunk = storage.getStringCodes(p.column, first, count, codes)) {
+                const uint8_t* matches = matchDictionary(p, *chunk, scratch).data();
+                compareKernel(codes, count, out, [matches](uint16_t code) { return matches[code] != 0; });
+                break;
+            }
+            storage.getStrings(p.column, first, count, scratch.strings);
+            evaluateTyped<std::string_view>(p, scratch.strings.data(), count, out, stringLiteral);
+            break;
+        }
+        case ColumnType::BOOLEAN: {
+            Selection bits;
+            Selection all;
+            storage.getBools(p.column, first, count, bits.words);
+            fillAll(count, all);
+            size_t words = (count + 63) / 64;
+            for (size_t w = 0; w < kBatchWords; w++) {
+                uint64_t x = w < words ? bits.words[w] : 0;
+                uint64_t r = 0;
+                if (p.kind == PredicateKind::COMPARE) {
+                    r = compareBoolWord(x, p.op, std::get<bool>(p.literals[0]));
+                } else if (p.kind == PredicateKind::BETWEEN) {
+                    r = compareBoolWord(x, CompareOp::GE, std::get<bool>(p.literals[0])) &
+                        compareBoolWord(x, CompareOp::LE, std::get<bool>(p.literals[1]));
+                } else {
+                    for (const auto& v : p.literals) {
+                        r |= compareBoolWord(x, CompareOp::EQ, std::get<bool>(v));
+                    }
+                }
+                out.words[w] = r & all.words[w];
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,337 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Table.h"
+#include "ThreadPool.h"
+
+// Rows per batch. Evaluation works on one batch at a time and always starts
+// batches on a multiple of kBatchRows, so a batch never straddles a chunk.
+constexpr size_t kBatchRows = 1024;
+constexpr size_t kBatchWords = kBatchRows / 64;
+
+// Rows per morsel, the unit of work of a parallel scan; a chunk holds four.
+constexpr size_t kMorselRows = 16 * kBatchRows;
+static_assert(kZoneRows % kMorselRows == 0, "a morsel never straddles a zone");
+
+// Bit i of a selection is set when row (first + i) of the batch qualifies.
+struct Selection {
+    uint64_t words[kBatchWords];
+};
+
+enum class PredicateKind {
+    COMPARE,
+    IN,
+    BETWEEN,
+    IS_NULL, // IS NOT NULL is NOT over it
+    AND,
+    OR,
+    NOT
+};
+
+enum class CompareOp {
+    EQ,
+    NE,
+    LT,
+    LE,
+    GT,
+    GE
+};
+
+// WHERE clause tree. Leaves reference a column by index and carry literals
+// already converted to that column's type. Comparisons with a NULL are
+// unknown, which selects the row neither for the comparison nor under NOT.
+struct Predicate {
+    PredicateKind kind;
+    CompareOp op = CompareOp::EQ;
+    int column = -1;
+    ColumnType type = ColumnType::INT;
+    std::vector<Value> literals; // COMPARE: 1, BETWEEN: lo/hi, IN: the list
+    std::vector<std::unique_ptr<Predicate>> children;
+};
+
+// Whether p holds for a row whose columns are all NULL, like the right side
+// of a LEFT join row without a match
+bool isTrueForNulls(const Predicate& p);
+
+// Per-thread buffers reused across batches.
+struct ScanScratch {
+    std::vector<int> ints;
+    std::vector<float> floats;
+    std::vector<std::string_view> strings;
+    std::vector<uint64_t> nulls;
+
+    // A STRING leaf's result for each code of the dictionary chunk it last saw
+    struct DictionaryMatch {
+        const Predicate* leaf;
+        const ColumnChunk* chunk;
+        std::vector<uint8_t> matches;
+    };
+    std::vector<DictionaryMatch> dictionaryMatches;
+};
+
+// What one worker of a profiled scan did (EXPLAIN ANALYZE). Padded to a
+// cache line, so workers counting side by side don't contend.
+struct alignas(64) ScanCounters {
+    uint64_t batches = 0;       // batches evaluated
+    uint64_t rows = 0;          // rows in them
+    uint64_t selected = 0;      // rows passed on
+    uint64_t filterNanos = 0;   // reading and evaluating the batches
+    uint64_t consumerNanos = 0; // in the caller's callback
+};
+
+class Filter {
+private:
+    const Table& table;
+    std::unique_ptr<Predicate> owned;
+    const Predicate* predicate; // null selects every row
+
+    // Term answered by an index, and the rows the index gave for it
+    // (sorted, unique, live); a null term means a full scan
+    const Predicate* indexed = nullptr;
+    std::vector<size_t> candidates;
+    std::string indexName;
+
+    // Per zone of the table (see ZoneMap): whether the predicate can select
+    // any of its rows; empty when no zone could be ruled out
+    std::vector<uint8_t> zoneMatches;
+
+    // One per pool worker while the scan is profiled, null otherwise
+    std::vector<ScanCounters>* counters = nullptr;
+
+    void chooseIndex();
+    void probeIndex(const Index& index);
+    void pruneZones();
+    bool skipsZone(size_t zone) const;
+    size_t getScannedRowCount() const; // rows in zones a scan reads
+    // Selects the rows where p is true or, negated, where it is false
+    void evaluate(const Predicate& p, bool negated, size_t first, size_t count, Selection& out,
+                  ScanScratch& scratch) const;
+    void evaluateLeaf(const Predicate& p, bool negated, size_t first, size_t count, Selection& out,
+                      ScanScratch& scratch) const;
+    void evaluateValues(const Predicate& p, size_t first, size_t count, Selection& out, ScanScratch& scratch) const;
+    const std::vector<uint8_t>& matchDictionary(const Predicate& p, const ColumnChunk& chunk, ScanScratch& scratch) const;
+
+public:
+    Filter(const Table& table, std::unique_ptr<Predicate> predicate);
+    // Borrows the predicate, which must outlive the filter (prepared plans)
+    Filter(const Table& table, const Predicate* predicate);
+
+    // Evaluates rows [first, first + count), count <= kBatchRows. Bits past
+    // count are always cleared.
+    void evaluateBatch(size_t first, size_t count, Selection& out, ScanScratch& scratch) const;
+
+    bool usesIndex() const;
+    // The index used, the term it answers (the whole predicate or one term
+    // of an AND) and the rows it gave
+    const std::string& getIndexName() const;
+    const Predicate* getIndexedTerm() const;
+    size_t getCandidateCount() const;
+    const Predicate* getPredicate() const;
+    size_t getSkippedZoneCount() const; // zones no scan reads
+    // Rows the filter is expected to select: exact when an index answers
+    // the whole predicate, otherwise from the table's statistics (or fixed
+    // guesses before ANALYZE)
+    double estimateRows() const;
+
+    size_t getMorselCount() const;
+
+    // Counts what every scan of the filter does into counters, one per
+    // worker of the pool scanning; null stops counting
+    void setCounters(std::vector<ScanCounters>* counters);
+
+    // Calls f(first, count, sel) for each batch that can hold matches, in
+    // row order; sel marks the qualifying rows of [first, first + count)
+    template <typename F>
+    void forEachBatch(ScanScratch& scratch, F&& f) const {
+        if (indexed) {
+            forEachCandidateBatch(0, table.getRowCount(), scratch, f);
+            return;
+        }
+        Selection sel;
+        size_t rowCount = table.getRowCount();
+        for (size_t first = 0; first < rowCount; first += kBatchRows) {
+            if (skipsZone(first / kZoneRows)) {
+                first = (first / kZoneRows + 1) * kZoneRows - kBatchRows;
+                continue;
+            }
+            size_t count = std::min(kBatchRows, rowCount - first);
+            scanBatch(0, first, count, sel, scratch, [&] { f(first, count, static_cast<const Selection&>(sel)); });
+        }
+    }
+
+    // Calls f(row) for every qualifying row, in row order
+    template <typename F>
+    void forEachMatch(F&& f) const {
+        if (indexed && indexed == predicate) {
+            std::chrono::steady_clock::time_point start;
+            if (counters) {
+                start = std::chrono::steady_clock::now();
+            }
+            for (size_t r : candidates) {
+                f(r);
+            }
+            if (counters) {
+                (*counters)[0].selected += candidates.size();
+                (*counters)[0].consumerNanos += nanosSince(start);
+            }
+            return;
+        }
+        ScanScratch scratch;
+        forEachBatch(scratch, [&](size_t first, size_t, const Selection& sel) {
+            forEachBit(first, sel, f);
+        });
+    }
+
+    // Like forEachBatch, but morsels of kMorselRows rows are scanned in
+    // parallel on the pool. Calls f(worker, morsel, first, count, sel); the
+    // batches of one morsel arrive in order on one thread, morsels in no
+    // particular order. Index probes are cheap and stay on the calling thread.
+    // Morsels in zones the predicate can't match are not scanned.
+    template <typename F>
+    void parallelForEachBatch(ThreadPool& pool, F&& f) const {
+        parallelForEachBatch(pool, 0, getMorselCount(), f);
+    }
+
+    // parallelForEachBatch over morsels [begin, end) only, for scans that
+    // stop early
+    template <typename F>
+    void parallelForEachBatch(ThreadPool& pool, size_t begin, size_t end, F&& f) const {
+        size_t rowCount = table.getRowCount();
+        if (indexed) {
+            ScanScratch scratch;
+            forEachCandidateBatch(begin * kMorselRows, std::min(rowCount, end * kMorselRows), scratch,
+                                  [&](size_t first, size_t count, const Selection& sel) {
+                                      f(size_t(0), first / kMorselRows, first, count, sel);
+                                  });
+            return;
+        }
+        std::vector<ScanScratch> scratch(pool.getThreadCount());
+        pool.parallelFor(end - begin, [&](size_t m, size_t worker) {
+            size_t morsel = begin + m;
+            if (skipsZone(morsel * kMorselRows / kZoneRows)) {
+                return;
+            }
+            Selection sel;
+            size_t last = std::min(rowCount, (morsel + 1) * kMorselRows);
+            for (size_t first = morsel * kMorselRows; first < last; first += kBatchRows) {
+                size_t count = std::min(kBatchRows, last - first);
+                scanBatch(worker, first, count, sel, scratch[worker],
+                          [&] { f(worker, morsel, first, count, static_cast<const Selection&>(sel)); });
+            }
+        });
+    }
+
+    // Row-at-a-time form of parallelForEachBatch: f(worker, morsel, row)
+    template <typename F>
+    void parallelForEachMatch(ThreadPool& pool, F&& f) const {
+        if (indexed) {
+            forEachMatch([&](size_t r) { f(size_t(0), r / kMorselRows, r); });
+            return;
+        }
+        parallelForEachBatch(pool, [&](size_t worker, size_t morsel, size_t first, size_t, const Selection& sel) {
+            forEachBit(first, sel, [&](size_t r) { f(worker, morsel, r); });
+        });
+    }
+
+    // parallelForEachMatch over morsels [begin, end) only
+    template <typename F>
+    void parallelForEachMatch(ThreadPool& pool, size_t begin, size_t end, F&& f) const {
+        parallelForEachBatch(pool, begin, end,
+                             [&](size_t worker, size_t morsel, size_t first, size_t, const Selection& sel) {
+                                 forEachBit(first, sel, [&](size_t r) { f(worker, morsel, r); });
+                             });
+    }
+
+private:
+    static uint64_t nanosSince(std::chrono::steady_clock::time_point start) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    // Evaluates a batch into sel and hands it to consume(). Profiling costs
+    // two clock reads per batch, and one branch when off.
+    template <typename F>
+    void scanBatch(size_t worker, size_t first, size_t count, Selection& sel, ScanScratch& scratch, F&& consume) const {
+        if (!counters) {
+            evaluateBatch(first, count, sel, scratch);
+            consume();
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        evaluateBatch(first, count, sel, scratch);
+        auto evaluated = std::chrono::steady_clock::now();
+        consume();
+        countBatch(worker, count, sel, start, evaluated);
+    }
+
+    void countBatch(size_t worker, size_t count, const Selection& sel, std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point evaluated) const {
+        ScanCounters& c = (*counters)[worker];
+        c.batches++;
+        c.rows += count;
+        for (size_t w = 0; w < kBatchWords; w++) {
+            c.selected += static_cast<uint64_t>(std::popcount(sel.words[w]));
+        }
+        c.filterNanos += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            evaluated - start).count());
+        c.consumerNanos += nanosSince(evaluated);
+    }
+
+    // forEachBatch for an index scan, over the candidates in rows [lo, hi);
+    // hi is a multiple of kBatchRows or the row count. Only batches holding
+    // candidates are evaluated, and the full predicate is rechecked there
+    // unless the probe was all of it.
+    template <typename F>
+    void forEachCandidateBatch(size_t lo, size_t hi, ScanScratch& scratch, F&& f) const {
+        Selection sel;
+        size_t rowCount = table.getRowCount();
+        size_t i = static_cast<size_t>(std::lower_bound(candidates.begin(), candidates.end(), lo) - candidates.begin());
+        while (i < candidates.size() && candidates[i] < hi) {
+            size_t first = candidates[i] / kBatchRows * kBatchRows;
+            size_t count = std::min(kBatchRows, rowCount - first);
+            std::chrono::steady_clock::time_point start;
+            if (counters) {
+                start = std::chrono::steady_clock::now();
+            }
+            Selection hits{};
+            for (; i < candidates.size() && candidates[i] < first + count; i++) {
+                size_t bit = candidates[i] - first;
+                hits.words[bit >> 6] |= uint64_t(1) << (bit & 63);
+            }
+            if (indexed != predicate) {
+                evaluateBatch(first, count, sel, scratch);
+                for (size_t w = 0; w < kBatchWords; w++) {
+                    hits.words[w] &= sel.words[w];
+                }
+            }
+            if (!counters) {
+                f(first, count, static_cast<const Selection&>(hits));
+                continue;
+            }
+            auto evaluated = std::chrono::steady_clock::now();
+            f(first, count, static_cast<const Selection&>(hits));
+            countBatch(0, count, hits, start, evaluated);
+        }
+    }
+
+    template <typename F>
+    static void forEachBit(size_t first, const Selection& sel, F&& f) {
+        for (size_t w = 0; w < kBatchWords; w++) {
+            uint64_t bits = sel.words[w];
+            while (bits) {
+                f(first + w * 64 + static_cast<size_t>(std::countr_zero(bits)));
+                bits &= bits - 1;
+            }
+        }
+    }
+};
+
+#endif //FILTER_H
@@ -0,0 +1,96 @@
+#include "Index.h"
+#include <stdexcept>
+
+Index::Index(const std::string& n, int col) : name(n), column(col) {}
+
+const std::string& Index::getName() const { return name; }
+int Index::getColumn() const { return column; }
+void Index::setColumn(int col) { column = col; }
+
+bool Index::supportsRange() const { return false; }
+
+void Index::lookupRange(const Value*, bool, const Value*, bool, std::vector<size_t>&) const {
+    throw std::logic_error("Index " + name + " does not support range lookups");
+}
+
+
+HashIndex::HashIndex(const std::string& n, int col) : Index(n, col) {}
+
+IndexType HashIndex::getType() const { return IndexType::HASH; }
+
+void HashIndex::insert(const Value& key, size_t row) {
+    if (isNull(key)) {
+        return;
+    }
+    entries.emplace(key, row);
+}
+
+void HashIndex::erase(const Value& key, size_t row) {
+    auto [first, last] = entries.equal_range(key);
+    for (auto it = first; it != last; ++it) {
+        if (it->second == row) {
+            entries.erase(it);
+            return;
+        }
+    }
+}
+
+void HashIndex::clear() {
+    entries.clear();
+}
+
+void HashIndex::lookupEqual(const Value& key, std::vector<size_t>& out) const {
+    auto [first, last] = entries.equal_range(key);
+    for (auto it = first; it != last; ++it) {
+        out.push_back(it->second);
+    }
+}
+
+
+OrderedIndex::OrderedIndex(const std::string& n, int col) : Index(n, col) {}
+
+IndexType OrderedIndex::getType() const { return IndexType::BTREE; }
+
+void OrderedIndex::insert(const Value& key, size_t row) {
+    if (isNull(key)) {
+        return;
+    }
+    entries.emplace(key, row);
+}
+
+void OrderedIndex::erase(const Value& key, size_t row) {
+    auto [first, last] = entries.equal_range(key);
+    for (auto it = first; it != last; ++it) {
+        if (it->second == row) {
+            entries.erase(it);
+            return;
+        }
+    }
+}
+
+void OrderedIndex::clear() {
+    entries.clear();
+}
+
+void OrderedIndex::lookupEqual(const Value& key, std::vector<size_t>& out) const {
+    auto [first, last] = entries.equal_range(key);
+    for (auto it = first; it != last; ++it) {
+        out.push_back(it->second);
+    }
+}
+
+bool OrderedIndex::supportsRange() const { return true; }
+
+void OrderedIndex::lookupRange(const Value* lo, bool loInclusive, const Value* hi, bool hiInclusive,
+                               std::vector<size_t>& out) const {
+    auto it = entries.begin();
+    if (lo) {
+        it = loInclusive ? entries.lower_bound(*lo) : entries.upper_bound(*lo);
+    }
+    for (; it != entries.end(); ++it) {
+        if (hi && (hiInclusive ? *hi < it->first : !(it->first < *hi))) {
+            break;
+        }
+        out.push_back(it->second);
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Column.h"
+
+enum class IndexType {
+    HASH,  // equality lookups in O(1)
+    BTREE  // ordered: equality and range lookups in O(log n)
+};
+
+// Secondary index from one column's values to row positions. Table keeps its
+// indexes in step with every row change. NULL keys are left out: no
+// predicate an index serves is true for a NULL.
+class Index {
+protected:
+    std::string name;
+    int column;
+
+public:
+    Index(const std::string& name, int column);
+    virtual ~Index() = default;
+
+    const std::string& getName() const;
+    int getColumn() const;
+    void setColumn(int column);
+
+    virtual IndexType getType() const = 0;
+    virtual void insert(const Value& key, size_t row) = 0;
+    virtual void erase(const Value& key, size_t row) = 0;
+    virtual void clear() = 0;
+
+    // Appends matching rows to out, in no particular order
+    virtual void lookupEqual(const Value& key, std::vector<size_t>& out) const = 0;
+    // Range lookup; a null bound is open. Only ordered indexes support it.
+    virtual bool supportsRange() const;
+    virtual void lookupRange(const Value* lo, bool loInclusive, const Value* hi, bool hiInclusive,
+                             std::vector<size_t>& out) const;
+};
+
+class HashIndex : public Index {
+private:
+    std::unordered_multimap<Value, size_t> entries;
+
+public:
+    HashIndex(const std::string& name, int column);
+
+    IndexType getType() const override;
+    void insert(const Value& key, size_t row) override;
+    void erase(const Value& key, size_t row) override;
+    void clear() override;
+    void lookupEqual(const Value& key, std::vector<size_t>& out) const override;
+};
+
+// Balanced search tree (std::multimap) behind CREATE INDEX ... USING BTREE
+class OrderedIndex : public Index {
+private:
+    std::multimap<Value, size_t> entries;
+
+public:
+    OrderedIndex(const std::string& name, int column);
+
+    IndexType getType() const override;
+    void insert(const Value& key, size_t row) override;
+    void erase(const Value& key, size_t row) override;
+    void clear() override;
+    void lookupEqual(const Value& key, std::vector<size_t>& out) const override;
+    bool supportsRange() const override;
+    void lookupRange(const Value* lo, bool loInclusive, const Value* hi, bool hiInclusive,
+                     std::vector<size_t>& out) const override;
+};
+
+#endif //INDEX_H
@@ -0,0 +1,133 @@
+#include "Join.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+JoinKeyReader::JoinKeyReader(const Table& table, int column)
+    : storage(table.getStorage()), column(column), type(table.getColumns()[column].getType()) {}
+
+void JoinKeyReader::load(size_t first, size_t count) {
+    nulls = storage.getNulls(column, first, count, nullScratch);
+    switch (type) {
+        case ColumnType::INT:
+            ints = storage.getInts(column, first, count, intScratch);
+            break;
+        case ColumnType::FLOAT:
+            floats = storage.getFloats(column, first, count, floatScratch);
+            break;
+        case ColumnType::BOOLEAN:
+            storage.getBools(column, first, count, bools);
+            break;
+        case ColumnType::STRING:
+            storage.getStrings(column, first, count, strings);
+            break;
+    }
+}
+
+JoinKey JoinKeyReader::key(size_t i) const {
+    JoinKey key;
+    if (nulls && ((nulls[i >> 6] >> (i & 63)) & 1)) {
+        key.null = true;
+        return key;
+    }
+    switch (type) {
+        case ColumnType::INT:
+            key.bits = static_cast<uint32_t>(ints[i]);
+            break;
+        case ColumnType::FLOAT: {
+            float f = floats[i];
+            if (f == 0.0f) {
+                f = 0.0f; // -0.0 = 0.0
+            }
+            uint32_t bits;
+            std::memcpy(&bits, &f, 4);
+            key.bits = bits;
+            break;
+        }
+        case ColumnType::BOOLEAN:
+            key.bits = (bools[i >> 6] >> (i & 63)) & 1;
+            break;
+        case ColumnType::STRING:
+            key.text = strings[i];
+            key.bits = std::hash<std::string_view>{}(key.text);
+            break;
+    }
+    key.hash = mix(key.bits);
+    return key;
+}
+
+HashJoin::HashJoin(const Table& table, int column, const Filter& filter, ThreadPool& pool) {
+    // Keys are gathered per morsel in parallel, then concatenated in row order
+    std::vector<std::vector<Entry>> parts(filter.getMorselCount());
+    std::vector<JoinKeyReader> readers;
+    readers.reserve(pool.getThreadCount());
+    for (size_t w = 0; w < pool.getThreadCount(); w++) {
+        readers.emplace_back(table, column);
+    }
+    filter.parallelForEachBatch(pool, [&](size_t worker, size_t morsel, size_t first, size_t count, const Selection& sel) {
+        bool any = false;
+        for (size_t w = 0; w < kBatchWords; w++) {
+            any |= sel.words[w] != 0;
+        }
+        if (!any) {
+            return;
+        }
+        JoinKeyReader& reader = readers[worker];
+        reader.load(first, count);
+        std::vector<Entry>& part = parts[morsel];
+        for (size_t w = 0; w < kBatchWords; w++) {
+            for (uint64_t bits = sel.words[w]; bits; bits &= bits - 1) {
+                size_t i = w * 64 + static_cast<size_t>(std::countr_zero(bits));
+                part.push_back({reader.key(i), first + i, 0});
+            }
+        }
+    });
+
+    size_t total = 0;
+    for (const auto& part : parts) {
+        total += part.size();
+    }
+    if (total >= UINT32_MAX) {
+        throw std::runtime_error("Join build side is too large");
+    }
+    entries.reserve(total);
+    for (auto& part : parts) {
+        entries.insert(entries.end(), part.begin(), part.end());
+        std::vector<Entry>().swap(part);
+    }
+
+    // Linking back to front leaves every chain in row order
+    buckets.assign(std::bit_ceil(std::max<size_t>(total, 1)), 0);
+    size_t mask = buckets.size() - 1;
+    for (size_t e = entries.size(); e-- > 0;) {
+        if (entries[e].key.null) {
+            continue;
+        }
+        uint32_t& head = buckets[entries[e].key.hash & mask];
+        entries[e].next = head;
+        head = static_cast<uint32_t>(e + 1);
+    }
+}
+
+size_t HashJoin::size() const {
+    return entries.size();
+}
+
+size_t HashJoin::getRow(size_t entry) const {
+    return entries[entry].row;
+}
+
+size_t HashJoin::getMemoryUsage() const {
+    return buckets.capacity() * sizeof(uint32_t) + entries.capacity() * sizeof(Entry);
+}
@@ -0,0 +1,89 @@
+#ifndef JOIN_H
+#define JOIN_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "Filter.h"
+#include "ThreadPool.h"
+
+enum class JoinType {
+    INNER,
+    LEFT
+};
+
+// A join column value: numbers and booleans as bits, strings as a view into
+// table storage, plus its hash. A NULL key equals nothing, itself included.
+struct JoinKey {
+    uint64_t hash = 0;
+    uint64_t bits = 0;
+    std::string_view text;
+    bool null = false;
+
+    bool operator==(const JoinKey& other) const {
+        return hash == other.hash && bits == other.bits && text == other.text;
+    }
+};
+
+// Reads the join column of one batch at a time straight from table storage
+class JoinKeyReader {
+private:
+    const TableStorage& storage;
+    int column;
+    ColumnType type;
+    std::vector<int> intScratch;
+    std::vector<float> floatScratch;
+    const int* ints = nullptr;
+    const float* floats = nullptr;
+    uint64_t bools[kBatchWords] = {};
+    std::vector<std::string_view> strings;
+    std::vector<uint64_t> nullScratch;
+    const uint64_t* nulls = nullptr;
+
+public:
+    JoinKeyReader(const Table& table, int column);
+
+    void load(size_t first, size_t count);
+    JoinKey key(size_t i) const; // i-th row of the loaded batch
+};
+
+// Hash table over the join column of the build side of a hash join. Entries
+// are stored in row order and chained per bucket, so a probe visits the
+// matching build rows in row order; nothing is copied out of the table.
+// Rows with a NULL key get an entry (a LEFT join still reports them) but
+// sit in no chain.
+class HashJoin {
+private:
+    struct Entry {
+        JoinKey key;
+        size_t row;
+        uint32_t next; // entry index + 1, 0 ends the chain
+    };
+
+    std::vector<uint32_t> buckets; // first entry index + 1; power of two
+    std::vector<Entry> entries;
+
+public:
+    // Builds over the rows `filter` selects, scanning them in parallel
+    HashJoin(const Table& table, int column, const Filter& filter, ThreadPool& pool);
+
+    size_t size() const;
+    size_t getRow(size_t entry) const;
+    size_t getMemoryUsage() const; // bytes of the entries and buckets
+
+    // Calls f(entry, row) for every build row whose key equals `key`
+    template <typename F>
+    void forEachMatch(const JoinKey& key, F&& f) const {
+        if (entries.empty() || key.null) {
+            return;
+        }
+        for (uint32_t e = buckets[key.hash & (buckets.size() - 1)]; e != 0; e = entries[e - 1].next) {
+            const Entry& entry = entries[e - 1];
+            if (entry.key == key) {
+                f(static_cast<size_t>(e - 1), entry.row);
+            }
+        }
+    }
+};
+
+#endif //JOIN_H
@@ -0,0 +1,38 @@
+#include "MappedFile.h"
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& fileName) {
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + fileName);
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat " + fileName);
+    }
+    size = static_cast<size_t>(st.st_size);
+    if (size > 0) {
+        void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Cannot map " + fileName);
+        }
+        data = static_cast<const char*>(p);
+    }
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        ::munmap(const_cast<char*>(data), size);
+    }
+}
+
+const char* MappedFile::getData() const { return data; }
+size_t MappedFile::getSize() const { return size; }
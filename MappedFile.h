@@ -0,0 +1,25 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only private mapping of a whole file. Pages are faulted in by the OS
+// on first access. Owned through shared_ptr by every chunk that points into it.
+class MappedFile {
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+
+public:
+    explicit MappedFile(const std::string& fileName); // throws std::runtime_error
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* getData() const;
+    size_t getSize() const;
+};
+
+#endif //MAPPEDFILE_H
@@ -0,0 +1,117 @@
+#include "NullBitmap.h"
+#include <bit>
+
+size_t NullBitmap::size() const { return rows; }
+size_t NullBitmap::count() const { return nulls; }
+
+const uint64_t* NullBitmap::data() const {
+    return nulls ? words.data() : nullptr;
+}
+
+bool NullBitmap::test(size_t i) const {
+    return nulls && ((words[i >> 6] >> (i & 63)) & 1);
+}
+
+void NullBitmap::allocate() {
+    words.resize((rows + 63) / 64, 0);
+}
+
+void NullBitmap::append(bool null) {
+    rows++;
+    if (null || !words.empty()) {
+        allocate();
+    }
+    if (null) {
+        words[(rows - 1) >> 6] |= uint64_t(1) << ((rows - 1) & 63);
+        nulls++;
+    }
+}
+
+void NullBitmap::appendValid(size_t n) {
+    rows += n;
+    if (!words.empty()) {
+        allocate();
+    }
+}
+
+void NullBitmap::appendRange(const uint64_t* bitmap, size_t first, size_t n) {
+    if (!bitmap) {
+        appendValid(n);
+        return;
+    }
+    for (size_t i = first; i < first + n; i++) {
+        append((bitmap[i >> 6] >> (i & 63)) & 1);
+    }
+}
+
+void NullBitmap::set(size_t i, bool null) {
+    if (test(i) == null) {
+        return;
+    }
+    allocate();
+    words[i >> 6] ^= uint64_t(1) << (i & 63);
+    if (null) {
+        nulls++;
+    } else if (--nulls == 0) {
+        std::vector<uint64_t>().swap(words);
+    }
+}
+
+// Shifts the flags after i down by one
+void NullBitmap::erase(size_t i) {
+    if (test(i)) {
+        nulls--;
+    }
+    rows--;
+    if (words.empty()) {
+        return;
+    }
+    if (nulls == 0) {
+        std::vector<uint64_t>().swap(words);
+        return;
+    }
+    size_t w = i >> 6;
+    uint64_t low = (uint64_t(1) << (i & 63)) - 1;
+    uint64_t carry = w + 1 < words.size() ? words[w + 1] << 63 : 0;
+    words[w] = (words[w] & low) | ((words[w] >> 1) & ~low) | carry;
+    for (size_t k = w + 1; k < words.size(); k++) {
+        words[k] = (words[k] >> 1) | (k + 1 < words.size() ? words[k + 1] << 63 : 0);
+    }
+    words.resize((rows + 63) / 64);
+}
+
+void NullBitmap::eraseRows(const uint64_t* erased) {
+    if (words.empty()) {
+        size_t kept = 0;
+        forEachClearRun(erased, rows, [&](size_t, size_t n) { kept += n; });
+        rows = kept;
+        return;
+    }
+    NullBitmap kept;
+    forEachClearRun(erased, rows, [&](size_t first, size_t n) { kept.appendRange(words.data(), first, n); });
+    *this = std::move(kept);
+}
+
+void NullBitmap::assign(const uint64_t* bitmap, size_t n) {
+    clear();
+    rows = n;
+    if (!bitmap) {
+        return;
+    }
+    words.assign(bitmap, bitmap + (n + 63) / 64);
+    if (n & 63) {
+        words.back() &= (uint64_t(1) << (n & 63)) - 1;
+    }
+    for (uint64_t word : words) {
+        nulls += static_cast<size_t>(std::popcount(word));
+    }
+    if (nulls == 0) {
+        std::vector<uint64_t>().swap(words);
+    }
+}
+
+void NullBitmap::clear() {
+    std::vector<uint64_t>().swap(words);
+    rows = 0;
+    nulls = 0;
+}
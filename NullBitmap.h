@@ -0,0 +1,75 @@
+#ifndef NULLBITMAP_H
+#define NULLBITMAP_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// NULL flags of one column (or chunk), one bit per row, set for NULL. The
+// bitmap holds no words until the first NULL arrives, so a column without
+// NULLs costs nothing and scans can tell from data() that they may skip the
+// check. NULL cells still occupy a slot in the column's value array, holding
+// the type's default value.
+class NullBitmap {
+private:
+    std::vector<uint64_t> words; // empty, or (rows + 63) / 64 of them
+    size_t rows = 0;
+    size_t nulls = 0;
+
+    void allocate();
+
+public:
+    size_t size() const;
+    size_t count() const;        // NULL rows
+    const uint64_t* data() const; // null when no row is NULL
+    bool test(size_t i) const;
+
+    void append(bool null);
+    void appendValid(size_t n);
+    // Appends flags [first, first + n) of a bitmap; null means all valid
+    void appendRange(const uint64_t* bitmap, size_t first, size_t n);
+    void set(size_t i, bool null);
+    void erase(size_t i);
+    // Drops the flags of the rows whose bit is set in `erased`, a bitmap over
+    // size() rows, keeping the others in order
+    void eraseRows(const uint64_t* erased);
+    void assign(const uint64_t* bitmap, size_t n); // null means all valid
+    void clear();
+};
+
+// Calls f(first, n) for each run [first, first + n) of rows below `rows`
+// whose bit is clear in bitmap, in order; whole words are skipped at a time
+template <typename F>
+void forEachClearRun(const uint64_t* bitmap, size_t rows, F&& f) {
+    size_t r = 0;
+    while (r < rows) {
+        // Next clear bit, then the next set bit after it
+        while (r < rows) {
+            uint64_t clear = ~bitmap[r >> 6] >> (r & 63);
+            if (clear) {
+                r += static_cast<size_t>(std::countr_zero(clear));
+                break;
+            }
+            r = (r | 63) + 1;
+        }
+        if (r >= rows) {
+            return;
+        }
+        size_t end = r;
+        while (end < rows) {
+            uint64_t set = bitmap[end >> 6] >> (end & 63);
+            if (set) {
+                end += static_cast<size_t>(std::countr_zero(set));
+                break;
+            }
+            end = (end | 63) + 1;
+        }
+        end = std::min(end, rows);
+        f(r, end - r);
+        r = end;
+    }
+}
+
+#endif //NULLBITMAP_H
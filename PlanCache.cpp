@@ -0,0 +1,93 @@
+#include "PlanCache.h"
+#include <cctype>
+
+PlanCache::PlanCache(size_t capacity) : capacity(capacity) {}
+
+std::shared_ptr<QueryPlan> PlanCache::find(const std::string& key) {
+    auto it = lookup.find(key);
+    if (it == lookup.end()) {
+        misses++;
+        return nullptr;
+    }
+    hits++;
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->second;
+}
+
+void PlanCache::insert(const std::string& key, std::shared_ptr<QueryPlan> plan) {
+    if (capacity == 0) {
+        return;
+    }
+    auto it = lookup.find(key);
+    if (it != lookup.end()) {
+        it->second->second = std::move(plan);
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+    entries.emplace_front(key, std::move(plan));
+    lookup.emplace(key, entries.begin());
+    evict();
+}
+
+void PlanCache::evict() {
+    while (entries.size() > capacity) {
+        lookup.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+void PlanCache::clear() {
+    entries.clear();
+    lookup.clear();
+}
+
+size_t PlanCache::size() const {
+    return entries.size();
+}
+
+size_t PlanCache::getCapacity() const {
+    return capacity;
+}
+
+void PlanCache::setCapacity(size_t newCapacity) {
+    capacity = newCapacity;
+    evict();
+}
+
+size_t PlanCache::getHits() const {
+    return hits;
+}
+
+size_t PlanCache::getMisses() const {
+    return misses;
+}
+
+std::string PlanCache::normalize(const std::string& query) {
+    std::string key;
+    key.reserve(query.size());
+    char quoteChar = '\0';
+    bool pendingSpace = false;
+    for (char c : query) {
+        if (quoteChar == '\0' && std::isspace(static_cast<unsigned char>(c))) {
+            pendingSpace = !key.empty();
+            continue;
+        }
+        if (pendingSpace) {
+            key += ' ';
+            pendingSpace = false;
+        }
+        if (quoteChar == '\0' && (c == '\'' || c == '"')) {
+            quoteChar = c;
+        } else if (c == quoteChar) {
+            quoteChar = '\0';
+        }
+        key += c;
+    }
+    if (!key.empty() && key.back() == ';') {
+        key.pop_back();
+        while (!key.empty() && key.back() == ' ') {
+            key.pop_back();
+        }
+    }
+    return key;
+}
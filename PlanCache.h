@@ -0,0 +1,43 @@
+#ifndef PLANCACHE_H
+#define PLANCACHE_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "QueryPlan.h"
+
+// Least-recently-used cache of compiled plans keyed by normalized query text.
+class PlanCache {
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<QueryPlan>>;
+
+    size_t capacity;
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> lookup;
+    size_t hits = 0;
+    size_t misses = 0;
+
+    void evict();
+
+public:
+    explicit PlanCache(size_t capacity = 256);
+
+    // Null on a miss; a hit becomes the most recently used entry
+    std::shared_ptr<QueryPlan> find(const std::string& key);
+    void insert(const std::string& key, std::shared_ptr<QueryPlan> plan);
+    void clear();
+
+    size_t size() const;
+    size_t getCapacity() const;
+    void setCapacity(size_t newCapacity); // 0 disables caching
+    size_t getHits() const;
+    size_t getMisses() const;
+
+    // Collapses whitespace outside quotes and drops a trailing semicolon, so
+    // queries differing only in layout share a plan. Case is kept: table and
+    // column names are case-sensitive.
+    static std::string normalize(const std::string& query);
+};
+
+#endif //PLANCACHE_H
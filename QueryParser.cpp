@@ -3,6 +3,12 @@
 #include <cctype>
 #include <algorithm>
 #include <unordered_map>
+#include <charconv>
+#include <atomic>
+#include <bit>
+#include <optional>
+#include "Filter.h"
+#include "CsvLoader.h"
 
 // Helper function to tokenize a query string with better handling of parentheses and quotes
 std::vector<std::string> tokenizeQuery(const std::string& query) {
@@ -40,6 +46,28 @@ std::vector<std::string> tokenizeQuery(const std::string& query) {
                 token.clear();
             }
             tokens.push_back(",");
+        } else if (!inQuotes && c == '?') {
+            // Parameter placeholder in a prepared statement
+            if (!token.empty()) {
+                tokens.push_back(token);
+                token.clear();
+            }
+            tokens.push_back("?");
+        } else if (!inQuotes && (c == '=' || c == '<' || c == '>' || c == '!')) {
+            // Comparison operators: =, <, >, <=, >=, <>, !=
+            if (!token.empty()) {
+                tokens.push_back(token);
+                token.clear();
+            }
+            std::string op(1, c);
+            if (i + 1 < query.length()) {
+                char next = query[i + 1];
+                if (next == '=' || (c == '<' && next == '>')) {
+                    op += next;
+                    i++;
+                }
+            }
+            tokens.push_back(op);
         } else if (!inQuotes && std::isspace(c)) {
             if (!token.empty()) {
                 tokens.push_back(token);
@@ -71,36 +99,441 @@ std::string toLower(const std::string& str) {
     return result;
 }
 
-QueryParser::QueryParser(Database &db) : db(db) {}
+// Helper function to strip surrounding single quotes from a literal token
+std::string unquote(const std::string& token) {
+    if (token.size() >= 2 && token.front() == '\'' && token.back() == '\'') {
+        return token.substr(1, token.size() - 2);
+    }
+    return token;
+}
+
+// Helper function to convert a literal token to a value of the given column
+// type; an unquoted NULL is NULL for every type
+Value parseLiteral(const std::string& token, ColumnType type) {
+    if (toLower(token) == "null") {
+        return std::monostate{};
+    }
+    std::string text = unquote(token);
+    const char* begin = text.data();
+    const char* end = text.data() + text.size();
+    switch (type) {
+        case ColumnType::INT: {
+            int v = 0;
+            auto [ptr, ec] = std::from_chars(begin, end, v);
+            if (ec != std::errc() || ptr != end) {
+                throw std::invalid_argument("Error converting value '" + text + "' to INTEGER");
+            }
+            return v;
+        }
+        case ColumnType::FLOAT: {
+            float v = 0.0f;
+            auto [ptr, ec] = std::from_chars(begin, end, v);
+            if (ec != std::errc() || ptr != end) {
+                throw std::invalid_argument("Error converting value '" + text + "' to FLOAT");
+            }
+            return v;
+        }
+        case ColumnType::STRING:
+            return text;
+        case ColumnType::BOOLEAN: {
+            std::string lower = toLower(text);
+            if (lower != "true" && lower != "false") {
+                throw std::invalid_argument("Error converting value '" + text + "' to BOOLEAN");
+            }
+            return lower == "true";
+        }
+    }
+    return text;
+}
+
+// Row count of a LIMIT or OFFSET clause
+static size_t parseCount(const std::string& token) {
+    size_t n = 0;
+    auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), n);
+    if (ec != std::errc() || ptr != token.data() + token.size()) {
+        throw std::invalid_argument("Invalid row count: " + token);
+    }
+    return n;
+}
+
+// Helper function to map a type name in a column definition to its type
+ColumnType parseColumnType(const std::string& name) {
+    if (name == "INTEGER") {
+        return ColumnType::INT;
+    } else if (name == "FLOAT") {
+        return ColumnType::FLOAT;
+    } else if (name == "STRING") {
+        return ColumnType::STRING;
+    } else if (name == "BOOLEAN") {
+        return ColumnType::BOOLEAN;
+    }
+    throw std::invalid_argument("Invalid column type: " + name);
+}
+
+// Helper function to read a column definition, name TYPE [NOT NULL]
+// [DEFAULT literal], from tokens[i] up to `end`; leaves i after it
+Column parseColumnDefinition(const std::vector<std::string>& tokens, size_t& i, size_t end) {
+    if (i + 1 >= end) {
+        throw std::invalid_argument("Incomplete column definition");
+    }
+    std::string name = tokens[i];
+    ColumnType type = parseColumnType(tokens[i + 1]);
+    i += 2;
+    bool nullable = true;
+    Value defaultValue = std::monostate{};
+    while (i + 1 < end) {
+        if (toLower(tokens[i]) == "not" && toLower(tokens[i + 1]) == "null") {
+            nullable = false;
+        } else if (toLower(tokens[i]) == "default") {
+            defaultValue = parseLiteral(tokens[i + 1], type);
+        } else {
+            break;
+        }
+        i += 2;
+    }
+    return Column(name, type, nullable, defaultValue);
+}
+
+// Recursive descent over the WHERE tokens:
+//   or   := and (OR and)*
+//   and  := not (AND not)*
+//   not  := NOT not | '(' or ')' | col op lit | col [NOT] IN (lit, ...)
+//         | col [NOT] BETWEEN lit AND lit | col IS [NOT] NULL
+namespace {
+struct WhereParser {
+    const Table& table;
+    const std::vector<std::string>& tokens;
+    size_t pos;
+    size_t end;
+    std::vector<ParamSlot>* params; // null: `?` is not allowed
+    std::vector<std::pair<Predicate*, size_t>> placeholders; // leaf, literal index
+    const std::string& qualifier; // accepted `qualifier.` column prefix, if not empty
+
+    bool atKeyword(const char* keyword) const {
+        return pos < end && toLower(tokens[pos]) == keyword;
+    }
+
+    const std::string& next() {
+        if (pos >= end) {
+            throw std::invalid_argument("Invalid WHERE clause: unexpected end");
+        }
+        return tokens[pos++];
+    }
+
+    void expect(const char* token) {
+        if (pos >= end || toLower(tokens[pos]) != token) {
+            throw std::invalid_argument(std::string("Invalid WHERE clause: expected '") + token + "'");
+        }
+        pos++;
+    }
+
+    // A literal of the leaf's type, or a `?` that is bound at execution
+    void parseValue(Predicate& leaf) {
+        const std::string& token = next();
+        if (token == "?") {
+            if (!params) {
+                throw std::invalid_argument("Parameter placeholder outside a prepared statement");
+            }
+            placeholders.emplace_back(&leaf, leaf.literals.size());
+            leaf.literals.push_back(defaultValueFor(leaf.type));
+            return;
+        }
+        Value value = parseLiteral(token, leaf.type);
+        if (isNull(value)) {
+            throw std::invalid_argument("Invalid WHERE clause: a comparison with NULL is never true, use IS NULL");
+        }
+        leaf.literals.push_back(std::move(value));
+    }
+
+    // Literal vectors are complete now, so slot pointers stay put
+    void resolvePlaceholders() {
+        for (const auto& [leaf, i] : placeholders) {
+            params->push_back({leaf->type, &leaf->literals[i]});
+        }
+    }
+
+    static std::unique_ptr<Predicate> combine(PredicateKind kind, std::unique_ptr<Predicate> lhs,
+                                              std::unique_ptr<Predicate> rhs) {
+        if (lhs->kind == kind) {
+            lhs->children.push_back(std::move(rhs));
+            return lhs;
+        }
+        auto node = std::make_unique<Predicate>();
+        node->kind = kind;
+        node->children.push_back(std::move(lhs));
+        node->children.push_back(std::move(rhs));
+        return node;
+    }
+
+    static std::unique_ptr<Predicate> negate(std::unique_ptr<Predicate> child) {
+        auto node = std::make_unique<Predicate>();
+        node->kind = PredicateKind::NOT;
+        node->children.push_back(std::move(child));
+        return node;
+    }
+
+    std::unique_ptr<Predicate> parseOr() {
+        auto lhs = parseAnd();
+        while (atKeyword("or")) {
+            pos++;
+            lhs = combine(PredicateKind::OR, std::move(lhs), parseAnd());
+        }
+        return lhs;
+    }
+
+    std::unique_ptr<Predicate> parseAnd() {
+        auto lhs = parseNot();
+        while (atKeyword("and")) {
+            pos++;
+            lhs = combine(PredicateKind::AND, std::move(lhs), parseNot());
+        }
+        return lhs;
+    }
+
+    std::unique_ptr<Predicate> parseNot() {
+        if (atKeyword("not")) {
+            pos++;
+            return negate(parseNot());
+        }
+        if (pos < end && tokens[pos] == "(") {
+            pos++;
+            auto inner = parseOr();
+            expect(")");
+            return inner;
+        }
+        return parseLeaf();
+    }
+
+    std::unique_ptr<Predicate> parseLeaf() {
+        std::string colName = next();
+        size_t dot = colName.find('.');
+        if (!qualifier.empty() && dot != std::string::npos) {
+            if (colName.compare(0, dot, qualifier) != 0) {
+                throw std::invalid_argument("Column \"" + colName + "\" is not in " + qualifier +
+                                            "; each AND term of a join condition may use only one table");
+            }
+            colName.erase(0, dot + 1);
+        }
+        int col = table.findColumn(colName);
+        if (col < 0) {
+            throw std::invalid_argument("Column \"" + colName + "\" does not exist");
+        }
+        auto leaf = std::make_unique<Predicate>();
+        leaf->column = col;
+        leaf->type = table.getColumns()[col].getType();
+
+        if (atKeyword("is")) {
+            pos++;
+            bool notNull = atKeyword("not");
+            if (notNull) {
+                pos++;
+            }
+            expect("null");
+            leaf->kind = PredicateKind::IS_NULL;
+            return notNull ? negate(std::move(leaf)) : std::move(leaf);
+        }
+
+        bool negated = false;
+        if (atKeyword("not")) {
+            negated = true;
+            pos++;
+        }
+
+        if (atKeyword("in")) {
+            pos++;
+            leaf->kind = PredicateKind::IN;
+            expect("(");
+            while (true) {
+                parseValue(*leaf);
+                if (pos < end && tokens[pos] == ",") {
+                    pos++;
+                    continue;
+                }
+                break;
+            }
+            expect(")");
+        } else if (atKeyword("between")) {
+            pos++;
+            leaf->kind = PredicateKind::BETWEEN;
+            parseValue(*leaf);
+            expect("and");
+            parseValue(*leaf);
+        } else if (negated) {
+            throw std::invalid_argument("Invalid WHERE clause: expected IN or BETWEEN after NOT");
+        } else {
+            const std::string& op = next();
+            leaf->kind = PredicateKind::COMPARE;
+            if (op == "=") {
+                leaf->op = CompareOp::EQ;
+            } else if (op == "!=" || op == "<>") {
+                leaf->op = CompareOp::NE;
+            } else if (op == "<") {
+                leaf->op = CompareOp::LT;
+            } else if (op == "<=") {
+                leaf->op = CompareOp::LE;
+            } else if (op == ">") {
+                leaf->op = CompareOp::GT;
+            } else if (op == ">=") {
+                leaf->op = CompareOp::GE;
+            } else {
+                throw std::invalid_argument("Invalid comparison operator: " + op);
+            }
+            parseValue(*leaf);
+        }
+        return negated ? negate(std::move(leaf)) : std::move(leaf);
+    }
+};
+}
+
+QueryParser::QueryParser(Database &db, std::ostream& out) : db(db), out(out), sink(out) {}
 
 // Main query parsing function
-void QueryParser::parseQuery(const std::string& query) {
+void QueryParser::parseQuery(const std::string& query, const std::vector<Value>& params) {
+    // SELECT plans and parameterized INSERT plans are cached by their text,
+    // so a repeated query skips tokenizing and parsing and only binds and
+    // runs. An INSERT of literals is rarely repeated and can be large, so
+    // it is compiled and run without evicting the plans worth keeping.
+    std::string key = PlanCache::normalize(query);
+    if (std::shared_ptr<QueryPlan> plan = plans.find(key)) {
+        executePlan(*plan, params);
+        return;
+    }
+
     std::vector<std::string> tokens = tokenizeQuery(query);
 
     if (tokens.empty()) {
-        std::cout << "Empty query" << std::endl;
+        out << "Empty query" << std::endl;
+        return;
+    }
+
+    std::string command = toLower(tokens[0]);
+
+    if (command == "insert" || command == "select") {
+        auto plan = std::make_shared<QueryPlan>();
+        plan->tokens = std::move(tokens);
+        compile(*plan);
+        if (plan->kind == PlanKind::SELECT || !plan->params.empty()) {
+            plans.insert(key, plan);
+        }
+        executePlan(*plan, params);
         return;
     }
+    if (!params.empty()) {
+        throw std::invalid_argument("Parameters are only supported for INSERT and SELECT");
+    }
+
+    if (command == "create" || command == "drop" || command == "alter" || command == "delete" ||
+        command == "update") {
+        executeStatement(tokens);
+    } else if (command == "copy") {
+        parseCopy(tokens);
+    } else if (command == "prepare") {
+        parsePrepare(tokens);
+    } else if (command == "execute") {
+        parseExecute(tokens);
+    } else if (command == "deallocate") {
+        parseDeallocate(tokens);
+    } else if (command == "analyze") {
+        parseAnalyze(tokens);
+    } else if (command == "explain") {
+        parseExplain(tokens);
+    } else {
+        out << "Unknown command: " << command << std::endl;
+    }
+}
 
+// Runs a DDL, DELETE or UPDATE statement; shared by parseQuery and log
+// replay. The statements log themselves while they still hold their locks,
+// so the log has them in the order they were applied.
+void QueryParser::executeStatement(const std::vector<std::string>& tokens) {
     std::string command = toLower(tokens[0]);
 
     if (command == "create" && tokens.size() > 1 && toLower(tokens[1]) == "table") {
         parseCreateTable(tokens);
+    } else if (command == "create" && tokens.size() > 1 && toLower(tokens[1]) == "index") {
+        parseCreateIndex(tokens);
     } else if (command == "drop" && tokens.size() > 1 && toLower(tokens[1]) == "table") {
         parseDropTable(tokens);
     } else if (command == "alter" && tokens.size() > 1 && toLower(tokens[1]) == "table") {
         parseAlterTable(tokens);
-    } else if (command == "insert") {
-        parseInsert(tokens);
-    } else if (command == "select") {
-        parseSelectQuery(tokens);
+    } else if (command == "delete") {
+        parseDelete(tokens);
+    } else if (command == "update") {
+        parseUpdate(tokens);
     } else {
-        std::cout << "Unknown command: " << command << std::endl;
+        throw std::invalid_argument("Unknown command: " + command);
+    }
+}
+
+// DDL, DELETE and UPDATE are logged as their token stream joined back into
+// text; tokens survive a second pass through tokenizeQuery unchanged. Replay
+// re-evaluates the WHERE clause against the same rows, so it picks the same
+// ones.
+void QueryParser::logStatement(const std::vector<std::string>& tokens) {
+    WriteAheadLog* log = db.getLog();
+    if (!log) {
+        return;
+    }
+    std::string statement;
+    for (const auto& token : tokens) {
+        if (!statement.empty()) {
+            statement += ' ';
+        }
+        statement += token;
     }
+    log->append(WalRecordType::STATEMENT, statement);
+}
+
+size_t QueryParser::recoverFromLog() {
+    WriteAheadLog* log = db.getLog();
+    if (!log) {
+        return 0;
+    }
+    uint64_t checkpoint = db.getCheckpointLsn();
+    size_t applied = 0;
+    // Replayed statements must not be logged again, and run in a session of
+    // their own whose messages go nowhere, so recovery is silent
+    std::unique_ptr<WriteAheadLog> detached = db.detachLog();
+    std::ostream discard(nullptr);
+    QueryParser replayer(db, discard);
+    log->replay([&](const WalRecord& record) {
+        if (record.lsn <= checkpoint) {
+            return;
+        }
+        try {
+            if (record.type == WalRecordType::INSERT) {
+                std::vector<Row> rows;
+                std::string tableName = WriteAheadLog::decodeRows(record.payload, rows);
+                std::shared_ptr<Table> table = db.GetTable(tableName);
+                if (table == nullptr) {
+                    throw std::invalid_argument("Table '" + tableName + "' does not exist");
+                }
+                Table::WriteLock write = table->lockForWrite();
+                table->addRows(rows);
+            } else if (record.type == WalRecordType::CHUNKS) {
+                std::vector<ColumnChunk> chunks;
+                std::string tableName = WriteAheadLog::decodeChunks(record.payload, chunks);
+                std::shared_ptr<Table> table = db.GetTable(tableName);
+                if (table == nullptr) {
+                    throw std::invalid_argument("Table '" + tableName + "' does not exist");
+                }
+                Table::WriteLock write = table->lockForWrite();
+                table->appendChunks(chunks);
+            } else {
+                replayer.executeStatement(tokenizeQuery(record.payload));
+            }
+            applied++;
+        } catch (const std::exception& e) {
+            std::cerr << "Skipping log record " << record.lsn << ": " << e.what() << std::endl;
+        }
+    });
+    log->setLastLsn(checkpoint);
+    db.attachLog(std::move(detached));
+    return applied;
 }
 
 void QueryParser::parseCreateTable(const std::vector<std::string> &tokens) {
-    // CREATE TABLE tablename ( col1 TYPE, col2 TYPE, ... )
+    // CREATE TABLE tablename ( col1 TYPE [NOT NULL] [DEFAULT literal], col2 TYPE, ... )
     if (tokens.size() < 6) {
         throw std::invalid_argument("Invalid CREATE TABLE syntax");
     }
@@ -130,10 +563,26 @@ void QueryParser::parseCreateTable(const std::vector<std::string> &tokens) {
         throw std::runtime_error("Invalid CREATE TABLE syntax: Missing parentheses");
     }
 
-    db.createTable(tableName);
-    std::cout << tableName << " created." << std::endl;
+    // Optional storage clause after the column list: USING ROW | COLUMNAR
+    StorageMode mode = StorageMode::ROW;
+    if (closeParen + 1 < tokens.size()) {
+        if (closeParen + 3 != tokens.size() || toLower(tokens[closeParen + 1]) != "using") {
+            throw std::invalid_argument("Invalid CREATE TABLE syntax: expected USING ROW|COLUMNAR");
+        }
+        std::string storageStr = toLower(tokens[closeParen + 2]);
+        if (storageStr == "row") {
+            mode = StorageMode::ROW;
+        } else if (storageStr == "columnar") {
+            mode = StorageMode::COLUMNAR;
+        } else {
+            throw std::invalid_argument("Invalid storage mode: " + tokens[closeParen + 2]);
+        }
+    }
 
-    // Parse column definitions between parentheses
+    // Parse column definitions between parentheses. The table is complete
+    // before other threads can see it, and stays locked until its CREATE is
+    // logged, so no write to it can be logged ahead of that.
+    auto table = std::make_shared<Table>(tableName, mode);
     for (size_t i = openParen + 1; i < closeParen; ) {
         // Skip commas
         if (tokens[i] == ",") {
@@ -141,31 +590,16 @@ void QueryParser::parseCreateTable(const std::vector<std::string> &tokens) {
             continue;
         }
 
-        if (i + 1 >= closeParen) {
-            throw std::invalid_argument("Incomplete column definition");
-        }
-
-        std::string columnName = tokens[i];
-        std::string columnTypeStr = tokens[i + 1];
-
-        ColumnType columnType;
-        if (columnTypeStr == "INTEGER") {
-            columnType = ColumnType::INT;
-        } else if (columnTypeStr == "FLOAT") {
-            columnType = ColumnType::FLOAT;
-        } else if (columnTypeStr == "STRING") {
-            columnType = ColumnType::STRING;
-        } else if (columnTypeStr == "BOOLEAN") {
-            columnType = ColumnType::BOOLEAN;
-        } else {
-            throw std::invalid_argument("Invalid column type: " + columnTypeStr);
-        }
-
-        Column newColumn(columnName, columnType);
-        db.GetTable(tableName)->addColumn(newColumn);
+        table->addColumn(parseColumnDefinition(tokens, i, closeParen));
+    }
 
-        i += 2; // Move to next column or comma
+    std::shared_lock<std::shared_mutex> catalog = db.lockCatalog();
+    Table::WriteLock write = table->lockForWrite();
+    if (!db.addTable(table)) {
+        throw std::invalid_argument("Table already exists");
     }
+    logStatement(tokens);
+    out << tableName << " created." << std::endl;
 }
 
 void QueryParser::parseDropTable(const std::vector<std::string> &tokens) {
@@ -174,23 +608,31 @@ void QueryParser::parseDropTable(const std::vector<std::string> &tokens) {
         throw std::invalid_argument("Invalid DROP TABLE syntax");
     }
 
+    // Writers still at work on the table finish (and log) first
     std::string tableName = tokens[2];
-    if (db.GetTable(tableName) == nullptr) {
+    std::shared_lock<std::shared_mutex> catalog = db.lockCatalog();
+    std::shared_ptr<Table> table; // declared first: it must outlive the lock
+    std::optional<Table::WriteLock> write;
+    table = lockTable(tableName, write);
+    if (table == nullptr) {
         throw std::invalid_argument("Table does not exist");
     }
 
     db.DropTable(tableName);
-    std::cout << "Table " << tableName << " dropped." << std::endl;
+    logStatement(tokens);
+    out << "Table " << tableName << " dropped." << std::endl;
 }
 
 void QueryParser::parseAlterTable(const std::vector<std::string> &tokens) {
-    // ALTER TABLE tablename ADD/DROP/ALTER columnname datatype
+    // ALTER TABLE tablename ADD columnname datatype [NOT NULL] [DEFAULT literal]
+    // ALTER TABLE tablename DROP COLUMN columnname
     if (tokens.size() < 5) {
         throw std::invalid_argument("Invalid ALTER TABLE syntax");
     }
 
     std::string tableName = tokens[2];
-    Table* table = db.GetTable(tableName);
+    std::optional<Table::WriteLock> write;
+    std::shared_ptr<Table> table = lockTable(tableName, write);
     if (table == nullptr) {
         throw std::invalid_argument("Table does not exist");
     }
@@ -198,59 +640,23 @@ void QueryParser::parseAlterTable(const std::vector<std::string> &tokens) {
     std::string operation = toLower(tokens[3]);
 
     if (operation == "add") {
-        if (tokens.size() != 6) {
+        // Only the schema changes: existing rows read the default (or NULL)
+        // without being rewritten
+        size_t i = 4;
+        Column newColumn = parseColumnDefinition(tokens, i, tokens.size());
+        if (i != tokens.size()) {
             throw std::invalid_argument("Invalid ALTER TABLE ADD syntax");
         }
 
-        std::string colname = tokens[4];
-        std::string coltype = tokens[5];
-
-        ColumnType columnType;
-        if (coltype == "INTEGER") {
-            columnType = ColumnType::INT;
-        } else if (coltype == "FLOAT") {
-            columnType = ColumnType::FLOAT;
-        } else if (coltype == "STRING") {
-            columnType = ColumnType::STRING;
-        } else if (coltype == "BOOLEAN") {
-            columnType = ColumnType::BOOLEAN;
-        } else {
-            throw std::invalid_argument("Invalid column type: " + coltype);
-        }
-
         // Check if column already exists
-        for (const auto& column : table->getColumns()) {
-            if (column.getName() == colname) {
-                throw std::invalid_argument("Column: " + colname + " already exists");
-            }
+        if (table->findColumn(newColumn.getName()) >= 0) {
+            throw std::invalid_argument("Column: " + newColumn.getName() + " already exists");
         }
 
-        Column newColumn(colname, columnType);
-        table->addColumn(newColumn);
-
-        // Add default values to existing rows
-        auto rows = table->getRows();
-        for (size_t i = 0; i < rows.size(); i++) {
-            Row& currentRow = const_cast<Row&>(rows[i]);
-            Value defaultValue;
-            switch (columnType) {
-                case ColumnType::INT:
-                    defaultValue = 0;
-                    break;
-                case ColumnType::FLOAT:
-                    defaultValue = 0.0f;
-                    break;
-                case ColumnType::STRING:
-                    defaultValue = std::string("");
-                    break;
-                case ColumnType::BOOLEAN:
-                    defaultValue = false;
-                    break;
-            }
-            currentRow.addValue(defaultValue);
-        }
+        table->addColumn(newColumn, newColumn.getDefault());
+        logStatement(tokens);
 
-        std::cout << "Column " << colname << " added successfully." << std::endl;
+        out << "Column " << newColumn.getName() << " added successfully." << std::endl;
     }
     else if (operation == "drop") {
         if (tokens.size() != 6 || toLower(tokens[4]) != "column") {
@@ -258,282 +664,1605 @@ void QueryParser::parseAlterTable(const std::vector<std::string> &tokens) {
         }
 
         std::string colname = tokens[5];
-        const auto& cols = table->getColumns();
-        auto it = std::find_if(cols.begin(), cols.end(), [&](const Column& col) {
-            return col.getName() == colname;
-        });
-
-        if (it == cols.end()) {
+        int colIndex = table->findColumn(colname);
+        if (colIndex < 0) {
             throw std::invalid_argument("Column " + colname + " does not exist");
         }
 
-        int colIndex = std::distance(cols.begin(), it);
+        // The column disappears from the schema now; the storage reclaims its
+        // cells later, and the other columns keep their data
+        Column column = table->getColumns()[colIndex];
+        table->dropColumn(column);
+        logStatement(tokens);
 
-        // Remove column from table
-        std::vector<Column> newColumns;
-        for (const auto& col : cols) {
-            if (col.getName() != colname) {
-                newColumns.push_back(col);
-            }
-        }
+        out << "Column " << colname << " dropped successfully." << std::endl;
+    }
+}
 
-        table->clearColumn();
-        for (const auto& col : newColumns) {
-            table->addColumn(col);
-        }
+void QueryParser::parseCreateIndex(const std::vector<std::string> &tokens) {
+    // CREATE INDEX indexname ON tablename ( column ) [USING HASH|BTREE]
+    if ((tokens.size() != 8 && tokens.size() != 10) || toLower(tokens[3]) != "on" ||
+        tokens[5] != "(" || tokens[7] != ")") {
+        throw std::invalid_argument("Invalid CREATE INDEX syntax");
+    }
 
-        // Remove corresponding values from all rows
-        table->dropAllRow(); // This will need to be implemented properly
+    std::string indexName = tokens[2];
+    std::string tableName = tokens[4];
+    std::optional<Table::WriteLock> write;
+    std::shared_ptr<Table> table = lockTable(tableName, write);
+    if (table == nullptr) {
+        throw std::invalid_argument("Table does not exist");
+    }
 
-        std::cout << "Column " << colname << " dropped successfully." << std::endl;
+    IndexType type = IndexType::BTREE;
+    if (tokens.size() == 10) {
+        std::string method = toLower(tokens[9]);
+        if (toLower(tokens[8]) != "using" || (method != "hash" && method != "btree")) {
+            throw std::invalid_argument("Invalid CREATE INDEX syntax: expected USING HASH|BTREE");
+        }
+        type = method == "hash" ? IndexType::HASH : IndexType::BTREE;
     }
-}
 
-void QueryParser::parseInsert(const std::vector<std::string> &tokens) {
-    // INSERT INTO table_name (column1, column2, ...) VALUES (value1, value2, ...)
+    table->createIndex(indexName, tokens[6], type);
+    logStatement(tokens);
+    out << "Index " << indexName << " created." << std::endl;
+}
 
-    if (tokens.size() < 6) {
-        throw std::invalid_argument("Invalid INSERT syntax: Not enough tokens");
+// The scan reads a snapshot, so writers carry on meanwhile; the statistics
+// are installed under the write lock unless the schema changed in between.
+// They are estimates and live in memory only: not logged, not saved.
+void QueryParser::parseAnalyze(const std::vector<std::string>& tokens) {
+    // ANALYZE tablename
+    if (tokens.size() != 2) {
+        throw std::invalid_argument("Invalid ANALYZE syntax");
     }
 
-    if (toLower(tokens[0]) != "insert" || toLower(tokens[1]) != "into") {
-        throw std::invalid_argument("Invalid INSERT syntax: Expected 'INSERT INTO'");
+    std::string tableName = tokens[1];
+    std::shared_ptr<const Table> snapshot = readSnapshot(tableName);
+    std::shared_ptr<TableStatistics> stats = analyzeTable(*snapshot, db.getThreadPool());
+
+    std::optional<Table::WriteLock> write;
+    std::shared_ptr<Table> table = lockTable(tableName, write);
+    if (table == nullptr || table->getSchemaVersion() != snapshot->getSchemaVersion()) {
+        throw std::invalid_argument("Table " + tableName + " changed during ANALYZE");
     }
+    table->setStatistics(stats);
+    out << "Table " << tableName << " analyzed: " << stats->rowCount << " rows, " << stats->sampledRows
+        << " sampled." << std::endl;
+}
 
-    std::string tableName = tokens[2];
-    Table* table = db.GetTable(tableName);
+void QueryParser::parseInsert(const std::vector<std::string> &tokens) {
+    QueryPlan plan;
+    plan.tokens = tokens;
+    compile(plan);
+    executePlan(plan, {});
+}
 
+void QueryParser::parseCopy(const std::vector<std::string>& tokens) {
+    // COPY tablename FROM 'file.csv' [HEADER] [DELIMITER 'c']
+    if (tokens.size() < 4 || toLower(tokens[2]) != "from") {
+        throw std::invalid_argument("Invalid COPY syntax");
+    }
+    std::string tableName = tokens[1];
+    std::shared_ptr<Table> table = db.GetTable(tableName);
     if (table == nullptr) {
         throw std::invalid_argument("Table '" + tableName + "' does not exist");
     }
-
-    // Find the column list and values list
-    size_t columnStart = 0, columnEnd = 0;
-    size_t valuesStart = 0, valuesEnd = 0;
-    bool foundValues = false;
-
-    for (size_t i = 3; i < tokens.size(); i++) {
-        if (tokens[i] == "(" && columnStart == 0) {
-            columnStart = i + 1;
-        } else if (tokens[i] == ")" && columnStart > 0 && columnEnd == 0) {
-            columnEnd = i;
-        } else if (toLower(tokens[i]) == "values") {
-            foundValues = true;
-        } else if (tokens[i] == "(" && foundValues && valuesStart == 0) {
-            valuesStart = i + 1;
-        } else if (tokens[i] == ")" && valuesStart > 0 && valuesEnd == 0) {
-            valuesEnd = i;
-            break;
+    std::string fileName = unquote(tokens[3]);
+
+    CsvOptions options;
+    for (size_t i = 4; i < tokens.size(); i++) {
+        std::string option = toLower(tokens[i]);
+        if (option == "header") {
+            options.header = true;
+        } else if (option == "delimiter" && i + 1 < tokens.size() && unquote(tokens[i + 1]).size() == 1) {
+            options.delimiter = unquote(tokens[++i])[0];
+        } else {
+            throw std::invalid_argument("Invalid COPY option: " + tokens[i]);
         }
     }
 
-    if (columnStart == 0 || columnEnd == 0 || valuesStart == 0 || valuesEnd == 0) {
-        throw std::invalid_argument("Invalid INSERT syntax: Missing parentheses or VALUES keyword");
-    }
+    // The whole file is parsed and checked (NOT NULL included) against the
+    // schema of a snapshot before the table is locked, so a bad record
+    // leaves the table untouched and other writers aren't held up while the
+    // file is read. Readers see the rows once all are in.
+    std::shared_ptr<const Table> schema = table->readSnapshot();
+    std::vector<std::vector<ColumnChunk>> batches = readCsv(fileName, schema->getColumns(), options);
 
-    // Parse column names
-    std::vector<std::string> columnNames;
-    for (size_t i = columnStart; i < columnEnd; i++) {
-        if (tokens[i] != ",") {
-            columnNames.push_back(tokens[i]);
-        }
+    std::optional<Table::WriteLock> write;
+    if (lockTable(tableName, write) != table || table->getSchemaVersion() != schema->getSchemaVersion()) {
+        throw std::invalid_argument("Table '" + tableName + "' changed during COPY");
     }
-
-    // Parse values
-    std::vector<std::string> valueStrings;
-    for (size_t i = valuesStart; i < valuesEnd; i++) {
-        if (tokens[i] != ",") {
-            std::string value = tokens[i];
-            // Remove quotes if present
-            if (value.size() >= 2 && value.front() == '\'' && value.back() == '\'') {
-                value = value.substr(1, value.size() - 2);
-            }
-            valueStrings.push_back(value);
+    size_t loaded = 0;
+    WriteAheadLog* log = db.getLog();
+    for (auto& batch : batches) {
+        loaded += batch.empty() ? 0 : batch[0].size();
+        // Encoded first, since appending takes the chunks over; logged once
+        // the batch is in, so the log never holds a batch that failed
+        std::string record = log ? WriteAheadLog::encodeChunks(tableName, batch) : std::string();
+        table->appendChunks(batch);
+        if (log) {
+            log->append(WalRecordType::CHUNKS, record);
         }
     }
+    out << loaded << " rows copied into " << tableName << "." << std::endl;
+}
 
-    if (columnNames.size() != valueStrings.size()) {
-        throw std::invalid_argument("Column count (" + std::to_string(columnNames.size()) +
-                                   ") does not match value count (" + std::to_string(valueStrings.size()) + ")");
+void QueryParser::parseDelete(const std::vector<std::string>& tokens) {
+    // DELETE FROM tablename [WHERE condition]
+    if (tokens.size() < 3 || toLower(tokens[1]) != "from" || (tokens.size() > 3 && toLower(tokens[3]) != "where")) {
+        throw std::invalid_argument("Invalid DELETE syntax");
     }
-
-    // Create a map of column names to indices
-    const auto& tableColumns = table->getColumns();
-    std::unordered_map<std::string, size_t> columnIndexMap;
-    for (size_t i = 0; i < tableColumns.size(); i++) {
-        columnIndexMap[tableColumns[i].getName()] = i;
+    std::optional<Table::WriteLock> write;
+    std::shared_ptr<Table> table = lockTable(tokens[2], write);
+    if (table == nullptr) {
+        throw std::invalid_argument("Table does not exist");
+    }
+    std::unique_ptr<Predicate> predicate;
+    if (tokens.size() > 3) {
+        predicate = parseWhereQuery(*table, tokens, 4, tokens.size());
     }
+    std::vector<size_t> rows;
+    Filter(*table, std::move(predicate)).forEachMatch([&](size_t r) { rows.push_back(r); });
+    table->deleteRows(rows);
+    logStatement(tokens);
+    bool compact = table->needsCompaction();
+    write.reset();
+    if (compact) {
+        db.scheduleCompaction(table);
+    }
+    if (rows.size() == 1) {
+        out << "1 row deleted." << std::endl;
+    } else {
+        out << rows.size() << " rows deleted." << std::endl;
+    }
+}
 
-    // Create row with default values
-    std::vector<Value> rowValues(tableColumns.size());
-    for (size_t i = 0; i < tableColumns.size(); i++) {
-        switch (tableColumns[i].getType()) {
-            case ColumnType::INT:
-                rowValues[i] = 0;
-                break;
-            case ColumnType::FLOAT:
-                rowValues[i] = 0.0f;
-                break;
-            case ColumnType::STRING:
-                rowValues[i] = std::string("");
-                break;
-            case ColumnType::BOOLEAN:
-                rowValues[i] = false;
-                break;
+void QueryParser::parseUpdate(const std::vector<std::string>& tokens) {
+    // UPDATE tablename SET col1 = value1 [, col2 = value2 ...] [WHERE condition]
+    if (tokens.size() < 6 || toLower(tokens[2]) != "set") {
+        throw std::invalid_argument("Invalid UPDATE syntax");
+    }
+    std::optional<Table::WriteLock> write;
+    std::shared_ptr<Table> table = lockTable(tokens[1], write);
+    if (table == nullptr) {
+        throw std::invalid_argument("Table does not exist");
+    }
+    const auto& columns = table->getColumns();
+    size_t where = tokens.size();
+    for (size_t i = 3; i < tokens.size(); i++) {
+        if (toLower(tokens[i]) == "where") {
+            where = i;
+            break;
         }
     }
 
-    // Set specified values
-    for (size_t i = 0; i < columnNames.size(); i++) {
-        auto it = columnIndexMap.find(columnNames[i]);
-        if (it == columnIndexMap.end()) {
-            throw std::invalid_argument("Column '" + columnNames[i] + "' does not exist");
+    // Every assignment is checked before any row changes
+    std::vector<std::pair<int, Value>> assignments;
+    for (size_t i = 3; i < where; i += 4) {
+        if (i + 2 >= where || tokens[i + 1] != "=" || (i + 3 < where && (tokens[i + 3] != "," || i + 4 >= where))) {
+            throw std::invalid_argument("Invalid UPDATE syntax: expected col = value, ...");
         }
-
-        size_t colIndex = it->second;
-        ColumnType colType = tableColumns[colIndex].getType();
-        std::string valueStr = valueStrings[i];
-
-        try {
-            switch (colType) {
-                case ColumnType::INT:
-                    rowValues[colIndex] = std::stoi(valueStr);
-                    break;
-                case ColumnType::FLOAT:
-                    rowValues[colIndex] = std::stof(valueStr);
-                    break;
-                case ColumnType::STRING:
-                    rowValues[colIndex] = valueStr;
-                    break;
-                case ColumnType::BOOLEAN:
-                    rowValues[colIndex] = (toLower(valueStr) == "true");
-                    break;
-            }
-        } catch (const std::exception& e) {
-            throw std::invalid_argument("Error converting value '" + valueStr + "': " + e.what());
+        int col = table->findColumn(tokens[i]);
+        if (col < 0) {
+            throw std::invalid_argument("Column '" + tokens[i] + "' does not exist");
+        }
+        Value value = parseLiteral(tokens[i + 2], columns[col].getType());
+        if (isNull(value) && !columns[col].isNullable()) {
+            throw std::invalid_argument("Column " + columns[col].getName() + " can't be NULL");
         }
+        assignments.emplace_back(col, std::move(value));
     }
-
-    // Create and add row
-    Row newRow;
-    for (const auto& value : rowValues) {
-        newRow.addValue(value);
+    if (assignments.empty()) {
+        throw std::invalid_argument("Invalid UPDATE syntax: expected col = value, ...");
     }
 
-    table->addRow(newRow);
-    std::cout << "1 row inserted." << std::endl;
+    std::unique_ptr<Predicate> predicate;
+    if (where < tokens.size()) {
+        predicate = parseWhereQuery(*table, tokens, where + 1, tokens.size());
+    }
+    // Matches are collected first, so assignments can't change which rows
+    // match. Rows are updated in place and keep their positions.
+    std::vector<size_t> rows;
+    Filter(*table, std::move(predicate)).forEachMatch([&](size_t r) { rows.push_back(r); });
+    std::vector<Row> updated;
+    updated.reserve(rows.size());
+    for (size_t r : rows) {
+        updated.push_back(table->getRow(r));
+        for (const auto& [col, value] : assignments) {
+            updated.back().updateValue(col, value);
+        }
+    }
+    table->updateRows(rows, updated);
+    logStatement(tokens);
+    if (rows.size() == 1) {
+        out << "1 row updated." << std::endl;
+    } else {
+        out << rows.size() << " rows updated." << std::endl;
+    }
 }
 
 void QueryParser::parseSelectQuery(const std::vector<std::string>& tokens) {
-    if (tokens.size() < 4) {
-        std::cout << "Invalid SELECT statement" << std::endl;
-        return;
-    }
+    QueryPlan plan;
+    plan.tokens = tokens;
+    compile(plan);
+    executePlan(plan, {});
+}
 
-    // Find FROM keyword
-    size_t fromPos = 0;
-    for (size_t i = 1; i < tokens.size(); i++) {
-        if (toLower(tokens[i]) == "from") {
-            fromPos = i;
-            break;
-        }
+// The plan is compiled afresh, not taken from the plan cache, so EXPLAIN
+// shows what the SELECT would run right now
+void QueryParser::parseExplain(const std::vector<std::string>& tokens) {
+    size_t start = tokens.size() > 1 && toLower(tokens[1]) == "analyze" ? 2 : 1;
+    if (tokens.size() <= start || toLower(tokens[start]) != "select") {
+        throw std::invalid_argument("EXPLAIN supports SELECT statements only");
     }
-
-    if (fromPos == 0 || fromPos >= tokens.size() - 1) {
-        std::cout << "Invalid SELECT statement: missing FROM clause" << std::endl;
-        return;
+    QueryPlan plan;
+    plan.tokens.assign(tokens.begin() + static_cast<std::ptrdiff_t>(start), tokens.end());
+    compile(plan);
+
+    Explain profile;
+    profile.analyze = start == 2;
+    size_t workers = db.getThreadPool().getThreadCount();
+    profile.scan.workers.resize(workers);
+    profile.build.workers.resize(workers);
+    explain = &profile;
+    sink.setDiscarding(true);
+    auto begin = std::chrono::steady_clock::now();
+    try {
+        executePlan(plan, {});
+    } catch (...) {
+        explain = nullptr;
+        sink.setDiscarding(false);
+        throw;
     }
+    uint64_t total = nanosSince(begin);
+    explain = nullptr;
+    sink.setDiscarding(false);
+    printPlan(out, profile, total);
+}
 
-    std::string tableName = tokens[fromPos + 1];
-    Table* table = db.GetTable(tableName);
-    if (!table) {
-        std::cout << "Table " << tableName << " does not exist" << std::endl;
-        return;
+void QueryParser::parsePrepare(const std::vector<std::string>& tokens) {
+    // PREPARE name AS statement
+    if (tokens.size() < 4 || toLower(tokens[2]) != "as") {
+        throw std::invalid_argument("Invalid PREPARE syntax");
     }
+    std::string name = tokens[1];
+    if (prepared.count(name)) {
+        throw std::invalid_argument("Prepared statement " + name + " already exists");
+    }
+    auto plan = std::make_shared<QueryPlan>();
+    plan->tokens.assign(tokens.begin() + 3, tokens.end());
+    compile(*plan);
+    out << "Statement " << name << " prepared (" << plan->params.size() << " parameters)." << std::endl;
+    prepared.emplace(name, std::move(plan));
+}
 
-    // Parse column list
-    std::vector<std::string> selectedColumns;
-    const auto& tableColumns = table->getColumns();
+void QueryParser::parseExecute(const std::vector<std::string>& tokens) {
+    // EXECUTE name [( value1, value2, ... )]
+    if (tokens.size() < 2) {
+        throw std::invalid_argument("Invalid EXECUTE syntax");
+    }
+    auto it = prepared.find(tokens[1]);
+    if (it == prepared.end()) {
+        throw std::invalid_argument("Prepared statement " + tokens[1] + " does not exist");
+    }
+    QueryPlan& plan = *it->second;
 
-    if (tokens[1] == "*") {
-        // Select all columns
-        for (const auto& col : tableColumns) {
-            selectedColumns.push_back(col.getName());
+    std::vector<std::string> args;
+    if (tokens.size() > 2) {
+        if (tokens[2] != "(" || tokens.back() != ")") {
+            throw std::invalid_argument("Invalid EXECUTE syntax: expected ( value, ... )");
         }
-    } else {
-        // Parse specific columns
-        for (size_t i = 1; i < fromPos; i++) {
+        for (size_t i = 3; i + 1 < tokens.size(); i++) {
             if (tokens[i] != ",") {
-                selectedColumns.push_back(tokens[i]);
+                args.push_back(tokens[i]);
             }
         }
     }
 
-    if (selectedColumns.empty()) {
-        std::cout << "No columns specified" << std::endl;
-        return;
-    }
-
-    // Get column indices
-    std::vector<int> colIndices;
-    for (const auto& colName : selectedColumns) {
-        bool found = false;
-        for (size_t i = 0; i < tableColumns.size(); i++) {
-            if (tableColumns[i].getName() == colName) {
-                colIndices.push_back(static_cast<int>(i));
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            std::cout << "Column \"" << colName << "\" does not exist" << std::endl;
-            return;
-        }
+    // Parameter types come from the current schema, so bring the plan up to
+    // date first
+    if (plan.kind == PlanKind::INSERT) {
+        std::optional<Table::WriteLock> write;
+        lockForInsert(plan, write);
+    } else {
+        readSnapshots(plan);
     }
-
-    // Print header
-    for (size_t i = 0; i < selectedColumns.size(); i++) {
-        std::cout << selectedColumns[i];
-        if (i < selectedColumns.size() - 1) {
-            std::cout << " | ";
-        }
+    if (args.size() != plan.params.size()) {
+        throw std::invalid_argument("Expected " + std::to_string(plan.params.size()) + " parameters, got " +
+                                    std::to_string(args.size()));
     }
-    std::cout << std::endl;
-
-    // Print separator
-    for (size_t i = 0; i < selectedColumns.size(); i++) {
-        for (size_t j = 0; j < selectedColumns[i].size(); j++) {
-            std::cout << "-";
-        }
-        if (i < selectedColumns.size() - 1) {
-            std::cout << "-+-";
-        }
+    std::vector<Value> params;
+    params.reserve(args.size());
+    for (size_t i = 0; i < args.size(); i++) {
+        params.push_back(parseLiteral(args[i], plan.params[i].type));
     }
-    std::cout << std::endl;
+    executePlan(plan, params);
+}
 
-    // Print rows
-    const auto& rows = table->getRows();
-    for (const auto& row : rows) {
-        const auto& values = row.getValues();
-        for (size_t i = 0; i < colIndices.size(); i++) {
-            int idx = colIndices[i];
-            if (idx >= 0 && idx < static_cast<int>(values.size())) {
-                const Value& val = values[idx];
-                std::visit([](const auto& v) {
-                    std::cout << v;
-                }, val);
-            }
-            if (i < colIndices.size() - 1) {
-                std::cout << " | ";
-            }
-        }
-        std::cout << std::endl;
+void QueryParser::parseDeallocate(const std::vector<std::string>& tokens) {
+    // DEALLOCATE name
+    if (tokens.size() != 2) {
+        throw std::invalid_argument("Invalid DEALLOCATE syntax");
     }
+    deallocate(tokens[1]);
+    out << "Statement " << tokens[1] << " deallocated." << std::endl;
 }
 
-void QueryParser::parseWhereQuery(const std::vector<std::string> &tokens) {
-    // This function would need to be integrated with parseSelectQuery
-    // for a complete WHERE clause implementation
-    // For now, it's a placeholder for future enhancement
-    std::cout << "WHERE clause parsing not yet implemented in this version" << std::endl;
-}
\ No newline at end of file
+void QueryParser::prepare(const std::string& name, const std::string& query) {
+    std::vector<std::string> tokens = tokenizeQuery(query);
+    tokens.insert(tokens.begin(), {"PREPARE", name, "AS"});
+    parsePrepare(tokens);
+}
+
+void QueryParser::execute(const std::string& name, const std::vector<Value>& params) {
+    auto it = prepared.find(name);
+    if (it == prepared.end()) {
+        throw std::invalid_argument("Prepared statement " + name + " does not exist");
+    }
+    executePlan(*it->second, params);
+}
+
+void QueryParser::deallocate(const std::string& name) {
+    if (prepared.erase(name) == 0) {
+        throw std::invalid_argument("Prepared statement " + name + " does not exist");
+    }
+}
+
+PlanCache& QueryParser::getPlanCache() {
+    return plans;
+}
+
+void QueryParser::setOutputFormat(OutputFormat format) {
+    sink.setFormat(format);
+}
+
+OutputFormat QueryParser::getOutputFormat() const {
+    return sink.getFormat();
+}
+
+// (Re)builds a plan from its tokens against the current schema
+void QueryParser::compile(QueryPlan& plan) {
+    if (plan.tokens.empty()) {
+        throw std::invalid_argument("Empty query");
+    }
+    plan.params.clear();
+    plan.rows.clear();
+    plan.columnNames.clear();
+    plan.columnIndices.clear();
+    plan.predicate.reset();
+    plan.aggregated = false;
+    plan.groupColumns.clear();
+    plan.aggregates.clear();
+    plan.outputs.clear();
+    plan.orderBy.clear();
+    plan.limit = QueryPlan::kNoLimit;
+    plan.offset = 0;
+    plan.schemaVersion = 0;
+    plan.joined = false;
+    plan.joinType = JoinType::INNER;
+    plan.joinTableName.clear();
+    plan.joinSchemaVersion = 0;
+    plan.leftKey = -1;
+    plan.rightKey = -1;
+    plan.joinPredicate.reset();
+
+    std::string command = toLower(plan.tokens[0]);
+    if (command == "insert") {
+        compileInsert(plan);
+    } else if (command == "select") {
+        compileSelect(plan);
+    } else {
+        throw std::invalid_argument("Only INSERT and SELECT statements can be prepared");
+    }
+}
+
+void QueryParser::compileInsert(QueryPlan& plan) {
+    // INSERT INTO table_name (column1, column2, ...) VALUES (value1, value2, ...)
+    const std::vector<std::string>& tokens = plan.tokens;
+
+    if (tokens.size() < 6) {
+        throw std::invalid_argument("Invalid INSERT syntax: Not enough tokens");
+    }
+
+    if (toLower(tokens[0]) != "insert" || toLower(tokens[1]) != "into") {
+        throw std::invalid_argument("Invalid INSERT syntax: Expected 'INSERT INTO'");
+    }
+
+    // The schema is read under the write lock, so a concurrent ALTER can't
+    // change it halfway through
+    std::string tableName = tokens[2];
+    std::optional<Table::WriteLock> write;
+    std::shared_ptr<Table> table = lockTable(tableName, write);
+
+    if (table == nullptr) {
+        throw std::invalid_argument("Table '" + tableName + "' does not exist");
+    }
+
+    // Column list, then VALUES and one or more ( ... ) tuples
+    if (tokens[3] != "(") {
+        throw std::invalid_argument("Invalid INSERT syntax: Missing column list");
+    }
+    std::vector<int> columnIndices;
+    size_t i = 4;
+    for (; i < tokens.size() && tokens[i] != ")"; i++) {
+        if (tokens[i] == ",") {
+            continue;
+        }
+        int colIndex = table->findColumn(tokens[i]);
+        if (colIndex < 0) {
+            throw std::invalid_argument("Column '" + tokens[i] + "' does not exist");
+        }
+        columnIndices.push_back(colIndex);
+    }
+    if (i + 2 >= tokens.size() || toLower(tokens[i + 1]) != "values") {
+        throw std::invalid_argument("Invalid INSERT syntax: Missing parentheses or VALUES keyword");
+    }
+    i += 2;
+
+    const auto& tableColumns = table->getColumns();
+    // Columns left out of the list take their DEFAULT, or NULL, which NOT
+    // NULL ones can't be
+    std::vector<Value> defaults;
+    for (size_t c = 0; c < tableColumns.size(); c++) {
+        defaults.push_back(tableColumns[c].getDefault());
+        if (!tableColumns[c].isNullable() && !tableColumns[c].hasDefault() &&
+            std::find(columnIndices.begin(), columnIndices.end(), static_cast<int>(c)) == columnIndices.end()) {
+            throw std::invalid_argument("Column '" + tableColumns[c].getName() + "' is NOT NULL and needs a value");
+        }
+    }
+
+    std::vector<std::pair<size_t, size_t>> placeholders; // (row, column) of each `?`, in order
+    std::vector<std::vector<Value>> rowValues;
+    while (true) {
+        if (i >= tokens.size() || tokens[i] != "(") {
+            throw std::invalid_argument("Invalid INSERT syntax: Missing parentheses or VALUES keyword");
+        }
+        i++;
+        // Start from a row of defaults and fill in the listed columns
+        std::vector<Value> values = defaults;
+        size_t count = 0;
+        for (; i < tokens.size() && tokens[i] != ")"; i++) {
+            if (tokens[i] == ",") {
+                continue;
+            }
+            if (count >= columnIndices.size()) {
+                throw std::invalid_argument("Column count (" + std::to_string(columnIndices.size()) +
+                                            ") does not match value count");
+            }
+            int colIndex = columnIndices[count++];
+            if (tokens[i] == "?") {
+                placeholders.emplace_back(rowValues.size(), colIndex);
+            } else {
+                values[colIndex] = parseLiteral(tokens[i], tableColumns[colIndex].getType());
+            }
+        }
+        if (i >= tokens.size()) {
+            throw std::invalid_argument("Invalid INSERT syntax: Missing parentheses or VALUES keyword");
+        }
+        if (count != columnIndices.size()) {
+            throw std::invalid_argument("Column count (" + std::to_string(columnIndices.size()) +
+                                       ") does not match value count (" + std::to_string(count) + ")");
+        }
+        rowValues.push_back(std::move(values));
+        i++;
+        if (i < tokens.size() && tokens[i] == ",") {
+            i++;
+            continue;
+        }
+        if (i != tokens.size()) {
+            throw std::invalid_argument("Invalid INSERT syntax near '" + tokens[i] + "'");
+        }
+        break;
+    }
+
+    plan.rows.resize(rowValues.size());
+    for (size_t r = 0; r < rowValues.size(); r++) {
+        for (auto& value : rowValues[r]) {
+            plan.rows[r].addValue(value);
+        }
+    }
+    for (const auto& [r, col] : placeholders) {
+        plan.params.push_back({tableColumns[col].getType(), &plan.rows[r].getValue(static_cast<int>(col))});
+    }
+    plan.kind = PlanKind::INSERT;
+    plan.tableName = tableName;
+    plan.schemaVersion = table->getSchemaVersion();
+}
+
+void QueryParser::compileSelect(QueryPlan& plan) {
+    const std::vector<std::string>& tokens = plan.tokens;
+
+    if (tokens.size() < 4) {
+        throw std::invalid_argument("Invalid SELECT statement");
+    }
+
+    // Find FROM keyword
+    size_t fromPos = 0;
+    for (size_t i = 1; i < tokens.size(); i++) {
+        if (toLower(tokens[i]) == "from") {
+            fromPos = i;
+            break;
+        }
+    }
+
+    if (fromPos == 0 || fromPos >= tokens.size() - 1) {
+        throw std::invalid_argument("Invalid SELECT statement: missing FROM clause");
+    }
+
+    for (size_t i = fromPos + 2; i < tokens.size() && toLower(tokens[i]) != "where"; i++) {
+        if (toLower(tokens[i]) == "join") {
+            compileJoin(plan, fromPos);
+            return;
+        }
+    }
+
+    std::string tableName = tokens[fromPos + 1];
+    std::shared_ptr<const Table> table = readSnapshot(tableName);
+
+    // Clauses after the table name, in order: WHERE, GROUP BY, ORDER BY,
+    // LIMIT [OFFSET]
+    size_t groupPos = tokens.size(), orderPos = tokens.size(), limitPos = tokens.size();
+    for (size_t i = fromPos + 2; i < tokens.size(); i++) {
+        std::string word = toLower(tokens[i]);
+        bool by = i + 1 < tokens.size() && toLower(tokens[i + 1]) == "by";
+        if (word == "group" && by && groupPos == tokens.size()) {
+            groupPos = i;
+        } else if (word == "order" && by && orderPos == tokens.size()) {
+            orderPos = i;
+        } else if (word == "limit" && limitPos == tokens.size()) {
+            limitPos = i;
+        }
+    }
+    if ((orderPos < groupPos && groupPos < tokens.size()) || (limitPos < orderPos && orderPos < tokens.size()) ||
+        (limitPos < groupPos && groupPos < tokens.size())) {
+        throw std::invalid_argument("Invalid SELECT statement: clauses must come as WHERE, GROUP BY, ORDER BY, LIMIT");
+    }
+    size_t groupEnd = std::min(orderPos, limitPos);
+    size_t whereEnd = std::min(groupPos, groupEnd);
+    if (fromPos + 2 < whereEnd) {
+        if (toLower(tokens[fromPos + 2]) != "where") {
+            throw std::invalid_argument("Invalid SELECT statement near '" + tokens[fromPos + 2] + "'");
+        }
+        plan.predicate = parseWhereQuery(*table, tokens, fromPos + 3, whereEnd, &plan.params);
+    }
+    std::vector<int> groupColumns;
+    if (groupPos < tokens.size()) {
+        for (size_t i = groupPos + 2; i < groupEnd; i++) {
+            if (tokens[i] == ",") {
+                continue;
+            }
+            int idx = table->findColumn(tokens[i]);
+            if (idx < 0) {
+                throw std::invalid_argument("Column \"" + tokens[i] + "\" does not exist");
+            }
+            groupColumns.push_back(idx);
+        }
+        if (groupColumns.empty()) {
+            throw std::invalid_argument("Invalid GROUP BY clause");
+        }
+    }
+    if (orderPos < tokens.size()) {
+        // ORDER BY col [ASC | DESC], ...
+        for (size_t i = orderPos + 2; i < limitPos; i++) {
+            SortKey key{table->findColumn(tokens[i])};
+            if (key.column < 0) {
+                throw std::invalid_argument("Column \"" + tokens[i] + "\" does not exist");
+            }
+            if (i + 1 < limitPos && (toLower(tokens[i + 1]) == "asc" || toLower(tokens[i + 1]) == "desc")) {
+                key.descending = toLower(tokens[++i]) == "desc";
+            }
+            plan.orderBy.push_back(key);
+            if (i + 1 < limitPos && (tokens[i + 1] != "," || i + 2 == limitPos)) {
+                throw std::invalid_argument("Invalid ORDER BY clause near '" + tokens[i + 1] + "'");
+            }
+            i++;
+        }
+        if (plan.orderBy.empty()) {
+            throw std::invalid_argument("Invalid ORDER BY clause");
+        }
+    }
+    if (limitPos < tokens.size()) {
+        // LIMIT n [OFFSET m]
+        if (limitPos + 2 != tokens.size() &&
+            (limitPos + 4 != tokens.size() || toLower(tokens[limitPos + 2]) != "offset")) {
+            throw std::invalid_argument("Invalid LIMIT clause: expected LIMIT n [OFFSET m]");
+        }
+        plan.limit = parseCount(tokens[limitPos + 1]);
+        if (limitPos + 4 == tokens.size()) {
+            plan.offset = parseCount(tokens[limitPos + 3]);
+        }
+    }
+
+    // Select list: *, columns and aggregate calls such as COUNT(*) or SUM(col)
+    const auto& tableColumns = table->getColumns();
+    std::vector<std::string> selectedColumns;
+    std::vector<int> colIndices;
+    std::vector<AggregateSpec> aggregates;
+    std::vector<OutputColumn> outputs;
+    bool star = false;
+    for (size_t i = 1; i < fromPos; i++) {
+        if (tokens[i] == ",") {
+            continue;
+        }
+        if (tokens[i] == "*") {
+            star = true;
+            for (size_t c = 0; c < tableColumns.size(); c++) {
+                selectedColumns.push_back(tableColumns[c].getName());
+                colIndices.push_back(static_cast<int>(c));
+            }
+            continue;
+        }
+        if (i + 1 < fromPos && tokens[i + 1] == "(") {
+            if (i + 3 >= fromPos || tokens[i + 3] != ")") {
+                throw std::invalid_argument("Invalid aggregate call near '" + tokens[i] + "'");
+            }
+            std::string name = toLower(tokens[i]);
+            const std::string& arg = tokens[i + 2];
+            AggregateSpec spec;
+            if (name == "count") {
+                spec.function = AggregateFunction::COUNT;
+            } else if (name == "sum") {
+                spec.function = AggregateFunction::SUM;
+            } else if (name == "avg") {
+                spec.function = AggregateFunction::AVG;
+            } else if (name == "min") {
+                spec.function = AggregateFunction::MIN;
+            } else if (name == "max") {
+                spec.function = AggregateFunction::MAX;
+            } else {
+                throw std::invalid_argument("Unknown function: " + tokens[i]);
+            }
+            if (arg == "*") {
+                if (spec.function != AggregateFunction::COUNT) {
+                    throw std::invalid_argument("Only COUNT accepts *");
+                }
+            } else {
+                spec.column = table->findColumn(arg);
+                if (spec.column < 0) {
+                    throw std::invalid_argument("Column \"" + arg + "\" does not exist");
+                }
+                spec.type = tableColumns[spec.column].getType();
+                bool numeric = spec.type == ColumnType::INT || spec.type == ColumnType::FLOAT;
+                if (!numeric && (spec.function == AggregateFunction::SUM || spec.function == AggregateFunction::AVG)) {
+                    throw std::invalid_argument(tokens[i] + " needs an INTEGER or FLOAT column");
+                }
+            }
+            std::string label = name;
+            std::transform(label.begin(), label.end(), label.begin(), ::toupper);
+            selectedColumns.push_back(label + "(" + arg + ")");
+            outputs.push_back({true, aggregates.size()});
+            aggregates.push_back(spec);
+            i += 3;
+            continue;
+        }
+        int idx = table->findColumn(tokens[i]);
+        if (idx < 0) {
+            throw std::invalid_argument("Column \"" + tokens[i] + "\" does not exist");
+        }
+        selectedColumns.push_back(tokens[i]);
+        colIndices.push_back(idx);
+    }
+
+    if (selectedColumns.empty()) {
+        throw std::invalid_argument("No columns specified");
+    }
+
+    plan.aggregated = !aggregates.empty() || !groupColumns.empty();
+    if (plan.aggregated) {
+        if (star) {
+            throw std::invalid_argument("SELECT * cannot be combined with aggregates or GROUP BY");
+        }
+        if (!plan.orderBy.empty()) {
+            throw std::invalid_argument("ORDER BY cannot be combined with aggregates or GROUP BY");
+        }
+        // Plain columns must be grouped on; rebuild outputs in select-list order
+        std::vector<OutputColumn> ordered;
+        size_t nextAggregate = 0, nextColumn = 0;
+        for (size_t i = 1; i < fromPos; i++) {
+            if (tokens[i] == ",") {
+                continue;
+            }
+            if (i + 1 < fromPos && tokens[i + 1] == "(") {
+                ordered.push_back(outputs[nextAggregate++]);
+                i += 3;
+                continue;
+            }
+            int idx = colIndices[nextColumn++];
+            auto it = std::find(groupColumns.begin(), groupColumns.end(), idx);
+            if (it == groupColumns.end()) {
+                throw std::invalid_argument("Column \"" + tokens[i] + "\" must appear in GROUP BY or an aggregate");
+            }
+            ordered.push_back({false, static_cast<size_t>(it - groupColumns.begin())});
+        }
+        plan.outputs = std::move(ordered);
+        plan.groupColumns = std::move(groupColumns);
+        plan.aggregates = std::move(aggregates);
+    }
+
+    plan.kind = PlanKind::SELECT;
+    plan.tableName = tableName;
+    plan.columnNames = std::move(selectedColumns);
+    plan.columnIndices = std::move(colIndices);
+    plan.schemaVersion = table->getSchemaVersion();
+}
+
+// SELECT ... FROM a [alias] [INNER | LEFT [OUTER]] JOIN b [alias] ON x = y [WHERE ...]
+// Column names may be qualified with a table name or alias. The WHERE
+// clause is split into its top-level AND terms, each of which filters the
+// input whose columns it uses before the join.
+void QueryParser::compileJoin(QueryPlan& plan, size_t fromPos) {
+    const std::vector<std::string>& tokens = plan.tokens;
+    size_t pos = fromPos + 1;
+    for (size_t i = pos; i < tokens.size(); i++) {
+        std::string word = toLower(tokens[i]);
+        if (word == "limit" || (word == "order" && i + 1 < tokens.size() && toLower(tokens[i + 1]) == "by")) {
+            throw std::invalid_argument("ORDER BY and LIMIT are not supported with JOIN");
+        }
+    }
+
+    auto isKeyword = [](const std::string& token) {
+        static const char* const keywords[] = {"inner", "left", "outer", "join", "on", "where", "group", "as"};
+        std::string lower = toLower(token);
+        return std::any_of(std::begin(keywords), std::end(keywords), [&](const char* k) { return lower == k; });
+    };
+    // Table name and optional [AS] alias
+    auto readTable = [&](std::string& name, std::string& qualifier) {
+        if (pos >= tokens.size()) {
+            throw std::invalid_argument("Invalid JOIN: missing table name");
+        }
+        name = tokens[pos++];
+        std::shared_ptr<const Table> table = readSnapshot(name);
+        qualifier = name;
+        bool as = pos < tokens.size() && toLower(tokens[pos]) == "as";
+        if (as) {
+            pos++;
+        }
+        if (pos < tokens.size() && !isKeyword(tokens[pos])) {
+            qualifier = tokens[pos++];
+        } else if (as) {
+            throw std::invalid_argument("Invalid JOIN: missing alias after AS");
+        }
+        return table;
+    };
+
+    std::string leftName, leftQualifier, rightName, rightQualifier;
+    std::shared_ptr<const Table> left = readTable(leftName, leftQualifier);
+    JoinType joinType = JoinType::INNER;
+    if (pos < tokens.size() && toLower(tokens[pos]) == "inner") {
+        pos++;
+    } else if (pos < tokens.size() && toLower(tokens[pos]) == "left") {
+        joinType = JoinType::LEFT;
+        pos++;
+        if (pos < tokens.size() && toLower(tokens[pos]) == "outer") {
+            pos++;
+        }
+    }
+    if (pos >= tokens.size() || toLower(tokens[pos]) != "join") {
+        throw std::invalid_argument("Invalid JOIN: expected 'JOIN'");
+    }
+    pos++;
+    std::shared_ptr<const Table> right = readTable(rightName, rightQualifier);
+    if (leftQualifier == rightQualifier) {
+        throw std::invalid_argument("Table " + leftQualifier + " is joined with itself; give it an alias");
+    }
+
+    // Column references resolve to left columns first, then right columns
+    const auto& leftColumns = left->getColumns();
+    const auto& rightColumns = right->getColumns();
+    int leftWidth = static_cast<int>(leftColumns.size());
+    auto resolve = [&](const std::string& name) {
+        size_t dot = name.find('.');
+        if (dot != std::string::npos) {
+            std::string qualifier = name.substr(0, dot);
+            std::string column = name.substr(dot + 1);
+            int idx = -1;
+            if (qualifier == leftQualifier) {
+                idx = left->findColumn(column);
+            } else if (qualifier == rightQualifier && (idx = right->findColumn(column)) >= 0) {
+                idx += leftWidth;
+            }
+            if (idx < 0) {
+                throw std::invalid_argument("Column \"" + name + "\" does not exist");
+            }
+            return idx;
+        }
+        int l = left->findColumn(name);
+        int r = right->findColumn(name);
+        if (l >= 0 && r >= 0) {
+            throw std::invalid_argument("Column reference \"" + name + "\" is ambiguous");
+        }
+        if (l < 0 && r < 0) {
+            throw std::invalid_argument("Column \"" + name + "\" does not exist");
+        }
+        return l >= 0 ? l : r + leftWidth;
+    };
+    auto typeOf = [&](int idx) {
+        return idx < leftWidth ? leftColumns[idx].getType() : rightColumns[idx - leftWidth].getType();
+    };
+
+    // ON x = y, one column from each table
+    if (pos + 3 >= tokens.size() || toLower(tokens[pos]) != "on" || tokens[pos + 2] != "=") {
+        throw std::invalid_argument("Invalid JOIN: expected 'ON column = column'");
+    }
+    int lhs = resolve(tokens[pos + 1]);
+    int rhs = resolve(tokens[pos + 3]);
+    if (lhs >= leftWidth) {
+        std::swap(lhs, rhs);
+    }
+    if (lhs >= leftWidth || rhs < leftWidth) {
+        throw std::invalid_argument("Join condition must compare a column of each table");
+    }
+    if (typeOf(lhs) != typeOf(rhs)) {
+        throw std::invalid_argument("Join columns " + tokens[pos + 1] + " and " + tokens[pos + 3] +
+                                    " have different types");
+    }
+    pos += 4;
+
+    std::vector<std::unique_ptr<Predicate>> leftTerms, rightTerms;
+    if (pos < tokens.size()) {
+        if (toLower(tokens[pos]) != "where") {
+            if (toLower(tokens[pos]) == "group") {
+                throw std::invalid_argument("GROUP BY is not supported on joins");
+            }
+            throw std::invalid_argument("Invalid SELECT statement near '" + tokens[pos] + "'");
+        }
+        pos++;
+        if (pos >= tokens.size()) {
+            throw std::invalid_argument("Invalid WHERE clause: missing condition");
+        }
+        // Split at AND outside parentheses, skipping the AND of BETWEEN
+        size_t depth = 0;
+        bool between = false;
+        size_t start = pos;
+        for (size_t i = pos; i <= tokens.size(); i++) {
+            if (i < tokens.size()) {
+                std::string token = toLower(tokens[i]);
+                if (token == "(") {
+                    depth++;
+                } else if (token == ")" && depth > 0) {
+                    depth--;
+                } else if (token == "between") {
+                    between = true;
+                } else if (token == "and" && between) {
+                    between = false;
+                    continue;
+                }
+                if (token != "and" || depth > 0) {
+                    continue;
+                }
+            }
+            size_t first = start;
+            while (first < i && (tokens[first] == "(" || toLower(tokens[first]) == "not")) {
+                first++;
+            }
+            if (first >= i) {
+                throw std::invalid_argument("Invalid WHERE clause: missing condition");
+            }
+            bool onLeft = resolve(tokens[first]) < leftWidth;
+            auto term = parseWhereQuery(onLeft ? *left : *right, tokens, start, i, &plan.params,
+                                        onLeft ? leftQualifier : rightQualifier);
+            (onLeft ? leftTerms : rightTerms).push_back(std::move(term));
+            start = i + 1;
+        }
+    }
+    auto conjoin = [](std::vector<std::unique_ptr<Predicate>>& terms) -> std::unique_ptr<Predicate> {
+        if (terms.size() <= 1) {
+            return terms.empty() ? nullptr : std::move(terms[0]);
+        }
+        auto node = std::make_unique<Predicate>();
+        node->kind = PredicateKind::AND;
+        node->children = std::move(terms);
+        return node;
+    };
+
+    // Select list: * expands to the left table's columns, then the right's
+    std::vector<std::string> selectedColumns;
+    std::vector<int> colIndices;
+    for (size_t i = 1; i < fromPos; i++) {
+        if (tokens[i] == ",") {
+            continue;
+        }
+        if (tokens[i] == "*") {
+            for (int c = 0; c < leftWidth + static_cast<int>(rightColumns.size()); c++) {
+                selectedColumns.push_back(c < leftWidth ? leftColumns[c].getName() : rightColumns[c - leftWidth].getName());
+                colIndices.push_back(c);
+            }
+            continue;
+        }
+        if (i + 1 < fromPos && tokens[i + 1] == "(") {
+            throw std::invalid_argument("Aggregates are not supported on joins");
+        }
+        colIndices.push_back(resolve(tokens[i]));
+        selectedColumns.push_back(tokens[i]);
+    }
+    if (selectedColumns.empty()) {
+        throw std::invalid_argument("No columns specified");
+    }
+
+    plan.kind = PlanKind::SELECT;
+    plan.tableName = leftName;
+    plan.schemaVersion = left->getSchemaVersion();
+    plan.columnNames = std::move(selectedColumns);
+    plan.columnIndices = std::move(colIndices);
+    plan.predicate = conjoin(leftTerms);
+    plan.joined = true;
+    plan.joinType = joinType;
+    plan.joinTableName = rightName;
+    plan.joinSchemaVersion = right->getSchemaVersion();
+    plan.leftKey = lhs;
+    plan.rightKey = rhs - leftWidth;
+    plan.joinPredicate = conjoin(rightTerms);
+}
+
+// Looks a table up and takes its write lock; null if there's no such table.
+// A table dropped or replaced while waiting for the lock is looked up again.
+std::shared_ptr<Table> QueryParser::lockTable(const std::string& tableName, std::optional<Table::WriteLock>& write) {
+    while (true) {
+        write.reset();
+        std::shared_ptr<Table> table = db.GetTable(tableName);
+        if (table == nullptr) {
+            return nullptr;
+        }
+        write.emplace(*table);
+        if (db.GetTable(tableName) == table) {
+            return table;
+        }
+    }
+}
+
+// Takes the write lock of an INSERT plan's table, recompiling the plan first
+// if the schema moved on since it was compiled. Compiling takes the lock
+// itself, so it happens with the lock released.
+std::shared_ptr<Table> QueryParser::lockForInsert(QueryPlan& plan, std::optional<Table::WriteLock>& write) {
+    while (true) {
+        std::shared_ptr<Table> table = lockTable(plan.tableName, write);
+        if (table != nullptr && table->getSchemaVersion() == plan.schemaVersion) {
+            return table;
+        }
+        write.reset();
+        compile(plan);
+    }
+}
+
+std::shared_ptr<const Table> QueryParser::readSnapshot(const std::string& tableName) {
+    std::shared_ptr<Table> table = db.GetTable(tableName);
+    if (!table) {
+        throw std::invalid_argument("Table " + tableName + " does not exist");
+    }
+    return table->readSnapshot();
+}
+
+// Snapshots of a SELECT plan's tables. SELECTs compile against snapshots
+// too, so the schemas only differ when a schema change was published in
+// between; the plan is recompiled against the newer snapshots then.
+PlanSnapshots QueryParser::readSnapshots(QueryPlan& plan) {
+    while (true) {
+        PlanSnapshots snapshots;
+        std::shared_ptr<Table> table = db.GetTable(plan.tableName);
+        std::shared_ptr<Table> joined = plan.joined ? db.GetTable(plan.joinTableName) : nullptr;
+        if (table && (!plan.joined || joined)) {
+            snapshots.table = table->readSnapshot();
+            if (joined) {
+                snapshots.joined = joined->readSnapshot();
+            }
+            if (snapshots.table->getSchemaVersion() == plan.schemaVersion &&
+                (!joined || snapshots.joined->getSchemaVersion() == plan.joinSchemaVersion)) {
+                return snapshots;
+            }
+        }
+        compile(plan);
+    }
+}
+
+static bool holdsType(const Value& value, ColumnType type) {
+    switch (type) {
+        case ColumnType::INT:
+            return std::holds_alternative<int>(value);
+        case ColumnType::FLOAT:
+            return std::holds_alternative<float>(value);
+        case ColumnType::STRING:
+            return std::holds_alternative<std::string>(value);
+        case ColumnType::BOOLEAN:
+            return std::holds_alternative<bool>(value);
+    }
+    return false;
+}
+
+// Writes the selected columns of one row
+static void writeColumns(ResultBuffer& out, const Table& table, const std::vector<int>& columns, size_t row) {
+    for (int c : columns) {
+        out.value(table.getValue(row, c));
+    }
+    out.endRow();
+}
+
+// Rows before the end of a plan's LIMIT, counting those OFFSET skips
+static size_t rowsWanted(const QueryPlan& plan) {
+    if (plan.limit > QueryPlan::kNoLimit - plan.offset) {
+        return QueryPlan::kNoLimit;
+    }
+    return plan.offset + plan.limit;
+}
+
+// EXPLAIN: an operator over child, passing its rows on
+static PlanOperator planOperator(const std::string& name, const std::string& detail, PlanOperator child) {
+    PlanOperator op;
+    op.name = name;
+    op.detail = detail;
+    op.estimatedRows = child.estimatedRows;
+    op.rowsIn = op.rowsOut = child.rowsOut;
+    op.children.push_back(std::move(child));
+    return op;
+}
+
+static std::string joinNames(const std::vector<std::string>& names) {
+    std::string text;
+    for (const std::string& name : names) {
+        text += (text.empty() ? "" : ", ") + name;
+    }
+    return text;
+}
+
+// The output columns, formatted and written
+static PlanOperator projectOperator(const QueryPlan& plan, PlanOperator child) {
+    return planOperator("Project", joinNames(plan.columnNames), std::move(child));
+}
+
+// LIMIT and OFFSET over child, if the plan has them; rows is what it kept
+static PlanOperator limitOperator(const QueryPlan& plan, PlanOperator child, uint64_t rows) {
+    if (plan.limit == QueryPlan::kNoLimit && plan.offset == 0) {
+        return child;
+    }
+    std::string detail = plan.limit == QueryPlan::kNoLimit ? "" : "LIMIT " + std::to_string(plan.limit);
+    if (plan.offset) {
+        detail += (detail.empty() ? "" : " ") + std::string("OFFSET ") + std::to_string(plan.offset);
+    }
+    PlanOperator op = planOperator("Limit", detail, std::move(child));
+    if (op.estimatedRows >= 0) {
+        op.estimatedRows = std::clamp(op.estimatedRows - static_cast<double>(plan.offset), 0.0,
+                                      static_cast<double>(plan.limit));
+    }
+    op.rowsOut = rows;
+    return op;
+}
+
+// Rows plan keeps of the rows its LIMIT and OFFSET see
+static uint64_t rowsKept(const QueryPlan& plan, uint64_t rows) {
+    return std::min<uint64_t>(rows - std::min<uint64_t>(rows, plan.offset), plan.limit);
+}
+
+// Without GROUP BY there is one group; with it, as many as the product of
+// the grouping columns' distinct counts (NULL counting as one), up to the
+// rows going in. No estimate when a grouping column wasn't analyzed.
+static PlanOperator describeAggregate(const QueryPlan& plan, const Table& table, const Filter& filter,
+                                      const ScanProfile* profile) {
+    static const char* const functions[] = {"COUNT", "SUM", "AVG", "MIN", "MAX"};
+    const std::vector<Column>& columns = table.getColumns();
+    std::string detail;
+    if (!plan.groupColumns.empty()) {
+        detail = "group by ";
+        for (size_t i = 0; i < plan.groupColumns.size(); i++) {
+            detail += (i ? ", " : "") + columns[plan.groupColumns[i]].getName();
+        }
+        detail += "; ";
+    }
+    for (size_t i = 0; i < plan.aggregates.size(); i++) {
+        const AggregateSpec& spec = plan.aggregates[i];
+        detail += (i ? ", " : "") + std::string(functions[static_cast<int>(spec.function)]) + "(" +
+                  (spec.column < 0 ? "*" : columns[spec.column].getName()) + ")";
+    }
+    PlanOperator op = planOperator("Aggregate", detail, describeScan(table, filter, profile));
+    double input = op.estimatedRows;
+    op.estimatedRows = 1;
+    const TableStatistics* stats = table.getStatistics();
+    for (int c : plan.groupColumns) {
+        if (!stats || !stats->columns[c].analyzed || input < 0) {
+            op.estimatedRows = -1;
+            break;
+        }
+        const ColumnStatistics& column = stats->columns[c];
+        op.estimatedRows = std::min(op.estimatedRows * (column.distinct + (column.nullFraction > 0)), input);
+    }
+    return op;
+}
+
+// The probe side's scan and the build side's under a Hash, in that order.
+// Each probe row is expected to match build rows / max(distinct keys) rows
+// when the key columns were analyzed, and every left row comes out of a LEFT
+// join at least once.
+static PlanOperator describeJoin(const QueryPlan& plan, const Table& left, const Table& right, bool buildLeft,
+                                 const Filter& probeFilter, const Filter& buildFilter, const Explain* profiled) {
+    const Table& probeTable = buildLeft ? right : left;
+    const Table& buildTable = buildLeft ? left : right;
+    PlanOperator hash = planOperator("Hash", "", describeScan(buildTable, buildFilter,
+                                                              profiled ? &profiled->build : nullptr));
+    PlanOperator join;
+    join.name = plan.joinType == JoinType::LEFT ? "Hash Left Join" : "Hash Join";
+    join.detail = left.getName() + "." + left.getColumns()[plan.leftKey].getName() + " = " + right.getName() + "." +
+                  right.getColumns()[plan.rightKey].getName();
+    join.children.push_back(describeScan(probeTable, probeFilter, profiled ? &profiled->scan : nullptr));
+
+    double distinct = 0;
+    bool analyzed = false;
+    for (auto [table, key] : {std::pair{&left, plan.leftKey}, std::pair{&right, plan.rightKey}}) {
+        const TableStatistics* stats = table->getStatistics();
+        if (stats && stats->columns[key].analyzed) {
+            distinct = std::max(distinct, stats->columns[key].distinct);
+            analyzed = true;
+        }
+    }
+    double probeRows = join.children[0].estimatedRows;
+    if (analyzed && probeRows >= 0 && hash.estimatedRows >= 0) {
+        join.estimatedRows = distinct > 0 ? probeRows * hash.estimatedRows / distinct : 0;
+        if (plan.joinType == JoinType::LEFT) {
+            join.estimatedRows = std::max(join.estimatedRows, buildLeft ? hash.estimatedRows : probeRows);
+        }
+    }
+    join.children.push_back(std::move(hash));
+    return join;
+}
+
+// INSERTs run under the table's write lock. SELECTs read snapshots and
+// don't wait for writers.
+void QueryParser::executePlan(QueryPlan& plan, const std::vector<Value>& params) {
+    std::shared_ptr<Table> table;
+    std::optional<Table::WriteLock> write;
+    PlanSnapshots snapshots;
+    if (plan.kind == PlanKind::INSERT) {
+        table = lockForInsert(plan, write);
+    } else {
+        snapshots = readSnapshots(plan);
+    }
+
+    if (params.size() != plan.params.size()) {
+        throw std::invalid_argument("Expected " + std::to_string(plan.params.size()) + " parameters, got " +
+                                    std::to_string(params.size()));
+    }
+    for (size_t i = 0; i < params.size(); i++) {
+        const ParamSlot& slot = plan.params[i];
+        if (holdsType(params[i], slot.type)) {
+            *slot.target = params[i];
+        } else if (isNull(params[i]) && plan.kind == PlanKind::INSERT) {
+            *slot.target = params[i]; // WHERE literals can't be NULL
+        } else if (slot.type == ColumnType::FLOAT && std::holds_alternative<int>(params[i])) {
+            *slot.target = static_cast<float>(std::get<int>(params[i]));
+        } else {
+            throw std::invalid_argument("Parameter " + std::to_string(i + 1) + " has the wrong type");
+        }
+    }
+
+    if (plan.kind == PlanKind::INSERT) {
+        table->addRows(plan.rows);
+        if (WriteAheadLog* log = db.getLog()) {
+            log->append(WalRecordType::INSERT, WriteAheadLog::encodeRows(plan.tableName, plan.rows));
+        }
+        if (plan.rows.size() == 1) {
+            out << "1 row inserted." << std::endl;
+        } else {
+            out << plan.rows.size() << " rows inserted." << std::endl;
+        }
+        return;
+    }
+
+    const Table& snapshot = *snapshots.table;
+    if (plan.joined) {
+        executeJoin(plan, snapshot, *snapshots.joined);
+        return;
+    }
+    auto setup = std::chrono::steady_clock::now();
+    Filter filter(snapshot, plan.predicate.get());
+    if (explain) {
+        explain->scan.setupNanos = nanosSince(setup);
+        if (explain->analyze) {
+            filter.setCounters(&explain->scan.workers);
+        }
+    }
+    if (plan.aggregated) {
+        executeAggregate(plan, snapshot, filter);
+        return;
+    }
+    if (!plan.orderBy.empty()) {
+        executeSorted(plan, snapshot, filter);
+        return;
+    }
+    if (plan.limit != QueryPlan::kNoLimit) {
+        executeLimited(plan, snapshot, filter);
+        return;
+    }
+    if (explain && !explain->analyze) {
+        explain->root = projectOperator(plan, describeScan(snapshot, filter, nullptr));
+        return;
+    }
+    const std::vector<int>& colIndices = plan.columnIndices;
+    uint64_t bytes = sink.getBytesWritten();
+    sink.header(plan.columnNames);
+
+    // Morsels are filtered and formatted in parallel straight from table
+    // storage into their own buffers, then written in row order
+    auto start = std::chrono::steady_clock::now();
+    size_t morsels = filter.getMorselCount();
+    std::vector<ResultBuffer>& buffers = sink.getBuffers(morsels);
+    filter.parallelForEachMatch(db.getThreadPool(), [&](size_t, size_t morsel, size_t r) {
+        writeColumns(buffers[morsel], snapshot, colIndices, r);
+    });
+    auto scanned = std::chrono::steady_clock::now();
+    for (size_t m = 0; m < morsels; m++) {
+        sink.write(buffers[m]);
+    }
+    sink.finish();
+    if (explain) {
+        explain->scan.wallNanos = nanosBetween(start, scanned);
+        PlanOperator project = projectOperator(plan, describeScan(snapshot, filter, &explain->scan));
+        project.nanos = explain->scan.consumerNanos() + nanosSince(scanned);
+        project.bytes = sink.getBytesWritten() - bytes;
+        explain->root = std::move(project);
+    }
+}
+
+// ORDER BY: every worker collects the sort keys of the rows it scans (with a
+// LIMIT, only the first offset + limit in sort order), the partials are
+// merged and sorted, and slices of the sorted rows are formatted in parallel
+void QueryParser::executeSorted(const QueryPlan& plan, const Table& table, const Filter& filter) {
+    auto describeSort = [&](const ScanProfile* profile) {
+        std::string keys;
+        for (const SortKey& key : plan.orderBy) {
+            keys += (keys.empty() ? "" : ", ") + table.getColumns()[key.column].getName();
+            keys += key.descending ? " DESC" : "";
+        }
+        return planOperator("Sort", keys, describeScan(table, filter, profile));
+    };
+    if (explain && !explain->analyze) {
+        explain->root = projectOperator(plan, limitOperator(plan, describeSort(nullptr), 0));
+        return;
+    }
+    ThreadPool& pool = db.getThreadPool();
+    std::vector<SortBuffer> partials;
+    partials.reserve(pool.getThreadCount());
+    for (size_t w = 0; w < pool.getThreadCount(); w++) {
+        partials.emplace_back(table, plan.orderBy, rowsWanted(plan));
+    }
+    auto start = std::chrono::steady_clock::now();
+    filter.parallelForEachBatch(pool, [&](size_t worker, size_t, size_t first, size_t count, const Selection& sel) {
+        partials[worker].consume(first, count, sel);
+    });
+    auto scanned = std::chrono::steady_clock::now();
+    size_t sortBytes = 0;
+    if (explain) {
+        for (const SortBuffer& partial : partials) {
+            sortBytes += partial.getMemoryUsage();
+        }
+    }
+    SortBuffer& result = partials[0];
+    for (size_t w = 1; w < partials.size(); w++) {
+        result.merge(partials[w]);
+    }
+    std::vector<size_t> rows = result.sortedRows(pool);
+    size_t first = std::min(plan.offset, rows.size());
+    size_t count = std::min(rows.size() - first, plan.limit);
+    auto sorted = std::chrono::steady_clock::now();
+
+    uint64_t bytes = sink.getBytesWritten();
+    sink.header(plan.columnNames);
+    size_t slices = (count + kMorselRows - 1) / kMorselRows;
+    std::vector<ResultBuffer>& buffers = sink.getBuffers(slices);
+    pool.parallelFor(slices, [&](size_t slice, size_t) {
+        size_t last = std::min(count, (slice + 1) * kMorselRows);
+        for (size_t i = slice * kMorselRows; i < last; i++) {
+            writeColumns(buffers[slice], table, plan.columnIndices, rows[first + i]);
+        }
+    });
+    for (size_t s = 0; s < slices; s++) {
+        sink.write(buffers[s]);
+    }
+    sink.finish();
+    if (explain) {
+        explain->scan.wallNanos = nanosBetween(start, scanned);
+        PlanOperator sort = describeSort(&explain->scan);
+        sort.nanos = explain->scan.consumerNanos() + nanosBetween(scanned, sorted);
+        sort.rowsOut = rows.size();
+        sort.bytes = sortBytes + rows.size() * sizeof(size_t);
+        PlanOperator project = projectOperator(plan, limitOperator(plan, std::move(sort), count));
+        project.nanos = nanosSince(sorted);
+        project.bytes = sink.getBytesWritten() - bytes;
+        explain->root = std::move(project);
+    }
+}
+
+// LIMIT without ORDER BY returns the first matches in row order. Morsels are
+// scanned a pool's worth at a time, in order, and the scan stops as soon as
+// enough rows have been found.
+void QueryParser::executeLimited(const QueryPlan& plan, const Table& table, const Filter& filter) {
+    if (explain && !explain->analyze) {
+        explain->root = projectOperator(plan, limitOperator(plan, describeScan(table, filter, nullptr), 0));
+        return;
+    }
+    ThreadPool& pool = db.getThreadPool();
+    size_t wanted = rowsWanted(plan);
+    size_t morsels = filter.getMorselCount();
+    size_t wave = pool.getThreadCount();
+    std::vector<std::vector<size_t>> matches(wave);
+    size_t found = 0;
+
+    uint64_t bytes = sink.getBytesWritten();
+    uint64_t scanNanos = 0;
+    auto start = std::chrono::steady_clock::now();
+    sink.header(plan.columnNames);
+    ResultBuffer& out = sink.getBuffer();
+    for (size_t begin = 0; begin < morsels && found < wanted; begin += wave) {
+        size_t end = std::min(morsels, begin + wave);
+        size_t needed = wanted - found;
+        for (auto& rows : matches) {
+            rows.clear();
+        }
+        auto scan = std::chrono::steady_clock::now();
+        filter.parallelForEachMatch(pool, begin, end, [&](size_t, size_t morsel, size_t r) {
+            // No morsel holds more rows than are still needed
+            std::vector<size_t>& rows = matches[morsel - begin];
+            if (rows.size() < needed) {
+                rows.push_back(r);
+            }
+        });
+        if (explain) {
+            scanNanos += nanosSince(scan);
+        }
+        for (size_t m = 0; m < end - begin; m++) {
+            for (size_t r : matches[m]) {
+                if (found == wanted) {
+                    break;
+                }
+                if (found >= plan.offset) {
+                    writeColumns(out, table, plan.columnIndices, r);
+                    sink.flushIfFull(out);
+                }
+                found++;
+            }
+        }
+    }
+    sink.write(out);
+    sink.finish();
+    if (explain) {
+        explain->scan.wallNanos = scanNanos;
+        PlanOperator limit = limitOperator(plan, describeScan(table, filter, &explain->scan), rowsKept(plan, found));
+        limit.nanos = explain->scan.consumerNanos();
+        PlanOperator project = projectOperator(plan, std::move(limit));
+        project.nanos = nanosSince(start) - scanNanos;
+        project.bytes = sink.getBytesWritten() - bytes;
+        explain->root = std::move(project);
+    }
+}
+
+// Every worker aggregates the morsels it scans into its own hash table; the
+// partials are merged into the first one
+void QueryParser::executeAggregate(const QueryPlan& plan, const Table& table, const Filter& filter) {
+    if (explain && !explain->analyze) {
+        explain->root = projectOperator(plan, limitOperator(plan, describeAggregate(plan, table, filter, nullptr), 0));
+        return;
+    }
+    ThreadPool& pool = db.getThreadPool();
+    std::vector<HashAggregator> partials;
+    partials.reserve(pool.getThreadCount());
+    for (size_t w = 0; w < pool.getThreadCount(); w++) {
+        partials.emplace_back(table, plan.groupColumns, plan.aggregates);
+    }
+    auto start = std::chrono::steady_clock::now();
+    filter.parallelForEachBatch(pool, [&](size_t worker, size_t, size_t first, size_t count, const Selection& sel) {
+        partials[worker].consume(first, count, sel);
+    });
+    auto scanned = std::chrono::steady_clock::now();
+    size_t aggregateBytes = 0;
+    if (explain) {
+        for (const HashAggregator& partial : partials) {
+            aggregateBytes += partial.getMemoryUsage();
+        }
+    }
+    HashAggregator& result = partials[0];
+    for (size_t w = 1; w < partials.size(); w++) {
+        result.merge(partials[w]);
+    }
+    auto merged = std::chrono::steady_clock::now();
+
+    uint64_t bytes = sink.getBytesWritten();
+    sink.header(plan.columnNames);
+    ResultBuffer& out = sink.getBuffer();
+    size_t end = std::min(result.getGroupCount(), rowsWanted(plan));
+    for (size_t g = plan.offset; g < end; g++) {
+        for (const OutputColumn& output : plan.outputs) {
+            if (output.aggregate) {
+                result.writeAggregate(out, g, output.index);
+            } else {
+                result.writeKey(out, g, output.index);
+            }
+        }
+        out.endRow();
+        sink.flushIfFull(out);
+    }
+    sink.write(out);
+    sink.finish();
+    if (explain) {
+        explain->scan.wallNanos = nanosBetween(start, scanned);
+        PlanOperator aggregate = describeAggregate(plan, table, filter, &explain->scan);
+        aggregate.nanos = explain->scan.consumerNanos() + nanosBetween(scanned, merged);
+        aggregate.rowsOut = result.getGroupCount();
+        aggregate.bytes = aggregateBytes;
+        PlanOperator project = projectOperator(plan, limitOperator(plan, std::move(aggregate),
+                                                                   rowsKept(plan, result.getGroupCount())));
+        project.nanos = nanosSince(merged);
+        project.bytes = sink.getBytesWritten() - bytes;
+        explain->root = std::move(project);
+    }
+}
+
+// Hash join: builds on the input expected to have fewer rows and probes it
+// with the other in parallel. The sizes are the filters' estimates once
+// either table was analyzed, otherwise the tables' row counts. Output rows
+// are formatted per probe morsel straight from both tables' storage and
+// written in probe order; a LEFT join whose left input is the build side
+// prints its unmatched rows last.
+void QueryParser::executeJoin(const QueryPlan& plan, const Table& left, const Table& right) {
+    static constexpr size_t kNoRow = static_cast<size_t>(-1);
+    ThreadPool& pool = db.getThreadPool();
+    // WHERE terms on the right table usually fail for a NULL-extended row,
+    // so with them a LEFT join returns what the inner join does and they
+    // can filter the right input. Terms that hold for NULLs (IS NULL) are
+    // instead checked per joined pair: a left row with matches is never
+    // NULL-extended, whether or not its pairs pass.
+    bool outer = plan.joinType == JoinType::LEFT && (!plan.joinPredicate || isTrueForNulls(*plan.joinPredicate));
+    auto setup = std::chrono::steady_clock::now();
+    Filter leftFilter(left, plan.predicate.get());
+    auto leftReady = std::chrono::steady_clock::now();
+    Filter rightFilter(right, outer ? nullptr : plan.joinPredicate.get());
+    auto rightReady = std::chrono::steady_clock::now();
+    bool buildLeft = left.getRowCount() < right.getRowCount();
+    if (left.getStatistics() || right.getStatistics()) {
+        buildLeft = leftFilter.estimateRows() < rightFilter.estimateRows();
+    }
+    const Table& probeTable = buildLeft ? right : left;
+    Filter& probeFilter = buildLeft ? rightFilter : leftFilter;
+    Filter& buildFilter = buildLeft ? leftFilter : rightFilter;
+    if (explain) {
+        uint64_t leftSetup = nanosBetween(setup, leftReady);
+        uint64_t rightSetup = nanosBetween(leftReady, rightReady);
+        explain->scan.setupNanos = buildLeft ? rightSetup : leftSetup;
+        explain->build.setupNanos = buildLeft ? leftSetup : rightSetup;
+        if (!explain->analyze) {
+            explain->root = projectOperator(plan, describeJoin(plan, left, right, buildLeft, probeFilter,
+                                                               buildFilter, nullptr));
+            return;
+        }
+        probeFilter.setCounters(&explain->scan.workers);
+        buildFilter.setCounters(&explain->build.workers);
+    }
+    std::vector<uint8_t> rightPass;
+    if (outer && plan.joinPredicate) {
+        rightPass.resize(right.getRowCount());
+        Filter(right, plan.joinPredicate.get()).forEachMatch([&](size_t r) { rightPass[r] = 1; });
+    }
+    int probeKey = buildLeft ? plan.rightKey : plan.leftKey;
+    auto building = std::chrono::steady_clock::now();
+    HashJoin build(buildLeft ? left : right, buildLeft ? plan.leftKey : plan.rightKey, buildFilter, pool);
+    auto built = std::chrono::steady_clock::now();
+    std::vector<uint8_t> matched(outer && buildLeft ? build.size() : 0);
+
+    int leftWidth = static_cast<int>(left.getColumns().size());
+    const std::vector<int>& colIndices = plan.columnIndices;
+    auto writeRow = [&](ResultBuffer& out, size_t leftRow, size_t rightRow) {
+        for (int c : colIndices) {
+            size_t row = c < leftWidth ? leftRow : rightRow;
+            if (row == kNoRow) {
+                out.null();
+            } else {
+                out.value(c < leftWidth ? left.getValue(row, c) : right.getValue(row, c - leftWidth));
+            }
+        }
+        out.endRow();
+    };
+
+    uint64_t bytes = sink.getBytesWritten();
+    sink.header(plan.columnNames);
+
+    std::vector<JoinKeyReader> readers;
+    readers.reserve(pool.getThreadCount());
+    for (size_t w = 0; w < pool.getThreadCount(); w++) {
+        readers.emplace_back(probeTable, probeKey);
+    }
+    size_t morsels = probeFilter.getMorselCount();
+    std::vector<ResultBuffer>& buffers = sink.getBuffers(morsels);
+    std::vector<uint64_t> joinedRows(explain ? morsels : 0); // per morsel, for EXPLAIN ANALYZE
+    auto probing = std::chrono::steady_clock::now();
+    probeFilter.parallelForEachBatch(pool, [&](size_t worker, size_t morsel, size_t first, size_t count,
+                                               const Selection& sel) {
+        bool any = false;
+        for (size_t w = 0; w < kBatchWords; w++) {
+            any |= sel.words[w] != 0;
+        }
+        if (!any) {
+            return;
+        }
+        JoinKeyReader& reader = readers[worker];
+        reader.load(first, count);
+        ResultBuffer& out = buffers[morsel];
+        size_t written = 0;
+        for (size_t w = 0; w < kBatchWords; w++) {
+            for (uint64_t bits = sel.words[w]; bits; bits &= bits - 1) {
+                size_t i = w * 64 + static_cast<size_t>(std::countr_zero(bits));
+                size_t r = first + i;
+                bool found = false;
+                build.forEachMatch(reader.key(i), [&](size_t entry, size_t b) {
+                    found = true;
+                    if (!matched.empty()) {
+                        std::atomic_ref<uint8_t>(matched[entry]).store(1, std::memory_order_relaxed);
+                    }
+                    if (!rightPass.empty() && !rightPass[buildLeft ? r : b]) {
+                        return;
+                    }
+                    if (buildLeft) {
+                        writeRow(out, b, r);
+                    } else {
+                        writeRow(out, r, b);
+                    }
+                    written++;
+                });
+                if (!found && outer && !buildLeft) {
+                    writeRow(out, r, kNoRow);
+                    written++;
+                }
+            }
+        }
+        if (!joinedRows.empty()) {
+            joinedRows[morsel] += written;
+        }
+    });
+    auto probed = std::chrono::steady_clock::now();
+    for (size_t m = 0; m < morsels; m++) {
+        sink.write(buffers[m]);
+    }
+    ResultBuffer& out = sink.getBuffer();
+    uint64_t unmatched = 0;
+    for (size_t e = 0; e < matched.size(); e++) {
+        if (!matched[e]) {
+            writeRow(out, build.getRow(e), kNoRow);
+            sink.flushIfFull(out);
+            unmatched++;
+        }
+    }
+    sink.write(out);
+    sink.finish();
+    if (explain) {
+        explain->build.wallNanos = nanosBetween(building, built);
+        explain->scan.wallNanos = nanosBetween(probing, probed);
+        PlanOperator join = describeJoin(plan, left, right, buildLeft, probeFilter, buildFilter, explain);
+        PlanOperator& hash = join.children[1];
+        hash.nanos = explain->build.consumerNanos();
+        hash.rowsOut = build.size();
+        hash.bytes = build.getMemoryUsage();
+        join.nanos = explain->scan.consumerNanos();
+        join.rowsIn = join.children[0].rowsOut + hash.rowsOut;
+        join.rowsOut = unmatched;
+        for (uint64_t rows : joinedRows) {
+            join.rowsOut += rows;
+        }
+        PlanOperator project = projectOperator(plan, std::move(join));
+        project.nanos = nanosSince(probed);
+        project.bytes = sink.getBytesWritten() - bytes;
+        explain->root = std::move(project);
+    }
+}
+
+std::unique_ptr<Predicate> QueryParser::parseWhereQuery(const Table& table, const std::vector<std::string> &tokens,
+                                                        size_t start, size_t end, std::vector<ParamSlot>* params,
+                                                        const std::string& qualifier) {
+    // WHERE condition: tokens[start] is the first token after WHERE
+    if (start >= end) {
+        throw std::invalid_argument("Invalid WHERE clause: missing condition");
+    }
+    WhereParser parser{table, tokens, start, end, params, {}, qualifier};
+    auto predicate = parser.parseOr();
+    if (parser.pos != end) {
+        throw std::invalid_argument("Invalid WHERE clause near '" + tokens[parser.pos] + "'");
+    }
+    if (params) {
+        parser.resolvePlaceholders();
+    }
+    return predicate;
+}
@@ -7,27 +7,103 @@
 
 
 #include"Database.h"
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include "Explain.h"
+#include "PlanCache.h"
+#include "ResultSink.h"
 
+// Snapshots a SELECT plan runs on; joined is null without a JOIN
+struct PlanSnapshots {
+    std::shared_ptr<const Table> table;
+    std::shared_ptr<const Table> joined;
+};
+
+// A session on a Database. The plan cache, prepared statements and output
+// belong to the session, so each thread uses a QueryParser of its own; the
+// sessions share only the database. SELECTs read table snapshots, and a
+// statement that changes a table holds that table's write lock, so
+// statements on different tables run in parallel.
 class QueryParser {
 private:
     Database& db;
+    std::ostream& out; // messages and SELECT output
+    PlanCache plans;
+    std::unordered_map<std::string, std::shared_ptr<QueryPlan>> prepared;
+    ResultSink sink;
+    // Set while EXPLAIN runs a plan: the executors describe the operators
+    // they set up into it, and without ANALYZE return before running them
+    Explain* explain = nullptr;
+
+    void executeStatement(const std::vector<std::string>& tokens);
+    void logStatement(const std::vector<std::string>& tokens);
+
+    void compile(QueryPlan& plan);
+    void compileInsert(QueryPlan& plan);
+    void compileSelect(QueryPlan& plan);
+    void compileJoin(QueryPlan& plan, size_t fromPos);
+    std::shared_ptr<Table> lockTable(const std::string& tableName, std::optional<Table::WriteLock>& write);
+    std::shared_ptr<Table> lockForInsert(QueryPlan& plan, std::optional<Table::WriteLock>& write);
+    std::shared_ptr<const Table> readSnapshot(const std::string& tableName);
+    PlanSnapshots readSnapshots(QueryPlan& plan);
+    void executePlan(QueryPlan& plan, const std::vector<Value>& params);
+    void executeAggregate(const QueryPlan& plan, const Table& table, const Filter& filter);
+    void executeSorted(const QueryPlan& plan, const Table& table, const Filter& filter);
+    void executeLimited(const QueryPlan& plan, const Table& table, const Filter& filter);
+    void executeJoin(const QueryPlan& plan, const Table& left, const Table& right);
 public:
-    QueryParser(Database& db);
+    explicit QueryParser(Database& db, std::ostream& out = std::cout);
 
-    void parseQuery(const std::string& query);
+    // params bind `?` placeholders of an INSERT or SELECT, in order
+    void parseQuery(const std::string& query, const std::vector<Value>& params = {});
+
+    // C++ side of PREPARE / EXECUTE / DEALLOCATE
+    void prepare(const std::string& name, const std::string& query);
+    void execute(const std::string& name, const std::vector<Value>& params = {});
+    void deallocate(const std::string& name);
+    PlanCache& getPlanCache();
+
+    // How SELECT results are written: text (default), tsv, csv or binary
+    void setOutputFormat(OutputFormat format);
+    OutputFormat getOutputFormat() const;
+
+    // Replays the database's write-ahead log on top of the loaded snapshot,
+    // skipping records the snapshot already contains. Returns records applied.
+    size_t recoverFromLog();
 
     //DDL Statements
     void parseCreateTable(const std::vector<std::string>& tokens);
     void parseDropTable(const std::vector<std::string>& tokens);
     void parseAlterTable(const std::vector<std::string>& tokens);
+    void parseCreateIndex(const std::vector<std::string>& tokens);
+    // ANALYZE tablename: gathers the statistics the planner uses
+    void parseAnalyze(const std::vector<std::string>& tokens);
 
     //DML Statements
 
     void parseInsert(const std::vector<std::string>& tokens);
+    void parseCopy(const std::vector<std::string>& tokens);
+    void parseDelete(const std::vector<std::string>& tokens);
+    void parseUpdate(const std::vector<std::string>& tokens);
+
+    // PREPARE name AS statement, EXECUTE name [(values)], DEALLOCATE name
+    void parsePrepare(const std::vector<std::string>& tokens);
+    void parseExecute(const std::vector<std::string>& tokens);
+    void parseDeallocate(const std::vector<std::string>& tokens);
 
 
     //DQL
     void parseSelectQuery(const std::vector<std::string>& tokens);
-    void parseWhereQuery(const std::vector<std::string>& tokens);
+    // EXPLAIN [ANALYZE] SELECT ...: the plan, one operator per line; ANALYZE
+    // runs it without printing the rows and adds what each operator did
+    void parseExplain(const std::vector<std::string>& tokens);
+    // Condition in tokens [start, end). params: where `?` placeholders are
+    // recorded; null rejects them. qualifier: the table name or alias that
+    // may prefix column names, as in `t.col`
+    std::unique_ptr<Predicate> parseWhereQuery(const Table& table, const std::vector<std::string>& tokens, size_t start,
+                                               size_t end, std::vector<ParamSlot>* params = nullptr,
+                                               const std::string& qualifier = "");
 };
 #endif //QUERYPARSER_H
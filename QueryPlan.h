@@ -0,0 +1,79 @@
+#ifndef QUERYPLAN_H
+#define QUERYPLAN_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Row.h"
+#include "Aggregate.h"
+#include "Join.h"
+#include "Sort.h"
+
+enum class PlanKind {
+    INSERT,
+    SELECT
+};
+
+// Where a printed column of an aggregate query comes from
+struct OutputColumn {
+    bool aggregate; // index into QueryPlan::aggregates, else into groupColumns
+    size_t index;
+};
+
+// A `?` placeholder: the plan literal a bound value is written into, and
+// the type it has to be.
+struct ParamSlot {
+    ColumnType type;
+    Value* target;
+};
+
+// An INSERT or SELECT parsed once, with table columns resolved to indices.
+// Executing it only binds parameters and runs; it is recompiled from its
+// tokens if the table's schema changed since (see Table::getSchemaVersion).
+// Slots point into the plan itself, so plans are not copyable.
+struct QueryPlan {
+    PlanKind kind = PlanKind::SELECT;
+    std::vector<std::string> tokens;
+    std::string tableName;
+    uint64_t schemaVersion = 0;
+    std::vector<ParamSlot> params; // in order of appearance
+
+    // INSERT: full rows, one per VALUES tuple, unlisted columns at defaults
+    std::vector<Row> rows;
+
+    // SELECT
+    std::vector<std::string> columnNames; // printed header
+    std::vector<int> columnIndices;
+    std::unique_ptr<Predicate> predicate; // null selects every row
+
+    // ORDER BY keys (plain SELECT only), then the rows LIMIT and OFFSET
+    // keep; limit is kNoLimit without a LIMIT
+    static constexpr size_t kNoLimit = SortBuffer::kNoLimit;
+    std::vector<SortKey> orderBy;
+    size_t limit = kNoLimit;
+    size_t offset = 0;
+
+    // Aggregate SELECT (aggregate functions or GROUP BY); columnIndices unused
+    bool aggregated = false;
+    std::vector<int> groupColumns;
+    std::vector<AggregateSpec> aggregates;
+    std::vector<OutputColumn> outputs;
+
+    // Joined SELECT: tableName is the left input. columnIndices number the
+    // left table's columns first, then the right table's; predicate filters
+    // the left input and joinPredicate the right one.
+    bool joined = false;
+    JoinType joinType = JoinType::INNER;
+    std::string joinTableName;
+    uint64_t joinSchemaVersion = 0;
+    int leftKey = -1;
+    int rightKey = -1;
+    std::unique_ptr<Predicate> joinPredicate;
+
+    QueryPlan() = default;
+    QueryPlan(const QueryPlan&) = delete;
+    QueryPlan& operator=(const QueryPlan&) = delete;
+};
+
+#endif //QUERYPLAN_H
@@ -0,0 +1,326 @@
+#include "ResultSink.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+ResultBuffer::ResultBuffer(OutputFormat format) : format(format) {}
+
+void ResultBuffer::setFormat(OutputFormat f) {
+    format = f;
+}
+
+void ResultBuffer::clear() {
+    used = 0;
+    column = 0;
+}
+
+char* ResultBuffer::reserve(size_t n) {
+    if (used + n > bytes.size()) {
+        bytes.resize(std::max({bytes.size() * 2, used + n, size_t(4096)}));
+    }
+    return bytes.data() + used;
+}
+
+void ResultBuffer::append(std::string_view text) {
+    std::memcpy(reserve(text.size()), text.data(), text.size());
+    used += text.size();
+}
+
+// Host byte order, which is little-endian on every supported platform
+void ResultBuffer::appendRaw(const void* data, size_t n) {
+    std::memcpy(reserve(n), data, n);
+    used += n;
+}
+
+void ResultBuffer::appendByte(uint8_t byte) {
+    *reserve(1) = static_cast<char>(byte);
+    used++;
+}
+
+void ResultBuffer::appendString(std::string_view text) {
+    uint32_t length = static_cast<uint32_t>(text.size());
+    appendRaw(&length, 4);
+    append(text);
+}
+
+// Starts a cell: the row marker or the separator from the previous cell
+void ResultBuffer::separator() {
+    if (format == OutputFormat::BINARY) {
+        if (column == 0) {
+            appendByte(1);
+        }
+    } else if (column > 0) {
+        switch (format) {
+            case OutputFormat::TEXT:
+                append(" | ");
+                break;
+            case OutputFormat::TSV:
+                append("\t");
+                break;
+            case OutputFormat::CSV:
+                append(",");
+                break;
+            case OutputFormat::BINARY:
+                break;
+        }
+    }
+    column++;
+}
+
+void ResultBuffer::value(const ValueRef& v) {
+    std::visit([this](const auto& x) {
+        value(x);
+    }, v);
+}
+
+void ResultBuffer::value(int v) {
+    separator();
+    if (format == OutputFormat::BINARY) {
+        appendByte(1);
+        appendRaw(&v, 4);
+        return;
+    }
+    char* p = reserve(16);
+    used = std::to_chars(p, p + 16, v).ptr - bytes.data();
+}
+
+void ResultBuffer::value(int64_t v) {
+    separator();
+    if (format == OutputFormat::BINARY) {
+        appendByte(5);
+        appendRaw(&v, 8);
+        return;
+    }
+    char* p = reserve(24);
+    used = std::to_chars(p, p + 24, v).ptr - bytes.data();
+}
+
+// Shortest text that reads back to the same value
+void ResultBuffer::value(float v) {
+    separator();
+    if (format == OutputFormat::BINARY) {
+        appendByte(2);
+        appendRaw(&v, 4);
+        return;
+    }
+    char* p = reserve(32);
+    used = std::to_chars(p, p + 32, v).ptr - bytes.data();
+}
+
+void ResultBuffer::value(double v) {
+    separator();
+    if (format == OutputFormat::BINARY) {
+        appendByte(6);
+        appendRaw(&v, 8);
+        return;
+    }
+    char* p = reserve(32);
+    used = std::to_chars(p, p + 32, v).ptr - bytes.data();
+}
+
+void ResultBuffer::value(bool v) {
+    separator();
+    if (format == OutputFormat::BINARY) {
+        appendByte(4);
+        appendByte(v ? 1 : 0);
+        return;
+    }
+    append(v ? "1" : "0");
+}
+
+void ResultBuffer::value(std::string_view v) {
+    separator();
+    switch (format) {
+        case OutputFormat::TEXT:
+            append(v);
+            break;
+        case OutputFormat::TSV:
+            if (v.find_first_of("\t\n\r\\") == std::string_view::npos) {
+                append(v);
+                break;
+            }
+            for (char c : v) {
+                switch (c) {
+                    case '\t': append("\\t"); break;
+                    case '\n': append("\\n"); break;
+                    case '\r': append("\\r"); break;
+                    case '\\': append("\\\\"); break;
+                    default: appendByte(static_cast<uint8_t>(c)); break;
+                }
+            }
+            break;
+        case OutputFormat::CSV:
+            // Quote fields that would otherwise split, and empty strings so
+            // they differ from NULL
+            if (!v.empty() && v.find_first_of(",\"\n\r") == std::string_view::npos) {
+                append(v);
+                break;
+            }
+            append("\"");
+            for (char c : v) {
+                if (c == '"') {
+                    append("\"\"");
+                } else {
+                    appendByte(static_cast<uint8_t>(c));
+                }
+            }
+            append("\"");
+            break;
+        case OutputFormat::BINARY:
+            appendByte(3);
+            appendString(v);
+            break;
+    }
+}
+
+void ResultBuffer::value(std::monostate) {
+    null();
+}
+
+void ResultBuffer::null() {
+    separator();
+    switch (format) {
+        case OutputFormat::TEXT:
+            append("NULL");
+            break;
+        case OutputFormat::TSV:
+            append("\\N");
+            break;
+        case OutputFormat::CSV:
+            break;
+        case OutputFormat::BINARY:
+            appendByte(0);
+            break;
+    }
+}
+
+void ResultBuffer::endRow() {
+    if (format != OutputFormat::BINARY) {
+        append("\n");
+    }
+    column = 0;
+}
+
+const char* ResultBuffer::data() const {
+    return bytes.data();
+}
+
+size_t ResultBuffer::size() const {
+    return used;
+}
+
+ResultSink::ResultSink(std::ostream& out, OutputFormat format) : out(out), format(format) {}
+
+OutputFormat ResultSink::getFormat() const {
+    return format;
+}
+
+void ResultSink::setFormat(OutputFormat f) {
+    format = f;
+}
+
+void ResultSink::header(const std::vector<std::string>& labels) {
+    ResultBuffer& buffer = getBuffer();
+    switch (format) {
+        case OutputFormat::TEXT:
+            for (const auto& label : labels) {
+                buffer.value(std::string_view(label));
+            }
+            buffer.endRow();
+            for (size_t i = 0; i < labels.size(); i++) {
+                if (i > 0) {
+                    buffer.append("-+-");
+                }
+                buffer.append(std::string(labels[i].size(), '-'));
+            }
+            buffer.append("\n");
+            break;
+        case OutputFormat::TSV:
+        case OutputFormat::CSV:
+            for (const auto& label : labels) {
+                buffer.value(std::string_view(label));
+            }
+            buffer.endRow();
+            break;
+        case OutputFormat::BINARY: {
+            buffer.append("PDBR");
+            uint32_t count = static_cast<uint32_t>(labels.size());
+            buffer.appendRaw(&count, 4);
+            for (const auto& label : labels) {
+                buffer.appendString(label);
+            }
+            break;
+        }
+    }
+    write(buffer);
+}
+
+std::vector<ResultBuffer>& ResultSink::getBuffers(size_t count) {
+    if (buffers.size() < count) {
+        buffers.resize(count);
+    }
+    for (auto& buffer : buffers) {
+        buffer.setFormat(format);
+        buffer.clear();
+    }
+    return buffers;
+}
+
+ResultBuffer& ResultSink::getBuffer() {
+    return getBuffers(1)[0];
+}
+
+void ResultSink::write(ResultBuffer& buffer) {
+    written += buffer.size();
+    if (buffer.size() > 0 && !discarding) {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
+    buffer.clear();
+}
+
+void ResultSink::flushIfFull(ResultBuffer& buffer) {
+    if (buffer.size() >= kFlushBytes) {
+        write(buffer);
+    }
+}
+
+void ResultSink::finish() {
+    if (discarding) {
+        written += format == OutputFormat::BINARY;
+        return;
+    }
+    if (format == OutputFormat::BINARY) {
+        char end = 0;
+        out.write(&end, 1);
+        written++;
+    }
+    out.flush();
+}
+
+void ResultSink::setDiscarding(bool discard) {
+    discarding = discard;
+}
+
+uint64_t ResultSink::getBytesWritten() const {
+    return written;
+}
+
+OutputFormat parseOutputFormat(const std::string& name) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (lower == "text") {
+        return OutputFormat::TEXT;
+    }
+    if (lower == "tsv") {
+        return OutputFormat::TSV;
+    }
+    if (lower == "csv") {
+        return OutputFormat::CSV;
+    }
+    if (lower == "binary") {
+        return OutputFormat::BINARY;
+    }
+    throw std::invalid_argument("Unknown output format: " + name);
+}
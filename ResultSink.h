@@ -0,0 +1,102 @@
+#ifndef RESULTSINK_H
+#define RESULTSINK_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ColumnChunk.h"
+
+enum class OutputFormat {
+    TEXT,   // columns separated by " | " under a header and separator line
+    TSV,    // tab-separated, \t \n \\ escaped, NULL as \N
+    CSV,    // RFC 4180, NULL as an empty field, the empty string as "" (as COPY reads it)
+    BINARY  // typed cells, see ResultBuffer
+};
+
+// Result rows formatted into a growable byte buffer that is reused across
+// queries. Numbers go through std::to_chars; nothing touches a stream until
+// the buffer is handed to a ResultSink.
+//
+// A BINARY result starts with "PDBR", a u32 column count and the column
+// names (u32 length, bytes). Rows start with a 0x01 byte; each cell is a
+// one-byte tag followed by its little-endian payload: 0 NULL, 1 int32,
+// 2 float32, 3 string (u32 length, bytes), 4 bool (u8), 5 int64, 6 float64.
+// The result ends with 0x00.
+class ResultBuffer {
+private:
+    OutputFormat format;
+    std::vector<char> bytes;
+    size_t used = 0;
+    size_t column = 0; // cells written in the current row
+
+    char* reserve(size_t n);
+    void separator();
+    void append(std::string_view text);
+    void appendRaw(const void* data, size_t n);
+    void appendByte(uint8_t byte);
+    void appendString(std::string_view text);
+
+    friend class ResultSink;
+
+public:
+    explicit ResultBuffer(OutputFormat format = OutputFormat::TEXT);
+
+    void setFormat(OutputFormat format);
+    void clear(); // keeps the allocation
+
+    void value(const ValueRef& value);
+    void value(int v);
+    void value(float v);
+    void value(std::string_view v);
+    void value(bool v);
+    void value(int64_t v);
+    void value(double v);
+    void value(std::monostate);  // NULL
+    void null();
+    void endRow();
+
+    const char* data() const;
+    size_t size() const;
+};
+
+// Where SELECT results go: a header, then buffers written with one call
+// each. Parallel scans fill one buffer per morsel and the sink writes them
+// in order; serial producers write into getBuffer() and call flushIfFull.
+class ResultSink {
+private:
+    std::ostream& out;
+    OutputFormat format;
+    std::vector<ResultBuffer> buffers;
+    uint64_t written = 0;
+    bool discarding = false;
+
+public:
+    static constexpr size_t kFlushBytes = 1 << 20;
+
+    explicit ResultSink(std::ostream& out, OutputFormat format = OutputFormat::TEXT);
+
+    OutputFormat getFormat() const;
+    void setFormat(OutputFormat format);
+
+    void header(const std::vector<std::string>& labels);
+
+    // count cleared buffers for a parallel producer, e.g. one per morsel
+    std::vector<ResultBuffer>& getBuffers(size_t count);
+    ResultBuffer& getBuffer(); // the first buffer, cleared
+
+    void write(ResultBuffer& buffer); // writes and clears
+    void flushIfFull(ResultBuffer& buffer);
+    void finish();                    // end marker (BINARY) and flush
+
+    // Results are still formatted and counted, but not written (EXPLAIN
+    // ANALYZE runs a query only for its profile)
+    void setDiscarding(bool discard);
+    uint64_t getBytesWritten() const; // since the sink was made
+};
+
+// Parses "text", "tsv", "csv" or "binary"
+OutputFormat parseOutputFormat(const std::string& name);
+
+#endif //RESULTSINK_H
@@ -2,8 +2,9 @@
 // Created by chang liu on 16/05/2025.
 //
 #include "Row.h"
+#include <stdexcept>
 
-#include "column.h"
+#include "Column.h"
 
 void Row:: addValue(const Value& v ){  values.push_back(v);    }
 void Row:: removeValue(int idx) {
@@ -35,6 +36,13 @@ Value& Row::getValue(int idx) {
         return values[idx];
     }
 }
+const Value& Row::getValue(int idx) const {
+    if (idx < 0 || static_cast<size_t>(idx) >= values.size()) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    return values[idx];
+}
+size_t Row::size() const { return values.size(); }
 const std::vector<Value>& Row::getValues() const {
     return values;
 }
@@ -5,8 +5,10 @@
 #ifndef ROW_H
 #define ROW_H
 #include <vector>
+#include <string>
+#include <variant>
 
-using Value = std::variant<int, float, std::string, bool>;
+using Value = std::variant<int, float, std::string, bool, std::monostate>;
 
 class Row {
 private:
@@ -22,6 +24,8 @@ public:
 
 
      Value& getValue(int idx) ;
+    const Value& getValue(int idx) const;
+    size_t size() const;
     const std::vector<Value>& getValues() const;
 };
 
@@ -0,0 +1,470 @@
+#include "RowStorage.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "CopyOnWrite.h"
+
+// Dead arena bytes a block tolerates before compacting, so blocks with a
+// few long strings are not rewritten on every update
+static constexpr size_t kMinCompactChars = 1 << 16;
+
+// Copies the block list only; the blocks themselves are shared
+std::unique_ptr<TableStorage> RowStorage::clone() const {
+    return std::make_unique<RowStorage>(*this);
+}
+
+StorageMode RowStorage::getMode() const { return StorageMode::ROW; }
+size_t RowStorage::getRowCount() const { return rowCount; }
+
+void RowStorage::checkRow(const Row& row) const {
+    if (row.size() != columns.size()) {
+        throw std::invalid_argument("Row doesn't match table schema");
+    }
+    for (size_t c = 0; c < columns.size(); c++) {
+        const Value& value = row.getValue(static_cast<int>(c));
+        if (!isNull(value) && value.index() != variantIndexFor(columns[c].type)) {
+            throw std::invalid_argument("Value type doesn't match column type");
+        }
+    }
+}
+
+RowStorage::Cell RowStorage::makeCell(Block& block, const ValueRef& value) {
+    Cell cell;
+    std::visit([&](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::monostate>) {
+            return;
+        } else if constexpr (std::is_same_v<T, std::string_view>) {
+            cell.length = static_cast<uint32_t>(v.size());
+            if (v.size() <= kInlineChars) {
+                std::memcpy(cell.payload, v.data(), v.size());
+            } else {
+                uint64_t offset = block.arena.size();
+                block.arena.append(v.data(), v.size());
+                std::memcpy(cell.payload, &offset, sizeof(offset));
+            }
+        } else {
+            std::memcpy(cell.payload, &v, sizeof(v));
+        }
+    }, value);
+    return cell;
+}
+
+void RowStorage::releaseCell(Block& block, ColumnType type, const Cell& cell) {
+    if (type == ColumnType::STRING && cell.length > kInlineChars) {
+        block.deadChars += cell.length;
+    }
+}
+
+std::string_view RowStorage::readString(const Cell& cell, const char* arena) {
+    if (cell.length <= kInlineChars) {
+        return {cell.payload, cell.length};
+    }
+    uint64_t offset;
+    std::memcpy(&offset, cell.payload, sizeof(offset));
+    return {arena + offset, cell.length};
+}
+
+ValueRef RowStorage::readCell(const Cell& cell, ColumnType type, const char* arena) {
+    switch (type) {
+        case ColumnType::INT: {
+            int v;
+            std::memcpy(&v, cell.payload, sizeof(v));
+            return v;
+        }
+        case ColumnType::FLOAT: {
+            float v;
+            std::memcpy(&v, cell.payload, sizeof(v));
+            return v;
+        }
+        case ColumnType::BOOLEAN: {
+            bool v;
+            std::memcpy(&v, cell.payload, sizeof(v));
+            return v;
+        }
+        case ColumnType::STRING:
+            return readString(cell, arena);
+    }
+    return 0;
+}
+
+ValueRef RowStorage::fillValue(const ColumnSlot& column) const {
+    if (column.fillNull) {
+        return std::monostate{};
+    }
+    return readCell(column.fill, column.type, column.fillText.data());
+}
+
+// Copies the block's live long strings into a fresh arena once half of it
+// is dead. Strings of dropped columns are not copied either.
+void RowStorage::compactArena(Block& block, const std::vector<ColumnSlot>& columns) {
+    if (block.deadChars < kMinCompactChars || block.deadChars * 2 < block.arena.size()) {
+        return;
+    }
+    AppendBuffer<char> live;
+    live.reserve(block.arena.size() - block.deadChars);
+    Cell* cells = block.cells.mutableData();
+    for (const auto& column : columns) {
+        if (column.type != ColumnType::STRING || column.slot >= block.stride) {
+            continue;
+        }
+        for (size_t r = 0; r < block.rows; r++) {
+            Cell& cell = cells[r * block.stride + column.slot];
+            if (cell.length <= kInlineChars) {
+                continue;
+            }
+            std::string_view text = readString(cell, block.arena.data());
+            uint64_t offset = live.size();
+            live.append(text.data(), text.size());
+            std::memcpy(cell.payload, &offset, sizeof(offset));
+        }
+    }
+    block.arena = std::move(live);
+    block.deadChars = 0;
+}
+
+// A block shared with a snapshot is copied first (see soleOwner)
+RowStorage::Block& RowStorage::writable(size_t b) {
+    Block& block = unshare(blocks[b]);
+    widen(block);
+    return block;
+}
+
+RowStorage::Block& RowStorage::newBlock(size_t stride) {
+    auto block = std::make_shared<Block>();
+    block->stride = stride;
+    block->nulls.resize(stride);
+    blocks.push_back(std::move(block));
+    return *blocks.back();
+}
+
+// All blocks but the last are full
+RowStorage::Block& RowStorage::tail() {
+    if (blocks.empty() || blocks.back()->rows == kBlockRows) {
+        return newBlock(slots);
+    }
+    return writable(blocks.size() - 1);
+}
+
+// Gives a block written before columns were added their slots, holding
+// the columns' fills
+void RowStorage::widen(Block& block) {
+    if (block.stride == slots) {
+        return;
+    }
+    AppendBuffer<Cell> cells;
+    cells.resize(block.rows * slots);
+    Cell* out = cells.mutableData();
+    for (size_t r = 0; r < block.rows; r++) {
+        std::copy_n(block.cells.data() + r * block.stride, block.stride, out + r * slots);
+    }
+    block.nulls.resize(slots);
+    for (const auto& column : columns) {
+        if (column.slot < block.stride) {
+            continue;
+        }
+        ValueRef fill = fillValue(column);
+        for (size_t r = 0; r < block.rows; r++) {
+            out[r * slots + column.slot] = makeCell(block, fill);
+            block.nulls[column.slot].append(column.fillNull);
+        }
+    }
+    block.cells = std::move(cells);
+    block.stride = slots;
+}
+
+void RowStorage::copyRows(const Block& source, size_t first, size_t n, Block& target, bool packed) const {
+    Cell* rows = target.cells.grow(n * target.stride);
+    std::fill_n(rows, n * target.stride, Cell());
+    for (size_t c = 0; c < columns.size(); c++) {
+        const ColumnSlot& column = columns[c];
+        size_t to = packed ? c : column.slot;
+        Cell* out = rows + to;
+        if (column.slot >= source.stride) {
+            ValueRef fill = fillValue(column);
+            for (size_t i = 0; i < n; i++, out += target.stride) {
+                *out = makeCell(target, fill);
+                target.nulls[to].append(column.fillNull);
+            }
+            continue;
+        }
+        const Cell* in = source.cells.data() + first * source.stride + column.slot;
+        bool strings = column.type == ColumnType::STRING;
+        for (size_t i = 0; i < n; i++, in += source.stride, out += target.stride) {
+            if (strings && in->length > kInlineChars) {
+                *out = makeCell(target, readString(*in, source.arena.data()));
+            } else {
+                *out = *in;
+            }
+        }
+        target.nulls[to].appendRange(source.nulls[column.slot].data(), first, n);
+    }
+    target.rows += n;
+}
+
+// Rewrites every block with one slot per column: dropped slots go, and
+// columns added since a block was written get their fill written out
+void RowStorage::repack() {
+    std::vector<std::shared_ptr<Block>> packed;
+    packed.reserve(blocks.size());
+    for (const auto& block : blocks) {
+        auto target = std::make_shared<Block>();
+        target->stride = columns.size();
+        target->nulls.resize(columns.size());
+        copyRows(*block, 0, block->rows, *target, true);
+        packed.push_back(std::move(target));
+    }
+    blocks = std::move(packed);
+    for (size_t c = 0; c < columns.size(); c++) {
+        columns[c].slot = c;
+    }
+    slots = columns.size();
+    deadSlots = 0;
+}
+
+// Hands out a new slot and writes nothing: existing blocks don't have the
+// slot, so their rows read as the fill
+void RowStorage::addColumn(ColumnType type, const Value& fill) {
+    if (!isNull(fill) && fill.index() != variantIndexFor(type)) {
+        throw std::invalid_argument("Value type doesn't match column type");
+    }
+    ColumnSlot column;
+    column.type = type;
+    column.slot = slots++;
+    column.fillNull = isNull(fill);
+    if (!column.fillNull) {
+        Block scratch;
+        column.fill = makeCell(scratch, toValueRef(fill));
+        column.fillText.assign(scratch.arena.data(), scratch.arena.size());
+    }
+    columns.push_back(std::move(column));
+}
+
+// The column's slot is left in the rows until the next compact()
+void RowStorage::dropColumn(size_t col) {
+    if (col >= columns.size()) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    columns.erase(columns.begin() + col);
+    deadSlots++;
+    if (columns.empty()) {
+        clear();
+    }
+}
+
+void RowStorage::compact() {
+    if (deadSlots > 0) {
+        repack();
+    }
+}
+
+void RowStorage::clearColumns() {
+    columns.clear();
+    clear();
+}
+
+void RowStorage::appendRow(const Row& row) {
+    checkRow(row);
+    Block& block = tail();
+    Cell* cells = block.cells.grow(block.stride);
+    std::fill_n(cells, block.stride, Cell());
+    for (size_t c = 0; c < columns.size(); c++) {
+        const ColumnSlot& column = columns[c];
+        const Value& value = row.getValue(static_cast<int>(c));
+        cells[column.slot] = makeCell(block, toValueRef(value));
+        block.nulls[column.slot].append(isNull(value));
+    }
+    block.rows++;
+    rowCount++;
+}
+
+void RowStorage::appendChunks(std::vector<ColumnChunk>& chunks) {
+    if (chunks.size() != columns.size()) {
+        throw std::invalid_argument("Chunk count doesn't match table schema");
+    }
+    size_t n = chunks.empty() ? 0 : chunks[0].size();
+    for (size_t done = 0; done < n;) {
+        Block& block = tail();
+        size_t take = std::min(n - done, kBlockRows - block.rows);
+        Cell* rows = block.cells.grow(take * block.stride);
+        std::fill_n(rows, take * block.stride, Cell());
+        for (size_t c = 0; c < chunks.size(); c++) {
+            const ColumnSlot& column = columns[c];
+            Cell* out = rows + column.slot;
+            for (size_t i = done; i < done + take; i++, out += block.stride) {
+                *out = chunks[c].isNull(i) ? Cell() : makeCell(block, chunks[c].get(i));
+            }
+            block.nulls[column.slot].appendRange(chunks[c].nullBits(), done, take);
+        }
+        block.rows += take;
+        done += take;
+    }
+    rowCount += n;
+}
+
+void RowStorage::updateRow(size_t idx, const Row& row) {
+    if (idx >= rowCount) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    checkRow(row);
+    Block& block = writable(idx / kBlockRows);
+    size_t r = idx % kBlockRows;
+    Cell* cells = block.cells.mutableData();
+    for (size_t c = 0; c < columns.size(); c++) {
+        const ColumnSlot& column = columns[c];
+        const Value& value = row.getValue(static_cast<int>(c));
+        Cell& target = cells[r * block.stride + column.slot];
+        releaseCell(block, column.type, target);
+        target = makeCell(block, toValueRef(value));
+        block.nulls[column.slot].set(r, isNull(value));
+    }
+    compactArena(block, columns);
+}
+
+void RowStorage::eraseRow(size_t idx) {
+    if (idx >= rowCount) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    std::vector<uint64_t> erased((rowCount + 63) / 64, 0);
+    erased[idx >> 6] |= uint64_t(1) << (idx & 63);
+    eraseRows(erased.data());
+}
+
+// Copies the runs of kept rows into new blocks, except that a block kept
+// whole which lands on a block boundary is kept as is (still shared with
+// any snapshot), so erasing near the end leaves earlier blocks alone
+void RowStorage::eraseRows(const uint64_t* erased) {
+    std::vector<std::shared_ptr<Block>> kept;
+    size_t keptRows = 0;
+    forEachClearRun(erased, rowCount, [&](size_t first, size_t n) {
+        while (n > 0) {
+            const std::shared_ptr<Block>& source = blocks[first / kBlockRows];
+            size_t offset = first % kBlockRows;
+            bool aligned = keptRows % kBlockRows == 0;
+            if (aligned && offset == 0 && n >= source->rows) {
+                kept.push_back(source);
+            } else {
+                if (aligned) {
+                    kept.push_back(std::make_shared<Block>());
+                    kept.back()->stride = slots;
+                    kept.back()->nulls.resize(slots);
+                }
+                size_t take = std::min({n, source->rows - offset, kBlockRows - kept.back()->rows});
+                copyRows(*source, offset, take, *kept.back(), false);
+                first += take;
+                n -= take;
+                keptRows += take;
+                continue;
+            }
+            first += source->rows;
+            n -= source->rows;
+            keptRows += source->rows;
+        }
+    });
+    blocks = std::move(kept);
+    rowCount = keptRows;
+}
+
+// Frees all blocks. With no rows left, every column gets a slot in the
+// (empty) rows again.
+void RowStorage::clear() {
+    std::vector<std::shared_ptr<Block>>().swap(blocks);
+    for (size_t c = 0; c < columns.size(); c++) {
+        columns[c].slot = c;
+    }
+    slots = columns.size();
+    deadSlots = 0;
+    rowCount = 0;
+}
+
+ValueRef RowStorage::getValue(size_t row, size_t col) const {
+    if (row >= rowCount || col >= columns.size()) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    const ColumnSlot& column = columns[col];
+    const Block& block = *blocks[row / kBlockRows];
+    size_t r = row % kBlockRows;
+    if (column.slot >= block.stride) {
+        return fillValue(column);
+    }
+    if (block.nulls[column.slot].test(r)) {
+        return std::monostate{};
+    }
+    return readCell(block.cells[r * block.stride + column.slot], column.type, block.arena.data());
+}
+
+Row RowStorage::getRow(size_t row) const {
+    if (row >= rowCount) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    Row result;
+    for (size_t col = 0; col < columns.size(); col++) {
+        result.addValue(toValue(getValue(row, col)));
+    }
+    return result;
+}
+
+const int* RowStorage::getInts(size_t col, size_t first, size_t count, std::vector<int>& scratch) const {
+    scratch.resize(count);
+    forEachCell(columns[col], first, count, [&](size_t i, const Cell& cell, const char*) {
+        std::memcpy(&scratch[i], cell.payload, sizeof(int));
+    });
+    return scratch.data();
+}
+
+const float* RowStorage::getFloats(size_t col, size_t first, size_t count, std::vector<float>& scratch) const {
+    scratch.resize(count);
+    forEachCell(columns[col], first, count, [&](size_t i, const Cell& cell, const char*) {
+        std::memcpy(&scratch[i], cell.payload, sizeof(float));
+    });
+    return scratch.data();
+}
+
+void RowStorage::getBools(size_t col, size_t first, size_t count, uint64_t* out) const {
+    for (size_t w = 0; w * 64 < count; w++) {
+        out[w] = 0;
+    }
+    forEachCell(columns[col], first, count, [&](size_t i, const Cell& cell, const char*) {
+        if (cell.payload[0]) {
+            out[i >> 6] |= uint64_t(1) << (i & 63);
+        }
+    });
+}
+
+void RowStorage::getStrings(size_t col, size_t first, size_t count, std::vector<std::string_view>& out) const {
+    out.resize(count);
+    forEachCell(columns[col], first, count, [&](size_t i, const Cell& cell, const char* arena) {
+        out[i] = readString(cell, arena);
+    });
+}
+
+// Batches inside one block that has the column's slot point straight into
+// its bitmap; the rest are gathered
+const uint64_t* RowStorage::getNulls(size_t col, size_t first, size_t count, std::vector<uint64_t>& scratch) const {
+    if (count == 0) {
+        return nullptr;
+    }
+    const ColumnSlot& column = columns[col];
+    const Block& block = *blocks[first / kBlockRows];
+    size_t r = first % kBlockRows;
+    if (count <= block.rows - r && column.slot < block.stride) {
+        const uint64_t* bits = block.nulls[column.slot].data();
+        return bits ? bits + r / 64 : nullptr;
+    }
+    bool any = false;
+    scratch.assign((count + 63) / 64, 0);
+    for (size_t i = 0; i < count;) {
+        const Block& source = *blocks[(first + i) / kBlockRows];
+        size_t offset = (first + i) % kBlockRows;
+        size_t n = std::min(count - i, source.rows - offset);
+        for (size_t j = 0; j < n; j++) {
+            bool null = column.slot < source.stride ? source.nulls[column.slot].test(offset + j) : column.fillNull;
+            if (null) {
+                scratch[(i + j) >> 6] |= uint64_t(1) << ((i + j) & 63);
+                any = true;
+            }
+        }
+        i += n;
+    }
+    return any ? scratch.data() : nullptr;
+}
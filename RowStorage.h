@@ -0,0 +1,132 @@
+#ifndef ROWSTORAGE_H
+#define ROWSTORAGE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AppendBuffer.h"
+#include "NullBitmap.h"
+#include "TableStorage.h"
+
+// Row-oriented layout: the cells of each record are stored next to each
+// other in fixed 16-byte cells, so a row is a contiguous run of memory and
+// a scan walks it in order. Rows are kept in blocks of kBlockRows. Strings
+// of up to kInlineChars bytes sit inside their cell; longer ones are an
+// offset into the block's character arena, which is compacted once dead
+// strings (from updates) take up half of it. NULLs are flagged in one
+// NullBitmap per slot and block; their cells stay zeroed.
+//
+// Blocks are shared between a table and its snapshots (see clone()); a
+// shared block is copied before it is written, so a snapshot keeps seeing
+// the rows it was taken with. The copy shares the cells and arena until
+// existing ones change: rows appended go past the end of the snapshot's
+// (see AppendBuffer), so appending to a shared last block copies no rows.
+//
+// Schema changes leave the rows where they are. Each column owns a slot,
+// a cell position within the row; a dropped column's slot stays in the
+// rows, unused, until compact() repacks all blocks. An added column gets
+// a new slot that blocks written before don't have: their rows read as the
+// column's fill value until the block is next written, when it is widened
+// to every slot handed out.
+class RowStorage : public TableStorage {
+private:
+    static constexpr size_t kInlineChars = 12;
+    static constexpr size_t kBlockRows = 8192; // a multiple of the scan batch
+
+    struct Cell {
+        uint32_t length = 0;           // STRING byte count
+        char payload[kInlineChars] = {}; // INT/FLOAT/BOOLEAN bits, an inline string or an arena offset
+    };
+
+    struct Block {
+        AppendBuffer<Cell> cells;      // rows * stride, row by row
+        size_t stride = 0;             // slots per row; later slots read as their column's fill
+        size_t rows = 0;
+        std::vector<NullBitmap> nulls; // per slot
+        AppendBuffer<char> arena;      // long strings
+        size_t deadChars = 0;          // arena bytes no cell refers to any more
+    };
+
+    struct ColumnSlot {
+        ColumnType type;
+        size_t slot = 0;
+        Cell fill;            // what rows of blocks without the slot read as
+        bool fillNull = false;
+        std::string fillText; // a long STRING fill, at offset 0 of fill
+    };
+
+    std::vector<ColumnSlot> columns;
+    std::vector<std::shared_ptr<Block>> blocks;
+    size_t slots = 0;      // slots handed out
+    size_t deadSlots = 0;
+    size_t rowCount = 0;
+
+    void checkRow(const Row& row) const;
+    static Cell makeCell(Block& block, const ValueRef& value);
+    static void releaseCell(Block& block, ColumnType type, const Cell& cell);
+    static std::string_view readString(const Cell& cell, const char* arena);
+    static ValueRef readCell(const Cell& cell, ColumnType type, const char* arena);
+    static void compactArena(Block& block, const std::vector<ColumnSlot>& columns);
+    ValueRef fillValue(const ColumnSlot& column) const;
+    Block& writable(size_t block); // unshares and widens the block
+    Block& tail();                 // block the next row goes into
+    Block& newBlock(size_t stride);
+    void widen(Block& block);
+    // Appends rows [first, first + n) of source to target, whose stride is
+    // either the current slots (packed false) or one slot per column
+    void copyRows(const Block& source, size_t first, size_t n, Block& target, bool packed) const;
+    void repack();
+
+    // Calls f(i, cell, arena) for rows [first, first + count) of a column
+    template <typename F>
+    void forEachCell(const ColumnSlot& column, size_t first, size_t count, F&& f) const {
+        for (size_t i = 0; i < count;) {
+            const Block& block = *blocks[(first + i) / kBlockRows];
+            size_t r = (first + i) % kBlockRows;
+            size_t n = std::min(count - i, block.rows - r);
+            if (column.slot < block.stride) {
+                const Cell* cell = block.cells.data() + r * block.stride + column.slot;
+                for (size_t j = 0; j < n; j++, cell += block.stride) {
+                    f(i + j, *cell, block.arena.data());
+                }
+            } else {
+                for (size_t j = 0; j < n; j++) {
+                    f(i + j, column.fill, column.fillText.data());
+                }
+            }
+            i += n;
+        }
+    }
+
+public:
+    RowStorage() = default;
+
+    std::unique_ptr<TableStorage> clone() const override;
+    StorageMode getMode() const override;
+    size_t getRowCount() const override;
+
+    void addColumn(ColumnType type, const Value& fill) override;
+    void dropColumn(size_t col) override;
+    void clearColumns() override;
+    void compact() override;
+
+    void appendRow(const Row& row) override;
+    void appendChunks(std::vector<ColumnChunk>& chunks) override;
+    void updateRow(size_t idx, const Row& row) override;
+    void eraseRow(size_t idx) override;
+    void eraseRows(const uint64_t* erased) override;
+    void clear() override;
+
+    ValueRef getValue(size_t row, size_t col) const override;
+    Row getRow(size_t row) const override;
+
+    const int* getInts(size_t col, size_t first, size_t count, std::vector<int>& scratch) const override;
+    const float* getFloats(size_t col, size_t first, size_t count, std::vector<float>& scratch) const override;
+    void getBools(size_t col, size_t first, size_t count, uint64_t* out) const override;
+    void getStrings(size_t col, size_t first, size_t count, std::vector<std::string_view>& out) const override;
+    const uint64_t* getNulls(size_t col, size_t first, size_t count, std::vector<uint64_t>& scratch) const override;
+};
+
+#endif //ROWSTORAGE_H
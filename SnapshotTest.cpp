@@ -0,0 +1,195 @@
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Database.h"
+#include "Filter.h"
+
+// Snapshot isolation: a snapshot never changes after it is taken, and one
+// taken while a writer runs shows the table as of a whole write, never part
+// of one. The writer keeps the invariants below true between writes only.
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static std::unique_ptr<Predicate> idEquals(int id) {
+    auto predicate = std::make_unique<Predicate>();
+    predicate->kind = PredicateKind::COMPARE;
+    predicate->op = CompareOp::EQ;
+    predicate->column = 0;
+    predicate->type = ColumnType::INT;
+    predicate->literals.push_back(id);
+    return predicate;
+}
+
+static std::vector<size_t> rowsWithId(const Table& table, int id) {
+    std::vector<size_t> rows;
+    Filter(table, idEquals(id)).forEachMatch([&](size_t r) { rows.push_back(r); });
+    return rows;
+}
+
+static Row pair(int id, int v) {
+    Row row;
+    row.addValue(id);
+    row.addValue(v);
+    row.addValue("value " + std::to_string(id));
+    return row;
+}
+
+// Every write leaves pairs of rows (id, v) and (id, -v): the live rows
+// come in pairs, sum to zero and carry their id in the string column
+struct Totals {
+    size_t rows = 0;
+    long long sum = 0;
+    bool strings = true;
+};
+
+static Totals totals(const Table& table) {
+    Totals t;
+    Filter(table, nullptr).forEachMatch([&](size_t r) {
+        int id = std::get<int>(table.getValue(r, 0));
+        t.sum += std::get<int>(table.getValue(r, 1));
+        t.strings &= std::get<std::string_view>(table.getValue(r, 2)) == "value " + std::to_string(id);
+        t.rows++;
+    });
+    return t;
+}
+
+// A snapshot stays as it was while the table is appended to, deleted
+// from, updated and compacted
+static void testFrozen(StorageMode mode) {
+    Table table("t", mode);
+    table.addColumn(Column("id", ColumnType::INT));
+    table.addColumn(Column("v", ColumnType::INT));
+    table.addColumn(Column("s", ColumnType::STRING));
+    const int ids = 70000; // more than one zone and chunk
+    {
+        Table::WriteLock write = table.lockForWrite();
+        std::vector<Row> rows;
+        for (int id = 0; id < ids; id++) {
+            rows.push_back(pair(id, id));
+            rows.push_back(pair(id, -id));
+        }
+        table.addRows(rows);
+    }
+    std::shared_ptr<const Table> before = table.readSnapshot();
+    {
+        Table::WriteLock write = table.lockForWrite();
+        table.addRows({pair(ids, 5), pair(ids, -5)});
+        std::vector<size_t> deleted;
+        for (int id = 0; id < ids; id += 3) {
+            for (size_t r : rowsWithId(table, id)) {
+                deleted.push_back(r);
+            }
+        }
+        table.deleteRows(deleted);
+        std::vector<size_t> updated = rowsWithId(table, 1);
+        table.updateRows(updated, {pair(1, 1000), pair(1, -1000)});
+        table.compact();
+    }
+    std::shared_ptr<const Table> after = table.readSnapshot();
+
+    Totals old = totals(*before);
+    check(before->getRowCount() == 2 * ids && before->getLiveRowCount() == 2 * ids, "snapshot keeps its row count");
+    check(old.rows == 2 * ids && old.sum == 0 && old.strings, "snapshot keeps its rows");
+    check(std::get<int>(before->getValue(2, 1)) == 1, "snapshot keeps updated values");
+
+    Totals now = totals(*after);
+    size_t live = 2 * (ids - (ids + 2) / 3 + 1);
+    check(after->getLiveRowCount() == live && now.rows == live, "new snapshot sees the writes");
+    check(now.sum == 0 && now.strings, "new snapshot is consistent");
+    check(rowsWithId(*after, 0).empty() && rowsWithId(*after, ids).size() == 2, "new snapshot sees deletes and inserts");
+    check(table.readSnapshot() == after, "unchanged table hands out the same snapshot");
+}
+
+// Readers check the invariants on snapshots taken while a writer inserts,
+// deletes and updates pairs
+static void testConcurrent(StorageMode mode) {
+    Database db;
+    db.createTable("t", mode);
+    std::shared_ptr<Table> table = db.GetTable("t");
+    table->addColumn(Column("id", ColumnType::INT));
+    table->addColumn(Column("v", ColumnType::INT));
+    table->addColumn(Column("s", ColumnType::STRING));
+    table->createIndex("t_id", "id", IndexType::HASH);
+
+    const int writes = 20000;
+    std::atomic<bool> done{false};
+    std::atomic<int> bad{0};
+    std::atomic<long> snapshots{0};
+    std::thread writer([&] {
+        std::mt19937 random(1);
+        for (int id = 0; id < writes; id++) {
+            Table::WriteLock write = table->lockForWrite();
+            table->addRows({pair(id, id + 1), pair(id, -(id + 1))});
+            if (id % 3 == 2) {
+                table->deleteRows(rowsWithId(*table, static_cast<int>(random() % id)));
+            }
+            if (id % 5 == 4) {
+                int victim = static_cast<int>(random() % id);
+                std::vector<size_t> rows = rowsWithId(*table, victim);
+                if (rows.size() == 2) {
+                    table->updateRows(rows, {pair(victim, 7), pair(victim, -7)});
+                }
+            }
+        }
+        done = true;
+    });
+    std::vector<std::thread> readers;
+    for (int k = 0; k < 2; k++) {
+        readers.emplace_back([&, k] {
+            std::mt19937 random(k + 10);
+            do {
+                std::shared_ptr<const Table> snapshot = table->readSnapshot();
+                Totals t = totals(*snapshot);
+                // The snapshot doesn't move under the reader
+                Totals again = totals(*snapshot);
+                if (t.sum != 0 || t.rows % 2 != 0 || !t.strings || t.rows != snapshot->getLiveRowCount() ||
+                    again.rows != t.rows || again.sum != t.sum) {
+                    bad++;
+                }
+                // Index lookups on the snapshot agree with a scan of it
+                if (t.rows > 0) {
+                    int id = static_cast<int>(random() % (t.rows / 2));
+                    size_t scanned = 0;
+                    for (size_t r = 0; r < snapshot->getRowCount(); r++) {
+                        scanned += !snapshot->isDeleted(r) && std::get<int>(snapshot->getValue(r, 0)) == id;
+                    }
+                    if (rowsWithId(*snapshot, id).size() != scanned || scanned % 2 != 0) {
+                        bad++;
+                    }
+                }
+                snapshots++;
+            } while (!done);
+        });
+    }
+    writer.join();
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    check(bad == 0, "concurrent snapshots are consistent");
+    check(snapshots > 0, "readers took snapshots");
+    Totals t = totals(*table->readSnapshot());
+    check(t.sum == 0 && t.rows == table->getLiveRowCount(), "final snapshot is consistent");
+}
+
+int main() {
+    for (StorageMode mode : {StorageMode::ROW, StorageMode::COLUMNAR}) {
+        testFrozen(mode);
+        testConcurrent(mode);
+    }
+    if (failures > 0) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
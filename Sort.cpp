@@ -0,0 +1,280 @@
+#include "Sort.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+// Fewest slots worth a run of their own in the parallel sort
+static constexpr size_t kMinRunSlots = 1 << 14;
+
+SortBuffer::SortBuffer(const Table& table, const std::vector<SortKey>& sortKeys, size_t limit)
+    : table(table), limit(limit) {
+    const auto& columns = table.getColumns();
+    for (const SortKey& sortKey : sortKeys) {
+        KeyColumn key;
+        key.column = sortKey.column;
+        key.type = columns[sortKey.column].getType();
+        key.descending = sortKey.descending;
+        keys.push_back(std::move(key));
+    }
+}
+
+void SortBuffer::loadBatch(size_t first, size_t count) {
+    const TableStorage& storage = table.getStorage();
+    for (KeyColumn& key : keys) {
+        key.batchNulls = storage.getNulls(key.column, first, count, key.nullScratch);
+        switch (key.type) {
+            case ColumnType::INT:
+                key.batchInts = storage.getInts(key.column, first, count, key.intScratch);
+                break;
+            case ColumnType::FLOAT:
+                key.batchFloats = storage.getFloats(key.column, first, count, key.floatScratch);
+                break;
+            case ColumnType::BOOLEAN:
+                storage.getBools(key.column, first, count, key.batchBools);
+                break;
+            case ColumnType::STRING:
+                storage.getStrings(key.column, first, count, key.batchStrings);
+                break;
+        }
+    }
+}
+
+void SortBuffer::reserveSlot(size_t slot) {
+    if (slot < rows.size()) {
+        return;
+    }
+    rows.resize(slot + 1);
+    for (KeyColumn& key : keys) {
+        key.nulls.resize(slot + 1);
+        switch (key.type) {
+            case ColumnType::INT:
+            case ColumnType::BOOLEAN:
+                key.ints.resize(slot + 1);
+                break;
+            case ColumnType::FLOAT:
+                key.floats.resize(slot + 1);
+                break;
+            case ColumnType::STRING:
+                key.strings.resize(slot + 1);
+                break;
+        }
+    }
+}
+
+void SortBuffer::store(size_t slot, size_t row, size_t i) {
+    rows[slot] = row;
+    for (KeyColumn& key : keys) {
+        key.nulls[slot] = key.batchNulls && ((key.batchNulls[i >> 6] >> (i & 63)) & 1);
+        switch (key.type) {
+            case ColumnType::INT:
+                key.ints[slot] = key.batchInts[i];
+                break;
+            case ColumnType::BOOLEAN:
+                key.ints[slot] = static_cast<int>((key.batchBools[i >> 6] >> (i & 63)) & 1);
+                break;
+            case ColumnType::FLOAT:
+                key.floats[slot] = key.batchFloats[i];
+                break;
+            case ColumnType::STRING:
+                key.strings[slot] = key.batchStrings[i];
+                break;
+        }
+    }
+}
+
+void SortBuffer::copySlot(size_t slot, const SortBuffer& from, size_t fromSlot) {
+    rows[slot] = from.rows[fromSlot];
+    for (size_t k = 0; k < keys.size(); k++) {
+        KeyColumn& key = keys[k];
+        const KeyColumn& source = from.keys[k];
+        key.nulls[slot] = source.nulls[fromSlot];
+        switch (key.type) {
+            case ColumnType::INT:
+            case ColumnType::BOOLEAN:
+                key.ints[slot] = source.ints[fromSlot];
+                break;
+            case ColumnType::FLOAT:
+                key.floats[slot] = source.floats[fromSlot];
+                break;
+            case ColumnType::STRING:
+                key.strings[slot] = source.strings[fromSlot];
+                break;
+        }
+    }
+}
+
+// The heap is ordered by less(), so its top is the kept row that sorts last
+// and the first to go when a row sorting before it turns up
+void SortBuffer::offer() {
+    auto cmp = [this](size_t a, size_t b) { return less(a, b); };
+    if (heap.size() < limit) {
+        heap.push_back(spare);
+        std::push_heap(heap.begin(), heap.end(), cmp);
+        spare = heap.size(); // nothing has been evicted yet, so this slot is unused
+    } else if (less(spare, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), cmp);
+        std::swap(heap.back(), spare);
+        std::push_heap(heap.begin(), heap.end(), cmp);
+    }
+}
+
+int SortBuffer::compare(const KeyColumn& key, size_t a, size_t b) const {
+    if (key.nulls[a] | key.nulls[b]) {
+        return int(key.nulls[a]) - int(key.nulls[b]);
+    }
+    switch (key.type) {
+        case ColumnType::INT:
+        case ColumnType::BOOLEAN:
+            return (key.ints[a] > key.ints[b]) - (key.ints[a] < key.ints[b]);
+        case ColumnType::FLOAT:
+            return (key.floats[a] > key.floats[b]) - (key.floats[a] < key.floats[b]);
+        case ColumnType::STRING:
+            return key.strings[a].compare(key.strings[b]);
+    }
+    return 0;
+}
+
+bool SortBuffer::less(size_t a, size_t b) const {
+    for (const KeyColumn& key : keys) {
+        int c = compare(key, a, b);
+        if (c != 0) {
+            return key.descending ? c > 0 : c < 0;
+        }
+    }
+    return rows[a] < rows[b];
+}
+
+void SortBuffer::consume(size_t first, size_t count, const Selection& sel) {
+    bool any = false;
+    for (size_t w = 0; w < kBatchWords; w++) {
+        any |= sel.words[w] != 0;
+    }
+    if (!any || limit == 0) {
+        return;
+    }
+    loadBatch(first, count);
+    for (size_t w = 0; w < kBatchWords; w++) {
+        for (uint64_t bits = sel.words[w]; bits; bits &= bits - 1) {
+            size_t i = w * 64 + static_cast<size_t>(std::countr_zero(bits));
+            size_t slot = limit == kNoLimit ? rows.size() : spare;
+            reserveSlot(slot);
+            store(slot, first + i, i);
+            if (limit != kNoLimit) {
+                offer();
+            }
+        }
+    }
+}
+
+void SortBuffer::merge(const SortBuffer& other) {
+    if (limit == kNoLimit) {
+        rows.insert(rows.end(), other.rows.begin(), other.rows.end());
+        for (size_t k = 0; k < keys.size(); k++) {
+            KeyColumn& key = keys[k];
+            const KeyColumn& source = other.keys[k];
+            key.nulls.insert(key.nulls.end(), source.nulls.begin(), source.nulls.end());
+            key.ints.insert(key.ints.end(), source.ints.begin(), source.ints.end());
+            key.floats.insert(key.floats.end(), source.floats.begin(), source.floats.end());
+            key.strings.insert(key.strings.end(), source.strings.begin(), source.strings.end());
+        }
+        return;
+    }
+    for (size_t slot : other.heap) {
+        reserveSlot(spare);
+        copySlot(spare, other, slot);
+        offer();
+    }
+}
+
+// Order-preserving image of the slot's first key: a smaller prefix sorts
+// first, equal prefixes need the full comparison. Exact for numbers and
+// booleans (NULL above every value); STRING prefixes are the first 8 bytes.
+uint64_t SortBuffer::prefix(size_t slot) const {
+    const KeyColumn& key = keys[0];
+    uint64_t p = ~uint64_t(0);
+    if (!key.nulls[slot]) {
+        switch (key.type) {
+            case ColumnType::INT:
+            case ColumnType::BOOLEAN:
+                p = static_cast<uint32_t>(key.ints[slot]) ^ 0x80000000u;
+                break;
+            case ColumnType::FLOAT: {
+                float v = key.floats[slot] == 0.0f ? 0.0f : key.floats[slot]; // -0 equals +0
+                uint32_t bits;
+                std::memcpy(&bits, &v, sizeof(bits));
+                p = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+                break;
+            }
+            case ColumnType::STRING: {
+                std::string_view text = key.strings[slot];
+                p = 0;
+                for (size_t i = 0; i < 8; i++) {
+                    p = (p << 8) | (i < text.size() ? static_cast<unsigned char>(text[i]) : 0u);
+                }
+                break;
+            }
+        }
+    }
+    return key.descending ? ~p : p;
+}
+
+std::vector<size_t> SortBuffer::sortedRows(ThreadPool& pool) const {
+    // Entries carry what most comparisons need, so sorting mostly stays
+    // within the entry array instead of visiting the key columns
+    struct Entry {
+        uint64_t prefix;
+        size_t row;
+        size_t slot;
+    };
+    std::vector<Entry> entries(limit == kNoLimit ? rows.size() : heap.size());
+    size_t n = entries.size();
+    size_t runs = std::clamp<size_t>(n / kMinRunSlots, 1, pool.getThreadCount());
+    std::vector<size_t> bounds(runs + 1);
+    for (size_t r = 0; r <= runs; r++) {
+        bounds[r] = n * r / runs;
+    }
+
+    bool exact = keys.size() == 1 && keys[0].type != ColumnType::STRING;
+    auto cmp = [&](const Entry& a, const Entry& b) {
+        if (a.prefix != b.prefix) {
+            return a.prefix < b.prefix;
+        }
+        return exact ? a.row < b.row : less(a.slot, b.slot);
+    };
+    pool.parallelFor(runs, [&](size_t r, size_t) {
+        for (size_t i = bounds[r]; i < bounds[r + 1]; i++) {
+            size_t slot = limit == kNoLimit ? i : heap[i];
+            entries[i] = {prefix(slot), rows[slot], slot};
+        }
+        std::sort(entries.begin() + bounds[r], entries.begin() + bounds[r + 1], cmp);
+    });
+    // Each round merges neighbouring pairs of sorted runs into runs twice
+    // as long, the pairs in parallel
+    std::vector<Entry> merged(runs > 1 ? n : 0);
+    for (size_t width = 1; width < runs; width *= 2) {
+        size_t pairs = (runs + 2 * width - 1) / (2 * width);
+        pool.parallelFor(pairs, [&](size_t p, size_t) {
+            size_t lo = bounds[2 * p * width];
+            size_t mid = bounds[std::min(runs, (2 * p + 1) * width)];
+            size_t hi = bounds[std::min(runs, (2 * p + 2) * width)];
+            std::merge(entries.begin() + lo, entries.begin() + mid, entries.begin() + mid, entries.begin() + hi,
+                       merged.begin() + lo, cmp);
+        });
+        entries.swap(merged);
+    }
+
+    std::vector<size_t> sorted(n);
+    for (size_t i = 0; i < n; i++) {
+        sorted[i] = entries[i].row;
+    }
+    return sorted;
+}
+
+size_t SortBuffer::getMemoryUsage() const {
+    size_t bytes = (rows.capacity() + heap.capacity()) * sizeof(size_t);
+    for (const KeyColumn& key : keys) {
+        bytes += key.ints.capacity() * sizeof(int) + key.floats.capacity() * sizeof(float) +
+                 key.strings.capacity() * sizeof(std::string_view) + key.nulls.capacity();
+    }
+    return bytes;
+}
@@ -0,0 +1,76 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "Filter.h"
+
+struct SortKey {
+    int column;
+    bool descending = false;
+};
+
+// Collects the rows a Filter selects together with their ORDER BY keys,
+// gathered per batch into typed arrays so that comparisons work on ints,
+// floats and string views (into table storage, valid while the table is
+// unchanged) instead of Values. With a limit only the first `limit` rows in
+// sort order are kept, in a bounded max-heap whose evicted slots are reused.
+// Every worker of a parallel scan fills its own buffer and the partials are
+// merged. NULLs sort after every value, so first when descending; ties keep
+// row order.
+class SortBuffer {
+private:
+    struct KeyColumn {
+        int column;
+        ColumnType type;
+        bool descending;
+        std::vector<int> ints; // INT, and BOOLEAN as 0/1
+        std::vector<float> floats;
+        std::vector<std::string_view> strings;
+        std::vector<uint8_t> nulls;
+
+        // The current batch, fetched once per batch
+        std::vector<int> intScratch;
+        std::vector<float> floatScratch;
+        const int* batchInts = nullptr;
+        const float* batchFloats = nullptr;
+        uint64_t batchBools[kBatchWords] = {};
+        std::vector<std::string_view> batchStrings;
+        std::vector<uint64_t> nullScratch;
+        const uint64_t* batchNulls = nullptr; // null when the batch has no NULLs
+    };
+
+    const Table& table;
+    size_t limit;
+    std::vector<KeyColumn> keys;
+    std::vector<size_t> rows; // row of each slot
+    std::vector<size_t> heap; // with a limit: the kept slots, the last in sort order on top
+    size_t spare = 0;         // with a limit: the slot the next candidate is written to
+
+    void loadBatch(size_t first, size_t count);
+    void reserveSlot(size_t slot);
+    void store(size_t slot, size_t row, size_t i); // i: index in the loaded batch
+    void copySlot(size_t slot, const SortBuffer& from, size_t fromSlot);
+    void offer(); // keeps the spare slot if it is among the first `limit`
+    int compare(const KeyColumn& key, size_t a, size_t b) const;
+    uint64_t prefix(size_t slot) const;
+    bool less(size_t a, size_t b) const;
+
+public:
+    static constexpr size_t kNoLimit = static_cast<size_t>(-1);
+
+    SortBuffer(const Table& table, const std::vector<SortKey>& keys, size_t limit = kNoLimit);
+
+    // Adds the selected rows of the batch [first, first + count)
+    void consume(size_t first, size_t count, const Selection& sel);
+    void merge(const SortBuffer& other);
+
+    // The collected rows in sort order: a merge sort whose runs are sorted
+    // on the pool's workers, then merged pairwise, also in parallel.
+    std::vector<size_t> sortedRows(ThreadPool& pool) const;
+
+    size_t getMemoryUsage() const; // bytes of the collected rows and keys
+};
+
+#endif //SORT_H
@@ -0,0 +1,227 @@
+#include "Statistics.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include "Filter.h"
+#include "Join.h"
+
+HyperLogLog::HyperLogLog() : registers(size_t(1) << kPrecision) {}
+
+// The top bits pick the register; the rest give the rank, with a guard bit
+// so a hash of all zeros still ends the run
+void HyperLogLog::add(uint64_t hash) {
+    uint8_t& reg = registers[hash >> (64 - kPrecision)];
+    uint64_t rest = (hash << kPrecision) | (uint64_t(1) << (kPrecision - 1));
+    reg = std::max(reg, static_cast<uint8_t>(std::countl_zero(rest) + 1));
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    for (size_t i = 0; i < registers.size(); i++) {
+        registers[i] = std::max(registers[i], other.registers[i]);
+    }
+}
+
+// Harmonic mean of the registers; while registers are still empty, linear
+// counting over them is the better estimate
+double HyperLogLog::estimate() const {
+    double m = static_cast<double>(registers.size());
+    double sum = 0;
+    size_t zeros = 0;
+    for (uint8_t reg : registers) {
+        sum += std::ldexp(1.0, -reg);
+        zeros += reg == 0;
+    }
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * std::log(m / static_cast<double>(zeros));
+    }
+    return estimate;
+}
+
+static bool asNumber(const Value& v, double& out) {
+    if (const int* i = std::get_if<int>(&v)) {
+        out = *i;
+    } else if (const float* f = std::get_if<float>(&v)) {
+        out = *f;
+    } else if (const bool* b = std::get_if<bool>(&v)) {
+        out = *b;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Where v lies between bounds a <= v <= b, from 0 to 1: linear for numbers,
+// halfway for strings
+static double positionIn(const Value& a, const Value& b, const Value& v) {
+    if (v == a) {
+        return 0;
+    }
+    if (v == b) {
+        return 1;
+    }
+    double x, lo, hi;
+    if (asNumber(v, x) && asNumber(a, lo) && asNumber(b, hi)) {
+        double position = (x - lo) / (hi - lo);
+        if (std::isfinite(position)) {
+            return std::clamp(position, 0.0, 1.0);
+        }
+    }
+    return 0.5;
+}
+
+double ColumnStatistics::fractionBelow(const Value& v, bool inclusive) const {
+    const std::vector<Value>& h = histogram;
+    auto it = inclusive ? std::upper_bound(h.begin(), h.end(), v) : std::lower_bound(h.begin(), h.end(), v);
+    size_t i = static_cast<size_t>(it - h.begin());
+    if (i == 0) {
+        return 0;
+    }
+    if (i == h.size()) {
+        return 1;
+    }
+    return (static_cast<double>(i - 1) + positionIn(h[i - 1], h[i], v)) / static_cast<double>(h.size() - 1);
+}
+
+// A bound repeated k + 1 times marks a frequent value holding about k
+// buckets' share of the rows; the other values split what is left evenly
+double ColumnStatistics::equalSelectivity(const Value& v) const {
+    if (distinct <= 0) {
+        return 0;
+    }
+    const std::vector<Value>& h = histogram;
+    double buckets = static_cast<double>(std::max<size_t>(h.size(), 2) - 1);
+    double frequentShare = 0;
+    double frequentValues = 0;
+    for (size_t i = 0; i < h.size();) {
+        size_t j = i;
+        while (j + 1 < h.size() && h[j + 1] == h[i]) {
+            j++;
+        }
+        if (j > i) {
+            double share = static_cast<double>(j - i) / buckets;
+            if (h[i] == v) {
+                return (1 - nullFraction) * share;
+            }
+            frequentShare += share;
+            frequentValues++;
+        }
+        i = j + 1;
+    }
+    double share = std::max(1 - frequentShare, 0.0) / std::max(distinct - frequentValues, 1.0);
+    return (1 - nullFraction) * share;
+}
+
+double ColumnStatistics::rangeSelectivity(const Value* lo, bool loInclusive, const Value* hi, bool hiInclusive) const {
+    if (histogram.empty()) {
+        return 0;
+    }
+    double upper = hi ? fractionBelow(*hi, hiInclusive) : 1;
+    double lower = lo ? fractionBelow(*lo, !loInclusive) : 0;
+    return (1 - nullFraction) * std::max(upper - lower, 0.0);
+}
+
+// Whether a row is in the sample: a hash of its position against a threshold,
+// so the sample doesn't depend on how morsels are spread over threads
+static bool sampled(size_t row, uint64_t threshold) {
+    uint64_t x = row + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x < threshold;
+}
+
+std::shared_ptr<TableStatistics> analyzeTable(const Table& table, ThreadPool& pool, size_t sampleRows) {
+    size_t columnCount = table.getColumnCount();
+    size_t liveRows = table.getLiveRowCount();
+    double rate = liveRows <= sampleRows ? 1.0 : static_cast<double>(sampleRows) / static_cast<double>(liveRows);
+    bool everyRow = rate >= 1.0;
+    uint64_t threshold = everyRow ? 0 : static_cast<uint64_t>(rate * 18446744073709551616.0);
+
+    // Per worker: a sketch, NULL count and key reader per column
+    struct WorkerState {
+        std::vector<HyperLogLog> sketches;
+        std::vector<size_t> nulls;
+        std::vector<JoinKeyReader> readers;
+    };
+    std::vector<WorkerState> workers(pool.getThreadCount());
+    for (WorkerState& state : workers) {
+        state.sketches.resize(columnCount);
+        state.nulls.resize(columnCount);
+        state.readers.reserve(columnCount);
+        for (size_t c = 0; c < columnCount; c++) {
+            state.readers.emplace_back(table, static_cast<int>(c));
+        }
+    }
+    Filter all(table, nullptr);
+    std::vector<std::vector<size_t>> samples(all.getMorselCount());
+    all.parallelForEachBatch(pool, [&](size_t worker, size_t morsel, size_t first, size_t count,
+                                       const Selection& sel) {
+        WorkerState& state = workers[worker];
+        for (size_t c = 0; c < columnCount; c++) {
+            JoinKeyReader& reader = state.readers[c];
+            reader.load(first, count);
+            for (size_t w = 0; w < kBatchWords; w++) {
+                for (uint64_t bits = sel.words[w]; bits; bits &= bits - 1) {
+                    JoinKey key = reader.key(w * 64 + static_cast<size_t>(std::countr_zero(bits)));
+                    if (key.null) {
+                        state.nulls[c]++;
+                    } else {
+                        state.sketches[c].add(key.hash);
+                    }
+                }
+            }
+        }
+        for (size_t w = 0; w < kBatchWords; w++) {
+            for (uint64_t bits = sel.words[w]; bits; bits &= bits - 1) {
+                size_t row = first + w * 64 + static_cast<size_t>(std::countr_zero(bits));
+                if (everyRow || sampled(row, threshold)) {
+                    samples[morsel].push_back(row);
+                }
+            }
+        }
+    });
+
+    auto stats = std::make_shared<TableStatistics>();
+    stats->rowCount = liveRows;
+    for (const auto& rows : samples) {
+        stats->sampledRows += rows.size();
+    }
+    stats->columns.resize(columnCount);
+    std::vector<Value> values;
+    for (size_t c = 0; c < columnCount; c++) {
+        ColumnStatistics& column = stats->columns[c];
+        HyperLogLog sketch;
+        size_t nulls = 0;
+        for (const WorkerState& state : workers) {
+            sketch.merge(state.sketches[c]);
+            nulls += state.nulls[c];
+        }
+        size_t nonNull = liveRows - nulls;
+        column.analyzed = true;
+        column.nullFraction = liveRows ? static_cast<double>(nulls) / static_cast<double>(liveRows) : 0;
+        column.distinct = nonNull ? std::clamp(sketch.estimate(), 1.0, static_cast<double>(nonNull)) : 0;
+
+        // NaN doesn't sort, and no comparison selects it anyway
+        values.clear();
+        for (const auto& rows : samples) {
+            for (size_t r : rows) {
+                Value v = toValue(table.getValue(r, c));
+                const float* f = std::get_if<float>(&v);
+                if (!isNull(v) && !(f && std::isnan(*f))) {
+                    values.push_back(std::move(v));
+                }
+            }
+        }
+        if (values.empty()) {
+            continue;
+        }
+        std::sort(values.begin(), values.end());
+        // Fewer values than buckets get a bound each, so none repeats by chance
+        size_t buckets = std::clamp<size_t>(values.size() - 1, 1, kHistogramBuckets);
+        for (size_t b = 0; b <= buckets; b++) {
+            column.histogram.push_back(values[b * (values.size() - 1) / buckets]);
+        }
+    }
+    return stats;
+}
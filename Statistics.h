@@ -0,0 +1,68 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Column.h"
+
+class Table;
+class ThreadPool;
+
+// Distinct-value sketch: 2^kPrecision one-byte registers, each holding the
+// longest run of leading zeros seen among the hashes routed to it. The
+// estimate is within a few percent (1.04 / sqrt(registers)) whatever the
+// number of values, and sketches of disjoint parts merge exactly.
+class HyperLogLog {
+public:
+    static constexpr int kPrecision = 12;
+
+private:
+    std::vector<uint8_t> registers;
+
+public:
+    HyperLogLog();
+
+    void add(uint64_t hash); // a well-mixed 64-bit hash of the value
+    void merge(const HyperLogLog& other);
+    double estimate() const;
+};
+
+// What ANALYZE found out about one column. The histogram holds equi-depth
+// bucket bounds of a sample of the non-NULL values: bucket i covers
+// [histogram[i], histogram[i + 1]] and holds an equal share of them, so a
+// value repeated across several bounds is a frequent one.
+struct ColumnStatistics {
+    bool analyzed = false; // false for columns added since
+    double nullFraction = 0;
+    double distinct = 0; // distinct non-NULL values
+    std::vector<Value> histogram;
+
+    // Share of all rows (NULLs included) where the column equals v, or lies
+    // within the bounds; a null bound is open
+    double equalSelectivity(const Value& v) const;
+    double rangeSelectivity(const Value* lo, bool loInclusive, const Value* hi, bool hiInclusive) const;
+
+private:
+    // Share of the non-NULL values below v, or at most v when inclusive
+    double fractionBelow(const Value& v, bool inclusive) const;
+};
+
+struct TableStatistics {
+    size_t rowCount = 0;    // live rows when analyzed
+    size_t sampledRows = 0; // rows the histograms come from
+    std::vector<ColumnStatistics> columns;
+};
+
+// Rows sampled per table unless told otherwise; like PostgreSQL's default of
+// 300 x 100 buckets, enough for the histograms' bounds to be within a
+// bucket of the truth
+constexpr size_t kSampleRows = 30000;
+constexpr size_t kHistogramBuckets = 100;
+
+// Scans every live row once in parallel for the distinct counts and NULL
+// fractions; histograms come from a uniform sample of about sampleRows rows
+std::shared_ptr<TableStatistics> analyzeTable(const Table& table, ThreadPool& pool,
+                                              size_t sampleRows = kSampleRows);
+
+#endif //STATISTICS_H
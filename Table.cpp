@@ -2,50 +2,258 @@
 // Created by chang liu on 16/05/2025.
 //
 #include"Table.h"
-Table::Table(const std::string& n)  { this->name = n; }
+#include "ResultSink.h"
+#include <atomic>
+#include <bit>
+
+static uint64_t nextSchemaVersion() {
+  static std::atomic<uint64_t> counter{0};
+  return ++counter;
+}
+
+// Published holds no snapshot until the first readSnapshot(); until then
+// writers don't pay for publishing. publishedLock is only ever held to copy
+// the pointer.
+struct Table::Versions {
+  std::mutex writer;
+  mutable std::mutex publishedLock;
+  std::shared_ptr<const Table> published;
+  std::atomic<uint64_t> changes{0};
+  std::atomic<uint64_t> released{0}; // changes as of the last write lock released
+  std::atomic<bool> wanted{false};   // a reader waits for a newer snapshot
+
+  std::shared_ptr<const Table> load() const {
+    std::lock_guard lock(publishedLock);
+    return published;
+  }
+  void store(std::shared_ptr<const Table> snapshot) {
+    std::lock_guard lock(publishedLock);
+    published.swap(snapshot);
+  }
+};
+
+Table::Table(const std::string& n, StorageMode mode)
+    : name(n), storage(makeTableStorage(mode)), indexes(std::make_shared<IndexSet>()),
+      schemaVersion(nextSchemaVersion()), versions(std::make_unique<Versions>()) {}
+Table::Table(const Table& t)
+    : name(t.name), columns(t.columns), storage(t.storage->clone()), indexes(t.indexes), indexLayout(t.indexLayout),
+      schemaVersion(t.schemaVersion), deleted(t.deleted), zones(t.zones),
+      statistics(t.statistics), version(t.versions->changes.load()) {}
+Table::Table(Table&&) noexcept = default;
+Table& Table::operator=(Table&&) noexcept = default;
 Table::~Table() =default;
 
 
-void Table::addColumn(const Column& c) {columns.push_back(c);};
-void Table::addRow(const Row& r) {rows.push_back(r);};
+void Table::addColumn(const Column& c) {addColumn(c, c.hasDefault() ? c.getDefault() : defaultValueFor(c.getType()));};
+void Table::addColumn(const Column& c, const Value& fill) {
+  if (!c.isNullable() && isNull(fill) && storage->getRowCount() > 0) {
+    throw std::invalid_argument("Column " + c.getName() + " is NOT NULL and needs a value for existing rows");
+  }
+  storage->addColumn(c.getType(), fill);
+  zones.addColumn(c.getType(), fill, storage->getRowCount());
+  columns.push_back(c);
+  if (statistics) {
+    auto updated = std::make_shared<TableStatistics>(*statistics);
+    updated->columns.emplace_back();
+    statistics = std::move(updated);
+  }
+  schemaVersion = nextSchemaVersion();
+  changed();
+}
+const Column* Table::findNullViolation(const Row& r) const {
+  for (size_t c = 0; c < columns.size() && c < r.size(); c++) {
+    if (!columns[c].isNullable() && isNull(r.getValue(static_cast<int>(c)))) {
+      return &columns[c];
+    }
+  }
+  return nullptr;
+}
+void Table::addRow(const Row& r) {
+  if (const Column* column = findNullViolation(r)) {
+    throw std::invalid_argument("Column " + column->getName() + " can't be NULL");
+  }
+  storage->appendRow(r);
+  zones.addRow(storage->getRowCount() - 1, r);
+  deleted.appendValid(1);
+  changed();
+  if (indexes->indexes.empty()) {
+    return;
+  }
+  std::unique_lock lock(indexes->lock);
+  size_t row = storage->getRowCount() - 1;
+  for (auto& index : indexes->indexes) {
+    index->insert(r.getValue(index->getColumn()), row);
+  }
+}
+void Table::addRows(const std::vector<Row>& rows) {
+  for (const auto& r : rows) {
+    if (const Column* column = findNullViolation(r)) {
+      throw std::invalid_argument("Column " + column->getName() + " can't be NULL");
+    }
+  }
+  size_t first = storage->getRowCount();
+  for (const auto& r : rows) {
+    storage->appendRow(r);
+    zones.addRow(storage->getRowCount() - 1, r);
+  }
+  deleted.appendValid(rows.size());
+  changed();
+  if (indexes->indexes.empty()) {
+    return;
+  }
+  std::unique_lock lock(indexes->lock);
+  for (auto& index : indexes->indexes) {
+    for (size_t i = 0; i < rows.size(); i++) {
+      index->insert(rows[i].getValue(index->getColumn()), first + i);
+    }
+  }
+}
+void Table::appendChunks(std::vector<ColumnChunk>& chunks) {
+  appendChunks(chunks, {});
+}
+void Table::appendChunks(std::vector<ColumnChunk>& chunks, const std::vector<Zone>& stats) {
+  for (size_t c = 0; c < chunks.size() && c < columns.size(); c++) {
+    if (!columns[c].isNullable() && chunks[c].nullCount() > 0) {
+      throw std::invalid_argument("Column " + columns[c].getName() + " can't be NULL");
+    }
+  }
+  size_t first = storage->getRowCount();
+  storage->appendChunks(chunks);
+  if (stats.empty()) {
+    zones.addRows(*storage, first, storage->getRowCount());
+  } else {
+    zones.setZone(first / kZoneRows, stats);
+  }
+  deleted.appendValid(storage->getRowCount() - first);
+  changed();
+  if (indexes->indexes.empty()) {
+    return;
+  }
+  std::unique_lock lock(indexes->lock);
+  for (auto& index : indexes->indexes) {
+    indexRows(*index, first, storage->getRowCount());
+  }
+}
 void Table::dropColumn(const Column& column) {
-  auto it = std::find_if(columns.begin(), columns.end(),
-                       [&column](const Column& c) {
-                           return c.getName() == column.getName();
-                       });
-
-  if (it != columns.end()) {
-    int idx = std::distance(columns.begin(), it);
-    columns.erase(it);
-
-    // Update all rows to remove values at this column index
-    for (auto& row : rows) {
-      //check if idx exists
-      if (idx < rows.size()) {
-        row.removeValue(idx);
+  int idx = findColumn(column.getName());
+  if (idx >= 0) {
+    columns.erase(columns.begin() + idx);
+    storage->dropColumn(idx);
+    zones.dropColumn(idx);
+    if (statistics) {
+      auto updated = std::make_shared<TableStatistics>(*statistics);
+      updated->columns.erase(updated->columns.begin() + idx);
+      statistics = std::move(updated);
+    }
+    schemaVersion = nextSchemaVersion();
+    changed();
+    // Indexes on the column go with it, the ones after it shift left
+    std::unique_lock lock(indexes->lock);
+    std::erase_if(indexes->indexes, [idx](const auto& index) { return index->getColumn() == idx; });
+    for (auto& index : indexes->indexes) {
+      if (index->getColumn() > idx) {
+        index->setColumn(index->getColumn() - 1);
       }
-      // row.removeValue(idx);
     }
+    changeLayout();
   }
 }
 void Table::dropRow(int idx) {
-  if(rows.size() <= idx) {
+  if (idx < 0 || static_cast<size_t>(idx) >= storage->getRowCount()) {
     throw std::out_of_range("Index out of bounds");
   }
   else{
-    rows.erase(rows.begin() + idx);
+    storage->eraseRow(idx);
+    zones.rebuild(*storage, idx);
+    deleted.erase(idx);
+    changed();
+    // Every row after idx moved, so positions in the indexes are stale
+    rebuildIndexes();
   }
 }
+void Table::deleteRows(const std::vector<size_t>& rows) {
+  for (size_t row : rows) {
+    if (row >= storage->getRowCount()) {
+      throw std::out_of_range("Index out of bounds");
+    }
+  }
+  for (size_t row : rows) {
+    deleted.set(row);
+  }
+  changed();
+}
+// Dead rows cost every scan a little, so they are compacted away sooner than
+// dead arena bytes: at a quarter of the table rather than half. Each
+// compaction is one pass over the table after at least a quarter of it was
+// deleted, i.e. amortized O(1) per deleted row.
+bool Table::needsCompaction() const {
+  return deleted.count() > 0 && deleted.count() * 4 >= storage->getRowCount();
+}
+void Table::compact() {
+  storage->compact();
+  if (deleted.count() == 0) {
+    return;
+  }
+  if (deleted.count() == storage->getRowCount()) {
+    dropAllRow();
+    return;
+  }
+  // Rows before the first tombstone stay where they are
+  std::vector<uint64_t> bits = deleted.bits();
+  size_t word = 0;
+  while (bits[word] == 0) {
+    word++;
+  }
+  size_t firstMoved = word * 64 + static_cast<size_t>(std::countr_zero(bits[word]));
+  storage->eraseRows(bits.data());
+  zones.rebuild(*storage, firstMoved);
+  deleted.clear();
+  deleted.appendValid(storage->getRowCount());
+  changed();
+  rebuildIndexes();
+}
 void Table::dropAllRow() {
-  this->rows.clear();
+  storage->clear();
+  zones.clearRows();
+  deleted.clear();
+  changed();
+  std::unique_lock lock(indexes->lock);
+  for (auto& index : indexes->indexes) {
+    index->clear();
+  }
+  changeLayout();
 }
 void Table::clearColumn() {
   columns.clear();
+  storage->clearColumns();
+  zones.clearColumns();
+  statistics.reset();
+  deleted.clear();
+  schemaVersion = nextSchemaVersion();
+  changed();
+  std::unique_lock lock(indexes->lock);
+  indexes->indexes.clear();
+  changeLayout();
 }
 void Table::updateRow(int idx,const Row& newRow) {
-  if (idx <= rows.size() && idx >= 0) {
-    if (newRow.getValues().size() == columns.size()) {
-      rows[idx] = newRow;
+  if (idx >= 0 && static_cast<size_t>(idx) < storage->getRowCount()) {
+    if (const Column* column = findNullViolation(newRow)) {
+      std::cerr << "Column " << column->getName() << " can't be NULL" << std::endl;
+    }
+    else if (newRow.getValues().size() == columns.size()) {
+      // The row changes in place, so snapshots can't trust its index entries
+      std::unique_lock lock(indexes->lock);
+      for (auto& index : indexes->indexes) {
+        index->erase(toValue(storage->getValue(idx, index->getColumn())), idx);
+      }
+      zones.removeRow(*storage, idx);
+      storage->updateRow(idx, newRow);
+      zones.addRow(idx, newRow);
+      changed();
+      for (auto& index : indexes->indexes) {
+        index->insert(newRow.getValue(index->getColumn()), idx);
+      }
+      changeLayout();
     }
     else {
       std::cerr << "New row doesn't match table schema" << std::endl;
@@ -55,6 +263,64 @@ void Table::updateRow(int idx,const Row& newRow) {
 }
 
 
+void Table::updateRows(const std::vector<size_t>& rows, const std::vector<Row>& updated) {
+  if (rows.size() != updated.size()) {
+    throw std::invalid_argument("Row count doesn't match");
+  }
+  if (rows.empty()) {
+    return;
+  }
+  for (size_t i = 0; i < rows.size(); i++) {
+    if (rows[i] >= storage->getRowCount()) {
+      throw std::out_of_range("Index out of bounds");
+    }
+    if (updated[i].getValues().size() != columns.size()) {
+      throw std::invalid_argument("New row doesn't match table schema");
+    }
+    if (const Column* column = findNullViolation(updated[i])) {
+      throw std::invalid_argument("Column " + column->getName() + " can't be NULL");
+    }
+  }
+  // Storage takes the rows in ascending order
+  if (!std::is_sorted(rows.begin(), rows.end())) {
+    std::vector<size_t> order(rows.size());
+    for (size_t i = 0; i < order.size(); i++) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return rows[a] < rows[b]; });
+    std::vector<size_t> sortedRows;
+    std::vector<Row> sortedUpdated;
+    for (size_t i : order) {
+      sortedRows.push_back(rows[i]);
+      sortedUpdated.push_back(updated[i]);
+    }
+    updateRows(sortedRows, sortedUpdated);
+    return;
+  }
+
+  std::unique_lock lock(indexes->lock);
+  for (auto& index : indexes->indexes) {
+    for (size_t row : rows) {
+      index->erase(toValue(storage->getValue(row, index->getColumn())), row);
+    }
+  }
+  for (size_t row : rows) {
+    zones.removeRow(*storage, row);
+  }
+  storage->updateRows(rows, updated);
+  for (size_t i = 0; i < rows.size(); i++) {
+    zones.addRow(rows[i], updated[i]);
+  }
+  changed();
+  for (auto& index : indexes->indexes) {
+    for (size_t i = 0; i < rows.size(); i++) {
+      index->insert(updated[i].getValue(index->getColumn()), rows[i]);
+    }
+  }
+  changeLayout();
+}
+
+
   void Table::print() const {
     // Print table name
     std::cout << "Table: " << name << "\t" << std::endl;
@@ -71,29 +337,206 @@ void Table::updateRow(int idx,const Row& newRow) {
     }
     std::cout << std::endl;
 
-    // Print rows
-    for (const auto& row : rows) {
-      const auto& values = row.getValues();
-
-      for (size_t i = 0; i < values.size() && i < columns.size(); i++) {
-        std::visit([](const auto& value) {
-            std::cout << value << "\t";
-        }, values[i]);
+    // Print rows, buffered; the empty last cell ends each with a tab as the
+    // header lines
+    ResultSink sink(std::cout, OutputFormat::TSV);
+    ResultBuffer& out = sink.getBuffer();
+    for (size_t r = 0; r < storage->getRowCount(); r++) {
+      if (deleted.test(r)) {
+        continue;
       }
-      std::cout << std::endl;
+      for (size_t i = 0; i < columns.size(); i++) {
+        out.value(storage->getValue(r, i));
+      }
+      out.value(std::string_view());
+      out.endRow();
+      sink.flushIfFull(out);
     }
+    sink.write(out);
+    sink.finish();
     std::cout << std::endl;
   }
 
 
-std::vector<Column> Table::getColumns() const {
+void Table::indexRows(Index& index, size_t first, size_t last) const {
+  for (size_t r = first; r < last; r++) {
+    index.insert(toValue(storage->getValue(r, index.getColumn())), r);
+  }
+}
+
+void Table::rebuildIndexes() {
+  std::unique_lock lock(indexes->lock);
+  for (auto& index : indexes->indexes) {
+    index->clear();
+    indexRows(*index, 0, storage->getRowCount());
+  }
+  changeLayout();
+}
+
+void Table::changeLayout() {
+  indexLayout = ++indexes->layout;
+}
+
+void Table::changed() {
+  if (versions) {
+    versions->changes++;
+  }
+}
+
+// Called with the writer lock held
+std::shared_ptr<const Table> Table::publish() const {
+  std::shared_ptr<const Table> current = versions->load();
+  if (current && current->version == versions->changes.load()) {
+    return current;
+  }
+  std::shared_ptr<const Table> snapshot(new Table(*this));
+  versions->store(snapshot);
+  return snapshot;
+}
+
+Table::WriteLock::WriteLock(const Table& t) : table(t), lock(t.versions->writer) {}
+
+// Publishing is left to readers, so writes nobody reads cost no snapshot;
+// only when a reader asked for one while we held the lock do we publish
+Table::WriteLock::~WriteLock() {
+  table.versions->released = table.versions->changes.load();
+  if (table.versions->wanted.exchange(false)) {
+    table.publish();
+  }
+}
+
+Table::WriteLock Table::lockForWrite() {
+  return WriteLock(*this);
+}
+
+// The published snapshot goes stale with every write; the first reader to
+// find it so publishes a new one. While a write is in progress the
+// published snapshot still serves if no write was released since it was
+// taken. Otherwise the reader waits for the write in progress and asks the
+// writer to publish on release, so the readers after it find a fresh one.
+std::shared_ptr<const Table> Table::readSnapshot() const {
+  std::shared_ptr<const Table> current = versions->load();
+  if (current && current->version == versions->changes.load()) {
+    return current;
+  }
+  std::unique_lock<std::mutex> lock(versions->writer, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    if (current && current->version >= versions->released.load()) {
+      return current;
+    }
+    versions->wanted = true;
+    lock.lock();
+  }
+  return publish();
+}
+
+void Table::createIndex(const std::string& indexName, const std::string& columnName, IndexType type) {
+  for (const auto& index : indexes->indexes) {
+    if (index->getName() == indexName) {
+      throw std::invalid_argument("Index " + indexName + " already exists");
+    }
+  }
+  int col = findColumn(columnName);
+  if (col < 0) {
+    throw std::invalid_argument("Column " + columnName + " does not exist");
+  }
+  std::unique_ptr<Index> index;
+  if (type == IndexType::HASH) {
+    index = std::make_unique<HashIndex>(indexName, col);
+  } else {
+    index = std::make_unique<OrderedIndex>(indexName, col);
+  }
+  indexRows(*index, 0, storage->getRowCount());
+  std::unique_lock lock(indexes->lock);
+  indexes->indexes.push_back(std::move(index));
+}
+
+const std::vector<std::unique_ptr<Index>>& Table::getIndexes() const {
+  return indexes->indexes;
+}
+
+std::shared_lock<std::shared_mutex> Table::lockIndexes() const {
+  return std::shared_lock(indexes->lock);
+}
+
+bool Table::indexesMatch() const {
+  return indexLayout == indexes->layout;
+}
+
+std::string Table::getName() const {
+  return name;
+}
+
+const std::vector<Column>& Table::getColumns() const {
   return columns;
 }
 
+// Replaces the whole schema; storage can't reinterpret old rows, so they go too.
 void Table::setColumns(const std::vector<Column>& newCols) {
-  this->columns = newCols;
+  clearColumn();
+  for (const auto& c : newCols) {
+    addColumn(c);
+  }
+}
+
+uint64_t Table::getSchemaVersion() const {
+  return schemaVersion;
+}
+
+StorageMode Table::getStorageMode() const {
+  return storage->getMode();
+}
+
+const TableStorage& Table::getStorage() const {
+  return *storage;
+}
+
+const ZoneMap& Table::getZoneMap() const {
+  return zones;
+}
+
+void Table::setStatistics(std::shared_ptr<const TableStatistics> s) {
+  statistics = std::move(s);
+  changed();
+}
+
+const TableStatistics* Table::getStatistics() const {
+  return statistics.get();
 }
 
-std::vector<Row> Table::getRows() const {
-  return rows;
+ValueRef Table::getValue(size_t row, size_t col) const {
+  return storage->getValue(row, col);
+}
+
+Row Table::getRow(size_t idx) const {
+  return storage->getRow(idx);
+}
+
+size_t Table::getRowCount() const {
+  return storage->getRowCount();
+}
+
+size_t Table::getLiveRowCount() const {
+  return storage->getRowCount() - deleted.count();
+}
+
+bool Table::isDeleted(size_t row) const {
+  return deleted.test(row);
+}
+
+const uint64_t* Table::getDeletedBits(size_t first) const {
+  return deleted.words(first);
+}
+
+size_t Table::getColumnCount() const {
+  return columns.size();
+}
+
+int Table::findColumn(const std::string& columnName) const {
+  for (size_t i = 0; i < columns.size(); i++) {
+    if (columns[i].getName() == columnName) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
 }
\ No newline at end of file
@@ -6,33 +6,154 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include "Column.h"
 #include "Row.h"
+#include "TableStorage.h"
+#include "Index.h"
+#include "TombstoneMap.h"
+#include "ZoneMap.h"
+#include "Statistics.h"
 
+// Secondary indexes of a table, shared with its snapshots. The table's
+// writer changes entries under the exclusive lock; readers probe under the
+// shared one. Row positions in the entries mean the same rows in every
+// snapshot taken at the same layout: appends and tombstones leave them
+// alone, while anything that moves rows or rewrites them in place starts a
+// new layout.
+struct IndexSet {
+    std::shared_mutex lock;
+    std::vector<std::unique_ptr<Index>> indexes;
+    uint64_t layout = 0;
+};
+
+// Multi-version concurrency: one writer at a time changes the table under
+// lockForWrite(), while readers work on immutable snapshots from
+// readSnapshot() and never wait for it. A snapshot shares storage blocks
+// with the table (see TableStorage::clone), so taking one is cheap and a
+// writer only copies the blocks it changes while a snapshot holds them.
 class Table {
 private:
+    struct Versions; // published snapshot and writer lock
+
     std::string name;
     std::vector<Column> columns;
-    std::vector<Row> rows;
+    std::unique_ptr<TableStorage> storage;
+    std::shared_ptr<IndexSet> indexes;
+    uint64_t indexLayout = 0; // IndexSet layout this table's rows match
+    uint64_t schemaVersion;
+    // Tombstones: rows deleted but still in storage. Scans skip them; they
+    // are erased in one pass once they make up a quarter of the rows (see
+    // needsCompaction).
+    TombstoneMap deleted;
+    ZoneMap zones; // per-zone column statistics, kept in step with the rows
+    // From the last ANALYZE, shared with snapshots; estimates only, so row
+    // changes leave them be (null before the first)
+    std::shared_ptr<const TableStatistics> statistics;
+    std::unique_ptr<Versions> versions; // null in a snapshot
+    uint64_t version = 0;               // changes a snapshot reflects
+
+    Table(const Table& table); // snapshot
+
+    void indexRows(Index& index, size_t first, size_t last) const;
+    void rebuildIndexes();
+    void changeLayout(); // call with the index lock held exclusively
+    void changed();
+    std::shared_ptr<const Table> publish() const;
+    const Column* findNullViolation(const Row& row) const; // NOT NULL column row leaves NULL
 
 public:
-    Table(const std::string& name);
+    // Held by the one thread changing the table; readers see the changes
+    // made under it together, once it is released
+    class WriteLock {
+    private:
+        const Table& table;
+        std::unique_lock<std::mutex> lock;
+
+    public:
+        explicit WriteLock(const Table& table);
+        ~WriteLock();
+    };
+
+    Table(const std::string& name, StorageMode mode = StorageMode::ROW);
+    Table(Table&&) noexcept;
+    Table& operator=(Table&&) noexcept;
     ~Table();
 
+    // Rows and fills that leave a NOT NULL column NULL are rejected
     void addColumn(const Column& column);
+    void addColumn(const Column& column, const Value& fill);
     void addRow(const Row& row);
+    void addRows(const std::vector<Row>& rows);
+    void appendChunks(std::vector<ColumnChunk>& chunks); // one per column, equal lengths
+    // appendChunks with the chunks' zone statistics, one per column, known
+    // already (loading a file): the table must end on a zone boundary and
+    // the chunks fill at most one zone. Empty stats are computed.
+    void appendChunks(std::vector<ColumnChunk>& chunks, const std::vector<Zone>& stats);
     void dropColumn(const Column& column);
     void dropRow(int idx);
+    // DELETE: tombstones the rows (row positions, in any order), so deleting
+    // k rows costs O(k). Row positions stay valid until the next compact().
+    void deleteRows(const std::vector<size_t>& rows);
+    // True once enough rows are tombstoned that compact() is worth its pass
+    bool needsCompaction() const;
+    // Erases the tombstoned rows now, renumbering the rest, and reclaims the
+    // space of dropped columns. Run in the background after a DELETE (see
+    // Database::scheduleCompaction) and before saving.
+    void compact();
     void dropAllRow();
     void clearColumn();
     void updateRow(int idx, const Row& row);
+    // UPDATE: overwrites the rows (row positions, in any order) with
+    // updated[i] in place, so they keep their positions and the table its
+    // row order. Snapshots taken before stop using the indexes.
+    void updateRows(const std::vector<size_t>& rows, const std::vector<Row>& updated);
 
     void print() const;
 
+    WriteLock lockForWrite();
+    // The table as of the last write lock released, or newer. Waits for a
+    // write in progress only when writes released before it went unread,
+    // since snapshots are taken on demand.
+    std::shared_ptr<const Table> readSnapshot() const;
+
+    // Secondary indexes, kept in sync by every row and column change above
+    void createIndex(const std::string& indexName, const std::string& columnName, IndexType type);
+    // The live table's indexes; readers of a snapshot hold lockIndexes()
+    // and check indexesMatch() before using them
+    const std::vector<std::unique_ptr<Index>>& getIndexes() const;
+    std::shared_lock<std::shared_mutex> lockIndexes() const;
+    bool indexesMatch() const; // index positions are this table's rows
+
     std::string getName() const;
-    std::vector<Column> getColumns() const;
+    const std::vector<Column>& getColumns() const;
     void setColumns(const std::vector<Column>& columns);
-    std::vector<Row> getRows() const;
+    // Changes whenever columns are added or removed; unique across tables, so
+    // a dropped and recreated table never reuses a version
+    uint64_t getSchemaVersion() const;
+
+    StorageMode getStorageMode() const;
+    const TableStorage& getStorage() const;
+    const ZoneMap& getZoneMap() const;
+    // Installed by ANALYZE, one entry per column; columns added afterwards
+    // get an entry that isn't analyzed
+    void setStatistics(std::shared_ptr<const TableStatistics> statistics);
+    const TableStatistics* getStatistics() const; // null if never analyzed
+
+    // Read-only access to stored cells. getValue returns a view into storage;
+    // getRow materializes a copy of one row.
+    ValueRef getValue(size_t row, size_t col) const;
+    Row getRow(size_t idx) const;
+    size_t getRowCount() const; // tombstoned rows included
+    size_t getLiveRowCount() const;
+    bool isDeleted(size_t row) const;
+    // Tombstone flags of rows from first (a multiple of 64) on, valid for
+    // one scan batch; null when no row is tombstoned
+    const uint64_t* getDeletedBits(size_t first) const;
+    size_t getColumnCount() const;
+    int findColumn(const std::string& columnName) const; // -1 if absent
 };
 
 #endif //TABLE_H
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "TableStorage.h"
+#include "RowStorage.h"
+#include "ColumnStorage.h"
+
+Value toValue(const ValueRef& ref) {
+    return std::visit([](const auto& v) -> Value {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::string_view>) {
+            return std::string(v);
+        } else {
+            return v;
+        }
+    }, ref);
+}
+
+ValueRef toValueRef(const Value& value) {
+    return std::visit([](const auto& v) -> ValueRef {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::string>) {
+            return std::string_view(v);
+        } else {
+            return v;
+        }
+    }, value);
+}
+
+size_t variantIndexFor(ColumnType type) {
+    switch (type) {
+        case ColumnType::INT:
+            return 0;
+        case ColumnType::FLOAT:
+            return 1;
+        case ColumnType::STRING:
+            return 2;
+        case ColumnType::BOOLEAN:
+            return 3;
+    }
+    return 0;
+}
+
+void TableStorage::updateRows(const std::vector<size_t>& rows, const std::vector<Row>& updated) {
+    for (size_t i = 0; i < rows.size(); i++) {
+        updateRow(rows[i], updated[i]);
+    }
+}
+
+const ColumnChunk* TableStorage::getStringCodes(size_t, size_t, size_t, const uint16_t*&) const {
+    return nullptr;
+}
+
+std::unique_ptr<TableStorage> makeTableStorage(StorageMode mode) {
+    if (mode == StorageMode::COLUMNAR) {
+        return std::make_unique<ColumnStorage>();
+    }
+    return std::make_unique<RowStorage>();
+}
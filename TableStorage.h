@@ -0,0 +1,87 @@
+#ifndef TABLESTORAGE_H
+#define TABLESTORAGE_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+#include <cstdint>
+#include "Column.h"
+#include "Row.h"
+#include "ColumnChunk.h"
+
+// Physical layout of a table, picked once at CREATE TABLE time.
+enum class StorageMode {
+    ROW,      // each record's cells stored together
+    COLUMNAR  // typed contiguous arrays per column
+};
+
+Value toValue(const ValueRef& ref);
+ValueRef toValueRef(const Value& value);
+// Index a Value alternative must have to be stored in a column of `type`
+size_t variantIndexFor(ColumnType type);
+
+// Interface implemented by the row and column layouts. Table owns one of
+// these and keeps the schema itself; storage only knows column types.
+class TableStorage {
+public:
+    virtual ~TableStorage() = default;
+
+    // Copy that shares the stored data with this one. Either side copies
+    // the parts it writes first, so the clone is a snapshot taking time
+    // proportional to the number of blocks rather than rows.
+    virtual std::unique_ptr<TableStorage> clone() const = 0;
+
+    virtual StorageMode getMode() const = 0;
+    virtual size_t getRowCount() const = 0;
+
+    // Schema changes. addColumn fills existing rows with `fill`, which may be
+    // NULL; neither it nor dropColumn rewrites the existing rows, so both take
+    // time independent of the row count.
+    virtual void addColumn(ColumnType type, const Value& fill) = 0;
+    virtual void dropColumn(size_t col) = 0;
+    virtual void clearColumns() = 0; // drops all columns and all rows
+    // Reclaims the space dropped columns leave behind in the rows, in one
+    // pass over the table. Only run from compaction, never per statement.
+    virtual void compact() {}
+
+    // Row values are of their column's type or std::monostate (NULL)
+    virtual void appendRow(const Row& row) = 0;
+    // Appends one chunk per column, all of the same length and matching the
+    // column types. Chunks may be moved from.
+    virtual void appendChunks(std::vector<ColumnChunk>& chunks) = 0;
+    virtual void updateRow(size_t idx, const Row& row) = 0;
+    // Overwrites rows[i] (ascending, distinct) with updated[i] in place
+    virtual void updateRows(const std::vector<size_t>& rows, const std::vector<Row>& updated);
+    virtual void eraseRow(size_t idx) = 0;
+    // Erases the rows whose bit is set in `erased` (a bitmap over all rows)
+    // in one pass; the rest keep their order
+    virtual void eraseRows(const uint64_t* erased) = 0;
+    virtual void clear() = 0;
+
+    virtual ValueRef getValue(size_t row, size_t col) const = 0;
+    virtual Row getRow(size_t row) const = 0; // materialized copy
+
+    // Typed batch access for scans over rows [first, first + count) of one
+    // column. Implementations may return a pointer straight into storage or
+    // gather into `scratch`; either way it stays valid until the next call
+    // with the same scratch buffer or until the table is modified.
+    virtual const int* getInts(size_t col, size_t first, size_t count, std::vector<int>& scratch) const = 0;
+    virtual const float* getFloats(size_t col, size_t first, size_t count, std::vector<float>& scratch) const = 0;
+    // Writes a bitmap of `count` bits to out (first must be a multiple of 64)
+    virtual void getBools(size_t col, size_t first, size_t count, uint64_t* out) const = 0;
+    virtual void getStrings(size_t col, size_t first, size_t count, std::vector<std::string_view>& out) const = 0;
+    // NULL flags of the same rows, bit i for row first + i (first must be a
+    // multiple of 64; bits past count are unspecified). Null when the column
+    // has no NULLs there. The typed accessors read a NULL as the type's default.
+    virtual const uint64_t* getNulls(size_t col, size_t first, size_t count, std::vector<uint64_t>& scratch) const = 0;
+    // For a STRING batch inside one dictionary encoded chunk: points codes at
+    // the batch's codes and returns the chunk, whose dictionaryAt() maps them
+    // back to strings. Null when the batch has no codes; use getStrings then.
+    virtual const ColumnChunk* getStringCodes(size_t col, size_t first, size_t count, const uint16_t*& codes) const;
+};
+
+std::unique_ptr<TableStorage> makeTableStorage(StorageMode mode);
+
+#endif //TABLESTORAGE_H
@@ -0,0 +1,146 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+// Set while a thread runs pool tasks, so nested parallelFor calls run inline
+static thread_local bool inTask = false;
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = threads;
+    slices = std::make_unique<Slice[]>(threadCount);
+    for (size_t w = 1; w < threadCount; w++) {
+        this->threads.emplace_back(&ThreadPool::workerLoop, this, w);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::getThreadCount() const {
+    return threadCount;
+}
+
+// Next morsel from the worker's own slice, else the back half of the next
+// non-empty slice after it. False once every slice is empty.
+bool ThreadPool::take(size_t worker, size_t& morsel) {
+    if (failed.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    Slice& own = slices[worker];
+    {
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.next < own.end) {
+            morsel = own.next++;
+            return true;
+        }
+    }
+    for (size_t i = 1; i < threadCount; i++) {
+        Slice& victim = slices[(worker + i) % threadCount];
+        size_t first, last;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            size_t remaining = victim.end - victim.next;
+            if (remaining == 0) {
+                continue;
+            }
+            first = victim.next + remaining / 2;
+            last = victim.end;
+            victim.end = first;
+        }
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.next = first + 1;
+        own.end = last;
+        morsel = first;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::work(size_t worker) {
+    inTask = true;
+    size_t morsel;
+    while (take(worker, morsel)) {
+        try {
+            (*task)(morsel, worker);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            failed = true;
+        }
+    }
+    inTask = false;
+}
+
+void ThreadPool::workerLoop(size_t worker) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        work(worker);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--running == 0) {
+            finished.notify_all();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(size_t morsels, const std::function<void(size_t morsel, size_t worker)>& f) {
+    if (morsels == 0) {
+        return;
+    }
+    // While another thread's query has the workers, this one runs on its own
+    // thread instead of queueing behind it
+    std::unique_lock<std::mutex> runLock(runMutex, std::defer_lock);
+    if (threadCount == 1 || morsels == 1 || inTask || !runLock.try_lock()) {
+        for (size_t m = 0; m < morsels; m++) {
+            f(m, 0);
+        }
+        return;
+    }
+
+    for (size_t w = 0; w < threadCount; w++) {
+        std::lock_guard<std::mutex> lock(slices[w].mutex);
+        slices[w].next = morsels * w / threadCount;
+        slices[w].end = morsels * (w + 1) / threadCount;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &f;
+        error = nullptr;
+        failed = false;
+        running = threadCount - 1;
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    std::exception_ptr thrown;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return running == 0; });
+        task = nullptr;
+        thrown = error;
+    }
+    if (thrown) {
+        std::rethrow_exception(thrown);
+    }
+}
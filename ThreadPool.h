@@ -0,0 +1,64 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers for morsel-driven parallelism. parallelFor hands each
+// worker an equal slice of the morsels; a worker that runs out steals the
+// back half of another worker's remaining slice, so uneven morsels (selective
+// filters, mapped pages not yet loaded) even out without a shared queue.
+class ThreadPool {
+private:
+    // Morsels [next, end) still owned by one worker
+    struct Slice {
+        std::mutex mutex;
+        size_t next = 0;
+        size_t end = 0;
+    };
+
+    size_t threadCount;
+    std::vector<std::thread> threads;   // workers 1..threadCount-1; the caller is worker 0
+    std::unique_ptr<Slice[]> slices;
+
+    std::mutex runMutex;                // held by the parallelFor using the workers
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(size_t, size_t)>* task = nullptr;
+    uint64_t generation = 0;
+    size_t running = 0;
+    bool stopping = false;
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    bool take(size_t worker, size_t& morsel);
+    void work(size_t worker);
+    void workerLoop(size_t worker);
+
+public:
+    // 0 picks one thread per hardware core
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t getThreadCount() const;
+
+    // Runs task(morsel, worker) for every morsel in [0, morsels) and returns
+    // when all are done; worker < getThreadCount() identifies the thread, for
+    // per-thread state. The first exception thrown stops the remaining
+    // morsels and is rethrown here. Calls made from inside a task, or while
+    // another thread's call has the workers, run inline.
+    void parallelFor(size_t morsels, const std::function<void(size_t morsel, size_t worker)>& task);
+};
+
+#endif //THREADPOOL_H
@@ -0,0 +1,83 @@
+#include "TombstoneMap.h"
+#include <algorithm>
+#include <bit>
+#include "CopyOnWrite.h"
+
+size_t TombstoneMap::size() const { return rows; }
+size_t TombstoneMap::count() const { return tombstones; }
+
+bool TombstoneMap::test(size_t row) const {
+    const Segment* segment = segments[row / kChunkRows].get();
+    size_t r = row % kChunkRows;
+    return segment && (((*segment)[r >> 6] >> (r & 63)) & 1);
+}
+
+// A segment without tombstones reads as this one
+const uint64_t* TombstoneMap::words(size_t first) const {
+    static const Segment none{};
+    if (tombstones == 0) {
+        return nullptr;
+    }
+    const Segment* segment = segments[first / kChunkRows].get();
+    return (segment ? segment->data() : none.data()) + first % kChunkRows / 64;
+}
+
+std::vector<uint64_t> TombstoneMap::bits() const {
+    std::vector<uint64_t> all((rows + 63) / 64, 0);
+    for (size_t s = 0; s < segments.size(); s++) {
+        if (segments[s]) {
+            size_t first = s * kSegmentWords;
+            std::copy_n(segments[s]->begin(), std::min(kSegmentWords, all.size() - first), all.begin() + first);
+        }
+    }
+    return all;
+}
+
+void TombstoneMap::appendValid(size_t n) {
+    rows += n;
+    segments.resize((rows + kChunkRows - 1) / kChunkRows);
+}
+
+// A segment shared with a snapshot is copied first (see soleOwner)
+void TombstoneMap::set(size_t row) {
+    if (test(row)) {
+        return;
+    }
+    std::shared_ptr<Segment>& segment = segments[row / kChunkRows];
+    if (!segment) {
+        segment = std::make_shared<Segment>();
+    }
+    size_t r = row % kChunkRows;
+    unshare(segment)[r >> 6] |= uint64_t(1) << (r & 63);
+    tombstones++;
+}
+
+// Sets the flags again, one row down, in fresh segments
+void TombstoneMap::erase(size_t row) {
+    std::vector<size_t> kept;
+    for (size_t s = 0; s < segments.size(); s++) {
+        if (!segments[s]) {
+            continue;
+        }
+        for (size_t w = 0; w < kSegmentWords; w++) {
+            for (uint64_t word = (*segments[s])[w]; word; word &= word - 1) {
+                size_t r = s * kChunkRows + w * 64 + static_cast<size_t>(std::countr_zero(word));
+                if (r != row) {
+                    kept.push_back(r < row ? r : r - 1);
+                }
+            }
+        }
+    }
+    size_t n = rows - 1;
+    clear();
+    appendValid(n);
+    for (size_t r : kept) {
+        set(r);
+    }
+}
+
+void TombstoneMap::clear() {
+    segments.clear();
+    rows = 0;
+    tombstones = 0;
+}
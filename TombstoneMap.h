@@ -0,0 +1,41 @@
+#ifndef TOMBSTONEMAP_H
+#define TOMBSTONEMAP_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "ColumnChunk.h"
+
+// Rows of a table deleted but still in storage, one bit per row, in
+// segments of kChunkRows rows. A table shares the segments with its
+// snapshots and copies one before setting a bit in it, so taking a
+// snapshot costs a pointer per segment and a DELETE copies at most the
+// segments it touches. Segments without tombstones hold no words.
+class TombstoneMap {
+private:
+    static constexpr size_t kSegmentWords = kChunkRows / 64;
+    using Segment = std::array<uint64_t, kSegmentWords>;
+
+    std::vector<std::shared_ptr<Segment>> segments; // null: no tombstone in it
+    size_t rows = 0;
+    size_t tombstones = 0;
+
+public:
+    size_t size() const;
+    size_t count() const; // tombstoned rows
+    bool test(size_t row) const;
+    // Flags of rows from first (a multiple of 64) to the end of its
+    // segment, which a scan batch never crosses. Null when no row is
+    // tombstoned.
+    const uint64_t* words(size_t first) const;
+    // Flags of all rows in one bitmap
+    std::vector<uint64_t> bits() const;
+
+    void appendValid(size_t n);
+    void set(size_t row);
+    void erase(size_t row); // shifts the flags after row down by one
+    void clear();
+};
+
+#endif //TOMBSTONEMAP_H
@@ -0,0 +1,481 @@
+#include "WriteAheadLog.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include "FileFormat.h"
+
+static constexpr size_t kRecordHeaderSize = 4 + 4 + 1 + 8;
+// INTERVAL policy writes early (without syncing) once this much is buffered
+static constexpr size_t kMaxBufferedBytes = 4 << 20;
+
+static void syncFile(int fd) {
+#if defined(__linux__)
+    if (::fdatasync(fd) != 0) {
+#else
+    if (::fsync(fd) != 0) {
+#endif
+        throw std::runtime_error("Cannot sync write-ahead log");
+    }
+}
+
+static void writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            throw std::runtime_error("Cannot write write-ahead log");
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+static void appendRecord(std::string& out, WalRecordType type, uint64_t lsn, const std::string& payload) {
+    char header[kRecordHeaderSize];
+    uint32_t size = static_cast<uint32_t>(payload.size());
+    uint8_t t = static_cast<uint8_t>(type);
+    std::memcpy(header, &size, 4);
+    std::memcpy(header + 8, &t, 1);
+    std::memcpy(header + 9, &lsn, 8);
+    uint32_t crc = crc32(header + 8, 9);
+    crc = crc32(payload.data(), payload.size(), crc);
+    std::memcpy(header + 4, &crc, 4);
+    out.append(header, kRecordHeaderSize);
+    out.append(payload);
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& name, const WalOptions& opts) : fileName(name), options(opts) {
+    fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open write-ahead log " + fileName);
+    }
+    if (options.policy == SyncPolicy::INTERVAL) {
+        syncThread = std::thread(&WriteAheadLog::syncLoop, this);
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    flushed.notify_all();
+    if (syncThread.joinable()) {
+        syncThread.join();
+    }
+    try {
+        sync();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+    ::close(fd);
+}
+
+size_t WriteAheadLog::replay(const std::function<void(const WalRecord&)>& apply) {
+    std::string contents;
+    char chunk[1 << 16];
+    ::lseek(fd, 0, SEEK_SET);
+    while (true) {
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n < 0) {
+            throw std::runtime_error("Cannot read write-ahead log");
+        }
+        if (n == 0) {
+            break;
+        }
+        contents.append(chunk, static_cast<size_t>(n));
+    }
+
+    size_t offset = 0;
+    size_t count = 0;
+    uint64_t lastLsn = 0;
+    while (contents.size() - offset >= kRecordHeaderSize) {
+        const char* header = contents.data() + offset;
+        uint32_t size;
+        uint32_t crc;
+        WalRecord record;
+        std::memcpy(&size, header, 4);
+        std::memcpy(&crc, header + 4, 4);
+        std::memcpy(&record.type, header + 8, 1);
+        std::memcpy(&record.lsn, header + 9, 8);
+        if (contents.size() - offset - kRecordHeaderSize < size) {
+            break; // torn write
+        }
+        const char* payload = header + kRecordHeaderSize;
+        if (crc32(payload, size, crc32(header + 8, 9)) != crc) {
+            break;
+        }
+        record.payload.assign(payload, size);
+        apply(record);
+        lastLsn = record.lsn;
+        offset += kRecordHeaderSize + size;
+        count++;
+    }
+
+    if (offset != contents.size()) {
+        std::cerr << "Write-ahead log: discarding " << contents.size() - offset
+                  << " bytes of incomplete records" << std::endl;
+        if (::ftruncate(fd, static_cast<off_t>(offset)) != 0) {
+            throw std::runtime_error("Cannot truncate write-ahead log");
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (lastLsn >= nextLsn) {
+        nextLsn = lastLsn + 1;
+        durableLsn = lastLsn;
+    }
+    return count;
+}
+
+uint64_t WriteAheadLog::append(WalRecordType type, const std::string& payload) {
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t lsn = nextLsn++;
+    appendRecord(buffer, type, lsn, payload);
+    pendingRecords++;
+
+    switch (options.policy) {
+        case SyncPolicy::EVERY_STATEMENT:
+            flushUpTo(lsn, lock);
+            break;
+        case SyncPolicy::BATCH:
+            if (pendingRecords >= options.batchRecords) {
+                flushUpTo(lsn, lock);
+            }
+            break;
+        case SyncPolicy::INTERVAL:
+            if (buffer.size() >= kMaxBufferedBytes) {
+                flushUpTo(lsn, lock);
+            }
+            break;
+    }
+    return lsn;
+}
+
+// Group commit: the first caller to find no flush running becomes the
+// leader and writes + syncs the whole buffer; others wait for it and only
+// lead a new flush if their record was not covered.
+void WriteAheadLog::flushUpTo(uint64_t lsn, std::unique_lock<std::mutex>& lock) {
+    while (durableLsn < lsn) {
+        if (flushing) {
+            flushed.wait(lock);
+            continue;
+        }
+        flushing = true;
+        std::string batch;
+        batch.swap(buffer);
+        pendingRecords = 0;
+        uint64_t upTo = nextLsn - 1;
+        lock.unlock();
+        try {
+            writeAll(fd, batch.data(), batch.size());
+            syncFile(fd);
+        } catch (...) {
+            lock.lock();
+            flushing = false;
+            flushed.notify_all();
+            throw;
+        }
+        lock.lock();
+        durableLsn = upTo;
+        flushing = false;
+        flushed.notify_all();
+    }
+}
+
+void WriteAheadLog::syncLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        flushed.wait_for(lock, std::chrono::milliseconds(options.intervalMs));
+        if (!buffer.empty() && !flushing) {
+            try {
+                flushUpTo(nextLsn - 1, lock);
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+            }
+        }
+    }
+}
+
+void WriteAheadLog::sync() {
+    std::unique_lock<std::mutex> lock(mutex);
+    flushUpTo(nextLsn - 1, lock);
+}
+
+void WriteAheadLog::truncate(uint64_t checkpointLsn) {
+    std::unique_lock<std::mutex> lock(mutex);
+    flushUpTo(nextLsn - 1, lock);
+    if (durableLsn <= checkpointLsn) {
+        if (::ftruncate(fd, 0) != 0) {
+            throw std::runtime_error("Cannot truncate write-ahead log");
+        }
+        syncFile(fd);
+        return;
+    }
+
+    // Records newer than the snapshot were written meanwhile: keep them by
+    // rewriting the log into a new file and swapping it in
+    lock.unlock();
+    std::string kept;
+    replay([&](const WalRecord& record) {
+        if (record.lsn > checkpointLsn) {
+            appendRecord(kept, record.type, record.lsn, record.payload);
+        }
+    });
+    lock.lock();
+    std::string tmpName = fileName + ".tmp";
+    int tmp = ::open(tmpName.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (tmp < 0) {
+        throw std::runtime_error("Cannot rewrite write-ahead log");
+    }
+    writeAll(tmp, kept.data(), kept.size());
+    syncFile(tmp);
+    if (std::rename(tmpName.c_str(), fileName.c_str()) != 0) {
+        ::close(tmp);
+        throw std::runtime_error("Cannot rewrite write-ahead log");
+    }
+    ::close(fd);
+    fd = tmp;
+}
+
+uint64_t WriteAheadLog::getLastLsn() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return nextLsn - 1;
+}
+
+void WriteAheadLog::setLastLsn(uint64_t lsn) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (lsn >= nextLsn) {
+        nextLsn = lsn + 1;
+        durableLsn = std::max(durableLsn, lsn);
+    }
+}
+
+const std::string& WriteAheadLog::getFileName() const {
+    return fileName;
+}
+
+// Rows are stored as u8 variant index followed by the value: i32, f32,
+// u32 length + bytes, or u8
+std::string WriteAheadLog::encodeRows(const std::string& tableName, const std::vector<Row>& rows) {
+    std::string out;
+    auto put = [&out](const void* p, size_t n) { out.append(static_cast<const char*>(p), n); };
+    uint32_t nameLen = static_cast<uint32_t>(tableName.size());
+    uint32_t rowCount = static_cast<uint32_t>(rows.size());
+    put(&nameLen, 4);
+    out.append(tableName);
+    put(&rowCount, 4);
+    for (const auto& row : rows) {
+        uint32_t valueCount = static_cast<uint32_t>(row.size());
+        put(&valueCount, 4);
+        for (const auto& value : row.getValues()) {
+            uint8_t tag = static_cast<uint8_t>(value.index());
+            put(&tag, 1);
+            std::visit([&](const auto& v) {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr (std::is_same_v<T, std::string>) {
+                    uint32_t len = static_cast<uint32_t>(v.size());
+                    put(&len, 4);
+                    out.append(v);
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    uint8_t b = v ? 1 : 0;
+                    put(&b, 1);
+                } else if constexpr (std::is_same_v<T, std::monostate>) {
+                    // NULL is the tag alone
+                } else {
+                    put(&v, sizeof(v));
+                }
+            }, value);
+        }
+    }
+    return out;
+}
+
+std::string WriteAheadLog::decodeRows(const std::string& payload, std::vector<Row>& rows) {
+    MemoryReader reader(payload.data(), payload.size());
+    uint32_t nameLen = reader.readU32();
+    std::string tableName(reader.take(nameLen), nameLen);
+    uint32_t rowCount = reader.readU32();
+    rows.reserve(rows.size() + rowCount);
+    for (uint32_t r = 0; r < rowCount; r++) {
+        Row row;
+        uint32_t valueCount = reader.readU32();
+        for (uint32_t i = 0; i < valueCount; i++) {
+            switch (reader.readU8()) {
+                case 0: {
+                    int v;
+                    std::memcpy(&v, reader.take(4), 4);
+                    row.addValue(v);
+                    break;
+                }
+                case 1: {
+                    float v;
+                    std::memcpy(&v, reader.take(4), 4);
+                    row.addValue(v);
+                    break;
+                }
+                case 2: {
+                    uint32_t len = reader.readU32();
+                    row.addValue(std::string(reader.take(len), len));
+                    break;
+                }
+                case 3:
+                    row.addValue(reader.readU8() != 0);
+                    break;
+                case 4:
+                    row.addValue(std::monostate{});
+                    break;
+                default:
+                    throw std::runtime_error("Corrupt write-ahead log record");
+            }
+        }
+        rows.push_back(std::move(row));
+    }
+    return tableName;
+}
+
+// u32 name length, name, u32 column count, u32 row count, then per column
+// u8 type, u64 size and the chunk's arrays (see FileFormat.h block payloads;
+// STRING always in the plain layout without the encoding fields). A chunk
+// with NULLs has kNullsFlag set in its type byte and its null bitmap words
+// right after it.
+static constexpr uint8_t kNullsFlag = 0x80;
+
+std::string WriteAheadLog::encodeChunks(const std::string& tableName, const std::vector<ColumnChunk>& chunks) {
+    std::string out;
+    auto put = [&out](const void* p, size_t n) { out.append(static_cast<const char*>(p), n); };
+    uint32_t nameLen = static_cast<uint32_t>(tableName.size());
+    uint32_t columnCount = static_cast<uint32_t>(chunks.size());
+    uint32_t rowCount = chunks.empty() ? 0 : static_cast<uint32_t>(chunks[0].size());
+    put(&nameLen, 4);
+    out.append(tableName);
+    put(&columnCount, 4);
+    put(&rowCount, 4);
+    for (const auto& chunk : chunks) {
+        uint8_t type = static_cast<uint8_t>(chunk.getType());
+        if (chunk.nullCount() > 0) {
+            type |= kNullsFlag;
+        }
+        put(&type, 1);
+        if (chunk.nullCount() > 0) {
+            put(chunk.nullBits(), (size_t(rowCount) + 63) / 64 * 8);
+        }
+        const void* data = nullptr;
+        uint64_t size = 0;
+        switch (chunk.getType()) {
+            case ColumnType::INT:
+                data = chunk.intData();
+                size = uint64_t(rowCount) * 4;
+                break;
+            case ColumnType::FLOAT:
+                data = chunk.floatData();
+                size = uint64_t(rowCount) * 4;
+                break;
+            case ColumnType::BOOLEAN:
+                data = chunk.boolBits();
+                size = (uint64_t(rowCount) + 63) / 64 * 8;
+                break;
+            case ColumnType::STRING: {
+                if (chunk.isDictionary()) {
+                    // Logged decoded; the table encodes it again once appended
+                    ColumnChunk plain(ColumnType::STRING);
+                    plain.appendRange(chunk, 0, rowCount);
+                    size = (uint64_t(rowCount) + 1) * 4 + plain.stringOffsets()[rowCount];
+                    put(&size, 8);
+                    put(plain.stringOffsets(), (size_t(rowCount) + 1) * 4);
+                    put(plain.stringChars(), plain.stringOffsets()[rowCount]);
+                    continue;
+                }
+                // Offsets are rebased to zero so the chars follow directly
+                uint32_t base = chunk.stringOffsets()[0];
+                uint64_t charCount = chunk.stringOffsets()[rowCount] - base;
+                size = (uint64_t(rowCount) + 1) * 4 + charCount;
+                put(&size, 8);
+                for (size_t i = 0; i <= rowCount; i++) {
+                    uint32_t offset = chunk.stringOffsets()[i] - base;
+                    put(&offset, 4);
+                }
+                put(chunk.stringChars() + base, charCount);
+                continue;
+            }
+        }
+        put(&size, 8);
+        put(data, size);
+    }
+    return out;
+}
+
+std::string WriteAheadLog::decodeChunks(const std::string& payload, std::vector<ColumnChunk>& chunks) {
+    MemoryReader reader(payload.data(), payload.size());
+    uint32_t nameLen = reader.readU32();
+    std::string tableName(reader.take(nameLen), nameLen);
+    uint32_t columnCount = reader.readU32();
+    uint32_t rowCount = reader.readU32();
+    chunks.clear();
+    for (uint32_t c = 0; c < columnCount; c++) {
+        uint8_t type = reader.readU8();
+        std::vector<uint64_t> nulls;
+        if (type & kNullsFlag) {
+            type &= ~kNullsFlag;
+            nulls.resize((size_t(rowCount) + 63) / 64);
+            std::memcpy(nulls.data(), reader.take(nulls.size() * 8), nulls.size() * 8);
+        }
+        if (type > static_cast<uint8_t>(ColumnType::BOOLEAN)) {
+            throw std::runtime_error("Corrupt write-ahead log record");
+        }
+        uint64_t size = reader.readU64();
+        const char* data = reader.take(size);
+        // The payload carries no alignment, so go through aligned copies
+        ColumnChunk chunk(static_cast<ColumnType>(type));
+        switch (chunk.getType()) {
+            case ColumnType::INT: {
+                std::vector<int> values(rowCount);
+                if (size != uint64_t(rowCount) * 4) {
+                    throw std::runtime_error("Corrupt write-ahead log record");
+                }
+                std::memcpy(values.data(), data, size);
+                chunk.appendInts(values.data(), rowCount);
+                break;
+            }
+            case ColumnType::FLOAT: {
+                std::vector<float> values(rowCount);
+                if (size != uint64_t(rowCount) * 4) {
+                    throw std::runtime_error("Corrupt write-ahead log record");
+                }
+                std::memcpy(values.data(), data, size);
+                chunk.appendFloats(values.data(), rowCount);
+                break;
+            }
+            case ColumnType::BOOLEAN: {
+                std::vector<uint64_t> words((rowCount + 63) / 64);
+                if (size != words.size() * 8) {
+                    throw std::runtime_error("Corrupt write-ahead log record");
+                }
+                std::memcpy(words.data(), data, size);
+                chunk.appendBools(words.data(), rowCount);
+                break;
+            }
+            case ColumnType::STRING: {
+                std::vector<uint32_t> offsets(uint64_t(rowCount) + 1);
+                uint64_t fixed = offsets.size() * 4;
+                if (size < fixed) {
+                    throw std::runtime_error("Corrupt write-ahead log record");
+                }
+                std::memcpy(offsets.data(), data, fixed);
+                if (offsets[0] != 0 || offsets[rowCount] != size - fixed) {
+                    throw std::runtime_error("Corrupt write-ahead log record");
+                }
+                chunk.appendStrings(offsets.data(), data + fixed, rowCount);
+                break;
+            }
+        }
+        if (!nulls.empty()) {
+            chunk.setNulls(nulls.data());
+        }
+        chunks.push_back(std::move(chunk));
+    }
+    return tableName;
+}
@@ -0,0 +1,90 @@
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Row.h"
+#include "ColumnChunk.h"
+
+// When appended records are forced to disk
+enum class SyncPolicy {
+    EVERY_STATEMENT, // each append returns once its record is durable
+    INTERVAL,        // a background thread syncs every intervalMs
+    BATCH            // sync once batchRecords records are pending
+};
+
+struct WalOptions {
+    SyncPolicy policy = SyncPolicy::EVERY_STATEMENT;
+    int intervalMs = 10;
+    size_t batchRecords = 64;
+};
+
+enum class WalRecordType : uint8_t {
+    INSERT = 1,    // payload: encodeRows()
+    STATEMENT = 2, // payload: DDL, DELETE or UPDATE statement text, replayed through the parser
+    CHUNKS = 3     // payload: encodeChunks(), a bulk-loaded batch
+};
+
+struct WalRecord {
+    WalRecordType type;
+    uint64_t lsn;
+    std::string payload;
+};
+
+// Append-only redo log. A record on disk is
+//   u32 payload size, u32 crc32 of (type, lsn, payload), u8 type, u64 lsn, payload
+// Appends are buffered in memory and written with one write + fsync per
+// group: whichever committer finds no flush in progress writes out everything
+// buffered so far, including records appended by other threads meanwhile.
+class WriteAheadLog {
+private:
+    std::string fileName;
+    int fd = -1;
+    WalOptions options;
+
+    std::mutex mutex;
+    std::condition_variable flushed;
+    std::string buffer;          // encoded records not yet written
+    size_t pendingRecords = 0;
+    uint64_t nextLsn = 1;
+    uint64_t durableLsn = 0;
+    bool flushing = false;
+    bool stopping = false;
+    std::thread syncThread;      // INTERVAL policy only
+
+    void flushUpTo(uint64_t lsn, std::unique_lock<std::mutex>& lock);
+    void syncLoop();
+
+public:
+    WriteAheadLog(const std::string& fileName, const WalOptions& options); // throws std::runtime_error
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Reads every intact record in order; a torn or corrupt tail is cut off.
+    // Call before the first append. Returns the number of records read.
+    size_t replay(const std::function<void(const WalRecord&)>& apply);
+
+    uint64_t append(WalRecordType type, const std::string& payload);
+    void sync(); // make everything appended so far durable
+    void truncate(uint64_t checkpointLsn); // drop records covered by a snapshot
+
+    uint64_t getLastLsn();
+    void setLastLsn(uint64_t lsn); // continue numbering after a snapshot's LSN
+    const std::string& getFileName() const;
+
+    static std::string encodeRows(const std::string& tableName, const std::vector<Row>& rows);
+    static std::string decodeRows(const std::string& payload, std::vector<Row>& rows); // returns table name
+    // One chunk per column, all of the same length; values are copied as raw
+    // typed arrays rather than row by row
+    static std::string encodeChunks(const std::string& tableName, const std::vector<ColumnChunk>& chunks);
+    static std::string decodeChunks(const std::string& payload, std::vector<ColumnChunk>& chunks); // returns table name
+};
+
+#endif //WRITEAHEADLOG_H
@@ -0,0 +1,223 @@
+#include "ZoneMap.h"
+#include "CopyOnWrite.h"
+#include <cmath>
+#include <limits>
+
+// Rows read from storage at a time when computing statistics; divides kZoneRows
+static constexpr size_t kStepRows = 1024;
+
+size_t zoneRowCount(size_t zone, size_t rowCount) {
+    size_t first = zone * kZoneRows;
+    return first < rowCount ? std::min(kZoneRows, rowCount - first) : 0;
+}
+
+// Bounds of the non-NULL values among n typed ones, folded into a zone as a
+// whole so a run of values costs one Value comparison rather than one each
+template <typename T>
+struct RunBounds {
+    T min{};
+    T max{};
+    bool any = false;
+    bool nan = false;
+    uint32_t nulls = 0;
+};
+
+template <typename T, typename Get, typename IsNull>
+static RunBounds<T> runBounds(size_t n, Get get, IsNull isNullAt) {
+    RunBounds<T> bounds;
+    for (size_t i = 0; i < n; i++) {
+        if (isNullAt(i)) {
+            bounds.nulls++;
+            continue;
+        }
+        T v = get(i);
+        if constexpr (std::is_floating_point_v<T>) {
+            if (std::isnan(v)) {
+                bounds.nan = true;
+                continue;
+            }
+        }
+        if (!bounds.any) {
+            bounds.min = v;
+            bounds.max = v;
+            bounds.any = true;
+        } else if (v < bounds.min) {
+            bounds.min = v;
+        } else if (bounds.max < v) {
+            bounds.max = v;
+        }
+    }
+    return bounds;
+}
+
+// A zone shared with a snapshot is copied first (see soleOwner)
+std::vector<Zone>& ZoneMap::zoneAt(size_t row) {
+    size_t zone = row / kZoneRows;
+    while (zones.size() <= zone) {
+        zones.push_back(std::make_shared<std::vector<Zone>>(types.size()));
+    }
+    return unshare(zones[zone]);
+}
+
+Zone& ZoneMap::zoneFor(size_t col, size_t row) {
+    return zoneAt(row)[col];
+}
+
+void ZoneMap::include(size_t col, Zone& zone, const Value& value) {
+    if (isNull(value)) {
+        zone.nullCount++;
+        return;
+    }
+    if (types[col] == ColumnType::BOOLEAN) {
+        return;
+    }
+    if (types[col] == ColumnType::FLOAT && std::isnan(std::get<float>(value))) {
+        zone.min = -std::numeric_limits<float>::infinity();
+        zone.max = std::numeric_limits<float>::infinity();
+        return;
+    }
+    if (isNull(zone.min)) {
+        zone.min = value;
+        zone.max = value;
+    } else if (value < zone.min) {
+        zone.min = value;
+    } else if (zone.max < value) {
+        zone.max = value;
+    }
+}
+
+// Leading rows up to a multiple of 64 are read one at a time, the rest in
+// steps through the typed batch accessors
+void ZoneMap::includeRows(const TableStorage& storage, size_t col, size_t first, size_t last) {
+    size_t r = first;
+    for (; r < last && r % 64 != 0; r++) {
+        include(col, zoneFor(col, r), toValue(storage.getValue(r, col)));
+    }
+    std::vector<uint64_t> nullScratch;
+    std::vector<int> ints;
+    std::vector<float> floats;
+    std::vector<std::string_view> strings;
+    while (r < last) {
+        size_t n = std::min(kStepRows - r % kStepRows, last - r);
+        Zone& zone = zoneFor(col, r);
+        const uint64_t* nulls = storage.getNulls(col, r, n, nullScratch);
+        auto isNullAt = [nulls](size_t i) { return nulls && ((nulls[i >> 6] >> (i & 63)) & 1); };
+        auto fold = [&](const auto& bounds) {
+            zone.nullCount += bounds.nulls;
+            if (bounds.nan) {
+                include(col, zone, std::numeric_limits<float>::quiet_NaN());
+            }
+            if (bounds.any) {
+                include(col, zone, Value(bounds.min));
+                include(col, zone, Value(bounds.max));
+            }
+        };
+        switch (types[col]) {
+            case ColumnType::INT: {
+                const int* values = storage.getInts(col, r, n, ints);
+                fold(runBounds<int>(n, [values](size_t i) { return values[i]; }, isNullAt));
+                break;
+            }
+            case ColumnType::FLOAT: {
+                const float* values = storage.getFloats(col, r, n, floats);
+                fold(runBounds<float>(n, [values](size_t i) { return values[i]; }, isNullAt));
+                break;
+            }
+            case ColumnType::STRING: {
+                storage.getStrings(col, r, n, strings);
+                RunBounds<std::string_view> bounds =
+                    runBounds<std::string_view>(n, [&strings](size_t i) { return strings[i]; }, isNullAt);
+                zone.nullCount += bounds.nulls;
+                if (bounds.any) {
+                    include(col, zone, std::string(bounds.min));
+                    include(col, zone, std::string(bounds.max));
+                }
+                break;
+            }
+            case ColumnType::BOOLEAN:
+                for (size_t i = 0; i < n; i++) {
+                    zone.nullCount += isNullAt(i);
+                }
+                break;
+        }
+        r += n;
+    }
+}
+
+// Existing rows all read as the fill, so every zone has the same bounds
+void ZoneMap::addColumn(ColumnType type, const Value& fill, size_t rowCount) {
+    size_t col = types.size();
+    types.push_back(type);
+    size_t count = std::max(zones.size(), (rowCount + kZoneRows - 1) / kZoneRows);
+    for (size_t z = 0; z < count; z++) {
+        std::vector<Zone>& columns = zoneAt(z * kZoneRows);
+        columns.resize(col + 1);
+        Zone& zone = columns[col];
+        if (isNull(fill)) {
+            zone.nullCount = static_cast<uint32_t>(zoneRowCount(z, rowCount));
+        } else {
+            include(col, zone, fill);
+        }
+    }
+}
+
+void ZoneMap::dropColumn(size_t col) {
+    types.erase(types.begin() + static_cast<std::ptrdiff_t>(col));
+    for (size_t z = 0; z < zones.size(); z++) {
+        std::vector<Zone>& columns = zoneAt(z * kZoneRows);
+        columns.erase(columns.begin() + static_cast<std::ptrdiff_t>(col));
+    }
+}
+
+void ZoneMap::clearColumns() {
+    types.clear();
+    zones.clear();
+}
+
+void ZoneMap::clearRows() {
+    zones.clear();
+}
+
+void ZoneMap::addRow(size_t row, const Row& values) {
+    std::vector<Zone>& columns = zoneAt(row);
+    for (size_t c = 0; c < types.size() && c < values.size(); c++) {
+        include(c, columns[c], values.getValue(static_cast<int>(c)));
+    }
+}
+
+void ZoneMap::addRows(const TableStorage& storage, size_t first, size_t last) {
+    for (size_t c = 0; c < types.size(); c++) {
+        includeRows(storage, c, first, last);
+    }
+}
+
+void ZoneMap::removeRow(const TableStorage& storage, size_t row) {
+    std::vector<Zone>& columns = zoneAt(row);
+    for (size_t c = 0; c < types.size(); c++) {
+        if (std::holds_alternative<std::monostate>(storage.getValue(row, c))) {
+            columns[c].nullCount--;
+        }
+    }
+}
+
+void ZoneMap::rebuild(const TableStorage& storage, size_t firstRow) {
+    size_t zone = firstRow / kZoneRows;
+    zones.resize(std::min(zones.size(), zone));
+    addRows(storage, std::min(zone * kZoneRows, storage.getRowCount()), storage.getRowCount());
+}
+
+void ZoneMap::setZone(size_t zone, const std::vector<Zone>& columns) {
+    std::vector<Zone>& target = zoneAt(zone * kZoneRows);
+    for (size_t c = 0; c < types.size() && c < columns.size(); c++) {
+        target[c] = columns[c];
+    }
+}
+
+size_t ZoneMap::getZoneCount() const {
+    return zones.size();
+}
+
+const Zone& ZoneMap::getZone(size_t col, size_t zone) const {
+    static const Zone unknown;
+    return zone < zones.size() ? (*zones[zone])[col] : unknown;
+}
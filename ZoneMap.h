@@ -0,0 +1,72 @@
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Column.h"
+#include "Row.h"
+#include "TableStorage.h"
+
+// Rows per zone; zone z covers rows [z * kZoneRows, (z + 1) * kZoneRows),
+// the same rows as a COLUMNAR chunk and a file row group
+constexpr size_t kZoneRows = kChunkRows;
+
+// Statistics of one column over one zone. min and max bound the non-NULL
+// values of INT, FLOAT and STRING columns and are NULL when there are none
+// (or for BOOLEAN columns, which only count NULLs). A FLOAT NaN widens the
+// bounds to -inf..inf, since it compares false against everything.
+struct Zone {
+    Value min = std::monostate{};
+    Value max = std::monostate{};
+    uint32_t nullCount = 0;
+};
+
+// Per-zone statistics of every column of a table, so a scan can skip the
+// zones a predicate can't match (see Filter). Table keeps them in step with
+// its rows: appends extend the last zone, and updates only ever widen the
+// bounds, so they stay correct but may get loose until the rows are
+// rewritten (compaction, a row erase) and the zones rebuilt.
+//
+// A table shares the zones with its snapshots and copies one before
+// changing it, so taking a snapshot costs a pointer per zone and a write
+// copies only the zones it touches (usually just the last).
+class ZoneMap {
+private:
+    std::vector<ColumnType> types;
+    std::vector<std::shared_ptr<std::vector<Zone>>> zones; // [zone][column]
+
+    std::vector<Zone>& zoneAt(size_t row);
+    Zone& zoneFor(size_t col, size_t row);
+    void include(size_t col, Zone& zone, const Value& value);
+    void includeRows(const TableStorage& storage, size_t col, size_t first, size_t last);
+
+public:
+    void addColumn(ColumnType type, const Value& fill, size_t rowCount);
+    void dropColumn(size_t col);
+    void clearColumns();
+    void clearRows();
+
+    // Takes in row `row`, just appended or written
+    void addRow(size_t row, const Row& values);
+    // Takes in rows [first, last) of storage, just appended
+    void addRows(const TableStorage& storage, size_t first, size_t last);
+    // Before row `row` of storage is overwritten: its NULLs stop counting
+    void removeRow(const TableStorage& storage, size_t row);
+    // Recomputes the zones from the one holding firstRow on, after rows
+    // from there moved
+    void rebuild(const TableStorage& storage, size_t firstRow = 0);
+
+    // Replaces the statistics of one zone of every column, for rows loaded
+    // together with their saved statistics
+    void setZone(size_t zone, const std::vector<Zone>& columns);
+
+    size_t getZoneCount() const;
+    // A zone the column has no statistics for reads as Zone{}: no bounds
+    const Zone& getZone(size_t col, size_t zone) const;
+};
+
+// Rows [zone * kZoneRows, ...) of a table of rowCount rows that zone holds
+size_t zoneRowCount(size_t zone, size_t rowCount);
+
+#endif //ZONEMAP_H
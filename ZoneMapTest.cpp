@@ -0,0 +1,94 @@
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include "Database.h"
+#include "QueryParser.h"
+#include "ZoneMap.h"
+
+// Zone-map pruning with NULLs: a scan skips the zones whose statistics rule
+// a predicate out, and NULLs neither match a comparison nor keep IS NULL
+// from skipping a zone without any. Counts are checked against the rows
+// the test wrote, so a zone skipped wrongly shows up as missing rows.
+//
+// Zone 0: v is NULL in every row
+// Zone 1: v = row number, no NULLs
+// Zone 2: v is NULL in even rows, 1000000 + row number in odd ones
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+static std::string run(QueryParser& parser, std::ostringstream& out, const std::string& query) {
+    out.str("");
+    parser.parseQuery(query);
+    return out.str();
+}
+
+// COUNT(*) of the rows matching the condition, and the zones its scan skipped
+static void checkCount(QueryParser& parser, std::ostringstream& out, const std::string& condition,
+                       long long count, int skipped) {
+    std::string result = run(parser, out, "SELECT COUNT(*) FROM t WHERE " + condition);
+    check(result == "COUNT(*)\n" + std::to_string(count) + "\n", condition + ": " + std::to_string(count) + " rows");
+    std::string plan = run(parser, out, "EXPLAIN SELECT COUNT(*) FROM t WHERE " + condition);
+    std::string zones = "zones skipped " + std::to_string(skipped) + " of 3";
+    check(plan.find(zones) != std::string::npos, condition + ": " + zones);
+}
+
+static void testNulls(const std::string& mode) {
+    Database db;
+    std::ostringstream out;
+    QueryParser parser(db, out);
+    parser.setOutputFormat(OutputFormat::TSV);
+    run(parser, out, "CREATE TABLE t (id INTEGER, v INTEGER) USING " + mode);
+    const int rows = 3 * static_cast<int>(kZoneRows);
+    for (int first = 0; first < rows; first += 1024) {
+        std::string insert = "INSERT INTO t (id, v) VALUES ";
+        for (int id = first; id < first + 1024; id++) {
+            std::string v;
+            if (id < static_cast<int>(kZoneRows) || (id >= 2 * static_cast<int>(kZoneRows) && id % 2 == 0)) {
+                v = "NULL";
+            } else if (id < 2 * static_cast<int>(kZoneRows)) {
+                v = std::to_string(id);
+            } else {
+                v = std::to_string(1000000 + id);
+            }
+            insert += (id > first ? ", (" : "(") + std::to_string(id) + ", " + v + ")";
+        }
+        run(parser, out, insert);
+    }
+    long long zone = kZoneRows;
+
+    checkCount(parser, out, "v IS NULL", zone + zone / 2, 1);
+    checkCount(parser, out, "v IS NOT NULL", zone + zone / 2, 1);
+    checkCount(parser, out, "v < 1000000", zone, 2);
+    checkCount(parser, out, "v >= 1000000", zone / 2, 2);
+    checkCount(parser, out, "v = 5", 0, 3);
+    checkCount(parser, out, "v IS NULL OR v = " + std::to_string(zone + 3), zone + zone / 2 + 1, 0);
+    checkCount(parser, out, "v IS NULL AND id < 10", 10, 2);
+
+    // A NULL written into zone 1 stops IS NULL skipping it
+    run(parser, out, "UPDATE t SET v = NULL WHERE id = " + std::to_string(zone + 7));
+    checkCount(parser, out, "v IS NULL", zone + zone / 2 + 1, 0);
+    checkCount(parser, out, "v < 1000000", zone - 1, 2);
+
+    // Filling zone 0 with values keeps IS NOT NULL from skipping it
+    run(parser, out, "UPDATE t SET v = 1 WHERE id < 4");
+    checkCount(parser, out, "v IS NOT NULL", zone + zone / 2 + 3, 0);
+    checkCount(parser, out, "v < 1000000", zone + 3, 1);
+}
+
+int main() {
+    for (const std::string mode : {"ROW", "COLUMNAR"}) {
+        testNulls(mode);
+    }
+    if (failures > 0) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,654 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "Database.h"
+#include "QueryParser.h"
+
+// projectDB_bench: rows/sec, latency percentiles and peak memory of the main
+// paths (INSERT, COPY, full and filtered scans, GROUP BY, save, load) on a
+// synthetic table. Every cell is a hash of the seed, its row and its column,
+// so the same options give the same data on every version and machine.
+//
+// projectDB_bench [options]
+//   --rows N              rows in the table (default 1000000)
+//   --columns SPEC        column mix besides id and grp, e.g. int:2,float:1,string:2,bool:1
+//   --string-length A[:B] string lengths, uniform in [A, B] (default 8:32)
+//   --nulls F             share of NULLs in INTEGER, FLOAT and BOOLEAN columns (default 0)
+//   --groups N            distinct grp values, the GROUP BY key (default 100)
+//   --seed N              data seed (default 42)
+//   --storage row|columnar
+//   --threads N           scan workers, 0 = one per core (default 0)
+//   --iterations N        timed runs of each scan, load and save (default 10)
+//   --insert-rows N       rows inserted by INSERT statements (default 100000)
+//   --insert-batch N      rows per INSERT statement (default 100)
+//   --format text|tsv|csv|binary   SELECT output format (default text)
+//   --dir PATH            where the CSV and database files go (default .)
+//   --json FILE           also write the report as JSON; - writes only JSON to stdout
+//
+// Scans count every row of the table towards rows/sec, matching or not.
+// Peak RSS is the process's high-water mark during a phase (reset before
+// it where the kernel allows), so it includes the table the phase reads.
+
+namespace {
+
+struct BenchOptions {
+    size_t rows = 1000000;
+    std::string columns = "int:2,float:1,string:2,bool:1";
+    size_t minStringLength = 8;
+    size_t maxStringLength = 32;
+    double nullFraction = 0;
+    size_t groups = 100;
+    uint64_t seed = 42;
+    std::string storage = "columnar";
+    size_t threads = 0;
+    size_t iterations = 10;
+    size_t insertRows = 100000;
+    size_t insertBatch = 100;
+    std::string format = "text";
+    std::string dir = ".";
+    std::string json;
+};
+
+struct BenchColumn {
+    std::string name;
+    ColumnType type;
+};
+
+size_t parseSize(const std::string& flag, const std::string& value) {
+    size_t n = 0;
+    auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), n);
+    if (value.empty() || ec != std::errc() || ptr != value.data() + value.size()) {
+        throw std::invalid_argument("Invalid value for " + flag + ": " + value);
+    }
+    return n;
+}
+
+uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// The table: id (the row number), grp (in [0, groups)), then the columns of
+// the spec, named by type: i0, i1, f0, s0, b0, ...
+class Dataset {
+private:
+    const BenchOptions& options;
+    std::vector<BenchColumn> columns;
+
+    uint64_t hash(size_t row, size_t column, uint64_t salt) const {
+        return mix(options.seed ^ mix(row * 1024 + column) ^ mix(salt));
+    }
+
+public:
+    explicit Dataset(const BenchOptions& options) : options(options) {
+        columns.push_back({"id", ColumnType::INT});
+        columns.push_back({"grp", ColumnType::INT});
+        std::stringstream spec(options.columns);
+        std::string item;
+        size_t counts[4] = {};
+        while (std::getline(spec, item, ',')) {
+            size_t colon = item.find(':');
+            std::string type = item.substr(0, colon);
+            size_t count = colon == std::string::npos ? 1 : parseSize("--columns", item.substr(colon + 1));
+            ColumnType columnType;
+            std::string prefix;
+            if (type == "int") {
+                columnType = ColumnType::INT;
+                prefix = "i";
+            } else if (type == "float") {
+                columnType = ColumnType::FLOAT;
+                prefix = "f";
+            } else if (type == "string") {
+                columnType = ColumnType::STRING;
+                prefix = "s";
+            } else if (type == "bool") {
+                columnType = ColumnType::BOOLEAN;
+                prefix = "b";
+            } else {
+                throw std::invalid_argument("Unknown column type in --columns: " + type);
+            }
+            for (size_t i = 0; i < count; i++) {
+                size_t& n = counts[static_cast<int>(columnType)];
+                columns.push_back({prefix + std::to_string(n++), columnType});
+            }
+        }
+    }
+
+    const std::vector<BenchColumn>& getColumns() const {
+        return columns;
+    }
+
+    // First column of a type after id and grp, or -1
+    int find(ColumnType type) const {
+        for (size_t c = 2; c < columns.size(); c++) {
+            if (columns[c].type == type) {
+                return static_cast<int>(c);
+            }
+        }
+        return -1;
+    }
+
+    std::string createStatement(const std::string& table) const {
+        std::string sql = "CREATE TABLE " + table + " (";
+        static const char* const types[] = {"INTEGER", "FLOAT", "STRING", "BOOLEAN"};
+        for (size_t c = 0; c < columns.size(); c++) {
+            sql += (c ? ", " : "") + columns[c].name + " " + types[static_cast<int>(columns[c].type)];
+        }
+        return sql + ") USING " + (options.storage == "row" ? "ROW" : "COLUMNAR");
+    }
+
+    // Appends the text of a cell; false for NULL, which appends nothing.
+    // INTEGERs are uniform in [0, 1000000), FLOATs in [0, 100000) with two
+    // decimals, strings are lowercase letters.
+    bool appendCell(std::string& out, size_t row, size_t column) const {
+        const BenchColumn& col = columns[column];
+        if (column == 0) {
+            out += std::to_string(row);
+            return true;
+        }
+        uint64_t h = hash(row, column, 0);
+        if (column == 1) {
+            out += std::to_string(h % options.groups);
+            return true;
+        }
+        if (col.type != ColumnType::STRING && options.nullFraction > 0 &&
+            static_cast<double>(hash(row, column, 1) >> 11) * 0x1.0p-53 < options.nullFraction) {
+            return false;
+        }
+        char text[32];
+        switch (col.type) {
+            case ColumnType::INT:
+                out += std::to_string(h % 1000000);
+                break;
+            case ColumnType::FLOAT:
+                std::snprintf(text, sizeof(text), "%.2f", static_cast<double>(h % 10000000) / 100);
+                out += text;
+                break;
+            case ColumnType::BOOLEAN:
+                out += h & 1 ? "true" : "false";
+                break;
+            case ColumnType::STRING: {
+                size_t span = options.maxStringLength - options.minStringLength + 1;
+                size_t length = options.minStringLength + h % span;
+                for (size_t i = 0; i < length; i++) {
+                    if (i % 12 == 0) {
+                        h = mix(h);
+                    }
+                    out += static_cast<char>('a' + (h >> (i % 12 * 5)) % 26);
+                }
+                break;
+            }
+        }
+        return true;
+    }
+
+    void appendSqlRow(std::string& out, size_t row) const {
+        out += "(";
+        for (size_t c = 0; c < columns.size(); c++) {
+            if (c) {
+                out += ", ";
+            }
+            bool quoted = columns[c].type == ColumnType::STRING;
+            if (quoted) {
+                out += "'";
+            }
+            if (!appendCell(out, row, c)) {
+                out += "NULL";
+            }
+            if (quoted) {
+                out += "'";
+            }
+        }
+        out += ")";
+    }
+
+    // Empty fields load as NULL; the strings have no quotes or commas
+    void appendCsvRow(std::string& out, size_t row) const {
+        for (size_t c = 0; c < columns.size(); c++) {
+            if (c) {
+                out += ",";
+            }
+            appendCell(out, row, c);
+        }
+        out += "\n";
+    }
+};
+
+// Counts SELECT output and throws it away
+class CountingBuffer : public std::streambuf {
+public:
+    uint64_t bytes = 0;
+
+protected:
+    int overflow(int c) override {
+        bytes++;
+        return c == EOF ? 0 : c;
+    }
+    std::streamsize xsputn(const char*, std::streamsize n) override {
+        bytes += static_cast<uint64_t>(n);
+        return n;
+    }
+};
+
+// Lets the kernel's peak RSS (VmHWM) start again from the current RSS, so a
+// phase's peak isn't an earlier phase's; not allowed everywhere
+bool resetPeakRss() {
+    std::ofstream file("/proc/self/clear_refs");
+    file << "5";
+    file.flush();
+    return static_cast<bool>(file);
+}
+
+long peakRssKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stol(line.substr(6));
+        }
+    }
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+struct PhaseResult {
+    std::string name;
+    std::string statement;
+    uint64_t rows = 0;  // rows processed over all timed operations
+    uint64_t bytes = 0; // output or file bytes over all timed operations
+    std::vector<double> millis; // one per timed operation
+    long peakRssKb = 0;
+
+    double totalMillis() const {
+        double total = 0;
+        for (double ms : millis) {
+            total += ms;
+        }
+        return total;
+    }
+
+    double rowsPerSecond() const {
+        double total = totalMillis();
+        return total > 0 ? static_cast<double>(rows) * 1000 / total : 0;
+    }
+
+    // Nearest rank
+    double percentile(double p) const {
+        std::vector<double> sorted = millis;
+        std::sort(sorted.begin(), sorted.end());
+        size_t rank = static_cast<size_t>(std::ceil(p / 100 * static_cast<double>(sorted.size())));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+};
+
+double millisSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// One untimed run, then iterations timed ones
+PhaseResult timeQuery(QueryParser& parser, CountingBuffer& output, const std::string& name,
+                      const std::string& query, size_t rows, size_t iterations) {
+    PhaseResult result;
+    result.name = name;
+    result.statement = query;
+    parser.parseQuery(query);
+    resetPeakRss();
+    for (size_t i = 0; i < iterations; i++) {
+        uint64_t bytes = output.bytes;
+        auto start = std::chrono::steady_clock::now();
+        parser.parseQuery(query);
+        result.millis.push_back(millisSince(start));
+        result.bytes += output.bytes - bytes;
+        result.rows += rows;
+    }
+    result.peakRssKb = peakRssKb();
+    return result;
+}
+
+BenchOptions parseOptions(int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--help" || flag == "-h") {
+            throw std::invalid_argument("");
+        }
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + flag);
+        }
+        std::string value = argv[++i];
+        if (flag == "--rows") {
+            options.rows = parseSize(flag, value);
+        } else if (flag == "--columns") {
+            options.columns = value;
+        } else if (flag == "--string-length") {
+            size_t colon = value.find(':');
+            options.minStringLength = parseSize(flag, value.substr(0, colon));
+            options.maxStringLength =
+                colon == std::string::npos ? options.minStringLength : parseSize(flag, value.substr(colon + 1));
+        } else if (flag == "--nulls") {
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), options.nullFraction);
+            if (value.empty() || ec != std::errc() || ptr != value.data() + value.size()) {
+                throw std::invalid_argument("Invalid value for --nulls: " + value);
+            }
+        } else if (flag == "--groups") {
+            options.groups = parseSize(flag, value);
+        } else if (flag == "--seed") {
+            options.seed = parseSize(flag, value);
+        } else if (flag == "--storage") {
+            options.storage = value;
+        } else if (flag == "--threads") {
+            options.threads = parseSize(flag, value);
+        } else if (flag == "--iterations") {
+            options.iterations = parseSize(flag, value);
+        } else if (flag == "--insert-rows") {
+            options.insertRows = parseSize(flag, value);
+        } else if (flag == "--insert-batch") {
+            options.insertBatch = parseSize(flag, value);
+        } else if (flag == "--format") {
+            options.format = value;
+        } else if (flag == "--dir") {
+            options.dir = value;
+        } else if (flag == "--json") {
+            options.json = value;
+        } else {
+            throw std::invalid_argument("Unknown option " + flag);
+        }
+    }
+    if (options.storage != "row" && options.storage != "columnar") {
+        throw std::invalid_argument("--storage must be row or columnar");
+    }
+    if (options.maxStringLength < options.minStringLength) {
+        throw std::invalid_argument("--string-length must be MIN[:MAX] with MIN <= MAX");
+    }
+    if (options.nullFraction < 0 || options.nullFraction > 1) {
+        throw std::invalid_argument("--nulls must be between 0 and 1");
+    }
+    if (options.rows == 0 || options.iterations == 0 || options.insertBatch == 0 || options.groups == 0) {
+        throw std::invalid_argument("--rows, --iterations, --insert-batch and --groups must be positive");
+    }
+    parseOutputFormat(options.format); // throws if unknown
+    Dataset check(options);             // and so does a bad column spec
+    return options;
+}
+
+std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char text[8];
+            std::snprintf(text, sizeof(text), "\\u%04x", c);
+            out += text;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+std::string jsonNumber(double v, int decimals = 3) {
+    char text[64];
+    std::snprintf(text, sizeof(text), "%.*f", decimals, v);
+    return text;
+}
+
+void writeJson(std::ostream& out, const BenchOptions& options, size_t threads, bool optimized,
+               const std::vector<PhaseResult>& results) {
+    out << "{\n";
+    out << "  \"benchmark\": \"projectDB_bench\",\n";
+    out << "  \"timestamp\": " << static_cast<long long>(std::time(nullptr)) << ",\n";
+    out << "  \"optimized_build\": " << (optimized ? "true" : "false") << ",\n";
+    out << "  \"config\": {\n";
+    out << "    \"rows\": " << options.rows << ",\n";
+    out << "    \"columns\": " << jsonString(options.columns) << ",\n";
+    out << "    \"string_length\": [" << options.minStringLength << ", " << options.maxStringLength << "],\n";
+    out << "    \"null_fraction\": " << jsonNumber(options.nullFraction, 6) << ",\n";
+    out << "    \"groups\": " << options.groups << ",\n";
+    out << "    \"seed\": " << options.seed << ",\n";
+    out << "    \"storage\": " << jsonString(options.storage) << ",\n";
+    out << "    \"threads\": " << threads << ",\n";
+    out << "    \"iterations\": " << options.iterations << ",\n";
+    out << "    \"insert_rows\": " << options.insertRows << ",\n";
+    out << "    \"insert_batch\": " << options.insertBatch << ",\n";
+    out << "    \"format\": " << jsonString(options.format) << "\n";
+    out << "  },\n";
+    out << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const PhaseResult& r = results[i];
+        out << (i ? "," : "") << "\n    {\n";
+        out << "      \"name\": " << jsonString(r.name) << ",\n";
+        if (!r.statement.empty()) {
+            out << "      \"statement\": " << jsonString(r.statement) << ",\n";
+        }
+        out << "      \"operations\": " << r.millis.size() << ",\n";
+        out << "      \"rows\": " << r.rows << ",\n";
+        out << "      \"bytes\": " << r.bytes << ",\n";
+        out << "      \"total_ms\": " << jsonNumber(r.totalMillis()) << ",\n";
+        out << "      \"rows_per_sec\": " << jsonNumber(r.rowsPerSecond(), 0) << ",\n";
+        out << "      \"latency_ms\": {\"min\": " << jsonNumber(r.percentile(0)) << ", \"p50\": "
+            << jsonNumber(r.percentile(50)) << ", \"p90\": " << jsonNumber(r.percentile(90)) << ", \"p99\": "
+            << jsonNumber(r.percentile(99)) << ", \"max\": " << jsonNumber(r.percentile(100)) << ", \"mean\": "
+            << jsonNumber(r.totalMillis() / static_cast<double>(r.millis.size())) << "},\n";
+        out << "      \"peak_rss_kb\": " << r.peakRssKb << "\n";
+        out << "    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+void printTable(const std::vector<PhaseResult>& results) {
+    std::printf("%-14s %6s %14s %10s %10s %10s %10s %10s\n", "phase", "ops", "rows/s", "p50 ms", "p90 ms",
+                "p99 ms", "max ms", "peak MB");
+    for (const PhaseResult& r : results) {
+        std::printf("%-14s %6zu %14.0f %10.3f %10.3f %10.3f %10.3f %10.1f\n", r.name.c_str(), r.millis.size(),
+                    r.rowsPerSecond(), r.percentile(50), r.percentile(90), r.percentile(99), r.percentile(100),
+                    static_cast<double>(r.peakRssKb) / 1024);
+    }
+}
+
+std::vector<PhaseResult> runBenchmarks(const BenchOptions& options, const Dataset& data, size_t& threads) {
+    std::vector<PhaseResult> results;
+    Database db;
+    db.setThreadCount(options.threads);
+    threads = db.getThreadPool().getThreadCount();
+    CountingBuffer output;
+    std::ostream out(&output);
+    QueryParser parser(db, out);
+    parser.setOutputFormat(parseOutputFormat(options.format));
+
+    // INSERT: statements of insertBatch rows each, texts built beforehand
+    {
+        PhaseResult result;
+        result.name = "insert";
+        parser.parseQuery(data.createStatement("bench_insert"));
+        std::string columns;
+        for (const BenchColumn& column : data.getColumns()) {
+            columns += (columns.empty() ? "" : ", ") + column.name;
+        }
+        std::vector<std::string> statements;
+        for (size_t first = 0; first < options.insertRows; first += options.insertBatch) {
+            std::string sql = "INSERT INTO bench_insert (" + columns + ") VALUES ";
+            size_t last = std::min(options.insertRows, first + options.insertBatch);
+            for (size_t r = first; r < last; r++) {
+                if (r > first) {
+                    sql += ", ";
+                }
+                data.appendSqlRow(sql, r);
+            }
+            statements.push_back(std::move(sql));
+        }
+        resetPeakRss();
+        for (const std::string& sql : statements) {
+            auto start = std::chrono::steady_clock::now();
+            parser.parseQuery(sql);
+            result.millis.push_back(millisSince(start));
+        }
+        result.rows = options.insertRows;
+        result.peakRssKb = peakRssKb();
+        if (!statements.empty()) {
+            results.push_back(std::move(result));
+        }
+        parser.parseQuery("DROP TABLE bench_insert");
+    }
+
+    // COPY of a generated CSV file into a fresh table, iterations times; the
+    // last load is the table the remaining phases read
+    std::string csvFile = options.dir + "/projectDB_bench.csv";
+    {
+        std::ofstream csv(csvFile, std::ios::binary);
+        std::string text;
+        for (size_t r = 0; r < options.rows; r++) {
+            data.appendCsvRow(text, r);
+            if (text.size() > (1 << 20)) {
+                csv << text;
+                text.clear();
+            }
+        }
+        csv << text;
+        if (!csv) {
+            throw std::runtime_error("Cannot write " + csvFile);
+        }
+    }
+    {
+        PhaseResult result;
+        result.name = "bulk_load";
+        result.statement = "COPY bench FROM '" + csvFile + "'";
+        std::ifstream csv(csvFile, std::ios::binary | std::ios::ate);
+        uint64_t csvBytes = static_cast<uint64_t>(csv.tellg());
+        resetPeakRss();
+        for (size_t i = 0; i < options.iterations; i++) {
+            if (db.GetTable("bench")) {
+                parser.parseQuery("DROP TABLE bench");
+            }
+            parser.parseQuery(data.createStatement("bench"));
+            auto start = std::chrono::steady_clock::now();
+            parser.parseQuery(result.statement);
+            result.millis.push_back(millisSince(start));
+            result.rows += options.rows;
+            result.bytes += csvBytes;
+        }
+        result.peakRssKb = peakRssKb();
+        results.push_back(std::move(result));
+    }
+    std::remove(csvFile.c_str());
+
+    // Scans: every column of every row out; a filter keeping about a tenth
+    // of the rows; a GROUP BY over all rows
+    results.push_back(timeQuery(parser, output, "full_scan", "SELECT * FROM bench", options.rows, options.iterations));
+    int filterColumn = data.find(ColumnType::INT);
+    std::string filter = filterColumn >= 0 ? data.getColumns()[filterColumn].name + " < 100000"
+                                           : "grp < " + std::to_string(std::max<size_t>(options.groups / 10, 1));
+    results.push_back(timeQuery(parser, output, "filtered_scan", "SELECT * FROM bench WHERE " + filter,
+                                options.rows, options.iterations));
+    int measure = filterColumn >= 0 ? filterColumn : data.find(ColumnType::FLOAT);
+    std::string x = measure >= 0 ? data.getColumns()[measure].name : "id";
+    results.push_back(timeQuery(parser, output, "aggregate",
+                                "SELECT grp, COUNT(*), SUM(" + x + "), MIN(" + x + "), MAX(" + x +
+                                    ") FROM bench GROUP BY grp",
+                                options.rows, options.iterations));
+
+    // Save, then load the file into a fresh database, read and memory-mapped
+    std::string dbFile = options.dir + "/projectDB_bench.db";
+    {
+        PhaseResult result;
+        result.name = "save";
+        resetPeakRss();
+        for (size_t i = 0; i < options.iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            if (!db.saveToFile(dbFile)) {
+                throw std::runtime_error("Cannot save to " + dbFile);
+            }
+            result.millis.push_back(millisSince(start));
+            result.rows += options.rows;
+            std::ifstream file(dbFile, std::ios::binary | std::ios::ate);
+            result.bytes += static_cast<uint64_t>(file.tellg());
+        }
+        result.peakRssKb = peakRssKb();
+        results.push_back(std::move(result));
+    }
+    for (bool mapped : {false, true}) {
+        PhaseResult result;
+        result.name = mapped ? "load_mmap" : "load";
+        resetPeakRss();
+        for (size_t i = 0; i < options.iterations; i++) {
+            Database loaded;
+            auto start = std::chrono::steady_clock::now();
+            if (!loaded.loadFromFile(dbFile, mapped)) {
+                throw std::runtime_error("Cannot load " + dbFile);
+            }
+            result.millis.push_back(millisSince(start));
+            result.rows += options.rows;
+        }
+        result.peakRssKb = peakRssKb();
+        results.push_back(std::move(result));
+    }
+    std::remove(dbFile.c_str());
+    return results;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        if (*e.what()) {
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+        std::cerr << "usage: projectDB_bench [--rows N] [--columns int:2,float:1,string:2,bool:1]\n"
+                     "       [--string-length MIN[:MAX]] [--nulls F] [--groups N] [--seed N]\n"
+                     "       [--storage row|columnar] [--threads N] [--iterations N]\n"
+                     "       [--insert-rows N] [--insert-batch N] [--format text|tsv|csv|binary]\n"
+                     "       [--dir PATH] [--json FILE|-]" << std::endl;
+        return 2;
+    }
+#ifdef __OPTIMIZE__
+    bool optimized = true;
+#else
+    bool optimized = false;
+    std::cerr << "Warning: unoptimized build; configure with -DCMAKE_BUILD_TYPE=Release" << std::endl;
+#endif
+
+    std::vector<PhaseResult> results;
+    size_t threads = 0;
+    try {
+        Dataset data(options);
+        results = runBenchmarks(options, data, threads);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (options.json == "-") {
+        writeJson(std::cout, options, threads, optimized, results);
+        return 0;
+    }
+    std::printf("%zu rows (%s), %s storage, %zu threads\n", options.rows, options.columns.c_str(),
+                options.storage.c_str(), threads);
+    printTable(results);
+    if (!options.json.empty()) {
+        std::ofstream json(options.json);
+        writeJson(json, options, threads, optimized, results);
+        if (!json) {
+            std::cerr << "Error: cannot write " << options.json << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -1,26 +1,41 @@
 #include <iostream>
 #include <string>
 #include <stdexcept>
+#include <sstream>
 #include "Database.h"
 #include "QueryParser.h"
 
 void printMenu() {
     std::cout << "\n=== SQL Database Management System ===" << std::endl;
     std::cout << "Available commands:" << std::endl;
-    std::cout << "1. CREATE TABLE tablename (col1 TYPE, col2 TYPE, ...)" << std::endl;
+    std::cout << "1. CREATE TABLE tablename (col1 TYPE, col2 TYPE, ...) [USING ROW|COLUMNAR]" << std::endl;
     std::cout << "2. DROP TABLE tablename" << std::endl;
-    std::cout << "3. ALTER TABLE tablename ADD columnname TYPE" << std::endl;
+    std::cout << "3. ALTER TABLE tablename ADD columnname TYPE [NOT NULL] [DEFAULT value]" << std::endl;
     std::cout << "4. ALTER TABLE tablename DROP COLUMN columnname" << std::endl;
     std::cout << "5. ALTER TABLE tablename ALTER COLUMN columnname TYPE" << std::endl;
-    std::cout << "6. INSERT INTO tablename (col1, col2, ...) VALUES (val1, val2, ...)" << std::endl;
-    std::cout << "7. SELECT * FROM tablename" << std::endl;
-    std::cout << "8. SELECT col1, col2 FROM tablename" << std::endl;
-    std::cout << "9. list - Show all tables" << std::endl;
-    std::cout << "10. demo - Run demonstration queries" << std::endl;
-    std::cout << "11. save filename - Save database to file" << std::endl;
-    std::cout << "12. load filename - Load database from file" << std::endl;
-    std::cout << "13. help - Show this menu" << std::endl;
-    std::cout << "14. exit - Exit the program" << std::endl;
+    std::cout << "6. CREATE INDEX indexname ON tablename (column) [USING HASH|BTREE]" << std::endl;
+    std::cout << "7. INSERT INTO tablename (col1, col2, ...) VALUES (val1, val2, ...)[, (...), ...]" << std::endl;
+    std::cout << "8. COPY tablename FROM 'file.csv' [HEADER] [DELIMITER 'c']" << std::endl;
+    std::cout << "9. DELETE FROM tablename [WHERE condition]" << std::endl;
+    std::cout << "10. UPDATE tablename SET col1 = val1, ... [WHERE condition]" << std::endl;
+    std::cout << "11. SELECT * FROM tablename" << std::endl;
+    std::cout << "12. SELECT col1, col2 FROM tablename [WHERE condition]" << std::endl;
+    std::cout << "13. SELECT col, COUNT(*), SUM(c), AVG(c), MIN(c), MAX(c) FROM tablename [WHERE condition] [GROUP BY col, ...]" << std::endl;
+    std::cout << "14. SELECT a.col, b.col FROM a [INNER|LEFT] JOIN b ON a.col = b.col [WHERE condition]" << std::endl;
+    std::cout << "15. PREPARE name AS INSERT ... | SELECT ... (use ? for parameters)" << std::endl;
+    std::cout << "16. EXECUTE name [(val1, val2, ...)] / DEALLOCATE name" << std::endl;
+    std::cout << "17. ANALYZE tablename - Gather statistics for the query planner" << std::endl;
+    std::cout << "18. EXPLAIN [ANALYZE] SELECT ... - Show the query plan (ANALYZE: run it and time each step)" << std::endl;
+    std::cout << "19. list - Show all tables" << std::endl;
+    std::cout << "20. demo - Run demonstration queries" << std::endl;
+    std::cout << "21. save filename - Save database to file" << std::endl;
+    std::cout << "22. load filename - Load database from file" << std::endl;
+    std::cout << "23. mmap filename - Load database by memory-mapping the file" << std::endl;
+    std::cout << "24. wal filename [sync | interval ms | batch n] - Attach a write-ahead log and replay it" << std::endl;
+    std::cout << "25. threads n - Use n worker threads for scans (0 = one per core)" << std::endl;
+    std::cout << "26. format text|tsv|csv|binary - How SELECT results are written" << std::endl;
+    std::cout << "27. help - Show this menu" << std::endl;
+    std::cout << "28. exit - Exit the program" << std::endl;
     std::cout << "\nSupported types: INTEGER, FLOAT, STRING, BOOLEAN" << std::endl;
     std::cout << "=====================================" << std::endl;
 }
@@ -165,6 +180,71 @@ int main() {
             continue;
         }
 
+        // Handle mmap command
+        if (input.substr(0, 4) == "mmap") {
+            if (input.length() > 5) {
+                std::string filename = input.substr(5);
+                if (db.loadFromFile(filename, true)) {
+                    std::cout << "Database mapped from " << filename << std::endl;
+                } else {
+                    std::cout << "Failed to map database from " << filename << std::endl;
+                }
+            } else {
+                std::cout << "Usage: mmap filename" << std::endl;
+            }
+            continue;
+        }
+
+        // Handle wal command: attach a write-ahead log, replaying what it holds
+        if (input.substr(0, 4) == "wal ") {
+            std::istringstream args(input.substr(4));
+            std::string filename, policy;
+            WalOptions options;
+            args >> filename >> policy;
+            if (policy == "interval") {
+                options.policy = SyncPolicy::INTERVAL;
+                args >> options.intervalMs;
+            } else if (policy == "batch") {
+                options.policy = SyncPolicy::BATCH;
+                args >> options.batchRecords;
+            } else if (!policy.empty() && policy != "sync") {
+                std::cout << "Usage: wal filename [sync | interval ms | batch n]" << std::endl;
+                continue;
+            }
+            try {
+                db.attachLog(std::make_unique<WriteAheadLog>(filename, options));
+                size_t replayed = parser.recoverFromLog();
+                std::cout << "Write-ahead log " << filename << " attached, "
+                          << replayed << " records replayed" << std::endl;
+            } catch (const std::exception& e) {
+                db.attachLog(nullptr);
+                std::cout << "Error: " << e.what() << std::endl;
+            }
+            continue;
+        }
+
+        // Handle threads command: resize the scan worker pool
+        if (input.substr(0, 8) == "threads ") {
+            try {
+                db.setThreadCount(std::stoul(input.substr(8)));
+                std::cout << "Using " << db.getThreadPool().getThreadCount() << " worker threads" << std::endl;
+            } catch (const std::exception&) {
+                std::cout << "Usage: threads n" << std::endl;
+            }
+            continue;
+        }
+
+        // Handle format command: how SELECT results are written
+        if (input.substr(0, 7) == "format ") {
+            try {
+                parser.setOutputFormat(parseOutputFormat(input.substr(7)));
+                std::cout << "Output format set to " << input.substr(7) << std::endl;
+            } catch (const std::exception&) {
+                std::cout << "Usage: format text|tsv|csv|binary" << std::endl;
+            }
+            continue;
+        }
+
         // Skip empty input
         if (input.empty()) {
             continue;